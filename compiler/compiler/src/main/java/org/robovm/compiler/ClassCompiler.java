@@ -141,6 +141,11 @@ import static org.robovm.compiler.llvm.Type.*;
  */
 public class ClassCompiler {
     private static final int DUMMY_METHOD_SIZE = 0x01abcdef;
+    /**
+     * Number of entries in the cache of recently used {@link ITable}s in
+     * each ITables struct. Must match ITABLES_CACHE_SIZE in types.h.
+     */
+    private static final int ITABLES_CACHE_SIZE = 4;
     public static final int CI_PUBLIC = 0x1;
     public static final int CI_FINAL = 0x2;
     public static final int CI_INTERFACE = 0x4;
@@ -1208,10 +1213,14 @@ public class ClassCompiler {
             if (tables.isEmpty()) {
                 return new NullConstant(I8_PTR);
             } else {
+                ArrayConstantBuilder cache = new ArrayConstantBuilder(I8_PTR);
+                for (int j = 0; j < ITABLES_CACHE_SIZE; j++) {
+                    cache.add(tables.get(0));
+                }
                 Global itablesStruct = new Global(Symbols.itablesSymbol(getInternalName(sootClass)), Linkage._private,
                         new StructureConstantBuilder()
                             .add(new IntegerConstant((short) tables.size()))
-                            .add(tables.get(0)) // cache value must never be null
+                            .add(cache.build())
                             .add(new ArrayConstantBuilder(I8_PTR).add(tables).build())
                             .build());
                 mb.addGlobal(itablesStruct);
@@ -62,6 +62,7 @@ import org.robovm.compiler.hash.ModifiedUtf8HashFunction;
 import org.robovm.compiler.llvm.Alias;
 import org.robovm.compiler.llvm.ArrayConstant;
 import org.robovm.compiler.llvm.ArrayConstantBuilder;
+import org.robovm.compiler.llvm.Bitcast;
 import org.robovm.compiler.llvm.Constant;
 import org.robovm.compiler.llvm.ConstantBitcast;
 import org.robovm.compiler.llvm.ConstantGetelementptr;
@@ -69,15 +70,21 @@ import org.robovm.compiler.llvm.Function;
 import org.robovm.compiler.llvm.FunctionDeclaration;
 import org.robovm.compiler.llvm.FunctionRef;
 import org.robovm.compiler.llvm.FunctionType;
+import org.robovm.compiler.llvm.Getelementptr;
 import org.robovm.compiler.llvm.Global;
 import org.robovm.compiler.llvm.IntegerConstant;
+import org.robovm.compiler.llvm.Load;
 import org.robovm.compiler.llvm.NullConstant;
+import org.robovm.compiler.llvm.PointerType;
 import org.robovm.compiler.llvm.Ret;
+import org.robovm.compiler.llvm.Store;
 import org.robovm.compiler.llvm.StructureConstant;
 import org.robovm.compiler.llvm.StructureConstantBuilder;
+import org.robovm.compiler.llvm.StructureType;
 import org.robovm.compiler.llvm.Type;
 import org.robovm.compiler.llvm.Unreachable;
 import org.robovm.compiler.llvm.Value;
+import org.robovm.compiler.llvm.Variable;
 import org.robovm.compiler.plugin.CompilerPlugin;
 import org.robovm.llvm.Context;
 import org.robovm.llvm.Module;
@@ -222,6 +229,7 @@ public class Linker {
                 new ModifiedUtf8HashFunction());
         int classCount = 0;
         Map<ClazzInfo, TypeInfo> typeInfos = new HashMap<ClazzInfo, TypeInfo>();
+        Map<Clazz, Global> infoGlobals = new HashMap<Clazz, Global>();
         for (Clazz clazz : linkClasses) {
             TypeInfo typeInfo = new TypeInfo();
             typeInfo.clazz = clazz;
@@ -237,6 +245,7 @@ public class Linker {
                 info = new Global(Symbols.infoStructSymbol(clazz.getInternalName()), infoErrorStruct);
             }
             mb.addGlobal(info);
+            infoGlobals.put(clazz, info);
             if (clazz.isInBootClasspath()) {
                 bcpHashGen.put(clazz.getInternalName(), new ConstantBitcast(info.ref(), I8_PTR));
             } else {
@@ -348,9 +357,10 @@ public class Linker {
                         new StructureConstantBuilder()
                                 .add(new IntegerConstant(typeInfo.id))
                                 .add(new IntegerConstant(0))
-                                .add(new IntegerConstant(-1))
                                 .add(new IntegerConstant(0))
                                 .add(new IntegerConstant(0))
+                                .add(new IntegerConstant(0))
+                                .add(new ArrayConstantBuilder(I32).add(buildInterfaceTable(new int[0])).build())
                                 .build()));
             } else {
                 int[] classIds = new int[typeInfo.classTypes.length];
@@ -361,15 +371,17 @@ public class Linker {
                 for (int i = 0; i < typeInfo.interfaceTypes.length; i++) {
                     interfaceIds[i] = typeInfo.interfaceTypes[i].id;
                 }
+                int[] interfaceTable = buildInterfaceTable(interfaceIds);
                 mb.addGlobal(new Global(Symbols.typeInfoSymbol(clazz.getInternalName()),
                         new StructureConstantBuilder()
                                 .add(new IntegerConstant(typeInfo.id))
                                 .add(new IntegerConstant((typeInfo.classTypes.length - 1) * 4 + 5 * 4))
-                                .add(new IntegerConstant(-1))
+                                .add(new IntegerConstant(interfaceTable.length - 1))
                                 .add(new IntegerConstant(typeInfo.classTypes.length))
                                 .add(new IntegerConstant(typeInfo.interfaceTypes.length))
                                 .add(new ArrayConstantBuilder(I32).add(classIds).build())
                                 .add(new ArrayConstantBuilder(I32).add(interfaceIds).build())
+                                .add(new ArrayConstantBuilder(I32).add(interfaceTable).build())
                                 .build()));
 
                 if (!config.isDebug() && !ci.isInterface() && !ci.isFinal() && typeInfo.children.isEmpty()) {
@@ -400,6 +412,11 @@ public class Linker {
         }
         config.getLogger().info("%d methods out of %d included in the executable", reachableMethodCount, totalMethodCount);
 
+        mb.addGlobal(new Global("_bcMethodAddresses", new ConstantGetelementptr(mb.newGlobal(
+                createMethodAddresses(mb, linkClasses, typeInfos, infoGlobals, reachableMethods), true).ref(), 0, 0)));
+        mb.addGlobal(new Global("_bcInvokers", new ConstantGetelementptr(mb.newGlobal(
+                createInvokers(mb, linkClasses, typeInfos, reachableMethods), true).ref(), 0, 0)));
+
         List<File> objectFiles = new ArrayList<File>();
 
         generateMachineCode(config, mbs, objectFiles);
@@ -672,6 +689,189 @@ public class Linker {
         return error.build();
     }
 
+    /**
+     * Creates the address to method index used by <code>findClassAt()</code>
+     * and <code>findMethodAt()</code> in <code>bc.c</code>. The layout is
+     * <code>{i32 count, [count x {i8* impl, i8* classInfo}]}</code>. The
+     * entries of a class are adjacent. The runtime reads the method sizes
+     * from the class info. The entries are in the same order as the object
+     * files are passed to the linker which usually means they are sorted by
+     * address in the executable. The runtime sorts them if they aren't.
+     */
+    private StructureConstant createMethodAddresses(ModuleBuilder mb, Set<Clazz> linkClasses,
+            Map<ClazzInfo, TypeInfo> typeInfos, Map<Clazz, Global> infoGlobals, Set<String> reachableMethods) {
+
+        ArrayConstantBuilder entries = new ArrayConstantBuilder(new StructureType(I8_PTR, I8_PTR));
+        int count = 0;
+        for (Clazz clazz : linkClasses) {
+            ClazzInfo ci = clazz.getClazzInfo();
+            if (typeInfos.get(ci).error) {
+                continue;
+            }
+            Constant info = new ConstantBitcast(infoGlobals.get(clazz).ref(), I8_PTR);
+            for (MethodInfo mi : ci.getMethods()) {
+                if (mi.isAbstract()
+                        || !reachableMethods.contains(clazz.getInternalName() + "." + mi.getName() + mi.getDesc())) {
+                    continue;
+                }
+                FunctionRef ref = new FunctionRef(methodSymbol(clazz.getInternalName(), mi.getName(), mi.getDesc()),
+                        getFunctionType(mi.getDesc(), mi.isStatic()));
+                mb.addFunctionDeclaration(new FunctionDeclaration(ref));
+                entries.add(new StructureConstantBuilder()
+                        .add(new ConstantBitcast(ref, I8_PTR))
+                        .add(info)
+                        .build());
+                count++;
+            }
+        }
+        return new StructureConstantBuilder()
+                .add(new IntegerConstant(count))
+                .add(entries.build())
+                .build();
+    }
+
+    /**
+     * Builds the hash table of interface ids which follows the class and
+     * interface ids in a TypeInfo. The table uses open addressing with
+     * linear probing, has a power of 2 size of at least twice the number of
+     * ids and starts probing at {@code id & (size - 1)}. Empty slots are
+     * {@code -1}. Must match {@code initInterfaceTable()} in {@code class.c}
+     * and {@code isinstance_interface} in {@code header.ll}.
+     */
+    static int[] buildInterfaceTable(int[] interfaceIds) {
+        int size = 1;
+        while (size < interfaceIds.length * 2) {
+            size <<= 1;
+        }
+        int[] table = new int[size];
+        Arrays.fill(table, -1);
+        for (int id : interfaceIds) {
+            int i = id & (size - 1);
+            while (table[i] != -1 && table[i] != id) {
+                i = (i + 1) & (size - 1);
+            }
+            table[i] = id;
+        }
+        return table;
+    }
+
+    /**
+     * Returns the call shape of a method. The shape is the descriptor with
+     * the receiver of instance methods added as the first parameter and all
+     * reference types replaced by {@code L}. Methods with the same shape have
+     * the same native signature. Must match {@code findInvoker()} in
+     * {@code callplan.c}.
+     */
+    static String getInvokerShape(String desc, boolean isStatic) {
+        StringBuilder sb = new StringBuilder("(");
+        if (!isStatic) {
+            sb.append('L');
+        }
+        int i = 1;
+        while (desc.charAt(i) != ')') {
+            char c = desc.charAt(i);
+            if (c == '[' || c == 'L') {
+                while (desc.charAt(i) == '[') {
+                    i++;
+                }
+                if (desc.charAt(i) == 'L') {
+                    i = desc.indexOf(';', i);
+                }
+                c = 'L';
+            }
+            sb.append(c);
+            i++;
+        }
+        char ret = desc.charAt(i + 1);
+        sb.append(')').append(ret == '[' ? 'L' : ret);
+        return sb.toString();
+    }
+
+    /**
+     * Creates an invoker stub for each call shape of the methods in the
+     * executable which can be called through {@code Method.invoke()} and a
+     * table of {shape, stub} entries sorted by shape. The runtime uses the
+     * stubs instead of {@code _call0} when invoking methods reflectively. The
+     * runtime counterpart is {@code findInvoker()} in {@code bc.c}.
+     */
+    private StructureConstant createInvokers(ModuleBuilder mb, Set<Clazz> linkClasses,
+            Map<ClazzInfo, TypeInfo> typeInfos, Set<String> reachableMethods) {
+
+        Set<String> shapes = new TreeSet<>();
+        for (Clazz clazz : linkClasses) {
+            ClazzInfo ci = clazz.getClazzInfo();
+            if (typeInfos.get(ci).error) {
+                continue;
+            }
+            for (MethodInfo mi : ci.getMethods()) {
+                String name = mi.getName();
+                if (name.equals("<init>") || name.equals("<clinit>")) {
+                    continue;
+                }
+                if (mi.isAbstract()
+                        || reachableMethods.contains(clazz.getInternalName() + "." + name + mi.getDesc())) {
+                    shapes.add(getInvokerShape(mi.getDesc(), mi.isStatic()));
+                }
+            }
+        }
+
+        ArrayConstantBuilder entries = new ArrayConstantBuilder(new StructureType(I8_PTR, I8_PTR));
+        for (String shape : shapes) {
+            Function fn = createInvoker(shape);
+            mb.addFunction(fn);
+            entries.add(new StructureConstantBuilder()
+                    .add(mb.getString(shape))
+                    .add(new ConstantBitcast(fn.ref(), I8_PTR))
+                    .build());
+        }
+        return new StructureConstantBuilder()
+                .add(new IntegerConstant(shapes.size()))
+                .add(entries.build())
+                .build();
+    }
+
+    /**
+     * Creates an invoker stub for the specified shape. The stub has the
+     * signature
+     * {@code void (Env* env, void* function, jvalue* args, jvalue* result)}.
+     * It loads the arguments from {@code args}, calls {@code function} and
+     * stores the return value in {@code result}.
+     */
+    private Function createInvoker(String shape) {
+        PointerType jvaluePtr = new PointerType(I64);
+        Function fn = new FunctionBuilder(invokerSymbol(shape),
+                new FunctionType(VOID, ENV_PTR, I8_PTR, jvaluePtr, jvaluePtr)).linkage(_private).build();
+
+        int end = shape.indexOf(')');
+        List<Type> paramTypes = new ArrayList<>();
+        List<Value> args = new ArrayList<>();
+        paramTypes.add(ENV_PTR);
+        args.add(fn.getParameterRef(0));
+        for (int i = 1; i < end; i++) {
+            Type type = getType(shape.substring(i, i + 1));
+            Variable slot = fn.newVariable(jvaluePtr);
+            fn.add(new Getelementptr(slot, fn.getParameterRef(2), i - 1));
+            Variable ptr = fn.newVariable(new PointerType(type));
+            fn.add(new Bitcast(ptr, slot.ref(), ptr.getType()));
+            Variable value = fn.newVariable(type);
+            fn.add(new Load(value, ptr.ref()));
+            paramTypes.add(type);
+            args.add(value.ref());
+        }
+        Type returnType = getType(shape.substring(end + 1));
+        FunctionType targetType = new FunctionType(returnType, paramTypes.toArray(new Type[paramTypes.size()]));
+        Variable target = fn.newVariable(targetType);
+        fn.add(new Bitcast(target, fn.getParameterRef(1), targetType));
+        Value result = call(fn, target.ref(), args);
+        if (result != null) {
+            Variable resultPtr = fn.newVariable(new PointerType(returnType));
+            fn.add(new Bitcast(resultPtr, fn.getParameterRef(3), resultPtr.getType()));
+            fn.add(new Store(result, resultPtr.ref()));
+        }
+        fn.add(new Ret());
+        return fn;
+    }
+
     private void createStrippedMethodStub(FunctionRef stubRef, ModuleBuilder mb, Clazz clazz, MethodInfo mi) {
         String symbol = methodSymbol(clazz.getInternalName(), mi.getName(), mi.getDesc());
         Alias alias = new Alias(symbol, external, stubRef);
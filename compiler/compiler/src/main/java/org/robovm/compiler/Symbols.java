@@ -345,6 +345,10 @@ public class Symbols {
         return arraySymbol(descriptor, "arrayptr");
     }
 
+    public static String invokerSymbol(String shape) {
+        return INTERNAL_SYMBOL_PREFIX + shape + "[invoker]";
+    }
+
     private static String arraySymbol(String descriptor, String type) {
         return INTERNAL_SYMBOL_PREFIX + descriptor + "[" + type + "]"; 
     }
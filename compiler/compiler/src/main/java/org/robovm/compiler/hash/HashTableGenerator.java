@@ -16,8 +16,14 @@
  */
 package org.robovm.compiler.hash;
 
-import java.util.LinkedList;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.Collections;
+import java.util.Comparator;
+import java.util.HashMap;
+import java.util.LinkedHashMap;
 import java.util.List;
+import java.util.Map;
 
 import org.robovm.compiler.llvm.Constant;
 import org.robovm.compiler.llvm.IntegerConstant;
@@ -27,119 +33,194 @@ import org.robovm.compiler.llvm.StructureConstantBuilder;
 import org.robovm.compiler.llvm.Type;
 
 /**
- * Generates static hash tables in the form of a {@link StructureConstant} using
- * a {@link HashFunction}.
+ * Generates static minimal perfect hash tables in the form of a
+ * {@link StructureConstant} using a {@link HashFunction}.
+ * <p>
+ * The table is built using the hash and displace (CHD) method. Keys are
+ * distributed into buckets using the low bits of their hash. For each bucket
+ * a seed is searched for which maps all keys in the bucket to free slots
+ * using {@code slot(h, seed) = (fmix32(h ^ seed) * slotCount) >>> 32}. There
+ * are exactly as many slots as keys. The hash of each key is stored alongside
+ * the value as a fingerprint so that a lookup can reject most misses without
+ * comparing keys. Keys whose hash equals the hash of another key can never be
+ * placed by any seed. Such keys are put in an overflow area after the slots
+ * which is searched linearly by fingerprint.
+ * <p>
+ * The generated structure has the following layout (all integers are
+ * {@code i32}). The runtime counterpart is {@code lookupClassInfo()} in
+ * {@code bc.c}.
+ *
+ * <pre>
+ * count            // slotCount + overflowCount
+ * bucketCount      // Always a power of 2
+ * slotCount
+ * overflowCount
+ * seeds[bucketCount]
+ * fingerprints[count]
+ * values[count]    // Slots followed by overflow entries
+ * </pre>
  */
 public class HashTableGenerator<K, V extends Constant> {
     private static final IntegerType INDEX_TYPE = Type.I32;
+    /**
+     * Average number of keys per bucket we aim for. The bucket count is
+     * rounded up to a power of 2 so the actual average is between half this
+     * and this.
+     */
+    private static final int KEYS_PER_BUCKET = 4;
+    /**
+     * Maximum number of seeds tried for a single bucket before giving up and
+     * trying again with twice as many buckets.
+     */
+    private static final int MAX_SEED = 1 << 24;
 
     private final HashFunction<K> function;
-    private List<Entry<K, V>>[] table;
-    private int tableSize;
-    private int count = 0;
-    private double loadFactor;
-    
+    private final Map<K, Entry<K, V>> entries = new LinkedHashMap<K, Entry<K, V>>();
+
     public HashTableGenerator(HashFunction<K> function) {
-        this(function, 4, 0.75);
-    }
-    
-    public HashTableGenerator(HashFunction<K> function, int tableSize) {
-        this(function, tableSize, 0.75);
-    }
-    
-    public HashTableGenerator(HashFunction<K> function, int tableSize, double loadFactor) {
         this.function = function;
-        this.tableSize = tableSize;
-        this.loadFactor = loadFactor;
-        allocateTable();
-    }
-    
-    @SuppressWarnings("unchecked")
-    private void allocateTable() {
-        this.table = new List[1 << tableSize];
     }
-    
+
     public void put(K k, V v) {
-        int h = function.hash(k);
-        putNoRehash(new Entry<K, V>(h, k, v));
-        if (count > loadFactor * table.length) {
-            rehash();
+        Entry<K, V> entry = entries.get(k);
+        if (entry != null) {
+            entry.v = v;
+        } else {
+            entries.put(k, new Entry<K, V>(function.hash(k), k, v));
         }
     }
-    
-    private void rehash() {
-        List<Entry<K, V>>[] oldTable = table;
-        tableSize++;
-        count = 0;
-        allocateTable();
-        for (int i = 0; i < oldTable.length; i++) {
-            if (oldTable[i] != null) {
-                for (Entry<K, V> entry : oldTable[i]) {
-                    putNoRehash(entry);
-                }
+
+    /**
+     * Returns the slot index for the specified hash and seed in a table with
+     * the specified number of slots. Must match the runtime.
+     */
+    static int slot(int h, int seed, int slotCount) {
+        return (int) (((MurmurHash3.fmix32(h ^ seed) & 0xffffffffL) * slotCount) >>> 32);
+    }
+
+    public StructureConstant generate() {
+        // Entries with a hash equal to that of an earlier entry go to the overflow area.
+        List<Entry<K, V>> placed = new ArrayList<Entry<K, V>>();
+        List<Entry<K, V>> overflow = new ArrayList<Entry<K, V>>();
+        Map<Integer, Entry<K, V>> byHash = new HashMap<Integer, Entry<K, V>>();
+        for (Entry<K, V> entry : entries.values()) {
+            if (byHash.containsKey(entry.h)) {
+                overflow.add(entry);
+            } else {
+                byHash.put(entry.h, entry);
+                placed.add(entry);
             }
         }
+
+        int slotCount = placed.size();
+        int bucketCount = 1;
+        while (bucketCount * KEYS_PER_BUCKET < slotCount) {
+            bucketCount <<= 1;
+        }
+        int[] seeds = new int[bucketCount];
+        @SuppressWarnings("unchecked")
+        Entry<K, V>[] slots = new Entry[slotCount];
+        while (!place(placed, bucketCount, seeds, slots)) {
+            bucketCount <<= 1;
+            seeds = new int[bucketCount];
+            Arrays.fill(slots, null);
+        }
+
+        StructureConstantBuilder builder = new StructureConstantBuilder();
+        builder.add(new IntegerConstant(slotCount + overflow.size()));
+        builder.add(new IntegerConstant(bucketCount, INDEX_TYPE));
+        builder.add(new IntegerConstant(slotCount, INDEX_TYPE));
+        builder.add(new IntegerConstant(overflow.size(), INDEX_TYPE));
+        for (int seed : seeds) {
+            builder.add(new IntegerConstant(seed, INDEX_TYPE));
+        }
+        for (Entry<K, V> entry : slots) {
+            builder.add(new IntegerConstant(entry.h, INDEX_TYPE));
+        }
+        for (Entry<K, V> entry : overflow) {
+            builder.add(new IntegerConstant(entry.h, INDEX_TYPE));
+        }
+        for (Entry<K, V> entry : slots) {
+            builder.add(entry.v);
+        }
+        for (Entry<K, V> entry : overflow) {
+            builder.add(entry.v);
+        }
+        return builder.build();
     }
-    
-    private void putNoRehash(Entry<K, V> entry) {
-        int idx = entry.h & ((1 << tableSize) - 1);
-        if (table[idx] == null) {
-            table[idx] = new LinkedList<Entry<K, V>>();
+
+    private static <K, V> boolean place(List<Entry<K, V>> placed, int bucketCount, int[] seeds, Entry<K, V>[] slots) {
+        int slotCount = slots.length;
+        List<List<Entry<K, V>>> buckets = new ArrayList<List<Entry<K, V>>>(bucketCount);
+        for (int i = 0; i < bucketCount; i++) {
+            buckets.add(new ArrayList<Entry<K, V>>());
         }
-        for (Entry<K, V> e : table[idx]) {
-            if (e.h == entry.h && (e.k.equals(entry.k))) {
-                e.v = entry.v;
-                return;
+        for (Entry<K, V> entry : placed) {
+            buckets.get(entry.h & (bucketCount - 1)).add(entry);
+        }
+        // Place the largest buckets first while there are still plenty of free slots.
+        List<Integer> order = new ArrayList<Integer>(bucketCount);
+        for (int i = 0; i < bucketCount; i++) {
+            order.add(i);
+        }
+        final List<List<Entry<K, V>>> b = buckets;
+        Collections.sort(order, new Comparator<Integer>() {
+            @Override
+            public int compare(Integer o1, Integer o2) {
+                return b.get(o2).size() - b.get(o1).size();
+            }
+        });
+
+        int[] bucketSlots = new int[KEYS_PER_BUCKET * 8];
+        for (int bucket : order) {
+            List<Entry<K, V>> keys = buckets.get(bucket);
+            if (keys.isEmpty()) {
+                break;
+            }
+            if (keys.size() > bucketSlots.length) {
+                bucketSlots = new int[keys.size()];
+            }
+            int seed = 0;
+            for (; seed < MAX_SEED; seed++) {
+                if (tryPlace(keys, seed, slots, bucketSlots)) {
+                    break;
+                }
+            }
+            if (seed == MAX_SEED) {
+                return false;
+            }
+            seeds[bucket] = seed;
+            for (int i = 0; i < keys.size(); i++) {
+                slots[bucketSlots[i]] = keys.get(i);
             }
         }
-        table[idx].add(entry);
-        count++;
+        return true;
     }
-    
-    public StructureConstant generate() {
-        StructureConstantBuilder builder = new StructureConstantBuilder();
-        int start = 0;
-        builder.add(new IntegerConstant(count));
-        builder.add(new IntegerConstant(table.length, INDEX_TYPE));
-        builder.add(new IntegerConstant(start, INDEX_TYPE));
-        for (int i = 1; i <= table.length; i++) {
-            if (table[i - 1] == null) {
-                builder.add(new IntegerConstant(start, INDEX_TYPE));                
-            } else {
-                start += table[i - 1].size();
-                builder.add(new IntegerConstant(start, INDEX_TYPE));
+
+    private static <K, V> boolean tryPlace(List<Entry<K, V>> keys, int seed, Entry<K, V>[] slots, int[] bucketSlots) {
+        for (int i = 0; i < keys.size(); i++) {
+            int s = slot(keys.get(i).h, seed, slots.length);
+            if (slots[s] != null) {
+                return false;
             }
-        }
-        for (int i = 0; i < table.length; i++) {
-            if (table[i] != null) {
-                for (Entry<K, V> entry : table[i]) {
-                    builder.add(entry.v);
+            for (int j = 0; j < i; j++) {
+                if (bucketSlots[j] == s) {
+                    return false;
                 }
             }
+            bucketSlots[i] = s;
         }
-        return builder.build();
+        return true;
     }
-    
+
     private static class Entry<K, V> {
-        int h;
-        K k;
+        final int h;
+        final K k;
         V v;
         Entry(int h, K k, V v) {
             this.h = h;
             this.k = k;
             this.v = v;
         }
-        @Override
-        public int hashCode() {
-            return h;
-        }
-        @SuppressWarnings("unchecked")
-        @Override
-        public boolean equals(Object obj) {
-            Entry<K, V> e = (Entry<K, V>) obj;
-            return this.h == e.h 
-                    && (this.k == e.k || this.k.equals(e.k))
-                    && (this.v == e.v || this.v.equals(e.v));
-        }
     }
 }
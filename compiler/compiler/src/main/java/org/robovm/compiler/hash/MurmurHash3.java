@@ -60,14 +60,17 @@ public class MurmurHash3 {
         // finalization
         h1 ^= len;
 
-        // fmix(h1);
-        h1 ^= h1 >>> 16;
-        h1 *= 0x85ebca6b;
-        h1 ^= h1 >>> 13;
-        h1 *= 0xc2b2ae35;
-        h1 ^= h1 >>> 16;
+        return fmix32(h1);
+    }
 
-        return h1;
+    /** Returns the MurmurHash3 32-bit finalization mix of h. */
+    public static int fmix32(int h) {
+        h ^= h >>> 16;
+        h *= 0x85ebca6b;
+        h ^= h >>> 13;
+        h *= 0xc2b2ae35;
+        h ^= h >>> 16;
+        return h;
     }
 
 }
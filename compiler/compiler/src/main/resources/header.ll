@@ -1,12 +1,12 @@
 %GatewayFrame = type {i8*, i8*, i8*}
 %StackFrame = type {i8*, i8*}
-%Thread = type {i32} ; Incomplete. Just enough to get threadId
+%Thread = type {i32, i8, %Object*} ; Incomplete. Just enough to get threadId, inBiasedLockOp and biasRevocationRequest
 %Env = type {i8*, i8*, i8*, %Thread*, i8*, i8*, %GatewayFrame*, i8*, i32}
 %DebugEnv = type {%Env, i8*, i8*, i8*, i8*, i8, i8}
 %TypeInfo = type {i32, i32, i32, i32, i32, [0 x i32]}
 %VITable = type {i16, [0 x i8*]}
 %ITable = type {%TypeInfo*, %VITable}
-%ITables = type {i16, %ITable*, [0 x %ITable*]}
+%ITables = type {i16, [4 x %ITable*], [0 x %ITable*]}
 ; NOTE: The compiler assumes that %Class is a multiple of 8 in size (currently 88 bytes + 0 bytes padding)
 %Class = type {i8*, i8*, i8*, i8*, %TypeInfo*, %VITable*, %ITables*, i8*, i8*, i8*, i8*, i8*, i32, i8*, i8*, i8*, i8*, i8*, i32, i32, i32, i16, i16}
 %Method = type opaque
@@ -43,6 +43,8 @@
 @array_F = external global %Class*
 @array_D = external global %Class*
 
+@biasedLockBits = external global i32 ; monitor.c
+
 declare void @_bcInitializeClass(%Env*, i8**)
 declare %Object* @_bcAllocate(%Env*, i8**)
 declare %Object* @_bcLdcArrayBootClass(%Env*, %Object**, i8*)
@@ -99,6 +101,7 @@ declare %Object* @_bcLdcString(%Env*, %Object**, i8*, i32)
         
 declare void @_bcMonitorEnter(%Env*, %Object*)
 declare void @_bcMonitorExit(%Env*, %Object*)
+declare void @revokeRequestedBias(%Thread*) ; monitor.c
 
 declare i8* @_bcResolveNative(%Env*, %Object*, i8*, i8*, i8*, i8*, i8**)
 
@@ -128,6 +131,18 @@ define private i32 @Thread_threadId(%Thread* %t) alwaysinline {
     ret i32 %2
 }
 
+define private void @Thread_inBiasedLockOp_store(%Thread* %t, i8 %value) alwaysinline {
+    %1 = getelementptr %Thread* %t, i32 0, i32 1 ; Thread->inBiasedLockOp
+    store volatile i8 %value, i8* %1
+    ret void
+}
+
+define private %Object* @Thread_biasRevocationRequest(%Thread* %t) alwaysinline {
+    %1 = getelementptr %Thread* %t, i32 0, i32 2 ; Thread->biasRevocationRequest
+    %2 = load volatile %Object** %1
+    ret %Object* %2
+}
+
 define private %Thread* @Env_currentThread(%Env* %env) alwaysinline {
     %1 = getelementptr %Env* %env, i32 0, i32 3 ; Env->currentThread
     %2 = load volatile %Thread** %1
@@ -209,16 +224,16 @@ define private i32 @TypeInfo_offset(%TypeInfo* %ti) alwaysinline {
     ret i32 %2
 }
 
-define private i32 @TypeInfo_cache(%TypeInfo* %ti) alwaysinline {
-    %1 = getelementptr %TypeInfo* %ti, i32 0, i32 2 ; TypeInfo->cache
+define private i32 @TypeInfo_interfaceTableMask(%TypeInfo* %ti) alwaysinline {
+    %1 = getelementptr %TypeInfo* %ti, i32 0, i32 2 ; TypeInfo->interfaceTableMask
     %2 = load volatile i32* %1
     ret i32 %2
 }
 
-define private void @TypeInfo_cache_store(%TypeInfo* %ti, i32 %value) alwaysinline {
-    %1 = getelementptr %TypeInfo* %ti, i32 0, i32 2 ; TypeInfo->cache
-    store volatile i32 %value, i32* %1
-    ret void
+define private i32 @TypeInfo_classCount(%TypeInfo* %ti) alwaysinline {
+    %1 = getelementptr %TypeInfo* %ti, i32 0, i32 3 ; TypeInfo->classCount
+    %2 = load volatile i32* %1
+    ret i32 %2
 }
 
 define private i32 @TypeInfo_interfaceCount(%TypeInfo* %ti) alwaysinline {
@@ -748,10 +763,6 @@ done:
 define private i1 @isinstance_class(%Object* %o, i32 %offset, i32 %id) alwaysinline {
     %c = call %Class* @Object_class(%Object* %o)
     %ti = call %TypeInfo* @Class_typeInfo(%Class* %c)
-    %cachedId = call i32 @TypeInfo_cache(%TypeInfo* %ti)
-    %isCachedEQ = icmp eq i32 %id, %cachedId
-    br i1 %isCachedEQ, label %found, label %notInCache
-notInCache:
     %otherOffset = call i32 @TypeInfo_offset(%TypeInfo* %ti)
     %isOffsetLE = icmp ule i32 %offset, %otherOffset
     br i1 %isOffsetLE, label %compareIds, label %notFound
@@ -761,47 +772,34 @@ compareIds:
     %3 = bitcast i8* %2 to i32*
     %otherId = load volatile i32* %3
     %isIdEQ = icmp eq i32 %id, %otherId
-    br i1 %isIdEQ, label %storeCache, label %notFound
-storeCache:
-    call void @TypeInfo_cache_store(%TypeInfo* %ti, i32 %id)
-    br label %found
-found:
-    ret i1 1
+    ret i1 %isIdEQ
 notFound:
     ret i1 0
 }
 
 define private i1 @isinstance_interface(%Object* %o, i32 %id) alwaysinline {
+entry:
     %c = call %Class* @Object_class(%Object* %o)
     %ti = call %TypeInfo* @Class_typeInfo(%Class* %c)
-    %cachedId = call i32 @TypeInfo_cache(%TypeInfo* %ti)
-    %isCachedEQ = icmp eq i32 %id, %cachedId
-    br i1 %isCachedEQ, label %found, label %notInCache
-notInCache:
+    %mask = call i32 @TypeInfo_interfaceTableMask(%TypeInfo* %ti)
+    %classCount = call i32 @TypeInfo_classCount(%TypeInfo* %ti)
     %ifCount = call i32 @TypeInfo_interfaceCount(%TypeInfo* %ti)
-    %hasIfs = icmp ne i32 %ifCount, 0
-    br i1 %hasIfs, label %computeBase, label %notFound
-computeBase:
-    %offset = call i32 @TypeInfo_offset(%TypeInfo* %ti)
-    %ti_18p = bitcast %TypeInfo* %ti to [0 x i8]*
-    %1 = getelementptr [0 x i8]* %ti_18p, i32 0, i32 %offset
-    %2 = bitcast i8* %1 to [0 x i32]*
-    %3 = getelementptr [0 x i32]* %2, i32 0, i32 1
-    %base = bitcast i32* %3 to [0 x i32]* ; %base now points to the first interface id
+    %typesCount = add i32 %classCount, %ifCount
+    %types = getelementptr %TypeInfo* %ti, i32 0, i32 5 ; TypeInfo->types
+    %table = getelementptr [0 x i32]* %types, i32 0, i32 %typesCount ; %table now points to the interface id hash table
+    %start = and i32 %id, %mask
     br label %loop
 loop:
-    %n_phi = phi i32 [0, %computeBase], [%n, %checkDone]
-    %4 = getelementptr [0 x i32]* %base, i32 0, i32 %n_phi
-    %n = add i32 %n_phi, 1
-    %otherId = load volatile i32* %4
+    %i = phi i32 [%start, %entry], [%next, %checkEmpty]
+    %1 = getelementptr i32* %table, i32 %i
+    %otherId = load volatile i32* %1
     %isIdEQ = icmp eq i32 %id, %otherId
-    br i1 %isIdEQ, label %storeCache, label %checkDone
-checkDone:
-    %isDone = icmp eq i32 %n, %ifCount
-    br i1 %isDone, label %notFound, label %loop
-storeCache:
-    call void @TypeInfo_cache_store(%TypeInfo* %ti, i32 %id)
-    br label %found
+    br i1 %isIdEQ, label %found, label %checkEmpty
+checkEmpty:
+    %isEmpty = icmp eq i32 %otherId, -1
+    %2 = add i32 %i, 1
+    %next = and i32 %2, %mask
+    br i1 %isEmpty, label %notFound, label %loop
 found:
     ret i1 1
 notFound:
@@ -889,8 +887,23 @@ false:
     ret i32 0
 }
 
+; Called after a lock word biased towards the current thread has been
+; updated. Handles a bias revocation request which arrived in the meantime.
+; See leaveBiasedLockOp() in monitor.c.
+define private void @leaveBiasedLockOp(%Thread* %t) alwaysinline {
+    call void @Thread_inBiasedLockOp_store(%Thread* %t, i8 0)
+    %request = call %Object* @Thread_biasRevocationRequest(%Thread* %t)
+    %hasRequest = icmp ne %Object* %request, null
+    br i1 %hasRequest, label %revoke, label %done
+revoke:
+    call void @revokeRequestedBias(%Thread* %t)
+    br label %done
+done:
+    ret void
+}
+
 define private void @monitorenter(%Env* %env, %Object* %o) alwaysinline {
-    ; Try the common case first before we call _bcMonitorEnter
+    ; Try the common cases first before we call _bcMonitorEnter
     %thin = call i32 @Object_lock(%Object* %o)
     %thinBit = and i32 %thin, 1
     %isThin = icmp eq i32 %thinBit, 0
@@ -898,14 +911,47 @@ define private void @monitorenter(%Env* %env, %Object* %o) alwaysinline {
 yesThin:
     %1 = lshr i32 %thin, 3 ; LW_LOCK_OWNER_SHIFT = 3
     %owner = and i32 %1, 65535 ; LW_LOCK_OWNER_MASK = 0xffff
-    %isUnowned = icmp eq i32 %owner, 0
-    br i1 %isUnowned, label %tryLock, label %callBc
-tryLock:
     %currentThread = call %Thread* @Env_currentThread(%Env* %env)
     %threadId = call i32 @Thread_threadId(%Thread* %currentThread)
-    %2 = shl i32 %threadId, 3 ; LW_LOCK_OWNER_SHIFT = 3
-    %newThin = or i32 %thin, %2
     %lockPtr = call i32* @Object_lockPtr(%Object* %o)
+    %isUnowned = icmp eq i32 %owner, 0
+    br i1 %isUnowned, label %tryLock, label %maybeBiased
+maybeBiased:
+    %biasedOwner = or i32 %threadId, 32768 ; LW_BIASED >> LW_LOCK_OWNER_SHIFT = 0x8000
+    %isBiased = icmp eq i32 %owner, %biasedOwner
+    br i1 %isBiased, label %lockBiased, label %callBc
+lockBiased:
+    ; The lock is biased towards the current thread. Only this thread
+    ; updates the lock word so no atomic instructions are needed. The bias
+    ; revocation signal handler leaves the lock word alone while
+    ; inBiasedLockOp is set but may have revoked the bias before that so
+    ; read the lock word again. See lockBiased() in monitor.c.
+    call void @Thread_inBiasedLockOp_store(%Thread* %currentThread, i8 1)
+    %biased = call i32 @Object_lock(%Object* %o)
+    %biasedOwnerBits = and i32 %biased, 524281 ; (LW_LOCK_OWNER_MASK << LW_LOCK_OWNER_SHIFT) | LW_SHAPE_MASK = 0x7fff9
+    %expectedOwnerBits = shl i32 %biasedOwner, 3 ; LW_LOCK_OWNER_SHIFT = 3
+    %isStillBiased = icmp eq i32 %biasedOwnerBits, %expectedOwnerBits
+    %biasedCount = lshr i32 %biased, 19 ; LW_LOCK_COUNT_SHIFT = 19
+    %isBelowMax = icmp ult i32 %biasedCount, 8191 ; LW_LOCK_COUNT_MASK = 0x1fff
+    %canLock = and i1 %isStillBiased, %isBelowMax
+    br i1 %canLock, label %incBiased, label %leaveBiased
+incBiased:
+    %newBiased = add i32 %biased, 524288 ; 1 << LW_LOCK_COUNT_SHIFT
+    store volatile i32 %newBiased, i32* %lockPtr
+    br label %leaveBiased
+leaveBiased:
+    %isLocked = phi i1 [true, %incBiased], [false, %lockBiased]
+    call void @leaveBiasedLockOp(%Thread* %currentThread)
+    br i1 %isLocked, label %success, label %callBc
+tryLock:
+    %2 = shl i32 %threadId, 3 ; LW_LOCK_OWNER_SHIFT = 3
+    ; Bias the lock towards the current thread unless its bias has been revoked before
+    %3 = and i32 %thin, 4 ; LW_BIAS_REVOKED = 0x2 << LW_HASH_STATE_SHIFT
+    %isRevoked = icmp ne i32 %3, 0
+    %biasBits = load i32* @biasedLockBits
+    %4 = select i1 %isRevoked, i32 0, i32 %biasBits
+    %5 = or i32 %2, %4
+    %newThin = or i32 %thin, %5
     %isSuccess = call i1 @atomic_cas(i32 %thin, i32 %newThin, i32* %lockPtr)
     br i1 %isSuccess, label %success, label %callBc
 success:
@@ -916,7 +962,7 @@ callBc:
 }
 
 define private void @monitorexit(%Env* %env, %Object* %o) alwaysinline {
-    ; Try the common case first before we call _bcMonitorExit
+    ; Try the common cases first before we call _bcMonitorExit
     %thin = call i32 @Object_lock(%Object* %o)
     %thinBit = and i32 %thin, 1
     %isThin = icmp eq i32 %thinBit, 0
@@ -926,18 +972,48 @@ yesThin:
     %owner = and i32 %1, 65535 ; LW_LOCK_OWNER_MASK = 0xffff
     %currentThread = call %Thread* @Env_currentThread(%Env* %env)
     %threadId = call i32 @Thread_threadId(%Thread* %currentThread)
+    %lockPtr = call i32* @Object_lockPtr(%Object* %o)
     %isOwner = icmp eq i32 %owner, %threadId
-    br i1 %isOwner, label %maybeUnlock, label %callBc
+    br i1 %isOwner, label %maybeUnlock, label %maybeBiased
+maybeBiased:
+    %biasedOwner = or i32 %threadId, 32768 ; LW_BIASED >> LW_LOCK_OWNER_SHIFT = 0x8000
+    %isBiased = icmp eq i32 %owner, %biasedOwner
+    br i1 %isBiased, label %unlockBiased, label %callBc
+unlockBiased:
+    ; See monitorenter and unlockBiased() in monitor.c
+    call void @Thread_inBiasedLockOp_store(%Thread* %currentThread, i8 1)
+    %biased = call i32 @Object_lock(%Object* %o)
+    %biasedOwnerBits = and i32 %biased, 524281 ; (LW_LOCK_OWNER_MASK << LW_LOCK_OWNER_SHIFT) | LW_SHAPE_MASK = 0x7fff9
+    %expectedOwnerBits = shl i32 %biasedOwner, 3 ; LW_LOCK_OWNER_SHIFT = 3
+    %isStillBiased = icmp eq i32 %biasedOwnerBits, %expectedOwnerBits
+    %biasedCount = lshr i32 %biased, 19 ; LW_LOCK_COUNT_SHIFT = 19
+    %isHeld = icmp ne i32 %biasedCount, 0
+    %canUnlock = and i1 %isStillBiased, %isHeld
+    br i1 %canUnlock, label %decBiased, label %leaveBiased
+decBiased:
+    %newBiased = sub i32 %biased, 524288 ; 1 << LW_LOCK_COUNT_SHIFT
+    store volatile i32 %newBiased, i32* %lockPtr
+    br label %leaveBiased
+leaveBiased:
+    %isUnlocked = phi i1 [true, %decBiased], [false, %unlockBiased]
+    call void @leaveBiasedLockOp(%Thread* %currentThread)
+    br i1 %isUnlocked, label %success, label %callBc
 maybeUnlock:
     %2 = lshr i32 %thin, 19 ; LW_LOCK_COUNT_SHIFT = 19
     %count = and i32 %2, 8191 ; LW_LOCK_COUNT_MASK = 0x1fff
-    %lockPtr = call i32* @Object_lockPtr(%Object* %o)
     %isZero = icmp eq i32 %count, 0
-    br i1 %isZero, label %unlock, label %callBc
+    br i1 %isZero, label %maybeContended, label %callBc
+maybeContended:
+    ; Let _bcMonitorExit wake the threads parked on the lock if it's contended
+    %3 = and i32 %thin, 2 ; LW_CONTENDED = 0x1 << LW_HASH_STATE_SHIFT
+    %isContended = icmp ne i32 %3, 0
+    br i1 %isContended, label %callBc, label %unlock
 unlock:
-    %newThin = and i32 %thin, 6 ; LW_HASH_STATE_MASK << LW_HASH_STATE_SHIFT (0x3 << 1)
-    fence seq_cst
-    store volatile i32 %newThin, i32* %lockPtr
+    ; A CAS since another thread may set LW_CONTENDED at any time
+    %newThin = and i32 %thin, 4 ; LW_BIAS_REVOKED = 0x2 << LW_HASH_STATE_SHIFT
+    %isSuccess = call i1 @atomic_cas(i32 %thin, i32 %newThin, i32* %lockPtr)
+    br i1 %isSuccess, label %success, label %callBc
+success:
     ret void
 callBc:
     tail call void @_bcMonitorExit(%Env* %env, %Object* %o)
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>.
+ */
+package org.robovm.compiler;
+
+import static org.junit.Assert.*;
+
+import org.junit.Test;
+
+/**
+ * Tests {@link Linker}.
+ */
+public class LinkerTest {
+
+    @Test
+    public void testGetInvokerShape() {
+        assertEquals("()V", Linker.getInvokerShape("()V", true));
+        assertEquals("(L)V", Linker.getInvokerShape("()V", false));
+        assertEquals("(ZBSCIJFD)I", Linker.getInvokerShape("(ZBSCIJFD)I", true));
+        assertEquals("(LLL)L", Linker.getInvokerShape("(Ljava/lang/String;[I)Ljava/lang/Object;", false));
+        assertEquals("(LIL)L", Linker.getInvokerShape("([[Ljava/lang/String;I[[J)[Z", true));
+    }
+
+    @Test
+    public void testBuildInterfaceTable() {
+        assertArrayEquals(new int[] {-1}, Linker.buildInterfaceTable(new int[0]));
+        assertArrayEquals(new int[] {-1, 5}, Linker.buildInterfaceTable(new int[] {5}));
+        assertArrayEquals(new int[] {-1, 1, 2, 3, -1, -1, -1, -1}, Linker.buildInterfaceTable(new int[] {1, 2, 3}));
+        // Colliding ids are placed in the following free slots
+        assertArrayEquals(new int[] {16, 32, 48, -1, -1, -1, -1, -1},
+                Linker.buildInterfaceTable(new int[] {16, 32, 48}));
+        assertArrayEquals(new int[] {6, -1, -1, 3, -1, -1, 14, 22},
+                Linker.buildInterfaceTable(new int[] {14, 22, 3, 6}));
+    }
+}
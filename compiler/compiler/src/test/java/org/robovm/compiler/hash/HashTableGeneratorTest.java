@@ -32,55 +32,94 @@ public class HashTableGeneratorTest {
     @Test
     public void testEmpty() {
         HashTableGenerator<String, Constant> gen = 
-                new HashTableGenerator<String, Constant>(new StringHash(), 2);
+                new HashTableGenerator<String, Constant>(new StringHash());
         StructureConstant result = gen.generate();
-        assertEquals("{i32 0, i32 4, i32 0, i32 0, i32 0, i32 0, i32 0}", result.toString());
+        assertEquals("{i32 0, i32 1, i32 0, i32 0, i32 0}", result.toString());
     }
 
     @Test
-    public void testNoRehashNoCollisions() {
+    public void testSingle() {
         HashTableGenerator<Integer, Constant> gen = 
-                new HashTableGenerator<Integer, Constant>(new IntegerHash(), 2);
-        gen.put(0, new IntegerConstant(0));
-        gen.put(1, new IntegerConstant(1));
-        gen.put(2, new IntegerConstant(2));
+                new HashTableGenerator<Integer, Constant>(new IntegerHash());
+        gen.put(7, new IntegerConstant(7));
         StructureConstant result = gen.generate();
-        assertEquals("{i32 3, i32 4, i32 0, i32 1, i32 2, i32 3, i32 3, i32 0, i32 1, i32 2}", result.toString());
+        assertEquals("{i32 1, i32 1, i32 1, i32 0, i32 0, i32 7, i32 7}", result.toString());
     }
-    
+
     @Test
-    public void testRehashNoCollisions() {
+    public void testAllKeysFound() {
         HashTableGenerator<Integer, Constant> gen = 
-                new HashTableGenerator<Integer, Constant>(new IntegerHash(), 2);
-        gen.put(0, new IntegerConstant(0));
-        gen.put(1, new IntegerConstant(1));
-        gen.put(2, new IntegerConstant(2));
-        gen.put(3, new IntegerConstant(3));
-        StructureConstant result = gen.generate();
-        assertEquals("{i32 4, i32 8, i32 0, i32 1, i32 2, i32 3, i32 4, i32 4, i32 4, i32 4, i32 4, i32 0, i32 1, i32 2, i32 3}", result.toString());
+                new HashTableGenerator<Integer, Constant>(new ScrambledIntegerHash());
+        for (int i = 0; i < 5000; i++) {
+            gen.put(i, new IntegerConstant(i));
+        }
+        int[] table = parse(gen.generate());
+        assertEquals(5000, table[0]);
+        assertEquals(5000, table[2]);
+        assertEquals(0, table[3]);
+        for (int i = 0; i < 5000; i++) {
+            assertEquals(i, lookup(table, new ScrambledIntegerHash().hash(i)));
+        }
     }
-    
+
     @Test
-    public void testNoRehashCollisions() {
+    public void testPutReplacesValue() {
         HashTableGenerator<Integer, Constant> gen = 
-                new HashTableGenerator<Integer, Constant>(new IntegerHash(), 2);
-        gen.put(0, new IntegerConstant(0));
-        gen.put(4, new IntegerConstant(4));
-        gen.put(8, new IntegerConstant(8));
+                new HashTableGenerator<Integer, Constant>(new IntegerHash());
+        gen.put(1, new IntegerConstant(1));
+        gen.put(1, new IntegerConstant(2));
         StructureConstant result = gen.generate();
-        assertEquals("{i32 3, i32 4, i32 0, i32 3, i32 3, i32 3, i32 3, i32 0, i32 4, i32 8}", result.toString());
+        assertEquals("{i32 1, i32 1, i32 1, i32 0, i32 0, i32 1, i32 2}", result.toString());
     }
-    
+
     @Test
-    public void testRehashCollisions() {
+    public void testEqualHashesGoToOverflow() {
         HashTableGenerator<Integer, Constant> gen = 
-                new HashTableGenerator<Integer, Constant>(new IntegerHash(), 2);
-        gen.put(0, new IntegerConstant(0));
-        gen.put(4, new IntegerConstant(4));
-        gen.put(8, new IntegerConstant(8));
-        gen.put(3, new IntegerConstant(3));
-        StructureConstant result = gen.generate();
-        assertEquals("{i32 4, i32 8, i32 0, i32 2, i32 2, i32 2, i32 3, i32 4, i32 4, i32 4, i32 4, i32 0, i32 8, i32 3, i32 4}", result.toString());
+                new HashTableGenerator<Integer, Constant>(new ModuloHash());
+        gen.put(1, new IntegerConstant(1));
+        gen.put(2, new IntegerConstant(2));
+        gen.put(11, new IntegerConstant(11));
+        gen.put(21, new IntegerConstant(21));
+        int[] table = parse(gen.generate());
+        assertEquals(4, table[0]);
+        assertEquals(2, table[2]);
+        assertEquals(2, table[3]);
+        int bucketCount = table[1];
+        int count = table[0];
+        // The overflow entries come last in insertion order
+        assertEquals(1, table[4 + bucketCount + 2]);
+        assertEquals(1, table[4 + bucketCount + 3]);
+        assertEquals(11, table[4 + bucketCount + count + 2]);
+        assertEquals(21, table[4 + bucketCount + count + 3]);
+        assertEquals(2, lookup(table, 2));
+    }
+
+    /**
+     * Parses the generated table into ints. Works since all values in these
+     * tests are i32 constants.
+     */
+    private static int[] parse(StructureConstant c) {
+        String s = c.toString();
+        String[] parts = s.substring(1, s.length() - 1).split(", ");
+        int[] result = new int[parts.length];
+        for (int i = 0; i < parts.length; i++) {
+            result[i] = Integer.parseInt(parts[i].substring("i32 ".length()));
+        }
+        return result;
+    }
+
+    /**
+     * Looks up the value with the specified hash in the primary slots the
+     * same way lookupClassInfo() in bc.c does.
+     */
+    private static int lookup(int[] table, int h) {
+        int count = table[0];
+        int bucketCount = table[1];
+        int slotCount = table[2];
+        int seed = table[4 + (h & (bucketCount - 1))];
+        int slot = HashTableGenerator.slot(h, seed, slotCount);
+        assertEquals(h, table[4 + bucketCount + slot]);
+        return table[4 + bucketCount + count + slot];
     }
     
     private static class IntegerHash implements HashFunction<Integer> {
@@ -90,6 +129,20 @@ public class HashTableGeneratorTest {
         }
     }
     
+    private static class ScrambledIntegerHash implements HashFunction<Integer> {
+        @Override
+        public int hash(Integer k) {
+            return MurmurHash3.fmix32(k + 1);
+        }
+    }
+    
+    private static class ModuloHash implements HashFunction<Integer> {
+        @Override
+        public int hash(Integer k) {
+            return k % 10;
+        }
+    }
+    
     private static class StringHash implements HashFunction<String> {
         @Override
         public int hash(String k) {
@@ -68,6 +68,40 @@ public class Stmt {
 
     public native boolean step() throws SQLite.Exception;
 
+    /**
+     * Perform up to batch.capacity() steps of compiled SQLite3
+     * statement and store the resulting rows in batch. All rows
+     * are fetched in one native call which is much cheaper than
+     * calling step() and the column_*() methods for each row.
+     * The previous contents of batch are discarded.
+     *
+     * Example:<BR>
+     * <PRE>
+     *   ...
+     *   StmtBatch b = new StmtBatch(256);
+     *   while (s.step_batch(b) > 0) {
+     *     for (int row = 0; row < b.rows(); row++) {
+     *       Object o = b.column(row, ...);
+     *       ...
+     *     }
+     *   }
+     * </PRE>
+     *
+     * @param batch the batch to fill
+     * @return number of rows stored in batch, 0 on end
+     * of result set.
+     */
+
+    public int step_batch(StmtBatch batch) throws SQLite.Exception {
+	batch.reset(column_count());
+	int n = step_batch0(batch, batch.capacity());
+	batch.set_rows(n);
+	return n;
+    }
+
+    private native int step_batch0(StmtBatch batch, int maxrows)
+	throws SQLite.Exception;
+
     /**
      * Close the compiled SQLite3 statement.
      */
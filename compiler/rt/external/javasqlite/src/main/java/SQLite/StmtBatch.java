@@ -0,0 +1,281 @@
+package SQLite;
+
+import java.util.Arrays;
+
+/**
+ * Class holding a batch of rows fetched from a compiled SQLite3
+ * statement with
+ * <A HREF="Stmt.html#step_batch(SQLite.StmtBatch)">Stmt.step_batch</A>.
+ * <BR><BR>
+ * All rows of a batch are fetched in a single native call. Values
+ * are kept in arrays per storage class: integers in a long[],
+ * floats in a double[], text as UTF-16 in a single char[] and
+ * blobs in a single byte[]. Strings are only created when
+ * asked for. This avoids one JNI call per column and row when
+ * reading large result sets.
+ * <BR><BR>
+ * Example:<BR>
+ * <PRE>
+ *   ...
+ *   Stmt s = db.prepare("select id, name from x");
+ *   StmtBatch b = new StmtBatch(256);
+ *   while (s.step_batch(b) > 0) {
+ *     for (int row = 0; row < b.rows(); row++) {
+ *       long id = b.column_long(row, 0);
+ *       String name = b.column_string(row, 1);
+ *       ...
+ *     }
+ *   }
+ *   ...
+ * </PRE>
+ * The contents of a batch are replaced by the next call to
+ * step_batch().
+ */
+
+public class StmtBatch {
+
+    /**
+     * Maximum number of rows per batch.
+     */
+
+    private final int capacity;
+
+    /**
+     * Number of columns and rows in this batch.
+     */
+
+    private int ncolumns = 0;
+    private int nrows = 0;
+
+    /**
+     * Cell values, indexed by row * ncolumns + col. The native
+     * code only writes the array matching the type of each
+     * cell. Text and blob cells store their start in chars
+     * resp. bytes in offsets and their length in lengths.
+     */
+
+    private int types[] = new int[0];
+    private long longs[] = new long[0];
+    private double doubles[] = new double[0];
+    private int offsets[] = new int[0];
+    private int lengths[] = new int[0];
+    private char chars[] = new char[0];
+    private byte bytes[] = new byte[0];
+
+    /**
+     * Lazily created strings of text cells.
+     */
+
+    private String strings[] = new String[0];
+
+    /**
+     * Create a batch for up to <code>capacity</code> rows.
+     * @param capacity maximum number of rows per batch
+     */
+
+    public StmtBatch(int capacity) {
+	if (capacity <= 0) {
+	    throw new IllegalArgumentException("capacity must be > 0");
+	}
+	this.capacity = capacity;
+    }
+
+    /**
+     * Called by Stmt.step_batch() before rows are fetched.
+     * Makes the cell arrays large enough for ncolumns columns.
+     */
+
+    void reset(int ncolumns) {
+	int ncells = ncolumns * capacity;
+	if (types.length < ncells) {
+	    types = new int[ncells];
+	    longs = new long[ncells];
+	    doubles = new double[ncells];
+	    offsets = new int[ncells];
+	    lengths = new int[ncells];
+	    strings = new String[ncells];
+	} else {
+	    Arrays.fill(strings, 0, this.ncolumns * nrows, null);
+	}
+	this.ncolumns = ncolumns;
+	this.nrows = 0;
+    }
+
+    void set_rows(int nrows) {
+	this.nrows = nrows;
+    }
+
+    /**
+     * Return the maximum number of rows per batch.
+     */
+
+    public int capacity() {
+	return capacity;
+    }
+
+    /**
+     * Return the number of rows in this batch.
+     */
+
+    public int rows() {
+	return nrows;
+    }
+
+    /**
+     * Return the number of columns in this batch.
+     */
+
+    public int columns() {
+	return ncolumns;
+    }
+
+    private int cell(int row, int col) {
+	if (row < 0 || row >= nrows) {
+	    throw new IndexOutOfBoundsException("row out of bounds");
+	}
+	if (col < 0 || col >= ncolumns) {
+	    throw new IndexOutOfBoundsException("column out of bounds");
+	}
+	return row * ncolumns + col;
+    }
+
+    /**
+     * Retrieve column type of a row.
+     * @param row row number in batch, 0-based
+     * @param col column number, 0-based
+     * @return column type code, e.g. SQLite.Constants.SQLITE_INTEGER
+     */
+
+    public int column_type(int row, int col) {
+	return types[cell(row, col)];
+    }
+
+    /**
+     * Retrieve long column of a row. Float values are
+     * truncated, other types are returned as 0.
+     * @param row row number in batch, 0-based
+     * @param col column number, 0-based
+     * @return long column value
+     */
+
+    public long column_long(int row, int col) {
+	int i = cell(row, col);
+	switch (types[i]) {
+	case Constants.SQLITE_INTEGER:
+	    return longs[i];
+	case Constants.SQLITE_FLOAT:
+	    return (long) doubles[i];
+	}
+	return 0;
+    }
+
+    /**
+     * Retrieve integer column of a row.
+     * @param row row number in batch, 0-based
+     * @param col column number, 0-based
+     * @return int column value
+     */
+
+    public int column_int(int row, int col) {
+	return (int) column_long(row, col);
+    }
+
+    /**
+     * Retrieve double column of a row. Integer values are
+     * converted, other types are returned as 0.
+     * @param row row number in batch, 0-based
+     * @param col column number, 0-based
+     * @return double column value
+     */
+
+    public double column_double(int row, int col) {
+	int i = cell(row, col);
+	switch (types[i]) {
+	case Constants.SQLITE_INTEGER:
+	    return longs[i];
+	case Constants.SQLITE_FLOAT:
+	    return doubles[i];
+	}
+	return 0;
+    }
+
+    /**
+     * Retrieve string column of a row. The String is created
+     * on the first call and cached in the batch. Integer and
+     * float values are converted, NULL and blobs return null.
+     * @param row row number in batch, 0-based
+     * @param col column number, 0-based
+     * @return String column value or null
+     */
+
+    public String column_string(int row, int col) {
+	int i = cell(row, col);
+	String s = strings[i];
+	if (s == null) {
+	    switch (types[i]) {
+	    case Constants.SQLITE_INTEGER:
+		s = Long.toString(longs[i]);
+		break;
+	    case Constants.SQLITE_FLOAT:
+		s = Double.toString(doubles[i]);
+		break;
+	    case Constants.SQLITE3_TEXT:
+		s = new String(chars, offsets[i], lengths[i]);
+		break;
+	    default:
+		return null;
+	    }
+	    strings[i] = s;
+	}
+	return s;
+    }
+
+    /**
+     * Retrieve blob column of a row.
+     * @param row row number in batch, 0-based
+     * @param col column number, 0-based
+     * @return copy of the byte[] column value or null if the
+     * column isn't a blob
+     */
+
+    public byte[] column_bytes(int row, int col) {
+	int i = cell(row, col);
+	if (types[i] != Constants.SQLITE_BLOB) {
+	    return null;
+	}
+	byte b[] = new byte[lengths[i]];
+	System.arraycopy(bytes, offsets[i], b, 0, lengths[i]);
+	return b;
+    }
+
+    /**
+     * Retrieve column data of a row as object.
+     * @param row row number in batch, 0-based
+     * @param col column number, 0-based
+     * @return Object or null
+     */
+
+    public Object column(int row, int col) {
+	switch (column_type(row, col)) {
+	case Constants.SQLITE_INTEGER:
+	    return Long.valueOf(column_long(row, col));
+	case Constants.SQLITE_FLOAT:
+	    return Double.valueOf(column_double(row, col));
+	case Constants.SQLITE_BLOB:
+	    return column_bytes(row, col);
+	case Constants.SQLITE3_TEXT:
+	    return column_string(row, col);
+	}
+	return null;
+    }
+
+    /**
+     * Internal native initializer.
+     */
+
+    private static native void internal_init();
+
+    static {
+	internal_init();
+    }
+}
@@ -85,9 +85,17 @@ public final class Constructor<T> extends AccessibleObject implements GenericDec
     ListOfTypes genericParameterTypes;
     TypeVariable<Constructor<T>>[] formalTypeParameters;
     private volatile boolean genericTypesAreInitialized = false;
-    
+
+    /*
+     * The instance this one was cloned from, or null if this is the one
+     * cached by the declaring class' ClassCache. Annotations and generic
+     * types are parsed once on the root and shared by all its copies.
+     */
+    private final Constructor<T> root;
+
     Constructor(long method){
         this.method = method;
+        this.root = null;
     }
     
     /**
@@ -98,6 +106,7 @@ public final class Constructor<T> extends AccessibleObject implements GenericDec
     /*package*/ Constructor(Constructor<T> orig) {
 
         this.method = orig.method;
+        this.root = orig.root != null ? orig.root : orig;
         this.modifiers = orig.modifiers;
         this.declaringClass = orig.declaringClass;
         this.parameterTypes = orig.parameterTypes;
@@ -118,6 +127,14 @@ public final class Constructor<T> extends AccessibleObject implements GenericDec
     @SuppressWarnings("unchecked")
     private synchronized void initGenericTypes() {
         if (!genericTypesAreInitialized) {
+            if (root != null) {
+                root.initGenericTypes();
+                formalTypeParameters = root.formalTypeParameters;
+                genericParameterTypes = root.genericParameterTypes;
+                genericExceptionTypes = root.genericExceptionTypes;
+                genericTypesAreInitialized = true;
+                return;
+            }
             String signatureAttribute = getSignatureAttribute();
             GenericSignatureParser parser = new GenericSignatureParser(
                     getDeclaringClass().getClassLoader());
@@ -222,7 +239,8 @@ public final class Constructor<T> extends AccessibleObject implements GenericDec
     @Override
     protected Annotation[] getDeclaredAnnotations(boolean copy) {
         if (declaredAnnotations == null) {
-            declaredAnnotations = Method.getDeclaredAnnotations(method);
+            declaredAnnotations = root != null
+                    ? root.getDeclaredAnnotations(false) : Method.getDeclaredAnnotations(method);
         }
         return copy ? declaredAnnotations.clone() : declaredAnnotations;
     }
@@ -236,6 +254,10 @@ public final class Constructor<T> extends AccessibleObject implements GenericDec
      * @return an array of arrays of {@code Annotation} instances
      */
     public Annotation[][] getParameterAnnotations() {
+        if (parameterAnnotations == null && root != null) {
+            root.getParameterAnnotations();
+            parameterAnnotations = root.parameterAnnotations;
+        }
         if (parameterAnnotations == null) {
             Annotation[][] pa = Method.getParameterAnnotations(method);
             if (pa.length == 0) {
@@ -243,7 +265,7 @@ public final class Constructor<T> extends AccessibleObject implements GenericDec
             }
             parameterAnnotations = pa;
         }
-        return parameterAnnotations.clone();
+        return Method.copyAnnotations(parameterAnnotations);
     }
 
     /**
@@ -319,7 +341,7 @@ public final class Constructor<T> extends AccessibleObject implements GenericDec
     }
     Class<?>[] getExceptionTypes(boolean copy) {
         if (exceptionTypes == null) {
-            exceptionTypes = Method.getExceptionTypes(method);
+            exceptionTypes = root != null ? root.getExceptionTypes(false) : Method.getExceptionTypes(method);
         }
         return copy ? exceptionTypes.clone() : exceptionTypes;
     }
@@ -359,7 +381,7 @@ public final class Constructor<T> extends AccessibleObject implements GenericDec
     }
     Class<?>[] getParameterTypes(boolean copy) {
         if (parameterTypes == null) {
-            parameterTypes = Method.getParameterTypes(method);
+            parameterTypes = root != null ? root.getParameterTypes(false) : Method.getParameterTypes(method);
         }
         return copy ? parameterTypes.clone() : parameterTypes;
     }
@@ -94,9 +94,17 @@ public final class Field extends AccessibleObject implements Member {
 
     private Type genericType;
     private volatile boolean genericTypesAreInitialized = false;
-    
+
+    /*
+     * The instance this one was cloned from, or null if this is the one
+     * cached by the declaring class' ClassCache. Annotations and generic
+     * types are parsed once on the root and shared by all its copies.
+     */
+    private final Field root;
+
     Field(long field){
         this.field = field;
+        this.root = null;
     }
     
     /**
@@ -106,6 +114,7 @@ public final class Field extends AccessibleObject implements Member {
      */
     /*package*/ Field(Field orig) {
         this.field = orig.field;
+        this.root = orig.root != null ? orig.root : orig;
         this.modifiers = orig.modifiers;
         this.declaringClass = orig.declaringClass;
         this.name = orig.name;
@@ -122,6 +131,12 @@ public final class Field extends AccessibleObject implements Member {
     
     private synchronized void initGenericType() {
         if (!genericTypesAreInitialized) {
+            if (root != null) {
+                root.initGenericType();
+                genericType = root.genericType;
+                genericTypesAreInitialized = true;
+                return;
+            }
             String signatureAttribute = getSignatureAttribute();
             GenericSignatureParser parser = new GenericSignatureParser(
                     getDeclaringClass().getClassLoader());
@@ -202,7 +217,8 @@ public final class Field extends AccessibleObject implements Member {
     @Override
     protected Annotation[] getDeclaredAnnotations(boolean copy) {
         if (declaredAnnotations == null) {
-            declaredAnnotations = getDeclaredAnnotations(field);
+            declaredAnnotations = root != null
+                    ? root.getDeclaredAnnotations(false) : getDeclaredAnnotations(field);
         }
         return copy ? declaredAnnotations.clone() : declaredAnnotations;
     }
@@ -116,10 +116,26 @@ public final class Method extends AccessibleObject implements GenericDeclaration
     private Type genericReturnType;
     private TypeVariable<Method>[] formalTypeParameters;
     private volatile boolean genericTypesAreInitialized = false;
-    
+
+    /*
+     * The instance this one was cloned from, or null if this is the one
+     * cached by the declaring class' ClassCache. Annotations and generic
+     * types are parsed once on the root and shared by all its copies.
+     */
+    private final Method root;
+
     @SuppressWarnings("unchecked")
     private synchronized void initGenericTypes() {
         if (!genericTypesAreInitialized) {
+            if (root != null) {
+                root.initGenericTypes();
+                formalTypeParameters = root.formalTypeParameters;
+                genericParameterTypes = root.genericParameterTypes;
+                genericExceptionTypes = root.genericExceptionTypes;
+                genericReturnType = root.genericReturnType;
+                genericTypesAreInitialized = true;
+                return;
+            }
             String signatureAttribute = getSignatureAttribute();
             GenericSignatureParser parser = new GenericSignatureParser(
                     getDeclaringClass().getClassLoader());
@@ -134,6 +150,7 @@ public final class Method extends AccessibleObject implements GenericDeclaration
     
     Method(long method) {
         this.method = method;
+        this.root = null;
     }
     
     /**
@@ -144,6 +161,7 @@ public final class Method extends AccessibleObject implements GenericDeclaration
     /*package*/ Method(Method orig) {
 
         this.method = orig.method;
+        this.root = orig.root != null ? orig.root : orig;
         this.modifiers = orig.modifiers;
         this.declaringClass = orig.declaringClass;
         this.name = orig.name;
@@ -284,7 +302,8 @@ public final class Method extends AccessibleObject implements GenericDeclaration
     @Override
     protected Annotation[] getDeclaredAnnotations(boolean copy) {
         if (declaredAnnotations == null) {
-            declaredAnnotations = getDeclaredAnnotations(method);
+            declaredAnnotations = root != null
+                    ? root.getDeclaredAnnotations(false) : getDeclaredAnnotations(method);
         }
         return copy ? declaredAnnotations.clone() : declaredAnnotations;
     }
@@ -302,6 +321,20 @@ public final class Method extends AccessibleObject implements GenericDeclaration
         }
         return annotations;
     }
+
+    /**
+     * Returns a copy of the specified parameter annotations which the caller
+     * may modify. Empty inner arrays can't be modified and are shared.
+     */
+    /*package*/ static Annotation[][] copyAnnotations(Annotation[][] annotations) {
+        Annotation[][] copy = annotations.clone();
+        for (int i = 0; i < copy.length; i++) {
+            if (copy[i].length > 0) {
+                copy[i] = copy[i].clone();
+            }
+        }
+        return copy;
+    }
     
     /**
      * Returns an array of arrays that represent the annotations of the formal
@@ -312,6 +345,10 @@ public final class Method extends AccessibleObject implements GenericDeclaration
      * @return an array of arrays of {@code Annotation} instances
      */
     public Annotation[][] getParameterAnnotations() {
+        if (parameterAnnotations == null && root != null) {
+            root.getParameterAnnotations();
+            parameterAnnotations = root.parameterAnnotations;
+        }
         if (parameterAnnotations == null) {
             Annotation[][] pa = getParameterAnnotations(method);
             if (pa.length == 0) {
@@ -319,7 +356,7 @@ public final class Method extends AccessibleObject implements GenericDeclaration
             }
             parameterAnnotations = pa;
         }
-        return parameterAnnotations.clone();
+        return copyAnnotations(parameterAnnotations);
     }
     final static native Annotation[][] getParameterAnnotations(long method);
     
@@ -362,7 +399,7 @@ public final class Method extends AccessibleObject implements GenericDeclaration
      */
     public Object getDefaultValue() {
         if (defaultValue == null) {
-            defaultValue = getDefaultValue(method);
+            defaultValue = root != null ? root.getDefaultValue() : getDefaultValue(method);
         }
         return defaultValue;
     }
@@ -423,7 +460,7 @@ public final class Method extends AccessibleObject implements GenericDeclaration
     }
     private Class<?>[] getExceptionTypes(boolean copy) {
         if (exceptionTypes == null) {
-            exceptionTypes = getExceptionTypes(method);
+            exceptionTypes = root != null ? root.getExceptionTypes(false) : getExceptionTypes(method);
         }
         return copy ? exceptionTypes.clone() : exceptionTypes;
     }
@@ -471,7 +508,7 @@ public final class Method extends AccessibleObject implements GenericDeclaration
     }
     final Class<?>[] getParameterTypes(boolean copy) {
         if (parameterTypes == null) {
-            parameterTypes = getParameterTypes(method);
+            parameterTypes = root != null ? root.getParameterTypes(false) : getParameterTypes(method);
         }
         return copy ? parameterTypes.clone() : parameterTypes;
     }
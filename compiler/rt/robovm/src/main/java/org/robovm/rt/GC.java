@@ -1,5 +1,8 @@
 package org.robovm.rt;
 
+import java.util.ArrayList;
+import java.util.List;
+
 /**
  * Interfaces with the garbage collector
  */
@@ -117,4 +120,149 @@ public class GC {
      */
     public static native void setTimeLimit(long value);
 
+    /**
+     * @return whether the collector runs in incremental (generational) mode. Enabled using the
+     * {@code -rvm:GCMode=incremental} option. Falls back to full collections if the platform
+     * doesn't support it.
+     */
+    public static native boolean isIncremental();
+
+    /**
+     * @return the number of partial (young generation) collections between full collections in
+     * incremental mode.
+     */
+    public static native int getFullFrequency();
+
+    /**
+     * In incremental mode, do a full collection every value+1 collections. Smaller values reclaim
+     * more memory at the cost of longer pauses.
+     * @param value the number of partial collections between full collections
+     */
+    public static native void setFullFrequency(int value);
+
+    /**
+     * @return the number of stop-the-world pauses recorded since startup or the last call to
+     * {@link #resetPauseTimeStats()}.
+     */
+    public static native long getPauseCount();
+
+    /**
+     * @return the total time in nanoseconds spent in stop-the-world pauses.
+     */
+    public static native long getTotalPauseTime();
+
+    /**
+     * @return the longest stop-the-world pause in nanoseconds.
+     */
+    public static native long getMaxPauseTime();
+
+    /**
+     * @return a histogram of stop-the-world pause times. Element 0 counts pauses shorter than
+     * 128 microseconds. Element i &gt; 0 counts pauses at least 2^(i+6) and less than 2^(i+7)
+     * microseconds long. The last element also counts all longer pauses.
+     */
+    public static native long[] getPauseTimeHistogram();
+
+    /**
+     * Resets the pause count, total and max pause times and the pause time histogram.
+     */
+    public static native void resetPauseTimeStats();
+
+    /**
+     * Returns the collection events recorded since the last call to this method. The VM records
+     * a {@link Event#START} and an {@link Event#END} event for each collection into a fixed size
+     * ring buffer. If the buffer is full when a collection starts or ends the event is dropped.
+     * Call this method regularly to avoid losing events.
+     *
+     * @return the events in the order they were recorded.
+     */
+    public static List<Event> drainEvents() {
+        List<Event> events = new ArrayList<>();
+        long[] buffer = new long[64 * Event.FIELDS];
+        int n;
+        do {
+            n = drainEvents0(buffer);
+            for (int i = 0; i < n; i++) {
+                events.add(new Event(buffer, i * Event.FIELDS));
+            }
+        } while (n == 64);
+        return events;
+    }
+
+    private static native int drainEvents0(long[] buffer);
+
+    /**
+     * @return the number of events dropped since startup because the event buffer was full.
+     */
+    public static native long getDroppedEventCount();
+
+    /**
+     * A collection event returned by {@link GC#drainEvents()}. Times are in nanoseconds.
+     */
+    public static final class Event {
+        /**
+         * The number of longs per event copied by the VM. Must match the size of the GCEvent
+         * struct in types.h.
+         */
+        private static final int FIELDS = 10;
+
+        public static final int START = 1;
+        public static final int END = 2;
+
+        /**
+         * {@link #START} or {@link #END}.
+         */
+        public final int type;
+        /**
+         * The number of completed collections when the event was recorded. See {@link GC#getCount()}.
+         */
+        public final long gcNumber;
+        /**
+         * Time the event was recorded. Same clock as {@link System#nanoTime()}.
+         */
+        public final long timestamp;
+        /**
+         * Only set for {@link #END} events. The time since the corresponding {@link #START} event.
+         */
+        public final long duration;
+        /**
+         * Only set for {@link #END} events. The total time the world was stopped during the
+         * collection. In incremental mode this is the sum of the pauses of all increments.
+         */
+        public final long pauseTime;
+        public final long heapSize;
+        public final long freeBytes;
+        /**
+         * Bytes allocated since the previous collection.
+         */
+        public final long bytesAllocated;
+        /**
+         * Bytes reclaimed since the previous collection. Since the heap is swept lazily this is a
+         * lower bound in {@link #END} events. The {@link #START} event of the next collection
+         * reports the final value.
+         */
+        public final long bytesReclaimed;
+        /**
+         * Only set for {@link #END} events. The number of objects queued for finalization since
+         * the previous {@link #END} event. Objects are queued when the GC invokes the finalizers
+         * after the collection which found them unreachable has ended. This happens in whichever
+         * thread ran that collection or allocates next, not in the finalizer thread. So this count
+         * lags by one collection: it mostly reports the objects found by the previous collection.
+         */
+        public final long finalizersQueued;
+
+        private Event(long[] buffer, int offset) {
+            type = (int) buffer[offset];
+            gcNumber = buffer[offset + 1];
+            timestamp = buffer[offset + 2];
+            duration = buffer[offset + 3];
+            pauseTime = buffer[offset + 4];
+            heapSize = buffer[offset + 5];
+            freeBytes = buffer[offset + 6];
+            bytesAllocated = buffer[offset + 7];
+            bytesReclaimed = buffer[offset + 8];
+            finalizersQueued = buffer[offset + 9];
+        }
+    }
+
 }
@@ -79,6 +79,16 @@ public final class VM {
      */
     public static native final Class<?>[] getStackClasses(int skipNum, int maxDepth);
 
+    /**
+     * Returns descriptions of the throw sites which have become hot and now
+     * reuse a preallocated exception. Hot exceptions are enabled by passing
+     * <code>-rvm:HotExceptions=&lt;n&gt;</code> where <code>n</code> is the
+     * number of exceptions per second a site must throw to become hot.
+     * 
+     * @return the hot throw sites. Empty if hot exceptions are disabled.
+     */
+    public static native final String[] getHotThrowSites();
+
     /**
      * Returns all {@link Class}es known to the VM optionally filtering on the
      * specified class or interface {@link Class}.
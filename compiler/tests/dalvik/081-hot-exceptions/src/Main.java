@@ -21,6 +21,55 @@ public class Main {
         int getArrayElement(int i) throws NullPointerException {
             return array[i];
         }
+
+        int getOtherArrayElement(int i) throws NullPointerException {
+            return array[i];
+        }
+    }
+
+    /*
+     * Throws from two sites and checks that every exception has the stack
+     * trace of the site which threw it, that a hot site reuses its exception
+     * and that different sites never share one.
+     */
+    static void testHotThrowSites() {
+        ArrayObj arrayObj = new ArrayObj();
+        NullPointerException[] first = new NullPointerException[1024];
+        NullPointerException[] other = new NullPointerException[1024];
+        for (int i = 0; i < 1024; i++) {
+            try {
+                arrayObj.getArrayElement(i);
+            } catch (NullPointerException npe) {
+                first[i] = npe;
+            }
+            try {
+                arrayObj.getOtherArrayElement(i);
+            } catch (NullPointerException npe) {
+                other[i] = npe;
+            }
+        }
+        boolean tracesOk = true;
+        boolean distinct = true;
+        for (int i = 0; i < 1024; i++) {
+            tracesOk &= thrownBy(first[i], "getArrayElement");
+            tracesOk &= thrownBy(other[i], "getOtherArrayElement");
+            for (int j = 0; j < 1024; j++) {
+                distinct &= first[i] != other[j];
+            }
+        }
+        System.out.println("traces ok = " + tracesOk);
+        System.out.println("sites distinct = " + distinct);
+        // getArrayElement() became hot in main().
+        System.out.println("reused = " + (first[0] == first[1023]));
+    }
+
+    static boolean thrownBy(Throwable t, String methodName) {
+        StackTraceElement[] trace = t.getStackTrace();
+        // A hot exception has the callers of the throw that made the site
+        // hot so only the top frame is checked.
+        return trace.length > 0
+            && trace[0].getClassName().equals(ArrayObj.class.getName())
+            && trace[0].getMethodName().equals(methodName);
     }
 
     public static void main(String[] args) {
@@ -38,5 +87,7 @@ public class Main {
         }
         System.out.println("sum = " + sum);
         System.out.println("exception = " + exception);
+
+        testHotThrowSites();
     }
 }
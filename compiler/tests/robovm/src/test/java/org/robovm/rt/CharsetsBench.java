@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.robovm.rt;
+package org.robovm.rt;
+
+import java.nio.charset.Charset;
+
+/**
+ * Not a test. Run manually to print the throughput of the native String
+ * encoders and decoders in {@code java_nio_charset_Charsets.cpp} on ASCII,
+ * Latin-1 and CJK heavy text.
+ */
+public class CharsetsBench {
+
+    public static void main(String[] args) {
+        Charset usAscii = Charset.forName("US-ASCII");
+        Charset iso88591 = Charset.forName("ISO-8859-1");
+        Charset utf8 = Charset.forName("UTF-8");
+        String[] labels = {"ASCII", "Latin-1", "CJK"};
+        String[] strings = {
+            CharsetsTest.text(4096, 0, 'a', 1),
+            CharsetsTest.text(4096, 4, '\u00c0', 0x40),
+            CharsetsTest.text(4096, 1, '\u4e00', 0x5000),
+        };
+        Charset[] charsets = {usAscii, iso88591, utf8};
+        int iterations = args.length > 0 ? Integer.parseInt(args[0]) : 2000;
+        for (int i = 0; i < strings.length; i++) {
+            for (Charset charset : charsets) {
+                if (i == 2 && charset != utf8) {
+                    continue;
+                }
+                String s = strings[i];
+                byte[] bytes = s.getBytes(charset);
+                long start = System.nanoTime();
+                for (int j = 0; j < iterations; j++) {
+                    bytes = s.getBytes(charset);
+                }
+                long encode = System.nanoTime() - start;
+                start = System.nanoTime();
+                for (int j = 0; j < iterations; j++) {
+                    s = new String(bytes, charset);
+                }
+                long decode = System.nanoTime() - start;
+                System.out.format("%-8s %-10s encode: %7.1f MB/s  decode: %7.1f MB/s%n", labels[i], charset.name(),
+                        s.length() * 2.0 * iterations * 1000 / encode, s.length() * 2.0 * iterations * 1000 / decode);
+            }
+        }
+    }
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.robovm.rt;
+
+import static org.junit.Assert.*;
+
+import java.nio.charset.Charset;
+import java.util.Random;
+
+import org.junit.Test;
+
+/**
+ * Tests the native String encoders and decoders in
+ * {@code java_nio_charset_Charsets.cpp} on strings which are long enough to
+ * use the vectorized loops.
+ */
+public class CharsetsTest {
+    private static final Charset US_ASCII = Charset.forName("US-ASCII");
+    private static final Charset ISO_8859_1 = Charset.forName("ISO-8859-1");
+    private static final Charset UTF_8 = Charset.forName("UTF-8");
+
+    /**
+     * Returns JSON-like text where every {@code every}th char of the values
+     * is taken from {@code [first, first + range)}.
+     */
+    static String text(int length, int every, char first, int range) {
+        Random random = new Random(1);
+        StringBuilder sb = new StringBuilder();
+        int n = 0;
+        while (sb.length() < length) {
+            sb.append("{\"id\":12345,\"name\":\"");
+            for (int i = 0; i < 24; i++) {
+                if (every > 0 && n++ % every == 0) {
+                    sb.append((char) (first + random.nextInt(range)));
+                } else {
+                    sb.append((char) ('a' + random.nextInt(26)));
+                }
+            }
+        }
+        sb.setLength(length);
+        return sb.toString();
+    }
+
+    @Test
+    public void testAscii() {
+        for (int length = 0; length < 100; length++) {
+            String s = text(length, 0, 'a', 1);
+            assertEquals(s, new String(s.getBytes(US_ASCII), US_ASCII));
+            assertEquals(s, new String(s.getBytes(ISO_8859_1), ISO_8859_1));
+            assertEquals(s, new String(s.getBytes(UTF_8), UTF_8));
+        }
+        byte[] bytes = text(40, 0, 'a', 1).getBytes(US_ASCII);
+        bytes[20] = (byte) 0xe5;
+        String s = new String(bytes, US_ASCII);
+        assertEquals('\ufffd', s.charAt(20));
+        assertEquals(text(40, 0, 'a', 1).substring(21), s.substring(21));
+    }
+
+    @Test
+    public void testUnmappableCharsAreReplaced() {
+        String s = text(40, 0, 'a', 1);
+        String t = s.substring(0, 17) + '\u00e5' + s.substring(18, 30) + '\u4e2d' + s.substring(31);
+        byte[] ascii = t.getBytes(US_ASCII);
+        assertEquals('?', ascii[17]);
+        assertEquals('?', ascii[30]);
+        byte[] latin1 = t.getBytes(ISO_8859_1);
+        assertEquals((byte) 0xe5, latin1[17]);
+        assertEquals('?', latin1[30]);
+        assertEquals(s.substring(31), new String(latin1, 31, 9, ISO_8859_1));
+    }
+
+    @Test
+    public void testUtf8() {
+        String[] strings = {
+            text(1000, 4, '\u00c0', 0x40),
+            text(1000, 1, '\u4e00', 0x5000),
+            text(100, 3, '\u0000', 0x80),
+            "abc\ud83d\ude00def\ud83dxyz\ude00" + text(40, 0, 'a', 1),
+        };
+        for (String s : strings) {
+            byte[] bytes = s.getBytes(UTF_8);
+            assertEquals(s.replace("\ud83dx", "?x").replace("z\ude00", "z?"), new String(bytes, UTF_8));
+        }
+    }
+}
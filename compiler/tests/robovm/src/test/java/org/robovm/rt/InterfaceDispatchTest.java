@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.robovm.rt;
+
+import static org.junit.Assert.*;
+
+import org.junit.Test;
+
+/**
+ * Tests that invokeinterface calls the right method when call sites
+ * alternate between several interfaces implemented by the same class.
+ */
+public class InterfaceDispatchTest {
+
+    interface A { int a(); }
+    interface B { int b(); }
+    interface C { int c(); }
+    interface D { int d(); }
+    interface E { int e(); }
+    interface F extends A, B { int f(); }
+
+    static class Impl implements C, D, E, F {
+        public int a() { return 1; }
+        public int b() { return 2; }
+        public int c() { return 3; }
+        public int d() { return 4; }
+        public int e() { return 5; }
+        public int f() { return 6; }
+    }
+
+    static class SubImpl extends Impl {
+        public int a() { return 10; }
+        public int e() { return 50; }
+    }
+
+    private static int callAll(Object o) {
+        return ((A) o).a() + ((B) o).b() + ((C) o).c() + ((D) o).d() + ((E) o).e() + ((F) o).f();
+    }
+
+    @Test
+    public void testAlternatingInterfaces() {
+        Object impl = new Impl();
+        Object subImpl = new SubImpl();
+        for (int i = 0; i < 1000; i++) {
+            assertEquals(21, callAll(impl));
+            assertEquals(75, callAll(subImpl));
+        }
+    }
+
+    @Test
+    public void testAlternatingInterfacesFromManyThreads() throws Exception {
+        final int threadCount = 8;
+        final boolean[] ok = new boolean[threadCount];
+        Thread[] threads = new Thread[threadCount];
+        for (int t = 0; t < threadCount; t++) {
+            final int index = t;
+            threads[t] = new Thread() {
+                public void run() {
+                    Object[] objects = {new Impl(), new SubImpl()};
+                    boolean result = true;
+                    for (int i = 0; i < 100000; i++) {
+                        result &= callAll(objects[i & 1]) == ((i & 1) == 0 ? 21 : 75);
+                    }
+                    ok[index] = result;
+                }
+            };
+        }
+        for (Thread t : threads) {
+            t.start();
+        }
+        for (Thread t : threads) {
+            t.join();
+        }
+        for (int t = 0; t < threadCount; t++) {
+            assertTrue("Wrong result in thread " + t, ok[t]);
+        }
+    }
+}
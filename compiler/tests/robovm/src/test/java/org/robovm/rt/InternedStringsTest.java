@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.robovm.rt;
+
+import static org.junit.Assert.*;
+
+import java.lang.ref.WeakReference;
+import java.util.ArrayList;
+import java.util.List;
+
+import org.junit.Test;
+
+/**
+ * Tests that {@link String#intern()} returns the same instance as string
+ * literals and earlier calls and that interned strings which are no longer
+ * referenced are collected.
+ */
+public class InternedStringsTest {
+
+    @Test
+    public void testIdentity() {
+        String literal = "InternedStringsTest \u00e5\u4e2d";
+        String copy = new String(literal.toCharArray());
+        assertNotSame(literal, copy);
+        assertSame(literal, copy.intern());
+        assertSame(literal, literal.intern());
+        assertSame("", new String().intern());
+
+        List<String> interned = new ArrayList<>();
+        for (int i = 0; i < 10000; i++) {
+            interned.add(("s" + i).intern());
+        }
+        for (int i = 0; i < 10000; i++) {
+            assertSame(interned.get(i), ("s" + i).intern());
+        }
+    }
+
+    @Test
+    public void testUnreferencedStringsAreCollected() throws Exception {
+        int count = 1000;
+        List<WeakReference<String>> refs = new ArrayList<>();
+        for (int i = 0; i < count; i++) {
+            refs.add(new WeakReference<String>(("InternedStringsTest " + i).intern()));
+        }
+        int cleared = 0;
+        long end = System.currentTimeMillis() + 10000;
+        while (cleared < count * 9 / 10 && System.currentTimeMillis() < end) {
+            System.gc();
+            Thread.sleep(10);
+            cleared = 0;
+            for (WeakReference<String> ref : refs) {
+                if (ref.get() == null) {
+                    cleared++;
+                }
+            }
+        }
+        // The GC is conservative so a few of the strings may still be
+        // considered reachable.
+        assertTrue("Only " + cleared + " of " + count + " strings collected",
+                cleared >= count * 9 / 10);
+
+        // Interning equal strings again must return live instances.
+        for (int i = 0; i < count; i++) {
+            String s = ("InternedStringsTest " + i).intern();
+            assertEquals("InternedStringsTest " + i, s);
+            assertSame(s, ("InternedStringsTest " + i).intern());
+        }
+    }
+}
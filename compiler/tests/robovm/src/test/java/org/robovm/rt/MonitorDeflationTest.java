@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.robovm.rt;
+
+import static org.junit.Assert.*;
+
+import java.util.concurrent.atomic.AtomicReference;
+
+import org.junit.Test;
+
+/**
+ * Tests that monitors used for {@link Object#wait()} and
+ * {@link Object#notify()} still provide mutual exclusion while the GC
+ * deflates and reuses idle monitors concurrently.
+ */
+public class MonitorDeflationTest {
+    private static final int PAIRS = 4;
+    private static final int CELLS = 16;
+    private static final int ITERATIONS = 20000;
+
+    static class Cell {
+        boolean full;
+        int value;
+        Thread owner;
+
+        void enter(AtomicReference<Throwable> failure) {
+            if (owner != null) {
+                failure.compareAndSet(null, new AssertionError(
+                        Thread.currentThread() + " entered monitor owned by " + owner));
+            }
+            owner = Thread.currentThread();
+        }
+
+        void exit() {
+            owner = null;
+        }
+    }
+
+    @Test
+    public void testWaitNotifyDuringGC() throws Exception {
+        final AtomicReference<Throwable> failure = new AtomicReference<Throwable>();
+        final boolean[] stop = new boolean[1];
+        Thread gc = new Thread() {
+            public void run() {
+                while (!isStopped()) {
+                    System.gc();
+                }
+            }
+            private boolean isStopped() {
+                synchronized (stop) {
+                    return stop[0];
+                }
+            }
+        };
+        gc.start();
+
+        Thread[] threads = new Thread[PAIRS * 2];
+        for (int i = 0; i < PAIRS; i++) {
+            final Cell[] cells = new Cell[CELLS];
+            for (int j = 0; j < CELLS; j++) {
+                cells[j] = new Cell();
+            }
+            threads[i * 2] = new Thread() {
+                public void run() {
+                    try {
+                        for (int k = 0; k < ITERATIONS; k++) {
+                            Cell cell = cells[k % CELLS];
+                            synchronized (cell) {
+                                while (cell.full) {
+                                    cell.wait();
+                                }
+                                cell.enter(failure);
+                                cell.full = true;
+                                cell.value = k;
+                                cell.notifyAll();
+                                cell.exit();
+                            }
+                        }
+                    } catch (Throwable t) {
+                        failure.compareAndSet(null, t);
+                    }
+                }
+            };
+            threads[i * 2 + 1] = new Thread() {
+                public void run() {
+                    try {
+                        for (int k = 0; k < ITERATIONS; k++) {
+                            Cell cell = cells[k % CELLS];
+                            synchronized (cell) {
+                                while (!cell.full) {
+                                    cell.wait();
+                                }
+                                cell.enter(failure);
+                                if (cell.value != k) {
+                                    failure.compareAndSet(null, new AssertionError(
+                                            "Expected " + k + " but got " + cell.value));
+                                }
+                                cell.full = false;
+                                cell.notifyAll();
+                                cell.exit();
+                            }
+                        }
+                    } catch (Throwable t) {
+                        failure.compareAndSet(null, t);
+                    }
+                }
+            };
+        }
+        for (Thread t : threads) {
+            t.start();
+        }
+        try {
+            for (Thread t : threads) {
+                t.join(60000);
+                assertFalse("Thread didn't finish", t.isAlive());
+            }
+        } finally {
+            synchronized (stop) {
+                stop[0] = true;
+            }
+            gc.join();
+        }
+        if (failure.get() != null) {
+            throw new AssertionError(failure.get());
+        }
+    }
+}
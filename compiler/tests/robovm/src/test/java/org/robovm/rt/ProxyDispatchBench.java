@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.robovm.rt;
+package org.robovm.rt;
+
+import org.robovm.rt.ProxyDispatchTest.Service;
+
+/**
+ * Not a test. Run manually to print the overhead of calling a method on a
+ * {@link java.lang.reflect.Proxy}.
+ */
+public class ProxyDispatchBench {
+
+    public static void main(String[] args) {
+        Service p = ProxyDispatchTest.newProxy();
+        int calls = args.length > 0 ? Integer.parseInt(args[0]) : 1000000;
+        int sum = 0;
+        for (int i = 0; i < 1000; i++) {
+            sum += p.getUser(i);
+        }
+        long start = System.nanoTime();
+        for (int i = 0; i < calls; i++) {
+            sum += p.getUser(i);
+        }
+        long duration = System.nanoTime() - start;
+        System.out.format("Proxy call: %.1f ns/call (%d)%n", (double) duration / calls, sum);
+    }
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.robovm.rt;
+
+import static org.junit.Assert.*;
+
+import java.lang.reflect.InvocationHandler;
+import java.lang.reflect.Method;
+import java.lang.reflect.Proxy;
+import java.util.Arrays;
+
+import org.junit.Test;
+
+/**
+ * Tests that calls to dynamic proxies reach the right {@link Method} with
+ * their arguments and return values intact for all parameter types.
+ */
+public class ProxyDispatchTest {
+
+    public interface Service {
+        int getUser(int id);
+        long sum(byte b, short s, char c, int i, long l, float f, double d, boolean z);
+        double scale(float f, double d);
+        String[] split(String s, char c);
+        void ping();
+    }
+
+    public interface Extended extends Service {
+        boolean isEmpty(Object[] objects);
+        char first(String s);
+    }
+
+    private static final InvocationHandler HANDLER = new InvocationHandler() {
+        @Override
+        public Object invoke(Object proxy, Method method, Object[] args) throws Throwable {
+            String name = method.getName();
+            if (name.equals("getUser")) {
+                return (Integer) args[0] + 1;
+            } else if (name.equals("sum")) {
+                return (Byte) args[0] + (Short) args[1] + (Character) args[2] + (Integer) args[3]
+                        + (Long) args[4] + (long) (float) (Float) args[5] + (long) (double) (Double) args[6]
+                        + ((Boolean) args[7] ? 1 : 0);
+            } else if (name.equals("scale")) {
+                return (Float) args[0] * (Double) args[1];
+            } else if (name.equals("split")) {
+                return ((String) args[0]).split(String.valueOf(args[1]));
+            } else if (name.equals("ping")) {
+                return null;
+            } else if (name.equals("isEmpty")) {
+                return ((Object[]) args[0]).length == 0;
+            } else if (name.equals("first")) {
+                return ((String) args[0]).charAt(0);
+            } else if (name.equals("hashCode")) {
+                return 42;
+            } else if (name.equals("equals")) {
+                return proxy == args[0];
+            } else if (name.equals("toString")) {
+                return "proxy";
+            }
+            throw new AssertionError(name);
+        }
+    };
+
+    static Extended newProxy() {
+        return (Extended) Proxy.newProxyInstance(ProxyDispatchTest.class.getClassLoader(),
+                new Class<?>[] {Extended.class}, HANDLER);
+    }
+
+    @Test
+    public void testArgumentsAndReturnValues() {
+        Extended p = newProxy();
+        assertEquals(124, p.getUser(123));
+        assertEquals(-1L + 2 + 'a' + 4 + 5_000_000_000L + 6 + 7 + 1,
+                p.sum((byte) -1, (short) 2, 'a', 4, 5_000_000_000L, 6.5f, 7.5, true));
+        assertEquals(3.0, p.scale(1.5f, 2.0), 0.0);
+        assertEquals(Arrays.asList("a", "b", "c"), Arrays.asList(p.split("a,b,c", ',')));
+        p.ping();
+        assertTrue(p.isEmpty(new Object[0]));
+        assertFalse(p.isEmpty(new String[] {"x"}));
+        assertEquals('\u00e5', p.first("\u00e5x"));
+        assertEquals(42, p.hashCode());
+        assertTrue(p.equals(p));
+        assertEquals("proxy", p.toString());
+    }
+}
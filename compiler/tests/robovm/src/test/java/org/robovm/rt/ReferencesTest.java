@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.robovm.rt;
+
+import static org.junit.Assert.*;
+
+import java.lang.ref.Reference;
+import java.lang.ref.ReferenceQueue;
+import java.lang.ref.WeakReference;
+import java.util.ArrayList;
+import java.util.List;
+
+import org.junit.Test;
+
+/**
+ * Tests that references are cleared and enqueued by the GC.
+ */
+public class ReferencesTest {
+
+    @Test
+    public void testWeakReferencesAreEnqueued() throws Exception {
+        int count = 10000;
+        ReferenceQueue<Object> queue = new ReferenceQueue<>();
+        List<WeakReference<Object>> refs = new ArrayList<>();
+        for (int i = 0; i < count; i++) {
+            refs.add(new WeakReference<Object>(new byte[64], queue));
+        }
+        int enqueued = 0;
+        long end = System.currentTimeMillis() + 10000;
+        while (enqueued < count && System.currentTimeMillis() < end) {
+            System.gc();
+            Reference<?> ref;
+            while ((ref = queue.remove(10)) != null) {
+                assertNull(ref.get());
+                enqueued++;
+            }
+        }
+        // The GC is conservative so a few of the referents may still be
+        // considered reachable.
+        assertTrue("Only " + enqueued + " of " + count + " references enqueued",
+                enqueued >= count * 9 / 10);
+    }
+
+    @Test
+    public void testWeakReferencesFromManyThreadsAreEnqueued() throws Exception {
+        final int threadCount = 8;
+        final int count = 2000;
+        final ReferenceQueue<Object> queue = new ReferenceQueue<>();
+        final List<List<WeakReference<Object>>> refs = new ArrayList<>();
+        Thread[] threads = new Thread[threadCount];
+        for (int t = 0; t < threadCount; t++) {
+            final List<WeakReference<Object>> list = new ArrayList<>();
+            refs.add(list);
+            threads[t] = new Thread() {
+                public void run() {
+                    for (int i = 0; i < count; i++) {
+                        list.add(new WeakReference<Object>(new byte[64], queue));
+                    }
+                }
+            };
+        }
+        for (Thread t : threads) {
+            t.start();
+        }
+        for (Thread t : threads) {
+            t.join();
+        }
+        for (List<WeakReference<Object>> list : refs) {
+            assertEquals(count, list.size());
+        }
+        int total = threadCount * count;
+        int enqueued = 0;
+        long end = System.currentTimeMillis() + 10000;
+        while (enqueued < total && System.currentTimeMillis() < end) {
+            System.gc();
+            Reference<?> ref;
+            while ((ref = queue.remove(10)) != null) {
+                assertNull(ref.get());
+                enqueued++;
+            }
+        }
+        assertTrue("Only " + enqueued + " of " + total + " references enqueued",
+                enqueued >= total * 9 / 10);
+    }
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.robovm.rt;
+package org.robovm.rt;
+
+import java.lang.reflect.Field;
+
+import org.robovm.rt.ReflectionCacheTest.Bean;
+import org.robovm.rt.ReflectionCacheTest.Name;
+
+/**
+ * Not a test. Run manually to print the time it takes to look up the
+ * annotations of all fields of a class.
+ */
+public class ReflectionCacheBench {
+
+    public static void main(String[] args) {
+        int iterations = args.length > 0 ? Integer.parseInt(args[0]) : 100000;
+        int count = 0;
+        long start = System.nanoTime();
+        for (int i = 0; i < iterations; i++) {
+            for (Field f : Bean.class.getDeclaredFields()) {
+                if (f.getAnnotation(Name.class) != null) {
+                    count++;
+                }
+            }
+        }
+        long duration = System.nanoTime() - start;
+        System.out.format("getDeclaredFields() + getAnnotation(): %.1f ns/field%n",
+                (double) duration / count);
+    }
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.robovm.rt;
+
+import static org.junit.Assert.*;
+
+import java.lang.annotation.Annotation;
+import java.lang.annotation.Retention;
+import java.lang.annotation.RetentionPolicy;
+import java.lang.reflect.Constructor;
+import java.lang.reflect.Field;
+import java.lang.reflect.Method;
+import java.util.List;
+
+import org.junit.Test;
+
+/**
+ * Tests that the {@link Method}, {@link Field} and {@link Constructor} copies
+ * returned by {@link Class} share annotations and generic types parsed once
+ * by the cached instances while still returning fresh arrays.
+ */
+public class ReflectionCacheTest {
+
+    @Retention(RetentionPolicy.RUNTIME)
+    public @interface Name {
+        String value();
+    }
+
+    public static class Bean {
+        @Name("a") public int a;
+        @Name("b") public String b;
+        @Name("c") public List<String> c;
+        public Bean() {}
+        @Name("ctor") public Bean(@Name("x") int x) {}
+        @Name("m") public List<String> m(@Name("y") List<Integer> y) { return null; }
+    }
+
+    @Test
+    public void testFieldCopiesShareAnnotations() throws Exception {
+        Field f1 = Bean.class.getDeclaredField("c");
+        Field f2 = Bean.class.getDeclaredField("c");
+        assertNotSame(f1, f2);
+        Name n1 = f1.getAnnotation(Name.class);
+        assertEquals("c", n1.value());
+        assertSame(n1, f2.getAnnotation(Name.class));
+        assertSame(f1.getGenericType(), f2.getGenericType());
+        Annotation[] a1 = f1.getDeclaredAnnotations();
+        Annotation[] a2 = f2.getDeclaredAnnotations();
+        assertNotSame(a1, a2);
+        a1[0] = null;
+        assertSame(n1, f1.getDeclaredAnnotations()[0]);
+    }
+
+    @Test
+    public void testMethodCopiesShareAnnotations() throws Exception {
+        Method m1 = Bean.class.getMethod("m", List.class);
+        Method m2 = Bean.class.getDeclaredMethods()[0];
+        assertEquals(m1, m2);
+        assertSame(m1.getAnnotation(Name.class), m2.getAnnotation(Name.class));
+        Annotation[][] pa1 = m1.getParameterAnnotations();
+        Annotation[][] pa2 = m2.getParameterAnnotations();
+        assertNotSame(pa1, pa2);
+        assertEquals("y", ((Name) pa1[0][0]).value());
+        assertSame(pa1[0][0], pa2[0][0]);
+        pa1[0][0] = null;
+        assertSame(pa2[0][0], m1.getParameterAnnotations()[0][0]);
+        assertSame(pa2[0][0], m2.getParameterAnnotations()[0][0]);
+        assertEquals(m1.getGenericReturnType(), m2.getGenericReturnType());
+        Class<?>[] p1 = m1.getParameterTypes();
+        p1[0] = null;
+        assertSame(List.class, m2.getParameterTypes()[0]);
+    }
+
+    @Test
+    public void testConstructorCopiesShareAnnotations() throws Exception {
+        Constructor<Bean> c1 = Bean.class.getConstructor(int.class);
+        Constructor<Bean> c2 = Bean.class.getDeclaredConstructor(int.class);
+        assertNotSame(c1, c2);
+        assertSame(c1.getAnnotation(Name.class), c2.getAnnotation(Name.class));
+        Annotation[][] pa1 = c1.getParameterAnnotations();
+        assertSame(pa1[0][0], c2.getParameterAnnotations()[0][0]);
+        pa1[0][0] = null;
+        assertEquals("x", ((Name) c1.getParameterAnnotations()[0][0]).value());
+        assertEquals("x", ((Name) c2.getParameterAnnotations()[0][0]).value());
+        assertEquals(0, Bean.class.getConstructor().getParameterAnnotations().length);
+    }
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.robovm.rt;
+package org.robovm.rt;
+
+import static org.robovm.rt.SQLiteBatchTest.COLUMNS;
+import static org.robovm.rt.SQLiteBatchTest.ROWS;
+
+import SQLite.Stmt;
+import SQLite.StmtBatch;
+
+/**
+ * Not a test. Run manually to print the time it takes to read a 20 column
+ * by 10000 row table using {@link Stmt#step_batch(StmtBatch)} and using
+ * {@link Stmt#step()} and the per column methods.
+ */
+public class SQLiteBatchBench {
+
+    public static void main(String[] args) throws Exception {
+        SQLiteBatchTest t = new SQLiteBatchTest();
+        t.setUp();
+        try {
+            for (int i = 0; i < 3; i++) {
+                Stmt s = t.db.prepare("select * from t");
+                long start = System.nanoTime();
+                long sum = 0;
+                while (s.step()) {
+                    for (int col = 0; col < COLUMNS; col++) {
+                        Object o = s.column(col);
+                        sum += o != null ? 1 : 0;
+                    }
+                }
+                long perColumn = System.nanoTime() - start;
+                s.close();
+
+                s = t.db.prepare("select * from t");
+                StmtBatch b = new StmtBatch(256);
+                start = System.nanoTime();
+                long batchSum = 0;
+                while (s.step_batch(b) > 0) {
+                    for (int row = 0; row < b.rows(); row++) {
+                        for (int col = 0; col < COLUMNS; col++) {
+                            Object o = b.column(row, col);
+                            batchSum += o != null ? 1 : 0;
+                        }
+                    }
+                }
+                long batch = System.nanoTime() - start;
+                s.close();
+
+                if (sum != batchSum) {
+                    throw new AssertionError("step_batch returned " + batchSum + " non-null cells, expected " + sum);
+                }
+                System.out.format("%d x %d cells: per column %.1f ms, step_batch %.1f ms%n",
+                        ROWS, COLUMNS, perColumn / 1e6, batch / 1e6);
+            }
+        } finally {
+            t.tearDown();
+        }
+    }
+}
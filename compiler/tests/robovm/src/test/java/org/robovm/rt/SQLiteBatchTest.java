@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+package org.robovm.rt;
+
+import static org.junit.Assert.*;
+
+import java.io.File;
+
+import org.junit.After;
+import org.junit.Before;
+import org.junit.Test;
+
+import SQLite.Constants;
+import SQLite.Database;
+import SQLite.Stmt;
+import SQLite.StmtBatch;
+
+/**
+ * Tests {@link Stmt#step_batch(StmtBatch)} against the values returned by
+ * {@link Stmt#step()} and the per column methods.
+ */
+public class SQLiteBatchTest {
+    static final int COLUMNS = 20;
+    static final int ROWS = 10000;
+
+    private File dbFile;
+    Database db;
+
+    @Before
+    public void setUp() throws Exception {
+        dbFile = File.createTempFile("SQLiteBatchTest", ".db");
+        db = new Database();
+        db.open(dbFile.getPath(), 0666);
+        StringBuilder sb = new StringBuilder("create table t (");
+        for (int col = 0; col < COLUMNS; col++) {
+            sb.append(col > 0 ? ", " : "").append("c").append(col);
+        }
+        db.exec(sb.append(")").toString(), null);
+        sb = new StringBuilder("insert into t values (");
+        for (int col = 0; col < COLUMNS; col++) {
+            sb.append(col > 0 ? ", ?" : "?");
+        }
+        db.exec("begin", null);
+        Stmt insert = db.prepare(sb.append(")").toString());
+        for (int row = 0; row < ROWS; row++) {
+            for (int col = 0; col < COLUMNS; col++) {
+                switch (col % 5) {
+                case 0: insert.bind(col + 1, (long) row * col); break;
+                case 1: insert.bind(col + 1, row / 3.0); break;
+                case 2: insert.bind(col + 1, "row " + row + " \u00e5\u4e2d"); break;
+                case 3: insert.bind(col + 1, new byte[] {(byte) row, (byte) col}); break;
+                case 4: if (row % 2 == 0) insert.bind(col + 1); else insert.bind(col + 1, "x"); break;
+                }
+            }
+            insert.step();
+            insert.reset();
+        }
+        insert.close();
+        db.exec("commit", null);
+    }
+
+    @After
+    public void tearDown() throws Exception {
+        db.close();
+        dbFile.delete();
+    }
+
+    @Test
+    public void testBatchMatchesPerColumn() throws Exception {
+        Stmt s1 = db.prepare("select * from t");
+        Stmt s2 = db.prepare("select * from t");
+        StmtBatch b = new StmtBatch(333);
+        int rows = 0;
+        while (s2.step_batch(b) > 0) {
+            assertEquals(COLUMNS, b.columns());
+            for (int row = 0; row < b.rows(); row++) {
+                assertTrue(s1.step());
+                for (int col = 0; col < COLUMNS; col++) {
+                    int type = s1.column_type(col);
+                    assertEquals(type, b.column_type(row, col));
+                    switch (type) {
+                    case Constants.SQLITE_INTEGER:
+                        assertEquals(s1.column_long(col), b.column_long(row, col));
+                        break;
+                    case Constants.SQLITE_FLOAT:
+                        assertEquals(s1.column_double(col), b.column_double(row, col), 0.0);
+                        break;
+                    case Constants.SQLITE3_TEXT:
+                        assertEquals(s1.column_string(col), b.column_string(row, col));
+                        assertSame(b.column_string(row, col), b.column_string(row, col));
+                        break;
+                    case Constants.SQLITE_BLOB:
+                        assertArrayEquals(s1.column_bytes(col), b.column_bytes(row, col));
+                        break;
+                    case Constants.SQLITE_NULL:
+                        assertNull(b.column(row, col));
+                        break;
+                    }
+                }
+                rows++;
+            }
+        }
+        assertFalse(s1.step());
+        assertEquals(ROWS, rows);
+        assertEquals(0, s2.step_batch(b));
+        assertEquals(0, b.rows());
+        s1.close();
+        s2.close();
+    }
+
+    @Test
+    public void testCapacityOverflow() throws Exception {
+        Stmt s = db.prepare("select * from t");
+        // COLUMNS * capacity doesn't fit in an int
+        StmtBatch b = new StmtBatch(Integer.MAX_VALUE / 10);
+        try {
+            s.step_batch(b);
+            fail("SQLite.Exception expected");
+        } catch (SQLite.Exception e) {
+        }
+        s.close();
+    }
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string.h>
+#include "addressindex.h"
+
+// Smallest number of bytes covered by a bucket.
+#define MIN_SHIFT 4
+
+static int compareAddressRanges(const void* _a, const void* _b) {
+    AddressRange* a = (AddressRange*) _a;
+    AddressRange* b = (AddressRange*) _b;
+    return a->start < b->start ? -1 : (a->start > b->start ? 1 : 0);
+}
+
+static jboolean isSorted(AddressRange* ranges, jint count) {
+    for (jint i = 1; i < count; i++) {
+        if (ranges[i].start < ranges[i - 1].start) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+AddressIndex* newAddressIndex(Env* env, AddressRange* ranges, jint count, jboolean owned) {
+    AddressIndex* index = rvmAllocateMemoryAtomicUncollectable(env, sizeof(AddressIndex));
+    if (!index) {
+        if (owned) {
+            rvmFreeMemoryUncollectable(env, ranges);
+        }
+        return NULL;
+    }
+    memset(index, 0, sizeof(AddressIndex));
+    if (owned) {
+        index->ranges = ranges;
+        index->ownsRanges = TRUE;
+    }
+    if (count == 0) {
+        return index;
+    }
+
+    if (owned) {
+        if (!isSorted(ranges, count)) {
+            qsort(ranges, count, sizeof(AddressRange), compareAddressRanges);
+        }
+    } else if (!isSorted(ranges, count)) {
+        // The ranges passed in may be in read-only memory. Sort a copy.
+        AddressRange* copy = rvmAllocateMemoryAtomicUncollectable(env, sizeof(AddressRange) * count);
+        if (!copy) goto error;
+        index->ranges = copy;
+        index->ownsRanges = TRUE;
+        memcpy(copy, ranges, sizeof(AddressRange) * count);
+        qsort(copy, count, sizeof(AddressRange), compareAddressRanges);
+        ranges = copy;
+    }
+    index->ranges = ranges;
+    index->count = count;
+    index->start = ranges[0].start;
+    index->end = ranges[0].start;
+    for (jint i = 0; i < count; i++) {
+        void* end = ranges[i].start + ranges[i].size;
+        if (end > index->end) {
+            index->end = end;
+        }
+    }
+
+    // Use about as many buckets as there are ranges. Lookups then scan a
+    // single range on average.
+    size_t span = index->end - index->start;
+    jint shift = MIN_SHIFT;
+    while ((span >> shift) > (size_t) count) {
+        shift++;
+    }
+    index->shift = shift;
+    jint bucketCount = (jint) (span >> shift) + 1;
+    index->buckets = rvmAllocateMemoryAtomicUncollectable(env, sizeof(jint) * bucketCount);
+    if (!index->buckets) goto error;
+    jint i = 0;
+    for (jint b = 0; b < bucketCount; b++) {
+        void* bucketStart = index->start + ((size_t) b << shift);
+        while (i < count && ranges[i].start + ranges[i].size <= bucketStart) {
+            i++;
+        }
+        index->buckets[b] = i;
+    }
+    return index;
+
+error:
+    freeAddressIndex(env, index);
+    return NULL;
+}
+
+void freeAddressIndex(Env* env, AddressIndex* index) {
+    if (index->buckets) {
+        rvmFreeMemoryUncollectable(env, index->buckets);
+    }
+    if (index->ownsRanges) {
+        rvmFreeMemoryUncollectable(env, index->ranges);
+    }
+    rvmFreeMemoryUncollectable(env, index);
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ADDRESSINDEX_H
+#define ADDRESSINDEX_H
+
+#include <robovm.h>
+
+/*
+ * An address range [start, start + size).
+ */
+typedef struct {
+    void* start;
+    void* data;
+    uint32_t size;
+} AddressRange;
+
+/*
+ * Sorted, non-overlapping AddressRanges with a bucket per 2^shift bytes of
+ * the covered address space. Each bucket holds the index of the first range
+ * which ends after the start of the bucket.
+ */
+typedef struct {
+    AddressRange* ranges;
+    jboolean ownsRanges;  // TRUE if ranges is freed with the index
+    jint count;
+    void* start;
+    void* end;
+    jint shift;
+    jint* buckets;
+} AddressIndex;
+
+/*
+ * Creates an index of the specified ranges. If owned is TRUE the ranges must
+ * have been allocated using rvmAllocateMemoryAtomicUncollectable(). They are
+ * then sorted in place and freed with the index, even if this fails.
+ * Otherwise a sorted copy is made if they aren't sorted already.
+ */
+extern AddressIndex* newAddressIndex(Env* env, AddressRange* ranges, jint count, jboolean owned);
+extern void freeAddressIndex(Env* env, AddressIndex* index);
+
+/*
+ * Returns the index of the range containing the specified address or -1 if
+ * not found.
+ */
+static inline jint findAddressRange(AddressIndex* index, void* address) {
+    if (address < index->start || address >= index->end) {
+        return -1;
+    }
+    jint i = index->buckets[(address - index->start) >> index->shift];
+    for (; i < index->count && index->ranges[i].start <= address; i++) {
+        if (address < index->ranges[i].start + index->ranges[i].size) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#endif
@@ -18,16 +18,45 @@
 #include "utlist.h"
 #include "MurmurHash3.h"
 #include "classinfo.h"
+#include "addressindex.h"
 
 #define LOG_TAG "bc"
 
 #define ALLOC_NATIVE_FRAMES_SIZE 8
 
+/*
+ * The _bcMethodAddresses table emitted by the compiler. Contains an entry for
+ * every method with an implementation in the executable. The entries of a
+ * class are adjacent. The sizes of the methods are read from the ClassInfo.
+ */
+typedef struct {
+    void* impl;
+    ClassInfoHeader* header;
+} MethodAddress;
+typedef struct {
+    uint32_t count;
+    MethodAddress methods[0];
+} MethodAddresses;
+
+/*
+ * The _bcInvokers table emitted by the compiler. Contains an invoker stub for
+ * every call shape (see callplan.c) of the methods in the executable sorted
+ * by shape.
+ */
+typedef struct {
+    const char* shape;
+    void* invoker;
+} Invoker;
+
+typedef struct {
+    uint32_t count;
+    Invoker invokers[0];
+} Invokers;
+
 typedef struct {
-    ClassInfoHeader* classInfoHeader;
-    void* start;
-    void* end;
-} AddressClassLookup;
+    AddressIndex* index;
+    Method* methods[0]; // The Method at each range in index. Filled in lazily.
+} MethodAddressIndex;
 
 typedef struct {
     ClassInfoHeader* exHeader;
@@ -47,6 +76,8 @@ extern void* _bcBootClassesHash;
 extern void* _bcClassesHash;
 extern void* _bcStrippedMethodStubs;
 extern void* _bcRuntimeData;
+extern void* _bcMethodAddresses;
+extern void* _bcInvokers;
 static Class* loadBootClass(Env*, const char*, Object*);
 static Class* loadUserClass(Env*, const char*, Object*);
 static void classInitialized(Env*, Class*);
@@ -54,14 +85,15 @@ static Interface* loadInterfaces(Env*, Class*);
 static Field* loadFields(Env*, Class*);
 static Method* loadMethods(Env*, Class*);
 static Class* findClassAt(Env*, void*);
+static Method* findMethodAt(Env*, void*);
+static void* findInvoker(Env*, const char*);
 static Class* createClass(Env*, ClassInfoHeader*, Object*);
 static jboolean exceptionMatch(Env* env, TrycatchContext*);
 static ObjectArray* listBootClasses(Env*, Class*);
 static ObjectArray* listUserClasses(Env*, Class*);
 static Options options = {0};
 static VM* vm = NULL;
-static jint addressClassLookupsCount = 0;
-static AddressClassLookup* addressClassLookups = NULL;
+static MethodAddressIndex* methodAddressIndex = NULL;
 
 static void initOptions() {
     options.mainClass = (char*) _bcMainClass;
@@ -74,6 +106,8 @@ static void initOptions() {
     options.loadFields = loadFields;
     options.loadMethods = loadMethods;
     options.findClassAt = findClassAt;
+    options.findMethodAt = findMethodAt;
+    options.findInvoker = findInvoker;
     options.exceptionMatch = exceptionMatch;
     options.staticLibs = _bcStaticLibs;
     options.runtimeData = &_bcRuntimeData;
@@ -103,67 +137,73 @@ int __attribute__ ((weak)) main(int argc, char* argv[]) {
     bcmain( argc, argv );
 }
 
+/*
+ * The class hashes are minimal perfect hash tables generated by the compiler
+ * (see HashTableGenerator.java). Layout (all integers are uint32_t):
+ *
+ *   count, bucketCount, slotCount, overflowCount,
+ *   seeds[bucketCount], fingerprints[count], ClassInfoHeader* values[count]
+ *
+ * where count = slotCount + overflowCount.
+ */
+typedef struct ClassInfosHash {
+    uint32_t count;
+    uint32_t bucketCount;
+    uint32_t slotCount;
+    uint32_t overflowCount;
+    uint32_t data[0]; // seeds followed by fingerprints
+} ClassInfosHash;
+
 static ClassInfoHeader** getClassInfosBase(void* hash) {
-    uint32_t size = ((uint32_t*) hash)[1];
-    void* base = hash
-            + sizeof(uint32_t) /* count */
-            + sizeof(uint32_t) /* size */
-            + (size << 2)
-            + sizeof(uint32_t) /* this is for the last end index in the hash */;
+    ClassInfosHash* h = (ClassInfosHash*) hash;
+    void* base = &h->data[h->bucketCount + h->count];
     // Make sure base is properly aligned
     return (ClassInfoHeader**) (((uintptr_t) base + sizeof(void*) - 1) & ~(sizeof(void*) - 1));
 }
 
 static uint32_t getClassInfosCount(void* hash) {
-    return ((uint32_t*) hash)[0];
+    return ((ClassInfosHash*) hash)->count;
+}
+
+static inline uint32_t fmix32(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
 }
 
 static ClassInfoHeader* lookupClassInfo(Env* env, const char* className, void* hash) {
+    ClassInfosHash* table = (ClassInfosHash*) hash;
+    if (table->count == 0) {
+        return NULL;
+    }
     ClassInfoHeader** base = getClassInfosBase(hash);
+    uint32_t* seeds = table->data;
+    uint32_t* fingerprints = &table->data[table->bucketCount];
 
     // Hash the class name
     uint32_t h = 0;
     MurmurHash3_x86_32(className, strlen(className) + 1, 0x1ce79e5c, &h);
-    uint32_t size = ((uint32_t*) hash)[1];
-    h &= size - 1;
 
-    // Get the start and end indexes
-    hash += sizeof(uint32_t) + sizeof(uint32_t); // Skip count and size
-    uint32_t start = ((uint32_t*) hash)[h];
-    uint32_t end = ((uint32_t*) hash)[h + 1];
-
-    // Iterate through the ClassInfoHeaders between start and end
-    for (uint32_t i = start; i < end; i++) {
-        ClassInfoHeader* header = base[i];
-        if (header && !strcmp(header->className, className)) {
-            return header;
+    // Every class in the table maps to its own slot. The fingerprint rejects
+    // most classes not in the table without having to compare names.
+    if (table->slotCount > 0) {
+        uint32_t seed = seeds[h & (table->bucketCount - 1)];
+        uint32_t slot = (uint32_t) (((uint64_t) fmix32(h ^ seed) * table->slotCount) >> 32);
+        if (fingerprints[slot] == h && !strcmp(base[slot]->className, className)) {
+            return base[slot];
         }
     }
-    return NULL;
-}
 
-static void iterateClassInfos(Env* env, jboolean (*callback)(Env*, ClassInfoHeader*, MethodInfo*, void*), void* hash, void* data) {
-    ClassInfoHeader** base = getClassInfosBase(hash);
-    uint32_t count = getClassInfosCount(hash);
-    uint32_t i = 0;
-    for (i = 0; i < count; i++) {
-        ClassInfoHeader* header = base[i];
-        if ((header->flags & CI_ERROR) == 0) {
-            ClassInfo ci;
-            void* p = base[i];
-            readClassInfo(&p, &ci);
-            skipInterfaceNames(&p, &ci);
-            skipFieldInfos(&p, &ci);
-            jint j;
-            for (j = 0; j < ci.methodCount; j++) {
-                MethodInfo mi;
-                readMethodInfo(&p, &mi);
-                if (!callback(env, base[i], &mi, data)) {
-                    break;
-                }
-            }
+    // Classes with the same hash as another class are stored after the slots.
+    for (uint32_t i = table->slotCount; i < table->count; i++) {
+        if (fingerprints[i] == h && !strcmp(base[i]->className, className)) {
+            return base[i];
         }
     }
+    return NULL;
 }
 
 static ObjectArray* listClasses(Env* env, Class* instanceofClazz, Object* classLoader, void* hash) {
@@ -274,6 +314,12 @@ static void wrapClassNotFoundException(Env* env, const char* className) {
     }
 }
 
+static void classRegistered(Env* env, Class* clazz, void* data) {
+    ClassInfoHeader* header = (ClassInfoHeader*) data;
+    header->clazz = clazz;
+    rvmHookClassLoaded(env, clazz, (void*)header);
+}
+
 static Class* createClass(Env* env, ClassInfoHeader* header, Object* classLoader) {
     ClassInfo ci;
     void* p = header;
@@ -292,12 +338,12 @@ static Class* createClass(Env* env, ClassInfoHeader* header, Object* classLoader
             header->instanceRefCount, ci.attributes, header->initializer);
 
     if (clazz) {
-        if (!rvmRegisterClass(env, clazz)) {
+        // header->clazz must be set before the class can be found by other
+        // threads.
+        if (!rvmRegisterClass(env, clazz, classRegistered, header)) {
             rvmReleaseClassLock(env);
             return NULL;
         }
-        header->clazz = clazz;
-        rvmHookClassLoaded(env, clazz, (void*)header);
     }
 
     rvmReleaseClassLock(env);
@@ -422,80 +468,74 @@ error:
     return NULL;
 }
 
-static inline jboolean hasImpl(MethodInfo* mi) {
-    if (!mi->impl) {
-        return FALSE;
+/*
+ * Fills in the AddressRanges of the count adjacent _bcMethodAddresses
+ * entries of a single class. The method sizes are read from the class's
+ * ClassInfo. Methods which aren't found get size 0 and never match.
+ */
+static void initMethodAddressRanges(MethodAddress* methods, jint count, AddressRange* ranges) {
+    for (jint i = 0; i < count; i++) {
+        ranges[i].start = methods[i].impl;
+        ranges[i].data = methods[i].header;
+        ranges[i].size = 0;
     }
-    return !isStrippedMethod(mi);
-}
-
-static jboolean countClassesWithConcreteMethodsCallback(Env* env, ClassInfoHeader* header, MethodInfo* mi, void* d) {
-    if (hasImpl(mi)) {
-        jint* count = (jint*) d;
-        *count = *count + 1;
-        return FALSE;
+    ClassInfo ci;
+    void* p = methods[0].header;
+    readClassInfo(&p, &ci);
+    skipInterfaceNames(&p, &ci);
+    skipFieldInfos(&p, &ci);
+    for (jint i = 0; i < ci.methodCount; i++) {
+        MethodInfo mi;
+        readMethodInfo(&p, &mi);
+        if (mi.impl) {
+            for (jint j = 0; j < count; j++) {
+                if (ranges[j].start == mi.impl) {
+                    ranges[j].size = mi.size;
+                    break;
+                }
+            }
+        }
     }
-    return TRUE;
 }
 
-static jboolean initAddressClassLookupsCallback(Env* env, ClassInfoHeader* header, MethodInfo* mi, void* d) {
-    if (hasImpl(mi)) {
-        AddressClassLookup** lookupPtr = (AddressClassLookup**) d;
-        AddressClassLookup* lookup = *lookupPtr;
-        if (lookup->classInfoHeader != header) {
-            if (lookup->classInfoHeader) {
-                *lookupPtr += 1;
-                lookup = *lookupPtr;
+static MethodAddressIndex* getMethodAddressIndex(Env* env) {
+    MethodAddressIndex* mai = rvmAtomicLoadAcquirePtr((void**) &methodAddressIndex);
+    if (!mai) {
+        MethodAddresses* addresses = (MethodAddresses*) _bcMethodAddresses;
+        jint count = addresses->count;
+        AddressRange* ranges = rvmAllocateMemoryAtomicUncollectable(env, sizeof(AddressRange) * (count > 0 ? count : 1));
+        if (!ranges) return NULL;
+        for (jint i = 0; i < count;) {
+            jint n = 1;
+            while (i + n < count && addresses->methods[i + n].header == addresses->methods[i].header) {
+                n++;
             }
-            lookup->classInfoHeader = header;
-            lookup->start = mi->impl;
-            lookup->end = mi->impl + mi->size;
-        } else if (lookup->start > mi->impl) {
-            lookup->start = mi->impl;
-        } else if (lookup->end <= mi->impl) {
-            lookup->end = mi->impl + mi->size;
+            initMethodAddressRanges(&addresses->methods[i], n, &ranges[i]);
+            i += n;
+        }
+        size_t size = sizeof(MethodAddressIndex) + sizeof(Method*) * count;
+        mai = rvmAllocateMemoryAtomicUncollectable(env, size);
+        if (!mai) {
+            rvmFreeMemoryUncollectable(env, ranges);
+            return NULL;
+        }
+        memset(mai, 0, size);
+        mai->index = newAddressIndex(env, ranges, count, TRUE);
+        if (!mai->index) {
+            rvmFreeMemoryUncollectable(env, mai);
+            return NULL;
+        }
+        if (!rvmAtomicCompareAndSwapPtr((void**) &methodAddressIndex, NULL, mai)) {
+            // Another thread got here first.
+            freeAddressIndex(env, mai->index);
+            rvmFreeMemoryUncollectable(env, mai);
+            mai = rvmAtomicLoadAcquirePtr((void**) &methodAddressIndex);
         }
     }
-    return TRUE;
-}
-
-static int addressClassLookupCompareBSearch(const void* _a, const void* _b) {
-    AddressClassLookup* needle = (AddressClassLookup*) _a;
-    AddressClassLookup* el = (AddressClassLookup*) _b;
-    void* pc = needle->start;
-    return (pc >= el->start && pc < el->end) ? 0 : ((pc < el->start) ? -1 : 1);
-}
-
-static int addressClassLookupCompareQSort(const void* _a, const void* _b) {
-    AddressClassLookup* a = (AddressClassLookup*) _a;
-    AddressClassLookup* b = (AddressClassLookup*) _b;
-    return (a->end <= b->start) ? -1 : 1;
-}
-
-static AddressClassLookup* getAddressClassLookups(Env* env) {
-    if (!addressClassLookups) {
-        jint count = 0;
-        iterateClassInfos(env, countClassesWithConcreteMethodsCallback, _bcBootClassesHash, &count);
-        iterateClassInfos(env, countClassesWithConcreteMethodsCallback, _bcClassesHash, &count);
-        AddressClassLookup* lookups = rvmAllocateMemoryAtomicUncollectable(env, sizeof(AddressClassLookup) * count);
-        if (!lookups) return NULL;
-        AddressClassLookup* _lookups = lookups;
-        iterateClassInfos(env, initAddressClassLookupsCallback, _bcBootClassesHash, &_lookups);
-        iterateClassInfos(env, initAddressClassLookupsCallback, _bcClassesHash, &_lookups);
-        qsort(lookups, count, sizeof(AddressClassLookup), addressClassLookupCompareQSort);
-        addressClassLookupsCount = count;
-        addressClassLookups = lookups;
-    }
-    return addressClassLookups;
+    return mai;
 }
 
-Class* findClassAt(Env* env, void* pc) {
-    AddressClassLookup* lookups = getAddressClassLookups(env);
-    if (!lookups) return NULL;
-    AddressClassLookup needle = {NULL, pc, pc};
-    AddressClassLookup* result = bsearch(&needle, lookups, addressClassLookupsCount, sizeof(AddressClassLookup), addressClassLookupCompareBSearch);
-    if (!result) return NULL;
-    ClassInfoHeader* header = result->classInfoHeader;
+static Class* getClassForHeader(Env* env, ClassInfoHeader* header) {
     Class* clazz = header->clazz;
     if (!clazz) {
         Object* loader = NULL;
@@ -507,6 +547,56 @@ Class* findClassAt(Env* env, void* pc) {
     return clazz;
 }
 
+Class* findClassAt(Env* env, void* pc) {
+    MethodAddressIndex* mai = getMethodAddressIndex(env);
+    if (!mai) return NULL;
+    jint i = findAddressRange(mai->index, pc);
+    if (i < 0) return NULL;
+    return getClassForHeader(env, (ClassInfoHeader*) mai->index->ranges[i].data);
+}
+
+Method* findMethodAt(Env* env, void* pc) {
+    MethodAddressIndex* mai = getMethodAddressIndex(env);
+    if (!mai) return NULL;
+    jint i = findAddressRange(mai->index, pc);
+    if (i < 0) return NULL;
+    Method* method = rvmAtomicLoadAcquirePtr((void**) &mai->methods[i]);
+    if (method) {
+        return method;
+    }
+    Class* clazz = getClassForHeader(env, (ClassInfoHeader*) mai->index->ranges[i].data);
+    if (!clazz) return NULL;
+    method = rvmGetMethods(env, clazz);
+    if (rvmExceptionCheck(env)) return NULL;
+    void* start = mai->index->ranges[i].start;
+    for (; method != NULL; method = method->next) {
+        if (method->impl == start) {
+            rvmAtomicStorePtr((void**) &mai->methods[i], method);
+            return method;
+        }
+    }
+    return NULL;
+}
+
+void* findInvoker(Env* env, const char* shape) {
+    Invokers* table = (Invokers*) _bcInvokers;
+    uint32_t lo = 0;
+    uint32_t hi = table->count;
+    while (lo < hi) {
+        uint32_t mid = lo + ((hi - lo) >> 1);
+        int c = strcmp(shape, table->invokers[mid].shape);
+        if (c == 0) {
+            return table->invokers[mid].invoker;
+        }
+        if (c < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return NULL;
+}
+
 jboolean exceptionMatch(Env* env, TrycatchContext* _tc) {
     BcTrycatchContext* tc = (BcTrycatchContext*) _tc;
     LandingPad* lps = tc->landingPads[tc->tc.sel - 1];
@@ -523,12 +613,9 @@ jboolean exceptionMatch(Env* env, TrycatchContext* _tc) {
             // Exception class not yet loaded so it cannot match.
             continue;
         }
-        Class* clazz = header->clazz;
-        Class* c = throwable->clazz;
-        while (c && c != clazz) {
-            c = c->superclass;
-        }
-        if (c == clazz) {
+        // Exception classes are never interfaces or arrays so the class
+        // display in the TypeInfo decides whether the throwable matches.
+        if (rvmIsClassTypeInfoAssignable(env, throwable->clazz->typeInfo, header->clazz->typeInfo)) {
             tc->tc.sel = lps[i].landingPadId;
             return TRUE;
         }
@@ -616,20 +703,10 @@ void* _bcLookupInterfaceMethod(Env* env, ClassInfoHeader* header, Object* thiz,
 }
 
 void* _bcLookupInterfaceMethodImpl(Env* env, ClassInfoHeader* header, Object* thiz, uint32_t index) {
-    TypeInfo* typeInfo = header->typeInfo;
-    ITables* itables = thiz->clazz->itables;
-    ITable* itable = itables->cache;
-    if (itable->typeInfo == typeInfo) {
+    ITable* itable = rvmFindITable(thiz->clazz->itables, header->typeInfo);
+    if (itable) {
         return itable->table.table[index];
     }
-    uint32_t i;
-    for (i = 0; i < itables->count; i++) {
-        itable = itables->table[i];
-        if (itable->typeInfo == typeInfo) {
-            itables->cache = itable;
-            return itable->table.table[index];
-        }
-    }
 
     ENTER;
     initializeClass(env, header);
@@ -698,19 +775,25 @@ Object* _bcExceptionClear(Env* env) {
 
 void _bcThrowNullPointerException(Env* env) {
     ENTER;
-    rvmThrowNullPointerException(env);
+    if (!rvmThrowHotException(env, java_lang_NullPointerException, __builtin_return_address(0))) {
+        rvmThrowNullPointerException(env);
+    }
     LEAVEV;
 }
 
 void _bcThrowArrayIndexOutOfBoundsException(Env* env, jint length, jint index) {
     ENTER;
-    rvmThrowArrayIndexOutOfBoundsException(env, length, index);
+    if (!rvmThrowHotException(env, java_lang_ArrayIndexOutOfBoundsException, __builtin_return_address(0))) {
+        rvmThrowArrayIndexOutOfBoundsException(env, length, index);
+    }
     LEAVEV;
 }
 
 void _bcThrowArithmeticException(Env* env) {
     ENTER;
-    rvmThrowArithmeticException(env);
+    if (!rvmThrowHotException(env, java_lang_ArithmeticException, __builtin_return_address(0))) {
+        rvmThrowArithmeticException(env);
+    }
     LEAVEV;
 }
 
@@ -782,14 +865,20 @@ void _bcThrowIncompatibleClassChangeError(Env* env, char* msg) {
 
 void _bcThrowClassCastException(Env* env, ClassInfoHeader* header, Object* o) {
     ENTER;
-    Class* clazz = ldcClass(env, header);
-    rvmThrowClassCastException(env, clazz, o->clazz);
+    if (!rvmThrowHotException(env, java_lang_ClassCastException, __builtin_return_address(0))) {
+        Class* clazz = ldcClass(env, header);
+        if (clazz) {
+            rvmThrowClassCastException(env, clazz, o->clazz);
+        }
+    }
     LEAVEV;
 }
 
 void _bcThrowClassCastExceptionArray(Env* env, Class* arrayClass, Object* o) {
     ENTER;
-    rvmThrowClassCastException(env, arrayClass, o->clazz);
+    if (!rvmThrowHotException(env, java_lang_ClassCastException, __builtin_return_address(0))) {
+        rvmThrowClassCastException(env, arrayClass, o->clazz);
+    }
     LEAVEV;
 }
 
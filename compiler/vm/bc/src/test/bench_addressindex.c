@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares the time it takes to map the pc of a stack frame to the method it
+ * belongs to using a bsearch() over per-class address ranges (what
+ * findClassAt() in bc.c did before addressindex.c) with findAddressRange().
+ * The synthetic code layout has classes with 1-32 methods of 16-2048 bytes
+ * each. The pcs looked up are random addresses inside the methods, like the
+ * return addresses seen when capturing a call stack.
+ *
+ * The time to build the old lookup table on first use isn't included. It
+ * required parsing the ClassInfo of every class in the executable.
+ *
+ * Usage: bench_addressindex [methods] [lookups]
+ */
+#include <robovm.h>
+#include <string.h>
+#include <time.h>
+#include "../addressindex.h"
+
+#define DEFAULT_METHODS 100000
+#define DEFAULT_LOOKUPS 10000000
+
+typedef struct {
+    void* data;
+    void* start;
+    void* end;
+} ClassRange;
+
+// addressindex.c only needs these from the rest of the VM.
+void* rvmAllocateMemoryAtomicUncollectable(Env* env, size_t size) {
+    return malloc(size);
+}
+void rvmFreeMemoryUncollectable(Env* env, void* m) {
+    free(m);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compareClassRangeBSearch(const void* _a, const void* _b) {
+    ClassRange* needle = (ClassRange*) _a;
+    ClassRange* el = (ClassRange*) _b;
+    void* pc = needle->start;
+    return (pc >= el->start && pc < el->end) ? 0 : ((pc < el->start) ? -1 : 1);
+}
+
+int main(int argc, char* argv[]) {
+    jint methodCount = argc > 1 ? atoi(argv[1]) : DEFAULT_METHODS;
+    long lookups = argc > 2 ? atol(argv[2]) : DEFAULT_LOOKUPS;
+    Env env;
+    memset(&env, 0, sizeof(Env));
+    srand(1);
+
+    // Lay out methods back to back starting at an arbitrary address. Nothing
+    // is ever read from these addresses.
+    AddressRange* ranges = malloc(sizeof(AddressRange) * methodCount);
+    ClassRange* classes = malloc(sizeof(ClassRange) * methodCount);
+    jint classCount = 0;
+    char* p = (char*) 0x100000;
+    for (jint i = 0; i < methodCount; classCount++) {
+        jint n = 1 + rand() % 32;
+        classes[classCount].data = &classes[classCount];
+        classes[classCount].start = p;
+        for (jint j = 0; j < n && i < methodCount; j++, i++) {
+            uint32_t size = 16 << (rand() % 8);
+            ranges[i].start = p;
+            ranges[i].data = &classes[classCount];
+            ranges[i].size = size;
+            p += size;
+        }
+        classes[classCount].end = p;
+    }
+
+    void** pcs = malloc(sizeof(void*) * 1024 * 1024);
+    for (jint i = 0; i < 1024 * 1024; i++) {
+        AddressRange* r = &ranges[rand() % methodCount];
+        pcs[i] = r->start + rand() % r->size;
+    }
+
+    double start = now();
+    AddressIndex* index = newAddressIndex(&env, ranges, methodCount, TRUE);
+    printf("%d methods in %d classes. Index built in %.2f ms\n", methodCount, classCount, (now() - start) * 1e3);
+
+    start = now();
+    for (long i = 0; i < lookups; i++) {
+        ClassRange needle = {NULL, pcs[i & (1024 * 1024 - 1)], NULL};
+        ClassRange* result = bsearch(&needle, classes, classCount, sizeof(ClassRange), compareClassRangeBSearch);
+        if (!result) {
+            fprintf(stderr, "pc %p not found\n", needle.start);
+            return 1;
+        }
+    }
+    double elapsed = now() - start;
+    printf("bsearch:  %8.1f ns/lookup\n", elapsed * 1e9 / lookups);
+
+    start = now();
+    for (long i = 0; i < lookups; i++) {
+        void* pc = pcs[i & (1024 * 1024 - 1)];
+        if (findAddressRange(index, pc) < 0) {
+            fprintf(stderr, "pc %p not found\n", pc);
+            return 1;
+        }
+    }
+    elapsed = now() - start;
+    printf("index:    %8.1f ns/lookup\n", elapsed * 1e9 / lookups);
+
+    return 0;
+}
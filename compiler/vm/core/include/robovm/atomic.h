@@ -56,6 +56,15 @@ static inline void* rvmAtomicLoadPtr(void** ptr) {
     return __sync_fetch_and_or(ptr, NULL);
 }
 
+/*
+ * Plain load with acquire semantics. Unlike rvmAtomicLoadPtr() this never
+ * writes to the cache line so use it for lock-free lookups of data
+ * published using rvmAtomicCompareAndSwapPtr().
+ */
+static inline void* rvmAtomicLoadAcquirePtr(void** ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
 static inline jint rvmAtomicStoreInt(jint* ptr, jint newval) {
     while (TRUE) {
         jint oldval = *ptr;
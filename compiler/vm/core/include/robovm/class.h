@@ -124,16 +124,40 @@ extern Class* array_J;
 extern Class* array_F;
 extern Class* array_D;
 
+static inline uint32_t* rvmGetInterfaceTable(TypeInfo* ti) {
+    return &ti->types[ti->classCount + ti->interfaceCount];
+}
 static inline jboolean rvmIsInterfaceTypeInfoAssignable(Env* env, TypeInfo* sti, TypeInfo* tti) {
     uint32_t id = tti->id;
-    uint32_t ifCount = sti->interfaceCount;
-    uint32_t* base = (uint32_t*) ((((char*) sti) + sti->offset) + sizeof(uint32_t));
+    uint32_t mask = sti->interfaceTableMask;
+    uint32_t* table = rvmGetInterfaceTable(sti);
+    uint32_t i = id & mask;
+    while (table[i] != id) {
+        if (table[i] == TYPE_INFO_EMPTY_SLOT) return FALSE;
+        i = (i + 1) & mask;
+    }
+    return TRUE;
+}
+/*
+ * Returns the ITable in itables for the interface with the specified
+ * TypeInfo or NULL if the class doesn't implement the interface. The cache
+ * slot selected by the interface's type id is checked first. The slot is
+ * only written on a miss. Interfaces used together on the same class
+ * usually map to different slots and don't keep evicting each other.
+ */
+static inline ITable* rvmFindITable(ITables* itables, TypeInfo* typeInfo) {
+    ITable** slot = &itables->cache[typeInfo->id & (ITABLES_CACHE_SIZE - 1)];
+    ITable* itable = *slot;
+    if (itable && itable->typeInfo == typeInfo) return itable;
     uint32_t i;
-    for (i = 0; i < ifCount; i++) {
-        if (*base == id) return TRUE;
-        base++;
+    for (i = 0; i < itables->count; i++) {
+        itable = itables->table[i];
+        if (itable->typeInfo == typeInfo) {
+            *slot = itable;
+            return itable;
+        }
     }
-    return FALSE;
+    return NULL;
 }
 static inline jboolean rvmIsClassTypeInfoAssignable(Env* env, TypeInfo* sti, TypeInfo* tti) {
     uint32_t id = tti->id;
@@ -167,7 +191,12 @@ extern BridgeMethod* rvmAddBridgeMethod(Env* env, Class* clazz, const char* name
         void* synchronizedImpl, void** targetFnPtr, void* attributes);
 extern CallbackMethod* rvmAddCallbackMethod(Env* env, Class* clazz, const char* name, const char* desc, jint vitableIndex, jint access, jint size, void* impl, 
 		void* synchronizedImpl, void* linetable, void* callbackImpl, void* attributes);
-extern jboolean rvmRegisterClass(Env* env, Class* clazz);
+/*
+ * Registers clazz with the class lock held. If setup isn't NULL it is called
+ * with data after the class has been registered but before other threads can
+ * find it.
+ */
+extern jboolean rvmRegisterClass(Env* env, Class* clazz, void (*setup)(Env*, Class*, void*), void* data);
 
 extern Class* rvmFindClass(Env* env, const char* className);
 extern Class* rvmFindClassInClasspathForLoader(Env* env, const char* className, Object* classLoader);
@@ -49,6 +49,8 @@ extern jboolean rvmThrowIllegalMonitorStateException(Env* env, const char* messa
 extern jboolean rvmThrowInterruptedException(Env* env);
 extern jboolean rvmThrowIllegalStateException(Env* env, const char* message);
 extern void rvmRaiseException(Env* env, Object* e);
+extern jboolean rvmThrowHotException(Env* env, Class* clazz, void* pc);
+extern ObjectArray* rvmGetHotThrowSites(Env* env);
 
 static inline jboolean rvmExceptionCheck(Env* env) {
     return env->throwable ? TRUE : FALSE;
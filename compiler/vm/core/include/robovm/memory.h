@@ -25,6 +25,7 @@ extern void rvmRegisterFinalizer(Env* env, Object* obj);
 extern void rvmRegisterReference(Env* env, Object* reference, Object* referent);
 extern void rvmRegisterDisappearingLink(Env* env, void** address, Object* obj);
 extern void rvmUnregisterDisappearingLink(Env* env, void** address);
+extern Object* rvmReadDisappearingLink(Env* env, void** address);
 extern Array* rvmAllocateMemoryForArray(Env* env, Class* arrayClass, jint length);
 extern void* rvmAllocateMemory(Env* env, size_t size);
 extern void* rvmAllocateMemoryUncollectable(Env* env, size_t size);
@@ -32,6 +33,11 @@ extern void* rvmAllocateMemoryAtomic(Env* env, size_t size);
 extern void* rvmAllocateMemoryAtomicUncollectable(Env* env, size_t size);
 extern void rvmFreeMemoryUncollectable(Env* env, void* m);
 extern void rvmGCCollect(Env* env);
+extern jboolean rvmIsIncrementalGC(Env* env);
+extern void rvmGetGCPauseStats(Env* env, GCPauseStats* stats);
+extern void rvmResetGCPauseStats(Env* env);
+extern jint rvmDrainGCEvents(Env* env, GCEvent* dest, jint max);
+extern jlong rvmGetDroppedGCEventCount(Env* env);
 extern jboolean rvmInitRefTable(Env* env, RefTable* refTable, jint size);
 extern jboolean rvmAddGlobalRef(Env* env, Object* object);
 extern jboolean rvmRemoveGlobalRef(Env* env, Object* object);
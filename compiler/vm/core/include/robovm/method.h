@@ -55,6 +55,7 @@ extern CallStack* rvmCaptureCallStack(Env* env);
 extern CallStack* rvmCaptureCallStackForThread(Env* env, RvmThread* thread);
 extern CallStackFrame* rvmResolveCallStackFrame(Env* env, CallStackFrame* frame);
 extern ObjectArray* rvmCallStackToStackTraceElements(Env* env, CallStack* callStack, jint first);
+extern jboolean rvmCallMethodUsingInvoker(Env* env, Method* method, jvalue* args, jvalue* result);
 extern void rvmCallVoidInstanceMethod(Env* env, Object* obj, Method* method, ...);
 extern void rvmCallVoidInstanceMethodA(Env* env, Object* obj, Method* method, jvalue* args);
 extern void rvmCallVoidInstanceMethodV(Env* env, Object* obj, Method* method, va_list args);
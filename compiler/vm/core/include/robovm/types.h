@@ -87,6 +87,7 @@ struct Method {
   void* impl;
   void* synchronizedImpl;
   void* linetable;
+  void* callPlan;  // Lazily built CallPlan used when calling the method from C, see callplan.c
 };
 
 struct NativeMethod {
@@ -139,16 +140,28 @@ struct ITable {
   VITable table;
 };
 
+#define ITABLES_CACHE_SIZE 4 // Must be a power of 2. Must match %ITables in header.ll and ClassCompiler.
+
 struct ITables {
   uint16_t count;
-  ITable* cache;
+  ITable* cache[ITABLES_CACHE_SIZE]; // Recently used ITables indexed by interface type id, see rvmFindITable()
   ITable* table[0];
 };
 
+/*
+ * The types array holds the ids of all superclasses (ending with this
+ * class) followed by the ids of all implemented interfaces. It's followed by
+ * an open addressing hash table of the interface ids with
+ * interfaceTableMask + 1 slots. Empty slots hold TYPE_INFO_EMPTY_SLOT. The
+ * table is never more than half full. Must correspond to the %TypeInfo
+ * type in header.ll and the TypeInfos emitted by the Linker.
+ */
+#define TYPE_INFO_EMPTY_SLOT 0xffffffff
+
 struct TypeInfo {
   uint32_t id;
   uint32_t offset;
-  uint32_t cache;
+  uint32_t interfaceTableMask;
   uint32_t classCount;
   uint32_t interfaceCount;
   uint32_t types[0];
@@ -214,10 +227,14 @@ struct Monitor {
   RvmThread*     waitSet;  /* threads currently waiting on this monitor */
   Monitor*    next;
   RvmMutex lock;
+  jint        contenders;     /* threads about to lock the monitor, negative once deflated */
 };
 
 struct RvmThread {
   jint threadId;
+  /* The next two fields are accessed by monitorenter and monitorexit in header.ll. Don't move them. */
+  volatile jboolean inBiasedLockOp;      /* TRUE while updating a lock word biased to this thread, see monitor.c */
+  Object* volatile biasRevocationRequest; /* Object whose bias another thread wants this thread to revoke */
   Env* env;
   Object* threadObj;
   struct RvmThread* waitNext;
@@ -231,6 +248,8 @@ struct RvmThread {
   jint status;
   pthread_cond_t waitCond;
   sigset_t signalMask;
+  void* allocCache;     /* thread local cache of free Object memory, see alloccache.c */
+  void* globalRefCache; /* global refs recently added by this thread, see reftable.c */
 };
 
 struct Array {
@@ -319,6 +338,34 @@ struct SystemProperty {
   SystemProperty* next;
 };
 
+#define GC_PAUSE_HISTOGRAM_BUCKETS 16
+
+// Stop-the-world pause times in nanoseconds. See rvmGetGCPauseStats().
+typedef struct GCPauseStats {
+    jlong count;
+    jlong totalTime;
+    jlong maxTime;
+    jlong histogram[GC_PAUSE_HISTOGRAM_BUCKETS];
+} GCPauseStats;
+
+#define GC_EVENT_TYPE_START 1
+#define GC_EVENT_TYPE_END 2
+
+// A collection event. All fields are jlongs so that events can be copied
+// straight into a long[]. See rvmDrainGCEvents().
+typedef struct GCEvent {
+    jlong type;
+    jlong gcNo;
+    jlong timestamp;        // Monotonic time in nanoseconds
+    jlong duration;         // END only. Nanoseconds since the START event
+    jlong pauseTime;        // END only. Stop-the-world nanoseconds since the previous END
+    jlong heapSize;
+    jlong freeBytes;
+    jlong bytesAllocated;   // Since the previous collection
+    jlong bytesReclaimed;   // Since the previous collection. Grows after END due to lazy sweeping
+    jlong finalizersQueued; // END only. FinalizerReferences enqueued since the previous END. Lags by one collection
+} GCEvent;
+
 typedef struct Options {
     char* mainClass;
     char** commandLineArgs;
@@ -327,6 +374,9 @@ typedef struct Options {
     jlong maxHeapSize;
     jlong initialHeapSize;
     jboolean enableGCHeapStats;
+    jboolean incrementalGC;
+    jint hotExceptionThreshold; // Throws per second before a throw site reuses a preallocated exception. 0 disables.
+    jboolean enableBiasedLocking;
     jboolean enableHooks;
     jboolean waitForResume;
     jboolean printPID;
@@ -349,6 +399,8 @@ typedef struct Options {
     Field* (*loadFields)(Env*, Class*);
     Method* (*loadMethods)(Env*, Class*);
     Class* (*findClassAt)(Env*, void*);
+    Method* (*findMethodAt)(Env*, void*); // Optional. Used instead of findClassAt if set.
+    void* (*findInvoker)(Env*, const char*); // Optional. Finds the invoker stub for a call shape, see callplan.c.
     jboolean (*exceptionMatch)(Env*, TrycatchContext*);
     ObjectArray* (*listBootClasses)(Env*, Class*);
     ObjectArray* (*listUserClasses)(Env*, Class*);
@@ -360,11 +412,16 @@ typedef struct VM {
     jboolean initialized;
 } VM;
 
+typedef struct RefTableEntry {
+    Object* object;
+    jint count; // Number of times object has been added to the table
+} RefTableEntry;
+
 typedef struct RefTable {
     struct RefTable* prev;
-    jint size; // Total size of this table
-    jint count; // Number of references in this table
-    void** entries;
+    jint size; // Total size of this table. Always a power of 2.
+    jint count; // Number of distinct objects in this table
+    RefTableEntry* entries;
 } RefTable;
 
 typedef struct GatewayFrame {
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Per-thread cache of free, small Object sized chunks of GC memory. Each
+ * cache has one stack of free chunks per size class (1 to
+ * ALLOC_CACHE_SIZE_CLASSES granules). Stacks are refilled in batches of
+ * roughly one GC heap block using GC_generic_malloc_many() which means that
+ * the allocation lock is taken once per batch rather than once per object.
+ *
+ * The chunks in a cache are kept alive by the cache itself which is
+ * allocated uncollectably and thus scanned conservatively by the GC. The
+ * first word of a chunk is what the GC uses to find the descriptor of a gcj
+ * kind object so while a chunk is in the cache its first word points to
+ * freeChunkClass which has a descriptor telling the GC that there is nothing
+ * to mark in the chunk.
+ */
+#include <robovm.h>
+#include <string.h>
+#include <gc/gc_inline.h>
+#include <gc/gc_gcj.h>
+#include "private.h"
+
+// The number of bytes in a GC heap block. Used to size the stacks in the
+// cache so that a single batch returned by GC_generic_malloc_many() fits.
+#define ALLOC_CACHE_BLOCK_SIZE 4096
+
+typedef struct RefillData {
+    AllocCache* cache;
+    jint index;
+    void* list;
+    GC_word gcNo;
+    void** top;
+} RefillData;
+
+// Fake Class pointed to by the first word of every chunk in a cache. Only
+// the gcDescriptor is ever read (by the GC) and it's 0 (GC_DS_LENGTH with
+// length 0) which means the GC will not scan the chunk.
+static Class freeChunkClass;
+
+static inline jint stackCapacity(jint index) {
+    return ALLOC_CACHE_BLOCK_SIZE / ((index + 1) * ALLOC_CACHE_GRANULE_BYTES) + 1;
+}
+
+AllocCache* gcNewAllocCache(void) {
+    jint slots = 0;
+    for (jint i = 0; i < ALLOC_CACHE_SIZE_CLASSES; i++) {
+        slots += stackCapacity(i);
+    }
+    AllocCache* cache = GC_MALLOC_UNCOLLECTABLE(sizeof(AllocCache) + slots * sizeof(void*));
+    if (!cache) {
+        return NULL;
+    }
+    memset(cache, 0, sizeof(AllocCache) + slots * sizeof(void*));
+    // GC_all_interior_pointers makes the GC add 1 extra byte to every
+    // allocation. We have to do the same when mapping sizes to granules.
+    cache->extraBytes = GC_get_all_interior_pointers() ? 1 : 0;
+    void** p = cache->slots;
+    for (jint i = 0; i < ALLOC_CACHE_SIZE_CLASSES; i++) {
+        cache->base[i] = p;
+        cache->top[i] = p;
+        p += stackCapacity(i);
+    }
+    return cache;
+}
+
+void gcFreeAllocCache(AllocCache* cache) {
+    // The chunks left in the cache become unreachable and will be reclaimed
+    // by the next GC.
+    GC_FREE(cache);
+}
+
+static void* refillLocked(void* _data) {
+    RefillData* data = (RefillData*) _data;
+    if (GC_get_gc_no() != data->gcNo) {
+        // A collection completed after the batch was returned to us and
+        // before we got the allocation lock. The chunks in the batch were
+        // only reachable through the first chunk and may have been
+        // reclaimed. Drop the batch.
+        return NULL;
+    }
+    AllocCache* cache = data->cache;
+    void** top = cache->top[data->index];
+    void** limit = cache->base[data->index] + stackCapacity(data->index);
+    void* chunk = data->list;
+    while (chunk && top < limit) {
+        void* next = GC_NEXT(chunk);
+        *((Class**) chunk) = &freeChunkClass;
+        *top++ = chunk;
+        chunk = next;
+    }
+    // If the batch was bigger than what fits in the stack the rest of the
+    // chunks are unreachable and will be reclaimed by the next GC.
+    data->top = top;
+    return NULL;
+}
+
+void** gcRefillAllocCache(AllocCache* cache, jint index) {
+    // A batch is dropped if a collection completes before we get to move
+    // it into the cache. This typically happens when
+    // GC_generic_malloc_many() itself triggers a collection. Try again once
+    // in that case before falling back to the slow path.
+    for (jint attempt = 0; attempt < 2; attempt++) {
+        RefillData data = {0};
+        data.cache = cache;
+        data.index = index;
+        data.gcNo = GC_get_gc_no();
+        GC_generic_malloc_many((index + 1) * ALLOC_CACHE_GRANULE_BYTES - cache->extraBytes, GC_gcj_kind, &data.list);
+        if (!data.list) {
+            return NULL;
+        }
+        GC_call_with_alloc_lock(refillLocked, &data);
+        if (data.top && data.top != cache->base[index]) {
+            cache->top[index] = data.top;
+            return data.top;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * CallPlans describe how to marshal the arguments of a Method into a
+ * CallInfo for _call0(). A plan is built the first time a method is called
+ * from C and cached in the Method so that later calls don't have to parse
+ * the method descriptor again.
+ *
+ * The compiler also emits invoker stubs which call a function with a
+ * particular signature shape directly using arguments in a jvalue array.
+ * The shape of a method is its descriptor with the receiver of instance
+ * methods added as the first parameter and all reference types replaced by
+ * L, e.g. (LIL)V for void foo(int, String[]). Static and instance methods
+ * with the same native signature share a shape.
+ */
+#include <robovm.h>
+#include <string.h>
+#include "private.h"
+
+// Methods have at most 255 parameters
+#define MAX_SHAPE_LENGTH (255 + 5)
+
+static void* findInvoker(Env* env, Method* method, const char* types) {
+    if (!env->vm->options->findInvoker) {
+        return NULL;
+    }
+    char shape[MAX_SHAPE_LENGTH];
+    char* s = shape;
+    *s++ = '(';
+    if (!(method->access & ACC_STATIC)) {
+        *s++ = 'L';
+    }
+    while (*types) {
+        *s++ = *types++;
+    }
+    *s++ = ')';
+    const char* returnType = rvmGetReturnType(method->desc);
+    *s++ = returnType[0] == '[' ? 'L' : returnType[0];
+    *s = '\0';
+    return env->vm->options->findInvoker(env, shape);
+}
+
+static CallPlan* buildCallPlan(Env* env, Method* method) {
+    jint paramsCount = rvmGetParameterCount(method);
+    CallPlan* plan = rvmAllocateMemoryAtomicUncollectable(env, sizeof(CallPlan) + paramsCount + 1);
+    if (!plan) return NULL;
+    memset(plan, 0, sizeof(CallPlan));
+
+    plan->ptrArgsCount = 1; // First arg is always the Env*
+    if (!(method->access & ACC_STATIC)) {
+        // Non-static methods takes the receiver object (this) as arg 2
+        plan->ptrArgsCount++;
+    }
+
+    const char* desc = method->desc;
+    const char* c;
+    jint i = 0;
+    while ((c = rvmGetNextParameterType(&desc))) {
+        switch (c[0]) {
+        case 'Z':
+        case 'B':
+        case 'S':
+        case 'C':
+        case 'I':
+            plan->intArgsCount++;
+            break;
+        case 'J':
+            plan->longArgsCount++;
+            break;
+        case 'F':
+            plan->floatArgsCount++;
+            break;
+        case 'D':
+            plan->doubleArgsCount++;
+            break;
+        case 'L':
+        case '[':
+            plan->ptrArgsCount++;
+            break;
+        }
+        plan->types[i++] = c[0] == '[' ? 'L' : c[0];
+    }
+    plan->types[i] = '\0';
+    plan->paramsCount = paramsCount;
+    const char* returnType = rvmGetReturnType(method->desc);
+    plan->returnType = returnType[0] == '[' ? 'L' : returnType[0];
+    plan->invoker = findInvoker(env, method, plan->types);
+    return plan;
+}
+
+CallPlan* getCallPlan(Env* env, Method* method) {
+    CallPlan* plan = rvmAtomicLoadAcquirePtr(&method->callPlan);
+    if (plan) {
+        return plan;
+    }
+    plan = buildCallPlan(env, method);
+    if (!plan) return NULL;
+    if (!rvmAtomicCompareAndSwapPtr(&method->callPlan, NULL, plan)) {
+        // Another thread got there first
+        rvmFreeMemoryUncollectable(env, plan);
+        plan = rvmAtomicLoadAcquirePtr(&method->callPlan);
+    }
+    return plan;
+}
+
+void addCallPlanArgs(CallInfo* callInfo, CallPlan* plan, jvalue* args) {
+    const char* types = plan->types;
+    for (jint i = 0; types[i]; i++) {
+        switch (types[i]) {
+        case 'Z':
+            call0AddInt(callInfo, (jint) args[i].z);
+            break;
+        case 'B':
+            call0AddInt(callInfo, (jint) args[i].b);
+            break;
+        case 'S':
+            call0AddInt(callInfo, (jint) args[i].s);
+            break;
+        case 'C':
+            call0AddInt(callInfo, (jint) args[i].c);
+            break;
+        case 'I':
+            call0AddInt(callInfo, args[i].i);
+            break;
+        case 'J':
+            call0AddLong(callInfo, args[i].j);
+            break;
+        case 'F':
+            call0AddFloat(callInfo, args[i].f);
+            break;
+        case 'D':
+            call0AddDouble(callInfo, args[i].d);
+            break;
+        case 'L':
+            call0AddPtr(callInfo, args[i].l);
+            break;
+        }
+    }
+}
+
+void addCallPlanArgsV(CallInfo* callInfo, CallPlan* plan, va_list args) {
+    // Values smaller than int are promoted to int and float to double when
+    // passed through ... so they have to be narrowed again here.
+    const char* types = plan->types;
+    for (jint i = 0; types[i]; i++) {
+        switch (types[i]) {
+        case 'Z':
+            call0AddInt(callInfo, (jint) (jboolean) va_arg(args, jint));
+            break;
+        case 'B':
+            call0AddInt(callInfo, (jint) (jbyte) va_arg(args, jint));
+            break;
+        case 'S':
+            call0AddInt(callInfo, (jint) (jshort) va_arg(args, jint));
+            break;
+        case 'C':
+            call0AddInt(callInfo, (jint) (jchar) va_arg(args, jint));
+            break;
+        case 'I':
+            call0AddInt(callInfo, va_arg(args, jint));
+            break;
+        case 'J':
+            call0AddLong(callInfo, va_arg(args, jlong));
+            break;
+        case 'F':
+            call0AddFloat(callInfo, (jfloat) va_arg(args, jdouble));
+            break;
+        case 'D':
+            call0AddDouble(callInfo, va_arg(args, jdouble));
+            break;
+        case 'L':
+            call0AddPtr(callInfo, va_arg(args, jobject));
+            break;
+        }
+    }
+}
@@ -18,7 +18,6 @@
 #include <string.h>
 #include "utlist.h"
 #include "private.h"
-#include "uthash.h"
 
 #define LOG_TAG "core.class"
 
@@ -117,44 +116,144 @@ static Method* java_lang_Double_valueOf = NULL;
 
 static RvmMutex classLock;
 
+/*
+ * Loaded classes are kept in a hash table which can be read without holding
+ * the classLock. Writers hold the classLock. Entries are never removed and
+ * never modified once published. When the table grows a new table with new
+ * entries is built and published. Readers still traversing the old table
+ * will find what they are looking for there or fall back to the slow path in
+ * findClass() which takes the lock. Old tables and entries are GCed once no
+ * reader refers to them.
+ */
+#define LOADED_CLASSES_INITIAL_SIZE 4096 // Must be a power of 2
 typedef struct LoadedClassEntry {
+    struct LoadedClassEntry* next;
     const char* key;      // The class name
+    uint32_t hash;
     Class* clazz;
-    UT_hash_handle hh;
 } LoadedClassEntry;
-static LoadedClassEntry* loadedClasses = NULL;
+typedef struct LoadedClassTable {
+    uint32_t mask;
+    jint count;
+    LoadedClassEntry* buckets[0];
+} LoadedClassTable;
+static LoadedClassTable* loadedClasses = NULL;
 
 // Class id counter used for dynamically created classes. We assume
 // that linked in classes never have class ids above about 250 million.
 static uint32_t classIdCounter = 0x10000000;
 
-static ITable emptyITable = {NULL, {0}};
-static ITables emptyITables = {0, &emptyITable};
+static ITables emptyITables = {0};
 
 static Class* findClassByDescriptor(Env* env, const char* desc, Object* classLoader, Class* (*loaderFunc)(Env*, const char*, Object*));
 static Class* findClass(Env* env, const char* className, Object* classLoader, Class* (*loaderFunc)(Env*, const char*, Object*));
 static Class* findBootClass(Env* env, const char* className);
+static jboolean registerClass(Env* env, Class* clazz, jint state, void (*setup)(Env*, Class*, void*), void* data);
 
 inline uint32_t nextClassId(void) {
     return __sync_fetch_and_add(&classIdCounter, 1);
 }
 
+uint32_t interfaceTableSize(uint32_t interfaceCount) {
+    // Must use the same sizes as Linker.buildInterfaceTable()
+    uint32_t size = 1;
+    while (size < interfaceCount * 2) {
+        size <<= 1;
+    }
+    return size;
+}
+
+void initInterfaceTable(TypeInfo* typeInfo) {
+    uint32_t size = interfaceTableSize(typeInfo->interfaceCount);
+    uint32_t mask = size - 1;
+    uint32_t* ids = &typeInfo->types[typeInfo->classCount];
+    uint32_t* table = rvmGetInterfaceTable(typeInfo);
+    memset(table, 0xff, sizeof(uint32_t) * size);
+    typeInfo->interfaceTableMask = mask;
+    for (uint32_t i = 0; i < typeInfo->interfaceCount; i++) {
+        uint32_t j = ids[i] & mask;
+        while (table[j] != TYPE_INFO_EMPTY_SLOT && table[j] != ids[i]) {
+            j = (j + 1) & mask;
+        }
+        table[j] = ids[i];
+    }
+}
+
+static inline uint32_t hashClassName(const char* className) {
+    // FNV-1a
+    uint32_t h = 2166136261U;
+    while (*className) {
+        h = (h ^ (uint8_t) *className++) * 16777619;
+    }
+    return h;
+}
+
+static LoadedClassTable* newLoadedClassTable(Env* env, uint32_t size) {
+    LoadedClassTable* table = rvmAllocateMemory(env, sizeof(LoadedClassTable) + size * sizeof(LoadedClassEntry*));
+    if (!table) return NULL;
+    table->mask = size - 1;
+    return table;
+}
+
+// Lock-free. May return NULL for a loaded class if the table is being grown
+// concurrently. Callers must check again with the classLock held before
+// loading the class.
 static Class* getLoadedClass(Env* env, const char* className) {
-    LoadedClassEntry* entry;
-    HASH_FIND_STR(loadedClasses, className, entry);
-    return entry ? entry->clazz : NULL;
+    LoadedClassTable* table = rvmAtomicLoadAcquirePtr((void**) &loadedClasses);
+    uint32_t hash = hashClassName(className);
+    LoadedClassEntry* entry = rvmAtomicLoadAcquirePtr((void**) &table->buckets[hash & table->mask]);
+    for (; entry != NULL; entry = entry->next) {
+        if (entry->hash == hash && !strcmp(entry->key, className)) {
+            return entry->clazz;
+        }
+    }
+    return NULL;
+}
+
+// Must be called with the classLock held.
+static jboolean growLoadedClassTable(Env* env) {
+    LoadedClassTable* old = loadedClasses;
+    LoadedClassTable* table = newLoadedClassTable(env, (old->mask + 1) << 1);
+    if (!table) return FALSE;
+    for (uint32_t i = 0; i <= old->mask; i++) {
+        for (LoadedClassEntry* e = old->buckets[i]; e != NULL; e = e->next) {
+            LoadedClassEntry* entry = rvmAllocateMemory(env, sizeof(LoadedClassEntry));
+            if (!entry) return FALSE;
+            *entry = *e;
+            entry->next = table->buckets[entry->hash & table->mask];
+            table->buckets[entry->hash & table->mask] = entry;
+        }
+    }
+    table->count = old->count;
+    rvmAtomicStorePtr((void**) &loadedClasses, table);
+    return TRUE;
 }
 
-static jboolean addLoadedClass(Env* env, Class* clazz) {
-    // LoadedClassEntrys are allocated atomically. Classes are always GC roots 
-    // which means that the class and it's name will be reachable regardless of 
-    // whether this is allocated atomically or not.
-    LoadedClassEntry* entry = rvmAllocateMemoryAtomicUncollectable(env, sizeof(LoadedClassEntry));
-    if (!entry) return FALSE;
+static LoadedClassEntry* newLoadedClassEntry(Env* env, Class* clazz) {
+    LoadedClassEntry* entry = rvmAllocateMemory(env, sizeof(LoadedClassEntry));
+    if (!entry) return NULL;
     entry->key = clazz->name;
+    entry->hash = hashClassName(clazz->name);
     entry->clazz = clazz;
-    HASH_ADD_KEYPTR(hh, loadedClasses, entry->key, strlen(entry->key), entry);
-    return TRUE;
+    return entry;
+}
+
+// Must be called with the classLock held. Never fails so that a class can't
+// be left half registered once it has been published.
+static void addLoadedClass(Env* env, LoadedClassEntry* entry) {
+    if (loadedClasses->count >= (jint) (loadedClasses->mask + 1) - ((loadedClasses->mask + 1) >> 2)) {
+        // Keep the load factor below 0.75. If growing fails we just get
+        // longer chains.
+        if (!growLoadedClassTable(env)) {
+            rvmExceptionClear(env);
+        }
+    }
+    LoadedClassEntry** bucket = &loadedClasses->buckets[entry->hash & loadedClasses->mask];
+    entry->next = *bucket;
+    // Publishes the entry. rvmAtomicStorePtr() is a full barrier so the
+    // entry and the Class are fully visible to readers from this point on.
+    rvmAtomicStorePtr((void**) bucket, entry);
+    loadedClasses->count++;
 }
 
 static inline void obtainClassLock() {
@@ -167,13 +266,14 @@ static inline void releaseClassLock() {
 
 static Class* createPrimitiveClass(Env* env, const char* desc) {
     uint32_t classId = nextClassId();
-    TypeInfo* typeInfo = rvmAllocateMemoryAtomic(env, sizeof(TypeInfo) + sizeof(uint32_t));
+    TypeInfo* typeInfo = rvmAllocateMemoryAtomic(env, sizeof(TypeInfo) + sizeof(uint32_t) * (1 + interfaceTableSize(0)));
     if (!typeInfo) return NULL;
     typeInfo->id = classId;
     typeInfo->offset = sizeof(TypeInfo);
-    typeInfo->cache = 0xffffffff;
     typeInfo->classCount = 1;
+    typeInfo->interfaceCount = 0;
     typeInfo->types[0] = classId;
+    initInterfaceTable(typeInfo);
 
     Class* clazz = rvmAllocateClass(env, desc, NULL, NULL,
         CLASS_TYPE_PRIMITIVE | ACC_PUBLIC | ACC_FINAL | ACC_ABSTRACT, typeInfo, NULL, NULL,
@@ -194,17 +294,17 @@ static Class* createArrayClass(Env* env, Class* componentType) {
     // annary classes.
     TypeInfo* typeInfo = NULL;
     uint32_t classId = nextClassId();
-    typeInfo = rvmAllocateMemoryAtomic(env, sizeof(TypeInfo) + sizeof(uint32_t) * 4);
+    typeInfo = rvmAllocateMemoryAtomic(env, sizeof(TypeInfo) + sizeof(uint32_t) * (4 + interfaceTableSize(2)));
     if (!typeInfo) return NULL;
     typeInfo->id = classId;
     typeInfo->offset = sizeof(TypeInfo) + sizeof(uint32_t);
-    typeInfo->cache = 0xffffffff;
     typeInfo->classCount = 2;
     typeInfo->interfaceCount = 2;
     typeInfo->types[0] = java_lang_Object->typeInfo->id;
     typeInfo->types[1] = classId;
     typeInfo->types[2] = java_lang_Cloneable->typeInfo->id;
     typeInfo->types[3] = java_io_Serializable->typeInfo->id;
+    initInterfaceTable(typeInfo);
 
     jint length = strlen(componentType->name);
     char* desc = NULL;
@@ -240,16 +340,24 @@ static Class* createArrayClass(Env* env, Class* componentType) {
     clazz->_methods = NULL;
     if (!rvmAddInterface(env, clazz, java_lang_Cloneable)) return NULL;
     if (!rvmAddInterface(env, clazz, java_io_Serializable)) return NULL;
-    if (!rvmRegisterClass(env, clazz)) return NULL;
-
-    clazz->flags = (clazz->flags & (~CLASS_STATE_MASK)) | CLASS_STATE_INITIALIZED;
+    // Array classes need no initialization. Register them as initialized
+    // since they become visible to other threads as soon as they are
+    // registered.
+    if (!registerClass(env, clazz, CLASS_STATE_INITIALIZED, NULL, NULL)) return NULL;
 
     return clazz;
 }
 
 static Class* findClass(Env* env, const char* className, Object* classLoader, Class* (*loaderFunc)(Env*, const char*, Object*)) {
-    obtainClassLock();
     Class* clazz = getLoadedClass(env, className);
+    if (clazz != NULL) {
+        return clazz;
+    }
+
+    obtainClassLock();
+    // Check again now that we hold the lock. Another thread may have loaded
+    // the class or the table may have been grown since we last checked.
+    clazz = getLoadedClass(env, className);
     if (clazz != NULL) {
         releaseClassLock();
         return clazz;
@@ -499,18 +607,12 @@ jboolean rvmIsAssignableFrom(Env* env, Class* s, Class* t) {
 
     TypeInfo* sti = s->typeInfo;
     TypeInfo* tti = t->typeInfo;
-    uint32_t id = tti->id;
-    if (sti->cache == id) {
-        return TRUE;
-    }
-
     if (CLASS_IS_INTERFACE(t)) {
-        if (rvmIsInterfaceTypeInfoAssignable(env, sti, tti)) goto found;
-        return FALSE;
+        return rvmIsInterfaceTypeInfoAssignable(env, sti, tti);
     }
 
     // t must be a class or array class
-    if (rvmIsClassTypeInfoAssignable(env, sti, tti)) goto found;
+    if (rvmIsClassTypeInfoAssignable(env, sti, tti)) return TRUE;
 
     // The TypeInfo of array classes doesn't give the complete information.
     if (CLASS_IS_ARRAY(t) && CLASS_IS_ARRAY(s) 
@@ -519,10 +621,6 @@ jboolean rvmIsAssignableFrom(Env* env, Class* s, Class* t) {
     }
 
     return FALSE;
-
-found:
-    sti->cache = id;
-    return TRUE;
 }
 
 jboolean rvmIsInstanceOf(Env* env, Object* obj, Class* clazz) {
@@ -543,6 +641,8 @@ jboolean rvmInitClasses(Env* env) {
         return FALSE;
     }
 
+    loadedClasses = newLoadedClassTable(env, LOADED_CLASSES_INITIAL_SIZE);
+    if (!loadedClasses) return FALSE;
     gcAddRoot(&loadedClasses);
 
     // Cache important classes in java.lang.
@@ -1101,7 +1201,7 @@ Method* rvmGetMethods(Env* env, Class* clazz) {
     return clazz->_methods;
 }
 
-jboolean rvmRegisterClass(Env* env, Class* clazz) {
+static jboolean registerClass(Env* env, Class* clazz, jint state, void (*setup)(Env*, Class*, void*), void* data) {
     assert(CLASS_IS_STATE_ALLOCATED(clazz));
 
     // We should now have enough of the class set up to build its GC descriptor
@@ -1111,22 +1211,34 @@ jboolean rvmRegisterClass(Env* env, Class* clazz) {
     // TODO: Verify the class hierarchy (class doesn't override final methods, changes public -> private, etc)
 
     obtainClassLock();
-    if (!addLoadedClass(env, clazz)) {
+    LoadedClassEntry* entry = newLoadedClassEntry(env, clazz);
+    if (!entry) {
         releaseClassLock();
         return FALSE;
     }
-
     if (!rvmAddGlobalRef(env, (Object*) clazz)) {
         releaseClassLock();
         return FALSE;
     }
 
-    clazz->flags = (clazz->flags & (~CLASS_STATE_MASK)) | CLASS_STATE_LOADED;
+    // Everything must be set up before the class is published in
+    // loadedClasses. Other threads don't take the classLock when looking up
+    // classes.
+    clazz->flags = (clazz->flags & (~CLASS_STATE_MASK)) | state;
+    if (setup) {
+        setup(env, clazz, data);
+    }
+
+    addLoadedClass(env, entry);
 
     releaseClassLock();
     return TRUE;
 }
 
+jboolean rvmRegisterClass(Env* env, Class* clazz, void (*setup)(Env*, Class*, void*), void* data) {
+    return registerClass(env, clazz, CLASS_STATE_LOADED, setup, data);
+}
+
 void rvmInitialize(Env* env, Class* clazz) {
     assert(env->currentThread != NULL);
 
@@ -1567,9 +1679,12 @@ Object* rvmCloneObject(Env* env, Object* obj) {
 }
 
 void rvmIterateLoadedClasses(Env* env, jboolean (*f)(Env*, Class*, void*), void* data) {
-    LoadedClassEntry* entry;
-    for (entry = loadedClasses; entry != NULL; entry = entry->hh.next) {
-        if (!f(env, entry->clazz, data)) return;
+    LoadedClassTable* table = rvmAtomicLoadAcquirePtr((void**) &loadedClasses);
+    for (uint32_t i = 0; i <= table->mask; i++) {
+        LoadedClassEntry* entry = rvmAtomicLoadAcquirePtr((void**) &table->buckets[i]);
+        for (; entry != NULL; entry = entry->next) {
+            if (!f(env, entry->clazz, data)) return;
+        }
     }
 }
 
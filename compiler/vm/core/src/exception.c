@@ -16,22 +16,160 @@
 #include <robovm.h>
 #include <stddef.h>
 #include <string.h>
+#include <time.h>
 #include "private.h"
 
 #define LOG_TAG "core.exception"
 #define THROW_FORMAT_BUF_SIZE 512
+// Number of slots in the hotThrowSites table. Must be a power of 2.
+#define HOT_THROW_SITES_SIZE 1024
+
+/*
+ * A site in compiled code which throws a runtime exception (e.g. a
+ * NullPointerException) through one of the _bcThrow*() functions. Once a
+ * site has thrown more than Options.hotExceptionThreshold exceptions of the
+ * same class within a second it is considered hot and from then on throws
+ * the same preallocated exception every time. The preallocated exception
+ * has no message and the call stack captured when the site became hot.
+ */
+typedef struct {
+    void* pc;          // The return address of the _bcThrow*() call
+    Class* clazz;
+    jlong second;      // The second count applies to
+    jint count;        // Number of throws during second
+    Object* exception; // NULL until the site is hot
+    jlong reuseCount;  // Number of times exception has been rethrown
+} HotThrowSite;
 
 static InstanceField* stackStateField = NULL;
 static Method* printStackTraceMethod = NULL;
+// Direct mapped table of HotThrowSites. Allocated uncollectable so that the
+// GC allocated HotThrowSites and their exceptions stay reachable.
+static HotThrowSite** hotThrowSites = NULL;
 
 jboolean rvmInitExceptions(Env* env) {
     stackStateField = rvmGetInstanceField(env, java_lang_Throwable, "stackState", "J");
     if (!stackStateField) return FALSE;
     printStackTraceMethod = rvmGetInstanceMethod(env, java_lang_Thread, "printStackTrace", "(Ljava/lang/Throwable;)V");
     if (!printStackTraceMethod) return FALSE;
+    if (env->vm->options->hotExceptionThreshold > 0) {
+        hotThrowSites = gcAllocateUncollectable(sizeof(HotThrowSite*) * HOT_THROW_SITES_SIZE);
+        if (!hotThrowSites) return FALSE;
+    }
+    return TRUE;
+}
+
+static inline HotThrowSite** getHotThrowSiteSlot(void* pc) {
+    uintptr_t h = (uintptr_t) pc;
+    h ^= h >> 12;
+    return &hotThrowSites[(h * 0x9e3779b1) >> 8 & (HOT_THROW_SITES_SIZE - 1)];
+}
+
+static void logHotThrowSite(Env* env, HotThrowSite* site) {
+    if (!IS_INFO_ENABLED) {
+        return;
+    }
+    CallStackFrame frame = {site->pc, NULL, NULL, 0};
+    if (rvmResolveCallStackFrame(env, &frame)) {
+        INFOF("Throw site %s.%s%s (line %d) is hot. Reusing a preallocated %s from now on.",
+            frame.method->clazz->name, frame.method->name, frame.method->desc, frame.lineNumber, site->clazz->name);
+    } else {
+        INFOF("Throw site %p is hot. Reusing a preallocated %s from now on.", site->pc, site->clazz->name);
+    }
+    rvmExceptionClear(env);
+}
+
+jboolean rvmThrowHotException(Env* env, Class* clazz, void* pc) {
+    if (!hotThrowSites) {
+        return FALSE;
+    }
+
+    HotThrowSite** slot = getHotThrowSiteSlot(pc);
+    HotThrowSite* site = rvmAtomicLoadAcquirePtr((void**) slot);
+    if (!site || site->pc != pc || site->clazz != clazz) {
+        if (site && rvmAtomicLoadAcquirePtr((void**) &site->exception)) {
+            // Never evict hot sites.
+            return FALSE;
+        }
+        HotThrowSite* newSite = gcAllocate(sizeof(HotThrowSite));
+        if (newSite) {
+            newSite->pc = pc;
+            newSite->clazz = clazz;
+            newSite->second = time(NULL);
+            newSite->count = 1;
+            rvmAtomicCompareAndSwapPtr((void**) slot, site, newSite);
+        }
+        return FALSE;
+    }
+
+    Object* e = rvmAtomicLoadAcquirePtr((void**) &site->exception);
+    if (e) {
+        // The counters are only statistics. Lost updates are fine.
+        site->reuseCount++;
+        rvmThrow(env, e);
+        return TRUE;
+    }
+
+    jlong now = time(NULL);
+    if (site->second != now) {
+        site->second = now;
+        site->count = 0;
+    }
+    if (++site->count <= env->vm->options->hotExceptionThreshold) {
+        return FALSE;
+    }
+
+    // The site just became hot. Create the exception the usual way to get
+    // the call stack captured.
+    if (!rvmThrowNew(env, clazz, NULL)) {
+        // Some other exception (e.g. OutOfMemoryError) has been thrown.
+        return TRUE;
+    }
+    e = rvmExceptionClear(env);
+    if (rvmAtomicCompareAndSwapPtr((void**) &site->exception, NULL, e)) {
+        logHotThrowSite(env, site);
+    } else {
+        e = rvmAtomicLoadAcquirePtr((void**) &site->exception);
+    }
+    rvmThrow(env, e);
     return TRUE;
 }
 
+ObjectArray* rvmGetHotThrowSites(Env* env) {
+    if (!hotThrowSites) {
+        return rvmNewObjectArray(env, 0, java_lang_String, NULL, NULL);
+    }
+    // Sites may become hot while we're iterating. Collect the strings in a
+    // single pass and then copy them to an array of the exact size.
+    ObjectArray* strings = rvmNewObjectArray(env, HOT_THROW_SITES_SIZE, java_lang_String, NULL, NULL);
+    if (!strings) return NULL;
+    jint count = 0;
+    for (jint i = 0; i < HOT_THROW_SITES_SIZE; i++) {
+        HotThrowSite* site = rvmAtomicLoadAcquirePtr((void**) &hotThrowSites[i]);
+        if (!site || !rvmAtomicLoadAcquirePtr((void**) &site->exception)) {
+            continue;
+        }
+        char s[512];
+        CallStackFrame frame = {site->pc, NULL, NULL, 0};
+        if (rvmResolveCallStackFrame(env, &frame)) {
+            snprintf(s, sizeof(s), "%s at %s.%s%s (line %d) reused %lld times",
+                site->clazz->name, frame.method->clazz->name, frame.method->name, frame.method->desc,
+                frame.lineNumber, (long long) site->reuseCount);
+        } else {
+            if (rvmExceptionCheck(env)) return NULL;
+            snprintf(s, sizeof(s), "%s at %p reused %lld times",
+                site->clazz->name, site->pc, (long long) site->reuseCount);
+        }
+        strings->values[count] = rvmNewStringUTF(env, s, -1);
+        if (!strings->values[count]) return NULL;
+        count++;
+    }
+    ObjectArray* result = rvmNewObjectArray(env, count, java_lang_String, NULL, NULL);
+    if (!result) return NULL;
+    memcpy(result->values, strings->values, count * sizeof(Object*));
+    return result;
+}
+
 void rvmRaiseException(Env* env, Object* e) {
     if (env->throwable != e) {
         rvmThrow(env, e);
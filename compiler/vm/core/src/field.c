@@ -15,15 +15,13 @@
  */
 #include <robovm.h>
 #include <string.h>
+#include "private.h"
 
 static Field* getField(Env* env, Class* clazz, char* name, char* desc) {
     Field* field = rvmGetFields(env, clazz);
     if (rvmExceptionCheck(env)) return NULL;
-    for (; field != NULL; field = field->next) {
-        if (!strcmp(field->name, name) && !strcmp(field->desc, desc)) {
-            return field;
-        }
-    }
+    field = lookupField(env, clazz, field, name, desc);
+    if (field) return field;
 
     Interface* interfaze = rvmGetInterfaces(env, clazz);
     if (rvmExceptionCheck(env)) return NULL;
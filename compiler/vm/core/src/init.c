@@ -151,6 +151,17 @@ void rvmParseOption(char* arg, Options* options) {
         }
     } else if (startsWith(arg, "EnableGCHeapStats")) {
         options->enableGCHeapStats = TRUE;
+    } else if (startsWith(arg, "GCMode=")) {
+        const char* mode = &arg[7];
+        if (!strcmp(mode, "incremental")) {
+            options->incrementalGC = TRUE;
+        } else if (!strcmp(mode, "full")) {
+            options->incrementalGC = FALSE;
+        }
+    } else if (startsWith(arg, "HotExceptions=")) {
+        options->hotExceptionThreshold = atoi(&arg[14]);
+    } else if (startsWith(arg, "EnableBiasedLocking")) {
+        options->enableBiasedLocking = TRUE;
     } else if (startsWith(arg, "EnableHooks")) {
         options->enableHooks = TRUE;
     } else if (startsWith(arg, "WaitForResume")) {
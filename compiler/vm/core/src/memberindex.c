@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Lazily built hash indexes used to look up a Method or Field in a Class by
+ * name and descriptor without walking the Class' linked list of members.
+ *
+ * The layout of Class is shared with compiled code so the indexes can't be
+ * stored in the Class itself. Instead they live in a side table keyed on the
+ * Class pointer. The side table is an open addressing hash table which is
+ * doubled when more than half of its slots are in use. Indexes are added
+ * while holding indexTablesLock. Lookups never take a lock. A table which
+ * has been replaced by a bigger one is never freed since lookups may still
+ * be reading it. The replaced tables add up to less than the current one.
+ *
+ * Classes with few members don't get an index of their own. Walking a short
+ * list is as fast as hashing the name and descriptor.
+ */
+#include <robovm.h>
+#include <string.h>
+#include "private.h"
+
+#define MIN_INDEXED_MEMBERS 8
+#define INITIAL_INDEX_TABLE_SIZE 256 // Must be a power of 2
+
+// Method and Field start with the same members. The code in this file only
+// touches those and works on both.
+typedef struct Member {
+    struct Member* next;
+    Class* clazz;
+    const char* name;
+    const char* desc;
+} Member;
+
+typedef struct MemberSlot {
+    uint32_t hash;            // hashMember() of the member's name and descriptor
+    Member* member;
+} MemberSlot;
+
+typedef struct MemberIndex {
+    Class* clazz;
+    Member* first;            // The head of the member list when the index was built
+    jint mask;                // Number of slots - 1
+    MemberSlot slots[0];
+} MemberIndex;
+
+typedef struct IndexTable {
+    jint mask;                // Number of slots - 1
+    jint count;               // Number of slots in use
+    MemberIndex* slots[0];
+} IndexTable;
+
+static IndexTable* methodIndexes;
+static IndexTable* fieldIndexes;
+static pthread_mutex_t indexTablesLock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline uint32_t hashString(uint32_t h, const char* s) {
+    // FNV-1a
+    while (*s) {
+        h = (h ^ (uint8_t) *s++) * 16777619;
+    }
+    return h;
+}
+
+static inline uint32_t hashMember(const char* name, const char* desc) {
+    return hashString(hashString(2166136261U, name), desc);
+}
+
+static inline uint32_t hashClass(Class* clazz) {
+    uintptr_t p = (uintptr_t) clazz;
+    return (uint32_t) ((p >> 4) ^ (p >> 16));
+}
+
+static inline jboolean memberEquals(Member* m, const char* name, const char* desc) {
+    // Callers usually pass the name and descriptor strings stored in the
+    // class so compare the pointers before the strings.
+    return (m->name == name || !strcmp(m->name, name)) && (m->desc == desc || !strcmp(m->desc, desc));
+}
+
+static Member* scanMembers(Member* first, const char* name, const char* desc) {
+    for (Member* m = first; m != NULL; m = m->next) {
+        if (memberEquals(m, name, desc)) {
+            return m;
+        }
+    }
+    return NULL;
+}
+
+static MemberIndex* getIndex(IndexTable** tablePtr, Class* clazz) {
+    IndexTable* table = rvmAtomicLoadAcquirePtr((void**) tablePtr);
+    if (!table) {
+        return NULL;
+    }
+    for (uint32_t i = hashClass(clazz) & table->mask; ; i = (i + 1) & table->mask) {
+        MemberIndex* index = rvmAtomicLoadAcquirePtr((void**) &table->slots[i]);
+        if (!index || index->clazz == clazz) {
+            return index;
+        }
+    }
+}
+
+static MemberIndex* buildIndex(Env* env, Class* clazz, Member* first) {
+    jint count = 0;
+    for (Member* m = first; m != NULL; m = m->next) {
+        count++;
+    }
+
+    // Keep the load factor at or below 0.5.
+    jint size = 16;
+    while (size < count * 2) {
+        size <<= 1;
+    }
+
+    MemberIndex* index = rvmAllocateMemoryAtomicUncollectable(env, sizeof(MemberIndex) + size * sizeof(MemberSlot));
+    if (!index) {
+        rvmExceptionClear(env);
+        return NULL;
+    }
+    memset(index, 0, sizeof(MemberIndex) + size * sizeof(MemberSlot));
+    index->clazz = clazz;
+    index->first = first;
+    index->mask = size - 1;
+
+    for (Member* m = first; m != NULL; m = m->next) {
+        uint32_t hash = hashMember(m->name, m->desc);
+        uint32_t i = hash & index->mask;
+        while (index->slots[i].member) {
+            if (index->slots[i].hash == hash && memberEquals(index->slots[i].member, m->name, m->desc)) {
+                // Duplicate. The list order decides which one is returned.
+                break;
+            }
+            i = (i + 1) & index->mask;
+        }
+        if (!index->slots[i].member) {
+            index->slots[i].hash = hash;
+            index->slots[i].member = m;
+        }
+    }
+    return index;
+}
+
+/*
+ * Stores index in the first free slot of table. Must be called with
+ * indexTablesLock held.
+ */
+static void putIndex(IndexTable* table, MemberIndex* index) {
+    uint32_t i = hashClass(index->clazz) & table->mask;
+    while (table->slots[i]) {
+        i = (i + 1) & table->mask;
+    }
+    // Publish the fully built index to lock-free readers.
+    rvmAtomicStorePtr((void**) &table->slots[i], index);
+    table->count++;
+}
+
+/*
+ * Returns a table with room for one more index than table, which is
+ * either table itself or a new table twice its size with all of its
+ * indexes. Returns NULL if a new table couldn't be allocated. Must be
+ * called with indexTablesLock held.
+ */
+static IndexTable* ensureIndexTableCapacity(Env* env, IndexTable** tablePtr) {
+    IndexTable* table = *tablePtr;
+    if (table && (table->count + 1) * 2 <= table->mask + 1) {
+        return table;
+    }
+
+    jint size = table ? (table->mask + 1) * 2 : INITIAL_INDEX_TABLE_SIZE;
+    IndexTable* newTable = rvmAllocateMemoryAtomicUncollectable(env, sizeof(IndexTable) + size * sizeof(MemberIndex*));
+    if (!newTable) {
+        rvmExceptionClear(env);
+        return NULL;
+    }
+    memset(newTable, 0, sizeof(IndexTable) + size * sizeof(MemberIndex*));
+    newTable->mask = size - 1;
+    if (table) {
+        for (jint i = 0; i <= table->mask; i++) {
+            if (table->slots[i]) {
+                putIndex(newTable, table->slots[i]);
+            }
+        }
+    }
+    rvmAtomicStorePtr((void**) tablePtr, newTable);
+    return newTable;
+}
+
+/*
+ * Adds index to the table and returns it or the index another thread
+ * added for the same Class first. Frees index and returns NULL if the
+ * table couldn't be grown.
+ */
+static MemberIndex* addIndex(Env* env, IndexTable** tablePtr, MemberIndex* index) {
+    pthread_mutex_lock(&indexTablesLock);
+    MemberIndex* other = getIndex(tablePtr, index->clazz);
+    if (other) {
+        // Another thread got here first.
+        pthread_mutex_unlock(&indexTablesLock);
+        rvmFreeMemoryUncollectable(env, index);
+        return other;
+    }
+    IndexTable* table = ensureIndexTableCapacity(env, tablePtr);
+    if (table) {
+        putIndex(table, index);
+    }
+    pthread_mutex_unlock(&indexTablesLock);
+    if (!table) {
+        rvmFreeMemoryUncollectable(env, index);
+        return NULL;
+    }
+    return index;
+}
+
+static inline jboolean hasFewMembers(Member* first) {
+    Member* m = first;
+    for (jint i = 0; m != NULL && i < MIN_INDEXED_MEMBERS; i++) {
+        m = m->next;
+    }
+    return m == NULL;
+}
+
+static Member* findMember(Env* env, IndexTable** tablePtr, Class* clazz, Member* first, const char* name, const char* desc) {
+    if (CLASS_IS_STATE_ALLOCATED(clazz) || hasFewMembers(first)) {
+        // Members are still being added to classes in the allocated state
+        // and short lists aren't worth indexing.
+        return scanMembers(first, name, desc);
+    }
+
+    MemberIndex* index = getIndex(tablePtr, clazz);
+    if (!index) {
+        index = buildIndex(env, clazz, first);
+        if (index) {
+            index = addIndex(env, tablePtr, index);
+        }
+        if (!index) {
+            return scanMembers(first, name, desc);
+        }
+    }
+
+    if (index->first != first) {
+        // Members have been added since the index was built.
+        return scanMembers(first, name, desc);
+    }
+
+    uint32_t hash = hashMember(name, desc);
+    uint32_t i = hash & index->mask;
+    Member* m;
+    while ((m = index->slots[i].member) != NULL) {
+        if (index->slots[i].hash == hash && memberEquals(m, name, desc)) {
+            return m;
+        }
+        i = (i + 1) & index->mask;
+    }
+    return NULL;
+}
+
+Method* lookupMethod(Env* env, Class* clazz, Method* methods, const char* name, const char* desc) {
+    return (Method*) findMember(env, &methodIndexes, clazz, (Member*) methods, name, desc);
+}
+
+Field* lookupField(Env* env, Class* clazz, Field* fields, const char* name, const char* desc) {
+    return (Field*) findMember(env, &fieldIndexes, clazz, (Member*) fields, name, desc);
+}
@@ -16,6 +16,10 @@
 #include <robovm.h>
 #include <string.h>
 #include <stdint.h>
+#include <time.h>
+#if defined(DARWIN)
+#   include <mach/mach_time.h>
+#endif
 #include <gc/gc_mark.h>
 #include <gc/gc_gcj.h>
 #include "private.h"
@@ -26,7 +30,6 @@
 
 #define MIN_HEAP_SIZE (4*1024*1024) // 4MB
 #define DEFAULT_INITIAL_HEAP_SIZE (16*1024*1024) // 16MB
-#define GLOBAL_REFS_INITIAL_SIZE 2048
 
 static Class* java_nio_DirectByteBuffer = NULL;
 static Method* java_nio_DirectByteBuffer_init = NULL;
@@ -89,16 +92,57 @@ typedef struct HeapStat {
     jlong numberOfLiveBytes;
     UT_hash_handle hh;
 } HeapStat;
-static ReferentEntry* referents = NULL;
 static uint32_t referentEntryGCKind;
 
-static RefTable globalRefs = {0};
-
-static RvmMutex referentsLock;
-static RvmMutex globalRefsLock;
+// The referents hash is split into shards by object address so that threads
+// registering references to different objects don't contend for one lock.
+#define REFERENTS_SHARDS_BITS 6
+#define REFERENTS_SHARDS (1 << REFERENTS_SHARDS_BITS)
+typedef struct ReferentsShard {
+    RvmMutex lock;
+    ReferentEntry* referents;
+} ReferentsShard;
+static ReferentsShard referentsShards[REFERENTS_SHARDS];
+
+// References cleared by finalizeObject() are collected in this circular list
+// and passed to ReferenceQueue.add() in one call once all the finalizers
+// the GC has queued have run. See invokeFinalizers().
+static Object* pendingClearedReferences = NULL;
+static RvmMutex pendingClearedReferencesLock;
 
 // The GC kind used when allocating Object arrays
 static uint32_t objectArrayGCKind;
+// The GC kind used when allocating primitive arrays in incremental mode. The
+// GC never write protects pages of this kind since they contain no pointers.
+static uint32_t primitiveArrayGCKind;
+
+// Set if the GC runs in incremental (generational) mode. See initGC().
+static jboolean incrementalGC = FALSE;
+
+// Stop-the-world pause times. Only accessed with the GC allocation lock held.
+static GCPauseStats pauseStats;
+static jlong pauseStartTime = 0;
+
+// Ring buffer of collection events. Events are only added by the GC with the
+// allocation lock held so there's a single writer which only ever advances
+// gcEventsHead. Readers advance gcEventsTail using CAS. The buffer never
+// blocks the GC. When it's full new events are dropped.
+#define GC_EVENTS_SIZE 256 // Must be a power of 2
+static GCEvent gcEvents[GC_EVENTS_SIZE];
+static jlong gcEventsHead = 0;
+static jlong gcEventsTail = 0;
+static jlong droppedGCEvents = 0;
+// State of the collection in progress. Only accessed with the allocation lock held.
+static jlong collectionStartTime = 0;
+static jlong collectionPauseTime = 0;
+static jlong lastFinalizersQueued = 0;
+// Incremented every time a FinalizerReference is enqueued. This happens when
+// the GC invokes finalizers after a collection has ended so the count in an
+// END event covers the objects found unreachable by the previous collection.
+static jlong finalizersQueued = 0;
+#if defined(DARWIN)
+static mach_timebase_info_data_t timebase;
+#endif
 
 // The GC descriptor used for object instances which have no references to other objects.
 #define REF_FREE_GC_DESCRIPTOR ((void*) ((0 << GC_DS_TAGS) | GC_DS_LENGTH))
@@ -213,7 +257,7 @@ static void dumpRefs(void* parent, void** start, void** end) {
 }
 
 static void heapDumpCallback(void* ptr, unsigned char kind, size_t sz, void* data) {
-    if ((kind == GC_gcj_kind || kind == objectArrayGCKind) && ptr) {
+    if ((kind == GC_gcj_kind || kind == objectArrayGCKind || (incrementalGC && kind == primitiveArrayGCKind)) && ptr) {
         Object* obj = (Object*) ptr;
         if (obj->clazz) {
             if (obj->clazz == java_lang_Class) {
@@ -288,7 +332,7 @@ static int heapStatsCallback(void* ptr, unsigned char kind, size_t sz, int live,
     HeapStat** statsHashPtr = data->statsHashPtr;
 
     Class* key = NULL;
-    if (kind == GC_gcj_kind || kind == objectArrayGCKind) {
+    if (kind == GC_gcj_kind || kind == objectArrayGCKind || (incrementalGC && kind == primitiveArrayGCKind)) {
         Object* obj = (Object*) ptr;
         if (obj && obj->clazz) {
             LoadedClass* loadedClass;
@@ -455,11 +499,120 @@ void gcHeapDump(Env* env) {
     fprintf(stderr, "}\n");
 }
 
+static jlong pauseClockNanos(void) {
+#if defined(DARWIN)
+    return (jlong) (mach_absolute_time() * timebase.numer / timebase.denom);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+static void recordPause(jlong nanos) {
+    // Bucket 0 counts pauses shorter than 128 us. Bucket i > 0 counts pauses
+    // in the range [2^(i+6), 2^(i+7)) us. The last bucket is open ended.
+    jlong micros = nanos / 1000;
+    jint bucket = 0;
+    while (micros >= 128 && bucket < GC_PAUSE_HISTOGRAM_BUCKETS - 1) {
+        micros >>= 1;
+        bucket++;
+    }
+    pauseStats.histogram[bucket]++;
+    pauseStats.count++;
+    pauseStats.totalTime += nanos;
+    if (nanos > pauseStats.maxTime) {
+        pauseStats.maxTime = nanos;
+    }
+    collectionPauseTime += nanos;
+}
+
+static void pushGCEvent(jlong type, jlong now) {
+    jlong head = gcEventsHead;
+    if (head - rvmAtomicLoadLong(&gcEventsTail) >= GC_EVENTS_SIZE) {
+        rvmAtomicStoreLong(&droppedGCEvents, droppedGCEvents + 1);
+        return;
+    }
+
+    struct GC_prof_stats_s stats;
+    GC_get_prof_stats_unsafe(&stats, sizeof(stats));
+
+    GCEvent* event = &gcEvents[head & (GC_EVENTS_SIZE - 1)];
+    memset(event, 0, sizeof(GCEvent));
+    event->type = type;
+    event->gcNo = stats.gc_no;
+    event->timestamp = now;
+    event->heapSize = stats.heapsize_full;
+    event->freeBytes = stats.free_bytes_full;
+    event->bytesAllocated = stats.bytes_allocd_since_gc;
+    event->bytesReclaimed = stats.bytes_reclaimed_since_gc;
+    if (type == GC_EVENT_TYPE_END) {
+        event->duration = now - collectionStartTime;
+        event->pauseTime = collectionPauseTime;
+        jlong queued = rvmAtomicLoadLong(&finalizersQueued);
+        event->finalizersQueued = queued - lastFinalizersQueued;
+        lastFinalizersQueued = queued;
+    }
+
+    // Make sure the event has been written before it's published.
+    rvmAtomicStoreLong(&gcEventsHead, head + 1);
+}
+
+// Called by the GC with the allocation lock held.
+static void onCollectionEvent(GC_EventType event) {
+    switch (event) {
+    // In incremental mode the GC doesn't report START and END for
+    // collections which are done in increments. Use the first mark phase
+    // event as start and the end of the reclaim phase as end.
+    case GC_EVENT_START:
+    case GC_EVENT_MARK_START:
+        if (!collectionStartTime) {
+            collectionStartTime = pauseClockNanos();
+            collectionPauseTime = 0;
+            pushGCEvent(GC_EVENT_TYPE_START, collectionStartTime);
+        }
+        break;
+    case GC_EVENT_RECLAIM_END:
+    case GC_EVENT_END:
+        if (collectionStartTime) {
+            deflateMonitors();
+            pushGCEvent(GC_EVENT_TYPE_END, pauseClockNanos());
+            collectionStartTime = 0;
+        }
+        break;
+    case GC_EVENT_PRE_STOP_WORLD:
+        pauseStartTime = pauseClockNanos();
+        break;
+    case GC_EVENT_POST_START_WORLD:
+        if (pauseStartTime) {
+            recordPause(pauseClockNanos() - pauseStartTime);
+            pauseStartTime = 0;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void invokeFinalizers(void);
+
 jboolean initGC(Options* options) {
     GC_set_no_dls(1);
     GC_set_java_finalization(1);
     GC_INIT();
     GC_init_gcj_malloc(GC_GCJ_RESERVED_MARK_PROC_INDEX, NULL);
+    if (options->incrementalGC) {
+        // Enables generational collection in addition to incremental
+        // marking. Dirty pages are tracked using soft-dirty bits or page
+        // protection depending on platform. If the platform supports neither
+        // GC_enable_incremental() does nothing and we keep running in
+        // stop-the-world mode.
+        GC_enable_incremental();
+        incrementalGC = GC_is_incremental_mode() ? TRUE : FALSE;
+        if (!incrementalGC) {
+            WARN("Incremental GC not supported on this platform. Falling back to full collections.");
+        }
+    }
     if (options->maxHeapSize > 0) {
         GC_set_max_heap_size(options->maxHeapSize);
     }
@@ -476,6 +629,10 @@ jboolean initGC(Options* options) {
     }
 
     objectArrayGCKind = GC_new_kind(GC_new_free_list(), GC_DS_LENGTH, 1, 1);
+    // A zero descriptor makes the GC treat the memory as pointer free. The
+    // lock word of a primitive array may point to a fat Monitor but those are
+    // allocated uncollectable.
+    primitiveArrayGCKind = GC_new_kind(GC_new_free_list(), GC_DS_LENGTH, 0, 1);
     referentEntryGCKind = gcNewDirectBitmapKind(REFERENT_ENTRY_GC_BITMAP);
     markObjectGcDescriptor = (void*) (size_t) GC_MAKE_PROC(GC_new_proc(markObject), 0);
 
@@ -483,10 +640,15 @@ jboolean initGC(Options* options) {
     memset(&fakeClass, 0, sizeof(Class));
     fakeClass.gcDescriptor = (void*) ((sizeof(Class) << GC_DS_TAG_BITS) | GC_DS_LENGTH);
 
-    if (rvmInitMutex(&referentsLock) != 0) {
+    for (jint i = 0; i < REFERENTS_SHARDS; i++) {
+        if (rvmInitMutex(&referentsShards[i].lock) != 0) {
+            return FALSE;
+        }
+    }
+    if (rvmInitMutex(&pendingClearedReferencesLock) != 0) {
         return FALSE;
     }
-    if (rvmInitMutex(&globalRefsLock) != 0) {
+    if (!initGlobalRefs()) {
         return FALSE;
     }
 
@@ -497,6 +659,15 @@ jboolean initGC(Options* options) {
         GC_set_start_callback(logGcHeapStats);
     }
 
+#if defined(DARWIN)
+    mach_timebase_info(&timebase);
+#endif
+    GC_set_on_collection_event(onCollectionEvent);
+    // Run finalizers from invokeFinalizers() instead of one at a time
+    // from GC_malloc().
+    GC_set_finalize_on_demand(1);
+    GC_set_finalizer_notifier(invokeFinalizers);
+
     return TRUE;
 }
 
@@ -522,6 +693,20 @@ void gcAddRoot(void* ptr) {
     GC_add_roots(ptr, ptr + sizeof(void*));
 }
 
+jboolean gcIsHeapPointer(void* ptr) {
+    return GC_is_heap_ptr(ptr) ? TRUE : FALSE;
+}
+
+/*
+ * Returns FALSE if ptr points into a heap object which the last collection
+ * found unreachable. Only valid at the end of a collection when called with
+ * the allocation lock held, i.e. from onCollectionEvent().
+ */
+jboolean gcIsLive(void* ptr) {
+    void* base = GC_base(ptr);
+    return !base || GC_is_marked(base) ? TRUE : FALSE;
+}
+
 uint32_t gcNewDirectBitmapKind(size_t bitmap) {
     assert((bitmap & GC_DS_TAGS) == 0);
     return GC_new_kind(GC_new_free_list(), bitmap | GC_DS_BITMAP, 0, 1);
@@ -707,6 +892,7 @@ static void enqueueFinalizerReferences(Env* env, Object** list, Object** cleared
             // Clear the referent
             clearReference(env, ref);
             enqueueReference(env, ref, cleared);
+            __sync_fetch_and_add(&finalizersQueued, 1);
         }
     }
     assert(*list == NULL);
@@ -714,20 +900,54 @@ static void enqueueFinalizerReferences(Env* env, Object** list, Object** cleared
 
 static void _finalizeObject(GC_PTR addr, GC_PTR client_data);
 
+static inline ReferentsShard* getReferentsShard(Object* o) {
+    uint32_t h = (uint32_t) ((uintptr_t) o >> 3) * 2654435761u;
+    return &referentsShards[h >> (32 - REFERENTS_SHARDS_BITS)];
+}
+
+/*
+ * Appends a circular list of cleared references to pendingClearedReferences.
+ */
+static void addPendingClearedReferences(Env* env, Object* list) {
+    rvmLockMutex(&pendingClearedReferencesLock);
+    if (pendingClearedReferences == NULL) {
+        pendingClearedReferences = list;
+    } else {
+        // Splice the two circular lists by swapping their pendingNext links
+        Object* next = rvmGetObjectInstanceFieldValue(env, pendingClearedReferences, java_lang_ref_Reference_pendingNext);
+        Object* listNext = rvmGetObjectInstanceFieldValue(env, list, java_lang_ref_Reference_pendingNext);
+        rvmSetObjectInstanceFieldValue(env, pendingClearedReferences, java_lang_ref_Reference_pendingNext, listNext);
+        rvmSetObjectInstanceFieldValue(env, list, java_lang_ref_Reference_pendingNext, next);
+    }
+    rvmUnlockMutex(&pendingClearedReferencesLock);
+}
+
+static void enqueuePendingClearedReferences(Env* env) {
+    rvmLockMutex(&pendingClearedReferencesLock);
+    Object* list = pendingClearedReferences;
+    pendingClearedReferences = NULL;
+    rvmUnlockMutex(&pendingClearedReferencesLock);
+    if (list != NULL) {
+        rvmCallVoidClassMethod(env, java_lang_ref_ReferenceQueue, java_lang_ref_ReferenceQueue_add, list);
+        assert(rvmExceptionOccurred(env) == NULL);
+    }
+}
+
 static void finalizeObject(Env* env, Object* obj) {
 //    TRACEF("finalizeObject: %p (%s)\n", obj, obj->clazz->name);
 
-    rvmLockMutex(&referentsLock);
+    ReferentsShard* shard = getReferentsShard(obj);
+    rvmLockMutex(&shard->lock);
     void* key = (void*) GC_HIDE_POINTER(obj);
     ReferentEntry* referentEntry;
-    HASH_FIND_PTR(referents, &key, referentEntry);
+    HASH_FIND_PTR(shard->referents, &key, referentEntry);
 
     assert(referentEntry != NULL);
 
     if (referentEntry->references == NULL) {
         // The object is not referenced by any type of reference and can never be resurrected.
-        HASH_DEL(referents, referentEntry);
-        rvmUnlockMutex(&referentsLock);
+        HASH_DEL(shard->referents, referentEntry);
+        rvmUnlockMutex(&shard->lock);
         // Run all cleanup handlers registered for the object
         CleanupHandlerList* l = referentEntry->cleanupHandlers;
         while (l) {
@@ -769,15 +989,16 @@ static void finalizeObject(Env* env, Object* obj) {
     enqueueFinalizerReferences(env, &finalizerReferences, &clearedReferences);
     clearAndEnqueueReferences(env, &phantomReferences, &clearedReferences);
 
+    rvmUnlockMutex(&shard->lock);
+
     // Reregister for finalization. If no new references have been added to the list of references for the referent the
-    // next time it gets finalized we know it will never be resurrected.
+    // next time it gets finalized we know it will never be resurrected. This is done outside the shard's lock like in
+    // registerReferentForFinalization(). Nothing can register new references to obj in between since obj only becomes
+    // reachable again once the cleared references have been enqueued.
     GC_REGISTER_FINALIZER_NO_ORDER(obj, _finalizeObject, NULL, NULL, NULL);
 
-    rvmUnlockMutex(&referentsLock);
-
     if (clearedReferences != NULL) {
-        rvmCallVoidClassMethod(env, java_lang_ref_ReferenceQueue, java_lang_ref_ReferenceQueue_add, clearedReferences);
-        assert(rvmExceptionOccurred(env) == NULL);
+        addPendingClearedReferences(env, clearedReferences);
     }
 }
 
@@ -794,6 +1015,22 @@ static void _finalizeObject(GC_PTR addr, GC_PTR client_data) {
     }
 }
 
+/*
+ * Called by the GC at most once per collection when objects registered for
+ * finalization have become unreachable. Runs finalizeObject() for all of
+ * them and then enqueues the references they cleared in one go.
+ */
+static void invokeFinalizers(void) {
+    Env* env = rvmGetEnv();
+    if (!rvmHasCurrentThread(env)) {
+        // See _finalizeObject(). The finalizers stay queued and we will be
+        // notified again after the next collection.
+        return;
+    }
+    GC_invoke_finalizers();
+    enqueuePendingClearedReferences(env);
+}
+
 void rvmRegisterFinalizer(Env* env, Object* obj) {
     // Call java.lang.FinalizerReference.add(obj)
     // A FinalizerReference will be created for obj and that reference will be registered using rvmRegisterReference().
@@ -801,56 +1038,81 @@ void rvmRegisterFinalizer(Env* env, Object* obj) {
 }
 
 /**
- * Returns the ReferentEntry for the specified object or creates one and adds
- * it to the referents hash if none exists. referentsLock MUST be held.
+ * Locks the shard and returns the ReferentEntry for the specified object.
+ * If there is none a new entry is allocated with the shard's lock released
+ * and added to the shard's referents hash unless another thread added one
+ * in between. Sets created to TRUE if this call added the entry. Returns
+ * NULL with the lock released if an OOM was thrown.
+ *
+ * Nothing which may take the GC's allocation lock is called with a shard's
+ * lock held. An allocation may run a collection and the finalizers queued
+ * by it in the allocating thread and finalizeObject() takes shard locks.
  */
-static ReferentEntry* getReferentEntryForObject(Env* env, Object* o) {
+static ReferentEntry* lockReferentEntry(Env* env, ReferentsShard* shard, Object* o, jboolean* created) {
     void* key = (void*) GC_HIDE_POINTER(o); // Hide the pointer from the GC so that the key doesn't prevent the object from being GCed.
     ReferentEntry* referentEntry;
-    HASH_FIND_PTR(referents, &key, referentEntry);
+    rvmLockMutex(&shard->lock);
+    HASH_FIND_PTR(shard->referents, &key, referentEntry);
+    if (referentEntry) {
+        return referentEntry;
+    }
+    rvmUnlockMutex(&shard->lock);
+
+    // Object is not in the hashtable. Add it.
+    ReferentEntry* newEntry = allocateMemoryOfKind(env, sizeof(ReferentEntry), referentEntryGCKind);
+    if (!newEntry) return NULL; // OOM thrown
+    newEntry->key = key;
+    rvmLockMutex(&shard->lock);
+    HASH_FIND_PTR(shard->referents, &key, referentEntry);
     if (!referentEntry) {
-        // Object is not in the hashtable. Add it.
-        referentEntry = allocateMemoryOfKind(env, sizeof(ReferentEntry), referentEntryGCKind);
-        if (!referentEntry) return NULL; // OOM thrown
-        referentEntry->key = key;
-        HASH_ADD_PTR(referents, key, referentEntry);
+        referentEntry = newEntry;
+        HASH_ADD_PTR(shard->referents, key, referentEntry);
+        *created = TRUE;
     }
     return referentEntry;
 }
 
+/*
+ * Objects with a ReferentEntry are always registered for finalization.
+ * Only objects which just got one need to be registered. This is done
+ * after the shard's lock has been released, see lockReferentEntry(). The
+ * object can't be finalized in between since the caller holds a reference
+ * to it.
+ */
+static inline void registerReferentForFinalization(Object* o, jboolean created) {
+    if (created) {
+        GC_REGISTER_FINALIZER_NO_ORDER(o, _finalizeObject, NULL, NULL, NULL);
+    }
+}
+
 void registerCleanupHandler(Env* env, Object* object, CleanupHandler handler) {
-    rvmLockMutex(&referentsLock);
+    ReferentsShard* shard = getReferentsShard(object);
+    jboolean created = FALSE;
     CleanupHandlerList* l = rvmAllocateMemory(env, sizeof(CleanupHandlerList));
-    if (!l) goto done; // OOM thrown
+    if (!l) return; // OOM thrown
     l->handler = handler;
-    ReferentEntry* referentEntry = getReferentEntryForObject(env, object);
-    if (!referentEntry) goto done;
+    ReferentEntry* referentEntry = lockReferentEntry(env, shard, object, &created);
+    if (!referentEntry) return; // OOM thrown
     // Add the handler to the object's list of cleanup handlers
     LL_PREPEND(referentEntry->cleanupHandlers, l);
-    // Register the referent for finalization
-    GC_REGISTER_FINALIZER_NO_ORDER(object, _finalizeObject, NULL, NULL, NULL);
-
-done:
-    rvmUnlockMutex(&referentsLock);
+    rvmUnlockMutex(&shard->lock);
+    registerReferentForFinalization(object, created);
 }
 
 void rvmRegisterReference(Env* env, Object* reference, Object* referent) {
     if (referent) {
         // Add 'reference' to the references list for 'referent' in the referents hashtable
-        rvmLockMutex(&referentsLock);
-
+        ReferentsShard* shard = getReferentsShard(referent);
+        jboolean created = FALSE;
         ReferenceList* l = rvmAllocateMemory(env, sizeof(ReferenceList));
-        if (!l) goto done; // OOM thrown
+        if (!l) return; // OOM thrown
         l->reference = reference;
-        ReferentEntry* referentEntry = getReferentEntryForObject(env, referent);
-        if (!referentEntry) goto done;
+        ReferentEntry* referentEntry = lockReferentEntry(env, shard, referent, &created);
+        if (!referentEntry) return; // OOM thrown
         // Add the reference to the referent's list of references
         LL_PREPEND(referentEntry->references, l);
-        // Register the referent for finalization
-        GC_REGISTER_FINALIZER_NO_ORDER(referent, _finalizeObject, NULL, NULL, NULL);
-
-done:
-        rvmUnlockMutex(&referentsLock);
+        rvmUnlockMutex(&shard->lock);
+        registerReferentForFinalization(referent, created);
     }
 }
 
@@ -862,10 +1124,26 @@ void rvmUnregisterDisappearingLink(Env* env, void** address) {
     GC_unregister_disappearing_link(address);
 }
 
+static void* readDisappearingLinkLocked(void* address) {
+    return *(void**) address;
+}
+
+/*
+ * Reads a disappearing link. The GC clears links after the world has been
+ * restarted so the link must be read with the allocation lock held.
+ * Otherwise an object which is about to be reclaimed could be returned.
+ */
+Object* rvmReadDisappearingLink(Env* env, void** address) {
+    return (Object*) GC_call_with_alloc_lock(readDisappearingLinkLocked, address);
+}
+
 jboolean rvmInitMemory(Env* env) {
     vm = env->vm;
 
-    gcAddRoot(&referents);
+    for (jint i = 0; i < REFERENTS_SHARDS; i++) {
+        gcAddRoot(&referentsShards[i].referents);
+    }
+    gcAddRoot(&pendingClearedReferences);
 
     java_lang_ref_Reference_referent = rvmGetInstanceField(env, java_lang_ref_Reference, "referent", "Ljava/lang/Object;");
     if (!java_lang_ref_Reference_referent) return FALSE;
@@ -988,7 +1266,14 @@ Class* rvmAllocateMemoryForClass(Env* env, jint classDataSize) {
 }
 
 Object* rvmAllocateMemoryForObject(Env* env, Class* clazz) {
-    Object* m = (Object*) gcAllocateObject(clazz->instanceDataSize, clazz);
+    Object* m = NULL;
+    RvmThread* thread = env->currentThread;
+    if (thread && thread->allocCache) {
+        m = (Object*) gcAllocateObjectFromCache(thread->allocCache, clazz->instanceDataSize, clazz);
+    }
+    if (!m) {
+        m = (Object*) gcAllocateObject(clazz->instanceDataSize, clazz);
+    }
     if (!m) {
         if (clazz == java_lang_OutOfMemoryError) {
             // We can't even allocate an OutOfMemoryError object. Prevent
@@ -1010,7 +1295,20 @@ Array* rvmAllocateMemoryForArray(Env* env, Class* arrayClass, jint length) {
     }
     Array* m = NULL;
     if (CLASS_IS_PRIMITIVE(arrayClass->componentType)) {
-        m = (Array*) gcAllocateObject((size_t) size, arrayClass);
+        if (incrementalGC) {
+            // Pages containing gcj objects are write protected by the GC in
+            // incremental mode on some platforms. System calls writing
+            // directly into such pages (e.g. read() into a byte[]) fail with
+            // EFAULT instead of raising a signal the GC can handle. Allocate
+            // primitive arrays from a pointer free kind which is never
+            // protected.
+            m = (Array*) gcAllocateKind((size_t) size, primitiveArrayGCKind);
+            if (m) {
+                m->object.clazz = arrayClass;
+            }
+        } else {
+            m = (Array*) gcAllocateObject((size_t) size, arrayClass);
+        }
     } else {
         // Object array. Conservatively scanned. Only the lock (if thin) 
         // and the length fields could become a problem if they look like 
@@ -1072,87 +1370,58 @@ void* rvmAllocateMemoryAtomicUncollectable(Env* env, size_t size) {
     return m;
 }
 
-jboolean rvmInitRefTable(Env* env, RefTable* refTable, jint size) {
-    refTable->entries = rvmAllocateMemoryUncollectable(env, size * sizeof(void*));
-    if (!refTable->entries) {
-        return FALSE;
-    }
-    refTable->size = size;
-    return TRUE;
+jboolean rvmIsCriticalOutOfMemoryError(Env* env, Object* throwable) {
+    return throwable == criticalOutOfMemoryError;
 }
 
-jboolean rvmAddGlobalRef(Env* env, Object* object) {
-    if (!object) {
-        return TRUE;
-    }
-    rvmLockMutex(&globalRefsLock);
-    if (!globalRefs.entries) {
-        if (!rvmInitRefTable(env, &globalRefs, GLOBAL_REFS_INITIAL_SIZE)) {
-            rvmUnlockMutex(&globalRefsLock);
-            return FALSE;
-        }
-    }
-    jboolean result = rvmAddRef(env, &globalRefs, object);
-    rvmUnlockMutex(&globalRefsLock);
-    return result;
+void rvmFreeMemoryUncollectable(Env* env, void* m) {
+    GC_FREE(m);
 }
 
-jboolean rvmRemoveGlobalRef(Env* env, Object* object) {
-    if (!object) {
-        return TRUE;
-    }
-    rvmLockMutex(&globalRefsLock);
-    jboolean result = rvmRemoveRef(env, &globalRefs, object);
-    rvmUnlockMutex(&globalRefsLock);
-    return result;
+void rvmGCCollect(Env* env) {
+    GC_gcollect();
 }
 
-jboolean rvmAddRef(Env* env, RefTable* refTable, Object* object) {
-    jint index = refTable->count;
-    if (index >= refTable->size) {
-        jint newSize = refTable->size << 1;
-        void** tmp = rvmAllocateMemoryUncollectable(env, newSize * sizeof(void*));
-        if (!tmp) {
-            return FALSE;
-        }
-        memcpy(tmp, refTable->entries, refTable->size * sizeof(void*));
-        rvmFreeMemoryUncollectable(env, refTable->entries);
-        refTable->entries = tmp;
-        refTable->size = newSize;
-    }
-    refTable->entries[index] = object;
-    refTable->count = index + 1;
-    return TRUE;
+jboolean rvmIsIncrementalGC(Env* env) {
+    return incrementalGC;
 }
 
-jboolean rvmRemoveRef(Env* env, RefTable* refTable, Object* object) {
-    // FIXME: Inefficient implementation
-    // Find the object from the end of the entries in the table.
-    for (jint i = refTable->count - 1; i >= 0; i--) {
-        if (refTable->entries[i] == object) {
-            refTable->entries[i] = NULL;
-            jint toMove = refTable->count - 1 - i;
-            if (toMove > 0) {
-                memmove(&refTable->entries[i], &refTable->entries[i + 1], toMove * sizeof(void*));
-                refTable->entries[refTable->count - 1] = NULL;
-            }
-            refTable->count--;
-            return TRUE;
-        }
-    }
-    return FALSE;
+static void* getPauseStatsLocked(void* data) {
+    memcpy(data, &pauseStats, sizeof(GCPauseStats));
+    return NULL;
 }
 
-jboolean rvmIsCriticalOutOfMemoryError(Env* env, Object* throwable) {
-    return throwable == criticalOutOfMemoryError;
+void rvmGetGCPauseStats(Env* env, GCPauseStats* stats) {
+    GC_call_with_alloc_lock(getPauseStatsLocked, stats);
 }
 
-void rvmFreeMemoryUncollectable(Env* env, void* m) {
-    GC_FREE(m);
+static void* resetPauseStatsLocked(void* data) {
+    memset(&pauseStats, 0, sizeof(GCPauseStats));
+    return NULL;
 }
 
-void rvmGCCollect(Env* env) {
-    GC_gcollect();
+void rvmResetGCPauseStats(Env* env) {
+    GC_call_with_alloc_lock(resetPauseStatsLocked, NULL);
+}
+
+jint rvmDrainGCEvents(Env* env, GCEvent* dest, jint max) {
+    while (TRUE) {
+        jlong tail = rvmAtomicLoadLong(&gcEventsTail);
+        jlong head = rvmAtomicLoadLong(&gcEventsHead);
+        jint n = (jint) (head - tail < max ? head - tail : max);
+        for (jint i = 0; i < n; i++) {
+            dest[i] = gcEvents[(tail + i) & (GC_EVENTS_SIZE - 1)];
+        }
+        // If another reader got here first the events we copied may have
+        // been overwritten. Try again in that case.
+        if (rvmAtomicCompareAndSwapLong(&gcEventsTail, tail, tail + n)) {
+            return n;
+        }
+    }
+}
+
+jlong rvmGetDroppedGCEventCount(Env* env) {
+    return rvmAtomicLoadLong(&droppedGCEvents);
 }
 
 jlong rvmGetFreeMemory(Env* env) {
@@ -30,12 +30,47 @@ DynamicLib* mainNativeLibs = NULL;
 
 static RvmMutex nativeLibsLock;
 static RvmMutex threadStackTraceLock;
-static jvalue emptyJValueArgs[1];
 static Class* java_lang_StackTraceElement = NULL;
 static Method* java_lang_StackTraceElement_constructor = NULL;
 static ObjectArray* empty_java_lang_StackTraceElement_array = NULL;
 
 
+// Number of slots in the resolvedFrames cache. Must be a power of 2.
+#define RESOLVED_FRAMES_CACHE_SIZE 4096
+
+// The result of resolving the pc of a CallStackFrame. Immutable once
+// published in the resolvedFrames cache.
+typedef struct {
+    void* pc;
+    Method* method; // NULL if pc isn't in a Java method
+    jint lineNumber;
+} ResolvedFrame;
+
+// Direct mapped cache of ResolvedFrames shared by all threads. Hot throw
+// sites resolve the same pcs over and over when their stack traces are
+// printed or inspected. Allocated uncollectable so that the GC allocated
+// ResolvedFrames it points to stay reachable. Entries are replaced on
+// collision.
+static ResolvedFrame** resolvedFrames = NULL;
+
+// Number of slots in the virtualCallTargets cache. Must be a power of 2.
+#define VIRTUAL_CALL_TARGETS_CACHE_SIZE 1024
+
+// The method found when looking up a virtual call to method on an instance
+// of clazz by name and descriptor. Immutable once published in the
+// virtualCallTargets cache.
+typedef struct {
+    Method* method;
+    Class* clazz;
+    Method* target;
+} VirtualCallTarget;
+
+// Direct mapped cache of VirtualCallTargets shared by all threads. Only
+// used for virtual calls which can't be dispatched through the receiver's
+// vtable or itables. Allocated uncollectable for the same reason as
+// resolvedFrames.
+static VirtualCallTarget** virtualCallTargets = NULL;
+
 // A shared CallStack struct used by rvmCaptureCallStackForThread() that can store at most MAX_CALL_STACK_LENGTH 
 // frames. dumpThreadStackTrace() assumes MAX_CALL_STACK_LENGTH.
 static CallStack* shared_callStack = NULL;
@@ -57,14 +92,9 @@ static inline void releaseThreadStackTraceLock() {
 }
 
 static Method* findMethod(Env* env, Class* clazz, const char* name, const char* desc) {
-    Method* method = rvmGetMethods(env, clazz);
+    Method* methods = rvmGetMethods(env, clazz);
     if (rvmExceptionCheck(env)) return NULL;
-    for (; method != NULL; method = method->next) {
-        if (!strcmp(method->name, name) && !strcmp(method->desc, desc)) {
-            return method;
-        }
-    }
-    return NULL;
+    return lookupMethod(env, clazz, methods, name, desc);
 }
 
 static Method* getMethod(Env* env, Class* clazz, const char* name, const char* desc) {
@@ -128,6 +158,14 @@ jboolean rvmInitMethods(Env* env) {
     if (!rvmAddGlobalRef(env, (Object*) empty_java_lang_StackTraceElement_array)) {
         return FALSE;
     }
+    resolvedFrames = gcAllocateUncollectable(sizeof(ResolvedFrame*) * RESOLVED_FRAMES_CACHE_SIZE);
+    if (!resolvedFrames) {
+        return FALSE;
+    }
+    virtualCallTargets = gcAllocateUncollectable(sizeof(VirtualCallTarget*) * VIRTUAL_CALL_TARGETS_CACHE_SIZE);
+    if (!virtualCallTargets) {
+        return FALSE;
+    }
 
     return TRUE;
 }
@@ -175,6 +213,9 @@ Method* rvmGetInstanceMethod(Env* env, Class* clazz, const char* name, const cha
 }
 
 Method* rvmFindMethodAtAddress(Env* env, void* address) {
+    if (env->vm->options->findMethodAt) {
+        return env->vm->options->findMethodAt(env, address);
+    }
     Class* clazz = env->vm->options->findClassAt(env, address);
     if (!clazz) return NULL;
     Method* method = rvmGetMethods(env, clazz);
@@ -354,6 +395,12 @@ static jint getLineNumber(CallStackFrame* frame) {
     return firstLineNumber + getLineTableEntry(lineOffsets, lineOffsetSize, index);
 }
 
+static inline ResolvedFrame** getResolvedFrameSlot(void* pc) {
+    uintptr_t h = (uintptr_t) pc;
+    h ^= h >> 12;
+    return &resolvedFrames[(h * 0x9e3779b1) >> 8 & (RESOLVED_FRAMES_CACHE_SIZE - 1)];
+}
+
 CallStackFrame* rvmResolveCallStackFrame(Env* env, CallStackFrame* frame) {
     if (frame->pc == NULL && frame->method == NULL) {
         // We've already tried to resolve this frame but 
@@ -366,12 +413,32 @@ CallStackFrame* rvmResolveCallStackFrame(Env* env, CallStackFrame* frame) {
         // is required
         return frame;
     }
-    frame->method = rvmFindMethodAtAddress(env, frame->pc);
+    ResolvedFrame** slot = getResolvedFrameSlot(frame->pc);
+    ResolvedFrame* resolved = rvmAtomicLoadAcquirePtr((void**) slot);
+    if (resolved && resolved->pc == frame->pc) {
+        frame->method = resolved->method;
+        frame->lineNumber = resolved->lineNumber;
+    } else {
+        frame->method = rvmFindMethodAtAddress(env, frame->pc);
+        if (frame->method) {
+            frame->lineNumber = METHOD_IS_NATIVE(frame->method) ? -2 : getLineNumber(frame);
+        }
+        // Don't cache failures caused by exceptions (e.g. OOM when loading
+        // the class).
+        if (!rvmExceptionCheck(env)) {
+            resolved = gcAllocate(sizeof(ResolvedFrame));
+            if (resolved) {
+                resolved->pc = frame->pc;
+                resolved->method = frame->method;
+                resolved->lineNumber = frame->lineNumber;
+                rvmAtomicStorePtr((void**) slot, resolved);
+            }
+        }
+    }
     if (!frame->method) {
         frame->pc = NULL;
         return NULL;
     }
-    frame->lineNumber = METHOD_IS_NATIVE(frame->method) ? -2 : getLineNumber(frame);
     return frame;
 }
 
@@ -459,159 +526,101 @@ jint rvmGetParameterCount(Method* method) {
     return count;
 }
 
-typedef struct {
-    jint ptrArgsCount, intArgsCount, longArgsCount, floatArgsCount, doubleArgsCount;
-} ArgsCount;
-
-static void countArgs(Env* env, Method* method, ArgsCount* argsCount) {
-    jint ptrArgsCount = 0, intArgsCount = 0, longArgsCount = 0, floatArgsCount = 0, doubleArgsCount = 0;
-    ptrArgsCount = 1; // First arg is always the Env*
-    if (!(method->access & ACC_STATIC)) {
-        // Non-static methods takes the receiver object (this) as arg 2
-        ptrArgsCount++;
-    }    
+static inline VirtualCallTarget** getVirtualCallTargetSlot(Method* method, Class* clazz) {
+    uintptr_t h = (uintptr_t) method ^ ((uintptr_t) clazz >> 3);
+    h ^= h >> 12;
+    return &virtualCallTargets[(h * 0x9e3779b1) >> 8 & (VIRTUAL_CALL_TARGETS_CACHE_SIZE - 1)];
+}
 
-    const char* desc = method->desc;
-    const char* c;
-    while ((c = rvmGetNextParameterType(&desc))) {
-        switch (c[0]) {
-        case 'Z':
-        case 'B':
-        case 'S':
-        case 'C':
-        case 'I':
-            intArgsCount++;
-            break;
-        case 'J':
-            longArgsCount++;
-            break;
-        case 'F':
-            floatArgsCount++;
-            break;
-        case 'D':
-            doubleArgsCount++;
-            break;
-        case 'L':
-        case '[':
-            ptrArgsCount++;
-            break;
+static Method* lookupVirtualCallTarget(Env* env, Class* clazz, Method* method) {
+    VirtualCallTarget** slot = getVirtualCallTargetSlot(method, clazz);
+    VirtualCallTarget* cached = rvmAtomicLoadAcquirePtr((void**) slot);
+    if (cached && cached->method == method && cached->clazz == clazz) {
+        return cached->target;
+    }
+    Method* target = rvmGetMethod(env, clazz, method->name, method->desc);
+    if (target) {
+        cached = gcAllocate(sizeof(VirtualCallTarget));
+        if (cached) {
+            cached->method = method;
+            cached->clazz = clazz;
+            cached->target = target;
+            rvmAtomicStorePtr((void**) slot, cached);
         }
     }
-
-    argsCount->ptrArgsCount = ptrArgsCount;
-    argsCount->intArgsCount = intArgsCount;
-    argsCount->longArgsCount = longArgsCount;
-    argsCount->floatArgsCount = floatArgsCount;
-    argsCount->doubleArgsCount = doubleArgsCount;
+    return target;
 }
 
-static void setArgs(Env* env, Object* obj, Method* method, CallInfo* callInfo, jvalue* args) {
-    call0AddPtr(callInfo, env);
-    if (!(method->access & ACC_STATIC)) {
-        call0AddPtr(callInfo, obj);
-    }    
+/*
+ * Returns the function to call for a virtual call to method on obj. Uses
+ * the vtable or itable slot of method just like invokevirtual and
+ * invokeinterface in compiled code. Falls back to looking up the method
+ * by name and descriptor in the class of obj.
+ */
+static void* getVirtualCallFunction(Env* env, Object* obj, Method* method) {
+    Class* clazz = obj->clazz;
+    Class* owner = method->clazz;
+    jint index = method->vitableIndex;
 
-    const char* desc = method->desc;
-    const char* c;
-    jint i = 0;
-    while ((c = rvmGetNextParameterType(&desc))) {
-        switch (c[0]) {
-        case 'Z':
-            call0AddInt(callInfo, (jint) args[i++].z);
-            break;
-        case 'B':
-            call0AddInt(callInfo, (jint) args[i++].b);
-            break;
-        case 'S':
-            call0AddInt(callInfo, (jint) args[i++].s);
-            break;
-        case 'C':
-            call0AddInt(callInfo, (jint) args[i++].c);
-            break;
-        case 'I':
-            call0AddInt(callInfo, args[i++].i);
-            break;
-        case 'J':
-            call0AddLong(callInfo, args[i++].j);
-            break;
-        case 'F':
-            call0AddFloat(callInfo, args[i++].f);
-            break;
-        case 'D':
-            call0AddDouble(callInfo, args[i++].d);
-            break;
-        case 'L':
-        case '[':
-            call0AddPtr(callInfo, args[i++].l);
-            break;
+    if (METHOD_IS_FINAL(method) || (CLASS_IS_FINAL(owner) && !CLASS_IS_INTERFACE(owner))) {
+        // Cannot be overridden
+        return method->synchronizedImpl ? method->synchronizedImpl : method->impl;
+    }
+
+    if (index >= 0) {
+        if (!CLASS_IS_INTERFACE(owner)) {
+            if (index < clazz->vitable->size) {
+                return clazz->vitable->table[index];
+            }
+        } else {
+            ITable* itable = rvmFindITable(clazz->itables, owner->typeInfo);
+            if (itable && index < itable->table.size) {
+                return itable->table.table[index];
+            }
         }
     }
+
+    Method* target = lookupVirtualCallTarget(env, clazz, method);
+    if (!target) {
+        return NULL;
+    }
+    return target->synchronizedImpl ? target->synchronizedImpl : target->impl;
 }
 
-#define /* CallInfo* */ INIT_CALL_INFO(/* Env* */ _env, /* Object* */ _obj, /* Method* */ _method, /* jboolean */ _virtual, /* jvalue* */ _args) ({ \
+#define /* CallInfo* */ INIT_CALL_INFO_WITH(/* Env* */ _env, /* Object* */ _obj, /* Method* */ _method, /* jboolean */ _virtual, _addArgs, _args) ({ \
     CallInfo* _callInfo = NULL; \
+    void* _function; \
     if (_virtual && !(_method->access & ACC_PRIVATE)) { \
-        /* Lookup the real method to be invoked */ \
-        _method = rvmGetMethod(_env, ((Object*) _obj)->clazz, _method->name, _method->desc); \
+        /* Find the real function to be invoked. The overriding method has */ \
+        /* the same descriptor so _method can still be used for the args. */ \
+        _function = getVirtualCallFunction(_env, (Object*) _obj, _method); \
+        if (!_function) { \
+            _method = NULL; \
+        } else { \
+            /* Used by _bcAbstractMethodCalled() if the slot is abstract */ \
+            _env->reserved0 = (void*) _method->name; \
+            _env->reserved1 = (void*) _method->desc; \
+        } \
+    } else { \
+        _function = _method->synchronizedImpl ? _method->synchronizedImpl : _method->impl; \
     } \
-    if (_method) { \
-        ArgsCount _argsCount; \
-        countArgs(_env, _method, &_argsCount); \
-        void* _function = _method->synchronizedImpl ? _method->synchronizedImpl : _method->impl; \
-        _callInfo = CALL0_ALLOCATE_CALL_INFO(_env, _function, _argsCount.ptrArgsCount, _argsCount.intArgsCount, _argsCount.longArgsCount, _argsCount.floatArgsCount, _argsCount.doubleArgsCount); \
-        setArgs(_env, _obj, _method, _callInfo, _args); \
+    CallPlan* _plan = _method ? getCallPlan(_env, _method) : NULL; \
+    if (_plan) { \
+        _callInfo = CALL0_ALLOCATE_CALL_INFO(_env, _function, _plan->ptrArgsCount, _plan->intArgsCount, _plan->longArgsCount, _plan->floatArgsCount, _plan->doubleArgsCount); \
+        call0AddPtr(_callInfo, _env); \
+        if (!(_method->access & ACC_STATIC)) { \
+            call0AddPtr(_callInfo, _obj); \
+        } \
+        _addArgs(_callInfo, _plan, _args); \
     } \
     _callInfo; \
 })
 
-static jvalue* va_list2jargs(Env* env, Method* method, va_list args) {
-    jint argsCount = rvmGetParameterCount(method);
-
-    if (argsCount == 0) {
-        return emptyJValueArgs;
-    }
+#define /* CallInfo* */ INIT_CALL_INFO(/* Env* */ _env, /* Object* */ _obj, /* Method* */ _method, /* jboolean */ _virtual, /* jvalue* */ _args) \
+    INIT_CALL_INFO_WITH(_env, _obj, _method, _virtual, addCallPlanArgs, _args)
 
-    jvalue *jvalueArgs = (jvalue*) rvmAllocateMemory(env, sizeof(jvalue) * argsCount);
-    if (!jvalueArgs) return NULL;
-
-    const char* desc = method->desc;
-    const char* c;
-    jint i = 0;
-    while ((c = rvmGetNextParameterType(&desc))) {
-        switch (c[0]) {
-        case 'B':
-            jvalueArgs[i++].b = (jbyte) va_arg(args, jint);
-            break;
-        case 'Z':
-            jvalueArgs[i++].z = (jboolean) va_arg(args, jint);
-            break;
-        case 'S':
-            jvalueArgs[i++].s = (jshort) va_arg(args, jint);
-            break;
-        case 'C':
-            jvalueArgs[i++].c = (jchar) va_arg(args, jint);
-            break;
-        case 'I':
-            jvalueArgs[i++].i = va_arg(args, jint);
-            break;
-        case 'J':
-            jvalueArgs[i++].j = va_arg(args, jlong);
-            break;
-        case 'F':
-            jvalueArgs[i++].f = (jfloat) va_arg(args, jdouble);
-            break;
-        case 'D':
-            jvalueArgs[i++].d = va_arg(args, jdouble);
-            break;
-        case '[':
-        case 'L':
-            jvalueArgs[i++].l = va_arg(args, jobject);
-            break;
-        }
-    }
-
-    return jvalueArgs;
-}
+#define /* CallInfo* */ INIT_CALL_INFO_V(/* Env* */ _env, /* Object* */ _obj, /* Method* */ _method, /* jboolean */ _virtual, /* va_list */ _args) \
+    INIT_CALL_INFO_WITH(_env, _obj, _method, _virtual, addCallPlanArgsV, _args)
 
 static void callVoidMethod(Env* env, CallInfo* callInfo) {
     void (*f)(CallInfo*) = _call0;
@@ -711,6 +720,49 @@ static jdouble callDoubleMethod(Env* env, CallInfo* callInfo) {
     return result;
 }
 
+/*
+ * Calls method through the invoker stub emitted by the compiler for its
+ * shape (see callplan.c). args[0] must hold the receiver if method is an
+ * instance method followed by the arguments. Instance methods are called
+ * virtually unless private. The result is stored in result. Returns FALSE
+ * if there is no invoker stub for the method in which case nothing is
+ * called. Otherwise returns TRUE and any exception thrown is left pending.
+ */
+jboolean rvmCallMethodUsingInvoker(Env* env, Method* method, jvalue* args, jvalue* result) {
+    CallPlan* plan = getCallPlan(env, method);
+    if (!plan || !plan->invoker) {
+        return FALSE;
+    }
+    result->j = 0;
+    void* function;
+    if (METHOD_IS_STATIC(method)) {
+        rvmInitialize(env, method->clazz);
+        if (rvmExceptionOccurred(env)) return TRUE;
+        function = method->synchronizedImpl ? method->synchronizedImpl : method->impl;
+    } else {
+        Object* obj = (Object*) args[0].l;
+        if (!(method->access & ACC_PRIVATE)) {
+            function = getVirtualCallFunction(env, obj, method);
+            if (!function) return TRUE;
+        } else {
+            function = method->synchronizedImpl ? method->synchronizedImpl : method->impl;
+        }
+        // Used by proxy0 and _bcAbstractMethodCalled()
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    void (*f)(Env*, void*, jvalue*, jvalue*) = plan->invoker;
+    rvmPushGatewayFrame(env);
+    TrycatchContext tc = {0};
+    tc.sel = CATCH_ALL_SEL;
+    if (!rvmTrycatchEnter(env, &tc)) {
+        f(env, function, args, result);
+    }
+    rvmTrycatchLeave(env);
+    rvmPopGatewayFrame(env);
+    return TRUE;
+}
+
 void rvmCallVoidInstanceMethodA(Env* env, Object* obj, Method* method, jvalue* args) {
     CallInfo* callInfo = INIT_CALL_INFO(env, obj, method, TRUE, args);
     if (!callInfo) return;
@@ -722,9 +774,13 @@ void rvmCallVoidInstanceMethodA(Env* env, Object* obj, Method* method, jvalue* a
 }
 
 void rvmCallVoidInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return;
-    rvmCallVoidInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, TRUE, args);
+    if (!callInfo) return;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    callVoidMethod(env, callInfo);
 }
 
 void rvmCallVoidInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -744,9 +800,13 @@ Object* rvmCallObjectInstanceMethodA(Env* env, Object* obj, Method* method, jval
 }
 
 Object* rvmCallObjectInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return NULL;
-    return rvmCallObjectInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, TRUE, args);
+    if (!callInfo) return NULL;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    return callObjectMethod(env, callInfo);
 }
 
 Object* rvmCallObjectInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -766,9 +826,13 @@ jboolean rvmCallBooleanInstanceMethodA(Env* env, Object* obj, Method* method, jv
 }
 
 jboolean rvmCallBooleanInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return FALSE;
-    return rvmCallBooleanInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, TRUE, args);
+    if (!callInfo) return FALSE;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    return callBooleanMethod(env, callInfo);
 }
 
 jboolean rvmCallBooleanInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -788,9 +852,13 @@ jbyte rvmCallByteInstanceMethodA(Env* env, Object* obj, Method* method, jvalue*
 }
 
 jbyte rvmCallByteInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0;
-    return rvmCallByteInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, TRUE, args);
+    if (!callInfo) return 0;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    return callByteMethod(env, callInfo);
 }
 
 jbyte rvmCallByteInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -810,9 +878,13 @@ jchar rvmCallCharInstanceMethodA(Env* env, Object* obj, Method* method, jvalue*
 }
 
 jchar rvmCallCharInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0;
-    return rvmCallCharInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, TRUE, args);
+    if (!callInfo) return 0;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    return callCharMethod(env, callInfo);
 }
 
 jchar rvmCallCharInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -832,9 +904,13 @@ jshort rvmCallShortInstanceMethodA(Env* env, Object* obj, Method* method, jvalue
 }
 
 jshort rvmCallShortInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0;
-    return rvmCallShortInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, TRUE, args);
+    if (!callInfo) return 0;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    return callShortMethod(env, callInfo);
 }
 
 jshort rvmCallShortInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -854,9 +930,13 @@ jint rvmCallIntInstanceMethodA(Env* env, Object* obj, Method* method, jvalue* ar
 }
 
 jint rvmCallIntInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0;
-    return rvmCallIntInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, TRUE, args);
+    if (!callInfo) return 0;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    return callIntMethod(env, callInfo);
 }
 
 jint rvmCallIntInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -876,9 +956,13 @@ jlong rvmCallLongInstanceMethodA(Env* env, Object* obj, Method* method, jvalue*
 }
 
 jlong rvmCallLongInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0;
-    return rvmCallLongInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, TRUE, args);
+    if (!callInfo) return 0;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    return callLongMethod(env, callInfo);
 }
 
 jlong rvmCallLongInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -898,9 +982,13 @@ jfloat rvmCallFloatInstanceMethodA(Env* env, Object* obj, Method* method, jvalue
 }
 
 jfloat rvmCallFloatInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0.0f;
-    return rvmCallFloatInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, TRUE, args);
+    if (!callInfo) return 0.0f;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    return callFloatMethod(env, callInfo);
 }
 
 jfloat rvmCallFloatInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -920,9 +1008,13 @@ jdouble rvmCallDoubleInstanceMethodA(Env* env, Object* obj, Method* method, jval
 }
 
 jdouble rvmCallDoubleInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0.0;
-    return rvmCallDoubleInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, TRUE, args);
+    if (!callInfo) return 0.0;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    return callDoubleMethod(env, callInfo);
 }
 
 jdouble rvmCallDoubleInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -942,9 +1034,13 @@ void rvmCallNonvirtualVoidInstanceMethodA(Env* env, Object* obj, Method* method,
 }
 
 void rvmCallNonvirtualVoidInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return;
-    rvmCallNonvirtualVoidInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, FALSE, args);
+    if (!callInfo) return;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    callVoidMethod(env, callInfo);
 }
 
 void rvmCallNonvirtualVoidInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -964,9 +1060,13 @@ Object* rvmCallNonvirtualObjectInstanceMethodA(Env* env, Object* obj, Method* me
 }
 
 Object* rvmCallNonvirtualObjectInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return NULL;
-    return rvmCallNonvirtualObjectInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, FALSE, args);
+    if (!callInfo) return NULL;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    return callObjectMethod(env, callInfo);
 }
 
 Object* rvmCallNonvirtualObjectInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -986,9 +1086,13 @@ jboolean rvmCallNonvirtualBooleanInstanceMethodA(Env* env, Object* obj, Method*
 }
 
 jboolean rvmCallNonvirtualBooleanInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return FALSE;
-    return rvmCallNonvirtualBooleanInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, FALSE, args);
+    if (!callInfo) return FALSE;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    return callBooleanMethod(env, callInfo);
 }
 
 jboolean rvmCallNonvirtualBooleanInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -1008,9 +1112,13 @@ jbyte rvmCallNonvirtualByteInstanceMethodA(Env* env, Object* obj, Method* method
 }
 
 jbyte rvmCallNonvirtualByteInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0;
-    return rvmCallNonvirtualByteInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, FALSE, args);
+    if (!callInfo) return 0;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    return callByteMethod(env, callInfo);
 }
 
 jbyte rvmCallNonvirtualByteInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -1030,9 +1138,13 @@ jchar rvmCallNonvirtualCharInstanceMethodA(Env* env, Object* obj, Method* method
 }
 
 jchar rvmCallNonvirtualCharInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0;
-    return rvmCallNonvirtualCharInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, FALSE, args);
+    if (!callInfo) return 0;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    return callCharMethod(env, callInfo);
 }
 
 jchar rvmCallNonvirtualCharInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -1052,9 +1164,13 @@ jshort rvmCallNonvirtualShortInstanceMethodA(Env* env, Object* obj, Method* meth
 }
 
 jshort rvmCallNonvirtualShortInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0;
-    return rvmCallNonvirtualShortInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, FALSE, args);
+    if (!callInfo) return 0;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    return callShortMethod(env, callInfo);
 }
 
 jshort rvmCallNonvirtualShortInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -1074,9 +1190,13 @@ jint rvmCallNonvirtualIntInstanceMethodA(Env* env, Object* obj, Method* method,
 }
 
 jint rvmCallNonvirtualIntInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0;
-    return rvmCallNonvirtualIntInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, FALSE, args);
+    if (!callInfo) return 0;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    return callIntMethod(env, callInfo);
 }
 
 jint rvmCallNonvirtualIntInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -1096,9 +1216,13 @@ jlong rvmCallNonvirtualLongInstanceMethodA(Env* env, Object* obj, Method* method
 }
 
 jlong rvmCallNonvirtualLongInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0;
-    return rvmCallNonvirtualLongInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, FALSE, args);
+    if (!callInfo) return 0;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    return callLongMethod(env, callInfo);
 }
 
 jlong rvmCallNonvirtualLongInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -1118,9 +1242,13 @@ jfloat rvmCallNonvirtualFloatInstanceMethodA(Env* env, Object* obj, Method* meth
 }
 
 jfloat rvmCallNonvirtualFloatInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0.0f;
-    return rvmCallNonvirtualFloatInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, FALSE, args);
+    if (!callInfo) return 0.0f;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    return callFloatMethod(env, callInfo);
 }
 
 jfloat rvmCallNonvirtualFloatInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -1140,9 +1268,13 @@ jdouble rvmCallNonvirtualDoubleInstanceMethodA(Env* env, Object* obj, Method* me
 }
 
 jdouble rvmCallNonvirtualDoubleInstanceMethodV(Env* env, Object* obj, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0.0;
-    return rvmCallNonvirtualDoubleInstanceMethodA(env, obj, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, obj, method, FALSE, args);
+    if (!callInfo) return 0.0;
+    if (obj && CLASS_IS_PROXY(obj->clazz)) {
+        env->reserved0 = (void*) method->name;
+        env->reserved1 = (void*) method->desc;
+    }
+    return callDoubleMethod(env, callInfo);
 }
 
 jdouble rvmCallNonvirtualDoubleInstanceMethod(Env* env, Object* obj, Method* method, ...) {
@@ -1160,9 +1292,11 @@ void rvmCallVoidClassMethodA(Env* env, Class* clazz, Method* method, jvalue* arg
 }
 
 void rvmCallVoidClassMethodV(Env* env, Class* clazz, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return;
-    rvmCallVoidClassMethodA(env, clazz, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, NULL, method, FALSE, args);
+    if (!callInfo) return;
+    rvmInitialize(env, method->clazz);
+    if (rvmExceptionOccurred(env)) return;
+    callVoidMethod(env, callInfo);
 }
 
 void rvmCallVoidClassMethod(Env* env, Class* clazz, Method* method, ...) {
@@ -1180,9 +1314,11 @@ Object* rvmCallObjectClassMethodA(Env* env, Class* clazz, Method* method, jvalue
 }
 
 Object* rvmCallObjectClassMethodV(Env* env, Class* clazz, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return NULL;
-    return rvmCallObjectClassMethodA(env, clazz, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, NULL, method, FALSE, args);
+    if (!callInfo) return NULL;
+    rvmInitialize(env, method->clazz);
+    if (rvmExceptionOccurred(env)) return NULL;
+    return callObjectMethod(env, callInfo);
 }
 
 Object* rvmCallObjectClassMethod(Env* env, Class* clazz, Method* method, ...) {
@@ -1200,9 +1336,11 @@ jboolean rvmCallBooleanClassMethodA(Env* env, Class* clazz, Method* method, jval
 }
 
 jboolean rvmCallBooleanClassMethodV(Env* env, Class* clazz, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return FALSE;
-    return rvmCallBooleanClassMethodA(env, clazz, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, NULL, method, FALSE, args);
+    if (!callInfo) return FALSE;
+    rvmInitialize(env, method->clazz);
+    if (rvmExceptionOccurred(env)) return FALSE;
+    return callBooleanMethod(env, callInfo);
 }
 
 jboolean rvmCallBooleanClassMethod(Env* env, Class* clazz, Method* method, ...) {
@@ -1220,9 +1358,11 @@ jbyte rvmCallByteClassMethodA(Env* env, Class* clazz, Method* method, jvalue* ar
 }
 
 jbyte rvmCallByteClassMethodV(Env* env, Class* clazz, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0;
-    return rvmCallByteClassMethodA(env, clazz, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, NULL, method, FALSE, args);
+    if (!callInfo) return 0;
+    rvmInitialize(env, method->clazz);
+    if (rvmExceptionOccurred(env)) return 0;
+    return callByteMethod(env, callInfo);
 }
 
 jbyte rvmCallByteClassMethod(Env* env, Class* clazz, Method* method, ...) {
@@ -1240,9 +1380,11 @@ jchar rvmCallCharClassMethodA(Env* env, Class* clazz, Method* method, jvalue* ar
 }
 
 jchar rvmCallCharClassMethodV(Env* env, Class* clazz, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0;
-    return rvmCallCharClassMethodA(env, clazz, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, NULL, method, FALSE, args);
+    if (!callInfo) return 0;
+    rvmInitialize(env, method->clazz);
+    if (rvmExceptionOccurred(env)) return 0;
+    return callCharMethod(env, callInfo);
 }
 
 jchar rvmCallCharClassMethod(Env* env, Class* clazz, Method* method, ...) {
@@ -1260,9 +1402,11 @@ jshort rvmCallShortClassMethodA(Env* env, Class* clazz, Method* method, jvalue*
 }
 
 jshort rvmCallShortClassMethodV(Env* env, Class* clazz, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0;
-    return rvmCallShortClassMethodA(env, clazz, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, NULL, method, FALSE, args);
+    if (!callInfo) return 0;
+    rvmInitialize(env, method->clazz);
+    if (rvmExceptionOccurred(env)) return 0;
+    return callShortMethod(env, callInfo);
 }
 
 jshort rvmCallShortClassMethod(Env* env, Class* clazz, Method* method, ...) {
@@ -1280,9 +1424,11 @@ jint rvmCallIntClassMethodA(Env* env, Class* clazz, Method* method, jvalue* args
 }
 
 jint rvmCallIntClassMethodV(Env* env, Class* clazz, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0;
-    return rvmCallIntClassMethodA(env, clazz, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, NULL, method, FALSE, args);
+    if (!callInfo) return 0;
+    rvmInitialize(env, method->clazz);
+    if (rvmExceptionOccurred(env)) return 0;
+    return callIntMethod(env, callInfo);
 }
 
 jint rvmCallIntClassMethod(Env* env, Class* clazz, Method* method, ...) {
@@ -1300,9 +1446,11 @@ jlong rvmCallLongClassMethodA(Env* env, Class* clazz, Method* method, jvalue* ar
 }
 
 jlong rvmCallLongClassMethodV(Env* env, Class* clazz, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0;
-    return rvmCallLongClassMethodA(env, clazz, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, NULL, method, FALSE, args);
+    if (!callInfo) return 0;
+    rvmInitialize(env, method->clazz);
+    if (rvmExceptionOccurred(env)) return 0;
+    return callLongMethod(env, callInfo);
 }
 
 jlong rvmCallLongClassMethod(Env* env, Class* clazz, Method* method, ...) {
@@ -1320,9 +1468,11 @@ jfloat rvmCallFloatClassMethodA(Env* env, Class* clazz, Method* method, jvalue*
 }
 
 jfloat rvmCallFloatClassMethodV(Env* env, Class* clazz, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0.0f;
-    return rvmCallFloatClassMethodA(env, clazz, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, NULL, method, FALSE, args);
+    if (!callInfo) return 0.0f;
+    rvmInitialize(env, method->clazz);
+    if (rvmExceptionOccurred(env)) return 0.0f;
+    return callFloatMethod(env, callInfo);
 }
 
 jfloat rvmCallFloatClassMethod(Env* env, Class* clazz, Method* method, ...) {
@@ -1340,9 +1490,11 @@ jdouble rvmCallDoubleClassMethodA(Env* env, Class* clazz, Method* method, jvalue
 }
 
 jdouble rvmCallDoubleClassMethodV(Env* env, Class* clazz, Method* method, va_list args) {
-    jvalue* jargs = va_list2jargs(env, method, args);
-    if (!jargs) return 0.0;
-    return rvmCallDoubleClassMethodA(env, clazz, method, jargs);
+    CallInfo* callInfo = INIT_CALL_INFO_V(env, NULL, method, FALSE, args);
+    if (!callInfo) return 0.0;
+    rvmInitialize(env, method->clazz);
+    if (rvmExceptionOccurred(env)) return 0.0;
+    return callDoubleMethod(env, callInfo);
 }
 
 jdouble rvmCallDoubleClassMethod(Env* env, Class* clazz, Method* method, ...) {
@@ -1362,23 +1514,29 @@ jboolean rvmUnregisterNative(Env* env, NativeMethod* method) {
 }
 
 void* rvmResolveNativeMethodImpl(Env* env, NativeMethod* method, const char* shortMangledName, const char* longMangledName, Object* classLoader, void** ptr) {
-    void* f = method->nativeImpl;
+    // Natives in statically linked code never get here. The compiler emits
+    // weak stubs with the JNI names of every native method which the linker
+    // replaces with the real implementations. Natives registered using
+    // RegisterNatives() are returned here without searching any libs.
+    void* f = rvmAtomicLoadPtr(&method->nativeImpl);
     if (!f) {
         DynamicLib* nativeLibs = NULL;
         if (!classLoader || rvmGetParentClassLoader(env, classLoader) == NULL) {
             // This is the bootstrap classloader
-            nativeLibs = bootNativeLibs;
+            nativeLibs = rvmAtomicLoadPtr((void**) &bootNativeLibs);
         } else if (rvmGetParentParentClassLoader(env, classLoader) == NULL && classLoader->clazz->classLoader == NULL) {
             // This is the system classloader
-            nativeLibs = mainNativeLibs;
+            nativeLibs = rvmAtomicLoadPtr((void**) &mainNativeLibs);
         } else {
             // Unknown classloader
             rvmThrowUnsatisfiedLinkError(env, "Unknown classloader");
             return NULL;
         }
 
-        obtainNativeLibsLock();
-
+        // The lists of libs are only appended to by rvmLoadNativeLibrary() and
+        // libs are never closed once added so they can be searched without
+        // holding nativeLibsLock. This keeps threads calling natives for the
+        // first time from queuing up behind each other's dlsym() calls.
         TRACEF("Searching for native method using short name: %s", shortMangledName);
         f = rvmFindDynamicLibSymbol(env, nativeLibs, shortMangledName, TRUE);
         if (f) {
@@ -1391,9 +1549,11 @@ void* rvmResolveNativeMethodImpl(Env* env, NativeMethod* method, const char* sho
             }
         }
 
-        method->nativeImpl = f;
-
-        releaseNativeLibsLock();
+        if (f && !rvmAtomicCompareAndSwapPtr(&method->nativeImpl, NULL, f)) {
+            // Another thread resolved the method or RegisterNatives() was
+            // called while we searched. Use whatever it stored.
+            f = rvmAtomicLoadPtr(&method->nativeImpl);
+        }
     }
 
     if (!f) {
@@ -1451,6 +1611,9 @@ jboolean rvmLoadNativeLibrary(Env* env, const char* path, Object* classLoader) {
         }
     }
 
+    // rvmResolveNativeMethodImpl() walks the list without the lock. Make
+    // sure lib has been fully written before it becomes reachable.
+    rvmAtomicSynchronize();
     rvmAddDynamicLib(env, lib, nativeLibs);
 
     releaseNativeLibsLock();
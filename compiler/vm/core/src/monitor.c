@@ -126,6 +126,20 @@ static inline int android_atomic_acquire_cas(LW_TYPE old_value, LW_TYPE new_valu
  *    [31 ---- 19] [18 ---- 3] [2 ---- 1] [0]
  *     lock count   thread id  hash state  0
  *
+ * Thread ids never use more than 15 bits. RoboVM uses the top bit of the
+ * thread id field to mark a thin lock as biased towards (reserved for)
+ * the thread in the remaining bits when biased locking has been enabled
+ * using -rvm:EnableBiasedLocking. The lock count of a biased lock is the
+ * number of times the lock is held by that thread. A count of 0 means that
+ * the lock is reserved but not held. Only the thread a lock is biased
+ * towards updates a biased lock word and it does so without atomic
+ * instructions. When another thread wants the lock it asks the owning
+ * thread to revoke the bias using a signal, see revokeBias(). Objects are
+ * never moved so the upper hash state bit is used to mark that a lock's
+ * bias has been revoked and that it must not be biased again. The lower
+ * hash state bit is set in a thin lock held by some thread when another
+ * thread is parked waiting for it to be released, see lockContended().
+ *
  * When set, the lock is in the "fat" state and its bits are formatted
  * as follows:
  *
@@ -183,6 +197,35 @@ static inline int android_atomic_acquire_cas(LW_TYPE old_value, LW_TYPE new_valu
 #define LW_LOCK_COUNT_SHIFT 19
 #define LW_LOCK_COUNT(x) (((x) >> LW_LOCK_COUNT_SHIFT) & LW_LOCK_COUNT_MASK)
 
+/*
+ * Bias field.  Set in thin locks reserved for the thread in the lower 15
+ * bits of the owner field.  The inline monitorenter and monitorexit in
+ * header.ll update locks biased towards the current thread like
+ * lockBiased() and unlockBiased() do and call into the VM for all other
+ * biased locks.
+ */
+#define LW_BIASED ((LW_TYPE) 0x8000 << LW_LOCK_OWNER_SHIFT)
+#define LW_IS_BIASED(x) (((x) & LW_BIASED) != 0)
+#define LW_BIAS_OWNER(x) (LW_LOCK_OWNER(x) & 0x7fff)
+
+/*
+ * Set when the bias of a lock has been revoked.  Never cleared.
+ */
+#define LW_BIAS_REVOKED ((LW_TYPE) 0x2 << LW_HASH_STATE_SHIFT)
+
+/*
+ * How long revokeBias() waits for the owner of a biased lock to revoke the
+ * bias before it gives up and tries again.
+ */
+#define BIAS_REVOCATION_TIMEOUT_MS 10
+
+/*
+ * Set in a thin lock owned by some thread when other threads are parked
+ * waiting for it to be released.  The owner must wake them when it
+ * releases or inflates the lock.  Cleared when the lock is released.
+ */
+#define LW_CONTENDED ((LW_TYPE) 0x1 << LW_HASH_STATE_SHIFT)
+
 /*
  * Returns TRUE if the lock has been fattened.
  */
@@ -203,31 +246,125 @@ static inline int android_atomic_acquire_cas(LW_TYPE old_value, LW_TYPE new_valu
  */
 
 static Monitor* threadSleepMonitor;
-static void freeMonitorCleanupHandler(Env* env, Object* object);
+
+/*
+ * Monitors are pooled.  Inflated monitors are linked into inUseMonitors.
+ * After each garbage collection deflateMonitors() moves the monitors of
+ * unreachable objects and the idle monitors of live objects, whose locks
+ * are made thin again, to freeMonitors.  rvmCreateMonitor() takes monitors
+ * from there before allocating new ones.
+ *
+ * Monitors are never freed.  A thread which read a fat lock word just
+ * before the lock was deflated still sees a valid Monitor.  It notices
+ * that the object no longer uses the monitor once it has registered as a
+ * contender, see lockFatMonitor().  Registered contenders keep a monitor
+ * from being deflated.  So do threads in waitMonitor() until they have
+ * reacquired the monitor.
+ */
+#define MONITOR_DEFLATED (-0x40000000)
+
+static pthread_mutex_t monitorsLock = PTHREAD_MUTEX_INITIALIZER;
+static Monitor* inUseMonitors = NULL;
+static Monitor* freeMonitors = NULL;
+
+/*
+ * Bits OR:ed into the lock word when an unowned thin lock which has never
+ * had its bias revoked is acquired.  Either 0 or LW_BIASED with a lock
+ * count of 1.  Also used by the inline monitorenter in header.ll.
+ */
+uint32_t biasedLockBits = 0;
+
+/*
+ * A thread which finds a thin lock held by another thread first spins for
+ * a while hoping that the owner releases it soon.  If it isn't released
+ * the thread sets LW_CONTENDED in the lock word and parks on the
+ * ContentionSlot the object hashes to until the owner releases or
+ * inflates the lock.  The thread which gets the thin lock after contention
+ * inflates it so that any remaining waiters block on the fat Monitor.
+ * This is the "tasuki lock" described in Onodera and Kawachiya's "A Study
+ * of Locking Objects with Bimodal Fields" (OOPSLA 1999).
+ *
+ * Each slot keeps the number of times to spin before parking.  It is
+ * doubled when spinning pays off and halved when the thread has to park,
+ * so it follows how long the locks hashing to the slot are usually held.
+ * Spinning is pointless on uniprocessors as the owner can't run while the
+ * thread spins.
+ */
+#define CONTENTION_SLOTS_BITS 6
+#define CONTENTION_SLOTS (1 << CONTENTION_SLOTS_BITS)
+#define MIN_SPINS 64
+#define MAX_SPINS (64 * 1024)
+
+typedef struct ContentionSlot {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t spins;
+} ContentionSlot;
+
+static ContentionSlot contentionSlots[CONTENTION_SLOTS];
+static uint32_t minSpins = 0;
+static uint32_t maxSpins = 0;
 
 jboolean rvmInitMonitors(Env* env) {
+    jint i;
+
     threadSleepMonitor = rvmCreateMonitor(env, NULL);
+    if (sysconf(_SC_NPROCESSORS_ONLN) > 1) {
+        minSpins = MIN_SPINS;
+        maxSpins = MAX_SPINS;
+    }
+    for (i = 0; i < CONTENTION_SLOTS; i++) {
+        pthread_mutex_init(&contentionSlots[i].lock, NULL);
+        pthread_cond_init(&contentionSlots[i].cond, NULL);
+        contentionSlots[i].spins = minSpins;
+    }
+#ifndef __SWITCH__
+    // Revoking a bias requires signals.
+    if (env->vm->options->enableBiasedLocking) {
+        biasedLockBits = LW_BIASED | (1 << LW_LOCK_COUNT_SHIFT);
+    }
+#endif
     return TRUE;
 }
 
 /*
- * Create and initialize a monitor.
+ * Create and initialize a monitor.  Monitors created for objects are
+ * taken from the pool if possible.
  */
 Monitor* rvmCreateMonitor(Env* env, Object* obj) {
-    Monitor* mon;
+    Monitor* mon = NULL;
 
-    mon = (Monitor*) rvmAllocateMemoryAtomicUncollectable(env, sizeof(Monitor));
-    if (mon == NULL) {
-        rvmAbort("Unable to allocate monitor");
+    if (obj) {
+        pthread_mutex_lock(&monitorsLock);
+        mon = freeMonitors;
+        if (mon) {
+            freeMonitors = mon->next;
+        }
+        pthread_mutex_unlock(&monitorsLock);
     }
-    if (((LW_TYPE)mon & 7) != 0) {
-        rvmAbort("Misaligned monitor: %p", mon);
+    if (mon) {
+        /*
+         * Contenders of the monitor's previous object which haven't yet
+         * noticed that it was deflated will decrement the count later.
+         */
+        __sync_fetch_and_sub(&mon->contenders, MONITOR_DEFLATED);
+    } else {
+        mon = (Monitor*) rvmAllocateMemoryAtomicUncollectable(env, sizeof(Monitor));
+        if (mon == NULL) {
+            rvmAbort("Unable to allocate monitor");
+        }
+        if (((LW_TYPE)mon & 7) != 0) {
+            rvmAbort("Misaligned monitor: %p", mon);
+        }
+        rvmInitMutex(&mon->lock);
     }
     mon->obj = obj;
-    rvmInitMutex(&mon->lock);
 
     if (obj) {
-        registerCleanupHandler(env, obj, freeMonitorCleanupHandler);
+        pthread_mutex_lock(&monitorsLock);
+        mon->next = inUseMonitors;
+        inUseMonitors = mon;
+        pthread_mutex_unlock(&monitorsLock);
     }
 
     return mon;
@@ -243,6 +380,17 @@ Object* rvmGetMonitorObject(Monitor* mon) {
         return mon->obj;
 }
 
+/*
+ * Returns the thread id of the thread holding the given thin lock or 0 if
+ * the lock isn't held.
+ */
+static inline uint32_t thinLockOwner(LW_TYPE thin) {
+    if (LW_IS_BIASED(thin)) {
+        return LW_LOCK_COUNT(thin) > 0 ? LW_BIAS_OWNER(thin) : 0;
+    }
+    return LW_LOCK_OWNER(thin);
+}
+
 /*
  * Returns the thread id of the thread owning the given lock.
  */
@@ -257,7 +405,7 @@ static uint32_t lockOwner(Object* obj) {
      */
     lock = obj->lock;
     if (LW_SHAPE(lock) == LW_SHAPE_THIN) {
-        return LW_LOCK_OWNER(lock);
+        return thinLockOwner(lock);
     } else {
         owner = LW_MONITOR(lock)->owner;
         return owner ? owner->threadId : 0;
@@ -290,36 +438,6 @@ jboolean rvmHoldsLock(Env* env, RvmThread* thread, Object* obj) {
     }
 }
 
-/*
- * Free the monitor associated with an object and make the object's lock
- * thin again.  This is called during garbage collection.
- */
-static void freeMonitor(Monitor *mon) {
-    assert(mon != NULL);
-    assert(mon->obj != NULL);
-    assert(LW_SHAPE(mon->obj->lock) == LW_SHAPE_FAT);
-
-    /* This lock is associated with an object
-     * that's being swept.  The only possible way
-     * anyone could be holding this lock would be
-     * if some JNI code locked but didn't unlock
-     * the object, in which case we've got some bad
-     * native code somewhere.
-     */
-    assert(rvmTryLockMutex(&mon->lock) == 0);
-    assert(rvmUnlockMutex(&mon->lock) == 0);
-    rvmDestroyMutex(&mon->lock);
-}
-
-static void freeMonitorCleanupHandler(Env* env, Object* object) {
-    if (LW_SHAPE(object->lock) == LW_SHAPE_FAT) {
-        Monitor* mon = LW_MONITOR(object->lock);
-        freeMonitor(mon);
-        object->lock = 0;
-        rvmFreeMemoryUncollectable(env, mon);
-    }
-}
-
 /*
  * Lock a monitor.
  */
@@ -339,6 +457,34 @@ static void lockMonitor(Env* env, RvmThread* self, Monitor* mon) {
     assert(mon->lockCount == 0);
 }
 
+/*
+ * Locks the fat monitor read from an object's lock word.  Returns FALSE if
+ * the lock has been deflated since the lock word was read.
+ */
+static jboolean lockFatMonitor(Env* env, RvmThread* self, Object* obj, Monitor* mon) {
+    LW_TYPE lock;
+    jboolean locked = FALSE;
+
+    if (mon->owner == self) {
+        mon->lockCount++;
+        return TRUE;
+    }
+    /*
+     * Register as a contender so the monitor isn't deflated while we wait
+     * for it.  If it has been deflated already the count is negative or,
+     * if it has been reused, the lock word no longer points to it.
+     */
+    if (__sync_fetch_and_add(&mon->contenders, 1) >= 0) {
+        lock = *(volatile LW_TYPE *)&obj->lock;
+        if (LW_SHAPE(lock) == LW_SHAPE_FAT && LW_MONITOR(lock) == mon) {
+            lockMonitor(env, self, mon);
+            locked = TRUE;
+        }
+    }
+    __sync_fetch_and_sub(&mon->contenders, 1);
+    return locked;
+}
+
 /*
  * Unlock a monitor.
  *
@@ -521,6 +667,15 @@ static void waitMonitor(Env* env, RvmThread* self, Monitor* mon, jlong msec, jin
      * not order sensitive as we hold the pthread mutex.
      */
     waitSetAppend(env, mon, self);
+    /*
+     * A notifying thread removes us from the wait set before we have
+     * reacquired the monitor.  Stay registered as a contender until then
+     * so that the monitor isn't deflated and reused for another object in
+     * between.  We hold the mutex so the monitor can't be deflated now.
+     */
+    jint contenders = __sync_fetch_and_add(&mon->contenders, 1);
+    assert(contenders >= 0);
+    (void) contenders;
     int prevLockCount = mon->lockCount;
     mon->lockCount = 0;
     mon->owner = NULL;
@@ -607,6 +762,7 @@ done:
     mon->owner = self;
     mon->lockCount = prevLockCount;
     waitSetRemove(env, mon, self);
+    __sync_fetch_and_sub(&mon->contenders, 1);
 
     /* set self->status back to THREAD_RUNNING, and self-suspend if needed */
     rvmChangeThreadStatus(env, self, THREAD_RUNNING);
@@ -688,13 +844,291 @@ static void notifyAllMonitor(Env* env, RvmThread* self, Monitor* mon) {
     }
 }
 
+/*
+ * Marks the calling thread as being in the middle of reading and updating
+ * a lock word biased towards it.  The bias revocation signal handler
+ * leaves lock words alone while this is set.
+ */
+static inline void enterBiasedLockOp(RvmThread* self) {
+    self->inBiasedLockOp = TRUE;
+}
+
+static inline void leaveBiasedLockOp(RvmThread* self) {
+    self->inBiasedLockOp = FALSE;
+    if (self->biasRevocationRequest) {
+        /*
+         * The revocation signal arrived while we were updating the lock
+         * word.  Handle it now.
+         */
+        revokeRequestedBias(self);
+    }
+}
+
+/*
+ * Returns the unbiased equivalent of a biased thin lock word.
+ */
+static inline LW_TYPE unbiasedLockWord(LW_TYPE thin) {
+    LW_TYPE count = LW_LOCK_COUNT(thin);
+    LW_TYPE unbiased = (thin & (LW_HASH_STATE_MASK << LW_HASH_STATE_SHIFT)) | LW_BIAS_REVOKED;
+    if (count > 0) {
+        unbiased |= (LW_TYPE) LW_BIAS_OWNER(thin) << LW_LOCK_OWNER_SHIFT;
+        unbiased |= (count - 1) << LW_LOCK_COUNT_SHIFT;
+    }
+    return unbiased;
+}
+
+/*
+ * Revokes the calling thread's bias on the given object's lock if it is
+ * still biased towards the calling thread.  The lock stays held by the
+ * calling thread if it was held.
+ */
+static void revokeOwnBias(RvmThread* self, Object* obj) {
+    volatile LW_TYPE *thinp = &obj->lock;
+    LW_TYPE thin = *thinp;
+    if (LW_SHAPE(thin) == LW_SHAPE_THIN && LW_IS_BIASED(thin)
+            && LW_BIAS_OWNER(thin) == self->threadId) {
+        android_atomic_release_store(unbiasedLockWord(thin), (LW_TYPE*)thinp);
+    }
+}
+
+/*
+ * Handles a bias revocation request posted by revokeBias() on another
+ * thread.  Called by the bias revocation signal handler and by
+ * leaveBiasedLockOp() if the signal arrived in the middle of a biased
+ * lock operation.  Whoever takes the request from biasRevocationRequest
+ * acknowledges it, so every request is acknowledged exactly once no matter
+ * how many signals are delivered.  Requests taken back by revokeBias()
+ * are never acknowledged.
+ */
+void revokeRequestedBias(RvmThread* self) {
+    Object* obj;
+
+    if (self->inBiasedLockOp) {
+        /*
+         * The lock word may be half way through an update.  Let
+         * leaveBiasedLockOp() handle the request.
+         */
+        return;
+    }
+    obj = self->biasRevocationRequest;
+    if (obj == NULL || !rvmAtomicCompareAndSwapPtr((void**) &self->biasRevocationRequest, obj, NULL)) {
+        /*
+         * Already handled.
+         */
+        return;
+    }
+    revokeOwnBias(self, obj);
+    ackBiasRevocation();
+}
+
+/*
+ * Revokes the bias of a lock biased towards another thread.  The owning
+ * thread updates the lock word without atomic instructions so it has to
+ * be interrupted and do the revocation itself.  The owner may not be able
+ * to handle the signal, e.g. if it has the signal blocked.  If it doesn't
+ * acknowledge the request within BIAS_REVOCATION_TIMEOUT_MS the request is
+ * taken back and this returns with the lock still biased.  The caller
+ * retries.
+ */
+static void revokeBias(Env* env, RvmThread* self, Object* obj) {
+    volatile LW_TYPE *thinp = &obj->lock;
+    RvmThread* owner;
+    LW_TYPE thin;
+    jboolean timedOut = FALSE;
+
+    /*
+     * Holding the thread list lock serializes revocations and keeps the
+     * owning thread from exiting or its thread id from being reused.
+     */
+    rvmLockThreadsList();
+    thin = *thinp;
+    if (LW_SHAPE(thin) == LW_SHAPE_THIN && LW_IS_BIASED(thin)) {
+        TRACEF("(%d) revoking bias of lock %p towards %d",
+             self->threadId, &obj->lock, LW_BIAS_OWNER(thin));
+        owner = rvmGetThreadByThreadId(env, LW_BIAS_OWNER(thin));
+        if (owner != NULL) {
+            owner->biasRevocationRequest = obj;
+            if (!signalBiasRevocation(env, owner)
+                    || !waitBiasRevocation(BIAS_REVOCATION_TIMEOUT_MS)) {
+                if (rvmAtomicCompareAndSwapPtr((void**) &owner->biasRevocationRequest, obj, NULL)) {
+                    /*
+                     * The owner never took the request so it won't
+                     * acknowledge it.
+                     */
+                    timedOut = TRUE;
+                } else {
+                    /*
+                     * The owner took the request just now.  It
+                     * acknowledges it as soon as it has revoked the bias.
+                     */
+                    waitBiasRevocation(-1);
+                }
+            }
+        } else {
+            /*
+             * The owning thread has exited.  Nothing else updates a
+             * biased lock word.
+             */
+            android_atomic_cas(thin, unbiasedLockWord(thin), (LW_TYPE*)thinp);
+        }
+    }
+    rvmUnlockThreadsList();
+
+    if (timedOut) {
+        /*
+         * Let other threads use the thread list before we try again.
+         */
+        struct timespec ts = {0, BIAS_REVOCATION_TIMEOUT_MS * 1000000L};
+        nanosleep(&ts, NULL);
+    }
+}
+
+/*
+ * Acquires a lock biased towards the calling thread.  Returns FALSE if the
+ * lock is no longer biased towards the calling thread.  Also returns FALSE
+ * and revokes the bias if the lock count field would overflow so that the
+ * thin lock code gets to deal with the deep recursion.
+ */
+static jboolean lockBiased(RvmThread* self, Object* obj) {
+    volatile LW_TYPE *thinp = &obj->lock;
+    jboolean locked = FALSE;
+    LW_TYPE thin;
+
+    enterBiasedLockOp(self);
+    thin = *thinp;
+    if (LW_SHAPE(thin) == LW_SHAPE_THIN && LW_IS_BIASED(thin)
+            && LW_BIAS_OWNER(thin) == self->threadId) {
+        if (LW_LOCK_COUNT(thin) < LW_LOCK_COUNT_MASK) {
+            *thinp = thin + (1 << LW_LOCK_COUNT_SHIFT);
+            locked = TRUE;
+        } else {
+            revokeOwnBias(self, obj);
+        }
+    }
+    leaveBiasedLockOp(self);
+    return locked;
+}
+
+/*
+ * Releases a lock biased towards and held by the calling thread.  Returns
+ * FALSE if the lock is no longer biased towards the calling thread or if
+ * it isn't held.
+ */
+static jboolean unlockBiased(RvmThread* self, Object* obj) {
+    volatile LW_TYPE *thinp = &obj->lock;
+    jboolean unlocked = FALSE;
+    LW_TYPE thin;
+
+    enterBiasedLockOp(self);
+    thin = *thinp;
+    if (LW_SHAPE(thin) == LW_SHAPE_THIN && LW_IS_BIASED(thin)
+            && LW_BIAS_OWNER(thin) == self->threadId
+            && LW_LOCK_COUNT(thin) > 0) {
+        *thinp = thin - (1 << LW_LOCK_COUNT_SHIFT);
+        unlocked = TRUE;
+    }
+    leaveBiasedLockOp(self);
+    return unlocked;
+}
+
+static inline void cpuRelax(void) {
+#if defined(RVM_X86) || defined(RVM_X86_64)
+    __asm__ __volatile__ ("pause" : : : "memory");
+#elif defined(RVM_THUMBV7) || defined(RVM_ARM64)
+    __asm__ __volatile__ ("yield" : : : "memory");
+#else
+    __asm__ __volatile__ ("" : : : "memory");
+#endif
+}
+
+static inline ContentionSlot* getContentionSlot(Object* obj) {
+    uint32_t h = (uint32_t) ((uintptr_t) obj >> 3) * 2654435761u;
+    return &contentionSlots[h >> (32 - CONTENTION_SLOTS_BITS)];
+}
+
+/*
+ * Wakes the threads parked on the object's ContentionSlot.  Called by the
+ * owner of a thin lock after it has released or inflated a lock which had
+ * LW_CONTENDED set.
+ */
+static void wakeContendedThreads(Object* obj) {
+    ContentionSlot* slot = getContentionSlot(obj);
+    pthread_mutex_lock(&slot->lock);
+    pthread_cond_broadcast(&slot->cond);
+    pthread_mutex_unlock(&slot->lock);
+}
+
+/*
+ * Acquires a thin lock owned by another thread.  Returns TRUE if the thin
+ * lock was acquired and FALSE if it was inflated or biased in the
+ * meantime.
+ */
+static jboolean lockContended(Env* env, RvmThread* self, Object* obj) {
+    volatile LW_TYPE *thinp = &obj->lock;
+    ContentionSlot* slot = getContentionSlot(obj);
+    LW_TYPE threadBits = (LW_TYPE) self->threadId << LW_LOCK_OWNER_SHIFT;
+    LW_TYPE thin;
+    uint32_t spins;
+    uint32_t i;
+    jint oldStatus;
+    jboolean acquired;
+
+    /*
+     * Spin while the lock is held.  Unowned thin locks never have
+     * LW_CONTENDED set.
+     */
+    spins = slot->spins;
+    for (i = 0; i < spins; i++) {
+        cpuRelax();
+        thin = *thinp;
+        if (LW_SHAPE(thin) != LW_SHAPE_THIN || LW_IS_BIASED(thin)) {
+            return FALSE;
+        }
+        if (LW_LOCK_OWNER(thin) == 0
+                && android_atomic_acquire_cas(thin, thin | threadBits, (LW_TYPE*)thinp) == 0) {
+            slot->spins = spins < maxSpins / 2 ? spins * 2 : maxSpins;
+            return TRUE;
+        }
+    }
+    slot->spins = spins > minSpins * 2 ? spins / 2 : minSpins;
+
+    /*
+     * Park until the owner releases or inflates the lock.  LW_CONTENDED
+     * is set and the lock word checked with the slot's lock held so the
+     * owner can't wake the slot between the check and the wait.
+     */
+    TRACEF("(%d) park on lock %p: %#x", self->threadId, &obj->lock, *thinp);
+    oldStatus = rvmChangeThreadStatus(env, self, THREAD_MONITOR);
+    pthread_mutex_lock(&slot->lock);
+    for (;;) {
+        thin = *thinp;
+        if (LW_SHAPE(thin) != LW_SHAPE_THIN || LW_IS_BIASED(thin)) {
+            acquired = FALSE;
+            break;
+        }
+        if (LW_LOCK_OWNER(thin) == 0) {
+            if (android_atomic_acquire_cas(thin, thin | threadBits, (LW_TYPE*)thinp) == 0) {
+                acquired = TRUE;
+                break;
+            }
+        } else if ((thin & LW_CONTENDED)
+                || android_atomic_cas(thin, thin | LW_CONTENDED, (LW_TYPE*)thinp) == 0) {
+            pthread_cond_wait(&slot->cond, &slot->lock);
+        }
+    }
+    pthread_mutex_unlock(&slot->lock);
+    rvmChangeThreadStatus(env, self, oldStatus);
+    return acquired;
+}
+
 /*
  * Changes the shape of a monitor from thin to fat, preserving the
  * internal lock state.  The calling thread must own the lock.
  */
 static void inflateMonitor(Env* env, RvmThread *self, Object* obj) {
+    volatile LW_TYPE *thinp = &obj->lock;
     Monitor *mon;
-    LW_TYPE thin;
+    LW_TYPE thin, fat;
 
     assert(self != NULL);
     assert(obj != NULL);
@@ -703,13 +1137,77 @@ static void inflateMonitor(Env* env, RvmThread *self, Object* obj) {
     /* Allocate and acquire a new monitor. */
     mon = rvmCreateMonitor(env, obj);
     lockMonitor(env, self, mon);
-    /* Propagate the lock state. */
-    thin = obj->lock;
-    mon->lockCount = LW_LOCK_COUNT(thin);
-    thin &= LW_HASH_STATE_MASK << LW_HASH_STATE_SHIFT;
-    thin |= (LW_TYPE)mon | LW_SHAPE_FAT;
-    /* Publish the updated lock word. */
-    android_atomic_release_store(thin, (LW_TYPE *)&obj->lock);
+    /* Propagate the lock state and publish the updated lock word.
+     * Contending threads may set LW_CONTENDED concurrently so a CAS
+     * is required. */
+    do {
+        thin = *thinp;
+        mon->lockCount = LW_LOCK_COUNT(thin);
+        fat = (thin & LW_BIAS_REVOKED) | (LW_TYPE)mon | LW_SHAPE_FAT;
+    } while (android_atomic_cas(thin, fat, (LW_TYPE *)thinp) != 0);
+    /* Wake the threads parked on the thin lock so they can block on
+     * the monitor instead. */
+    if (thin & LW_CONTENDED) {
+        wakeContendedThreads(obj);
+    }
+}
+
+/*
+ * Deflates a monitor unless it is owned, has threads waiting on it or
+ * threads about to lock it.  The lock word of the monitor's object is
+ * made thin again if the object is still live.
+ */
+static jboolean deflateMonitor(Monitor* mon, jboolean live) {
+    volatile LW_TYPE *lockp;
+    jboolean deflated = FALSE;
+
+    if (pthread_mutex_trylock(&mon->lock) != 0) {
+        return FALSE;
+    }
+    /*
+     * The mutex is recursive so the calling thread may be the owner.
+     */
+    if (mon->owner == NULL && mon->waitSet == NULL
+            && __sync_bool_compare_and_swap(&mon->contenders, 0, MONITOR_DEFLATED)) {
+        if (live) {
+            /*
+             * Nothing else updates the lock word of an unowned fat lock.
+             */
+            lockp = &mon->obj->lock;
+            android_atomic_release_store(*lockp & LW_BIAS_REVOKED, (LW_TYPE *)lockp);
+        }
+        mon->obj = NULL;
+        deflated = TRUE;
+    }
+    pthread_mutex_unlock(&mon->lock);
+    return deflated;
+}
+
+/*
+ * Returns the monitors of objects found unreachable by the last garbage
+ * collection to the pool and deflates idle monitors of live objects.
+ * Called by the GC with the allocation lock held at the end of each
+ * collection so it must neither block nor allocate.  A monitor which can't
+ * be deflated now is retried after the next collection.
+ */
+void deflateMonitors(void) {
+    Monitor** link;
+    Monitor* mon;
+
+    if (pthread_mutex_trylock(&monitorsLock) != 0) {
+        return;
+    }
+    link = &inUseMonitors;
+    while ((mon = *link) != NULL) {
+        if (deflateMonitor(mon, gcIsLive(mon->obj))) {
+            *link = mon->next;
+            mon->next = freeMonitors;
+            freeMonitors = mon;
+        } else {
+            link = &mon->next;
+        }
+    }
+    pthread_mutex_unlock(&monitorsLock);
 }
 
 /*
@@ -721,11 +1219,6 @@ static void inflateMonitor(Env* env, RvmThread *self, Object* obj) {
 void rvmLockObject(Env* env, Object* obj) {
     RvmThread* self = env->currentThread;
     volatile LW_TYPE *thinp;
-    jint oldStatus;
-    struct timespec tm;
-    long sleepDelayNs;
-    long minSleepDelayNs = 1000000;  /* 1 millisecond */
-    long maxSleepDelayNs = 1000000000;  /* 1 second */
     LW_TYPE thin, newThin;
     int32_t threadId;
 
@@ -740,13 +1233,27 @@ retry:
          * The lock is a thin lock.  The owner field is used to
          * determine the acquire method, ordered by cost.
          */
-        if (LW_LOCK_OWNER(thin) == threadId) {
+        if (LW_IS_BIASED(thin)) {
+            /*
+             * The lock is biased.  If it's biased towards the calling
+             * thread it can be acquired without atomic instructions.
+             * Otherwise the bias must be revoked first.
+             */
+            if (LW_BIAS_OWNER(thin) == threadId) {
+                if (lockBiased(self, obj)) {
+                    return;
+                }
+            } else {
+                revokeBias(env, self, obj);
+            }
+            goto retry;
+        } else if (LW_LOCK_OWNER(thin) == threadId) {
             /*
              * The calling thread owns the lock.  Increment the
              * value of the recursion count field.
              */
-            obj->lock += 1 << LW_LOCK_COUNT_SHIFT;
-            if (LW_LOCK_COUNT(obj->lock) == LW_LOCK_COUNT_MASK) {
+            newThin = __sync_add_and_fetch(thinp, (LW_TYPE) 1 << LW_LOCK_COUNT_SHIFT);
+            if (LW_LOCK_COUNT(newThin) == LW_LOCK_COUNT_MASK) {
                 /*
                  * The reacquisition limit has been reached.  Inflate
                  * the lock so the next acquire will not overflow the
@@ -760,8 +1267,14 @@ retry:
              * calling thread into the owner field.  This is the
              * common case.  In performance critical code the JIT
              * will have tried this before calling out to the VM.
+             * The lock is biased towards the calling thread unless
+             * biased locking is disabled or the lock has had its bias
+             * revoked before.
              */
             newThin = thin | (threadId << LW_LOCK_OWNER_SHIFT);
+            if (!(thin & LW_BIAS_REVOKED)) {
+                newThin |= biasedLockBits;
+            }
             if (android_atomic_acquire_cas(thin, newThin,
                     (LW_TYPE*)thinp) != 0) {
                 /*
@@ -770,83 +1283,23 @@ retry:
                 goto retry;
             }
         } else {
-            TRACEF("(%d) spin on lock %p: %#x (%#x) %#x",
-                 threadId, &obj->lock, 0, *thinp, thin);
-            /*
-             * The lock is owned by another thread.  Notify the VM
-             * that we are about to wait.
-             */
-            oldStatus = rvmChangeThreadStatus(env, self, THREAD_MONITOR);
             /*
-             * Spin until the thin lock is released or inflated.
+             * The lock is owned by another thread.  Spin or park until
+             * it is released.
              */
-            sleepDelayNs = 0;
-            for (;;) {
-                thin = *thinp;
+            if (!lockContended(env, self, obj)) {
                 /*
-                 * Check the shape of the lock word.  Another thread
-                 * may have inflated the lock while we were waiting.
+                 * The thin lock was inflated or biased by another
+                 * thread.  Try again.
                  */
-                if (LW_SHAPE(thin) == LW_SHAPE_THIN) {
-                    if (LW_LOCK_OWNER(thin) == 0) {
-                        /*
-                         * The lock has been released.  Install the
-                         * thread id of the calling thread into the
-                         * owner field.
-                         */
-                        newThin = thin | (threadId << LW_LOCK_OWNER_SHIFT);
-                        if (android_atomic_acquire_cas(thin, newThin,
-                                (LW_TYPE *)thinp) == 0) {
-                            /*
-                             * The acquire succeed.  Break out of the
-                             * loop and proceed to inflate the lock.
-                             */
-                            break;
-                        }
-                    } else {
-                        /*
-                         * The lock has not been released.  Yield so
-                         * the owning thread can run.
-                         */
-                        if (sleepDelayNs == 0) {
-                            sched_yield();
-                            sleepDelayNs = minSleepDelayNs;
-                        } else {
-                            tm.tv_sec = 0;
-                            tm.tv_nsec = sleepDelayNs;
-                            nanosleep(&tm, NULL);
-                            /*
-                             * Prepare the next delay value.  Wrap to
-                             * avoid once a second polls for eternity.
-                             */
-                            if (sleepDelayNs < maxSleepDelayNs / 2) {
-                                sleepDelayNs *= 2;
-                            } else {
-                                sleepDelayNs = minSleepDelayNs;
-                            }
-                        }
-                    }
-                } else {
-                    /*
-                     * The thin lock was inflated by another thread.
-                     * Let the VM know we are no longer waiting and
-                     * try again.
-                     */
-                    TRACEF("(%d) lock %p surprise-fattened",
-                             threadId, &obj->lock);
-                    rvmChangeThreadStatus(env, self, oldStatus);
-                    goto retry;
-                }
+                TRACEF("(%d) lock %p surprise-fattened",
+                         threadId, &obj->lock);
+                goto retry;
             }
-            TRACEF("(%d) spin on lock done %p: %#x (%#x) %#x",
-                 threadId, &obj->lock, 0, *thinp, thin);
-            /*
-             * We have acquired the thin lock.  Let the VM know that
-             * we are no longer waiting.
-             */
-            rvmChangeThreadStatus(env, self, oldStatus);
+            TRACEF("(%d) contended lock %p acquired", threadId, &obj->lock);
             /*
-             * Fatten the lock.
+             * Fatten the lock so that any other threads waiting for it
+             * block on the monitor.
              */
             inflateMonitor(env, self, obj);
             TRACEF("(%d) lock %p fattened", threadId, &obj->lock);
@@ -855,8 +1308,13 @@ retry:
         /*
          * The lock is a fat lock.
          */
-        assert(LW_MONITOR(obj->lock) != NULL);
-        lockMonitor(env, self, LW_MONITOR(obj->lock));
+        assert(LW_MONITOR(thin) != NULL);
+        if (!lockFatMonitor(env, self, obj, LW_MONITOR(thin))) {
+            /*
+             * The lock was deflated.  Try again.
+             */
+            goto retry;
+        }
     }
 }
 
@@ -877,6 +1335,17 @@ jboolean rvmUnlockObject(Env* env, Object* obj) {
      * examining its state.
      */
     thin = *(volatile LW_TYPE *)&obj->lock;
+    if (LW_SHAPE(thin) == LW_SHAPE_THIN && LW_IS_BIASED(thin)
+            && LW_BIAS_OWNER(thin) == self->threadId) {
+        if (unlockBiased(self, obj)) {
+            return TRUE;
+        }
+        /*
+         * The bias has been revoked or the lock isn't held.  Fall
+         * through to the thin lock code.
+         */
+        thin = *(volatile LW_TYPE *)&obj->lock;
+    }
     if (LW_SHAPE(thin) == LW_SHAPE_THIN) {
         /*
          * The lock is thin.  We must ensure that the lock is owned
@@ -884,23 +1353,29 @@ jboolean rvmUnlockObject(Env* env, Object* obj) {
          */
         if (LW_LOCK_OWNER(thin) == self->threadId) {
             /*
-             * We are the lock owner.  It is safe to update the lock
-             * without CAS as lock ownership guards the lock itself.
+             * We are the lock owner.  Other threads may still set
+             * LW_CONTENDED in the lock word so it has to be updated
+             * atomically.
              */
             if (LW_LOCK_COUNT(thin) == 0) {
                 /*
                  * The lock was not recursively acquired, the common
-                 * case.  Unlock by clearing all bits except for the
-                 * hash state.
+                 * case.  Unlock by clearing all bits except for
+                 * LW_BIAS_REVOKED and wake any parked threads.
                  */
-                thin &= (LW_HASH_STATE_MASK << LW_HASH_STATE_SHIFT);
-                android_atomic_release_store(thin, (LW_TYPE*)&obj->lock);
+                while (android_atomic_cas(thin, thin & LW_BIAS_REVOKED,
+                        (LW_TYPE*)&obj->lock) != 0) {
+                    thin = *(volatile LW_TYPE *)&obj->lock;
+                }
+                if (thin & LW_CONTENDED) {
+                    wakeContendedThreads(obj);
+                }
             } else {
                 /*
                  * The object was recursively acquired.  Decrement the
                  * lock recursion count field.
                  */
-                obj->lock -= 1 << LW_LOCK_COUNT_SHIFT;
+                __sync_sub_and_fetch(&obj->lock, (LW_TYPE) 1 << LW_LOCK_COUNT_SHIFT);
             }
         } else {
             /*
@@ -939,12 +1414,20 @@ void rvmObjectWait(Env* env, Object* obj, jlong msec, jint nsec, jboolean interr
     if (LW_SHAPE(thin) == LW_SHAPE_THIN) {
         /* Make sure that 'self' holds the lock.
          */
-        if (LW_LOCK_OWNER(thin) != self->threadId) {
+        if (thinLockOwner(thin) != self->threadId) {
             rvmThrowIllegalMonitorStateException(env, 
                 "object not locked by thread before wait()");
             return;
         }
 
+        /* Only unbiased thin locks can be inflated.
+         */
+        if (LW_IS_BIASED(thin)) {
+            enterBiasedLockOp(self);
+            revokeOwnBias(self, obj);
+            leaveBiasedLockOp(self);
+        }
+
         /* This thread holds the lock.  We need to fatten the lock
          * so 'self' can block on it.  Don't update the object lock
          * field yet, because 'self' needs to acquire the lock before
@@ -970,7 +1453,7 @@ void rvmObjectNotify(Env* env, Object* obj) {
     if (LW_SHAPE(thin) == LW_SHAPE_THIN) {
         /* Make sure that 'self' holds the lock.
          */
-        if (LW_LOCK_OWNER(thin) != self->threadId) {
+        if (thinLockOwner(thin) != self->threadId) {
             rvmThrowIllegalMonitorStateException(env, 
                 "object not locked by thread before notify()");
             return;
@@ -998,7 +1481,7 @@ void rvmObjectNotifyAll(Env* env, Object* obj) {
     if (LW_SHAPE(thin) == LW_SHAPE_THIN) {
         /* Make sure that 'self' holds the lock.
          */
-        if (LW_LOCK_OWNER(thin) != self->threadId) {
+        if (thinLockOwner(thin) != self->threadId) {
             rvmThrowIllegalMonitorStateException(env, 
                 "object not locked by thread before notifyAll()");
             return;
@@ -36,6 +36,8 @@ extern void gcRegisterCurrentThread();
 extern void gcUnregisterCurrentThread();
 extern void gcAddRoot(void* ptr);
 extern void gcAddRoots(void* start, void* end);
+extern jboolean gcIsHeapPointer(void* ptr);
+extern jboolean gcIsLive(void* ptr);
 extern uint32_t gcNewDirectBitmapKind(size_t bitmap);
 extern void* gcAllocate(size_t size);
 extern void* gcAllocateUncollectable(size_t size);
@@ -43,6 +45,67 @@ extern void gcFree(void* ptr);
 extern void* allocateMemoryOfKind(Env* env, size_t size, uint32_t kind);
 extern void registerCleanupHandler(Env* env, Object* object, CleanupHandler handler);
 
+/* memberindex.c */
+extern Method* lookupMethod(Env* env, Class* clazz, Method* methods, const char* name, const char* desc);
+extern Field* lookupField(Env* env, Class* clazz, Field* fields, const char* name, const char* desc);
+
+/* reftable.c */
+#define GLOBAL_REF_CACHE_SIZE 8 // Must be a power of 2
+
+typedef struct GlobalRefCache GlobalRefCache;
+
+extern jboolean initGlobalRefs(void);
+extern void freeGlobalRefCache(Env* env, RvmThread* thread);
+
+/* utf8.c */
+extern jint getUnicodeLengthOfUtf8(const char* utf8);
+extern jint getUtf8LengthOfUnicode(const jchar* unicode, jint unicodeLength);
+extern void utf8ToUnicode(jchar* unicode, const char* utf8);
+extern void unicodeToUtf8(char* utf8, const jchar* unicode, jint unicodeLength);
+extern void latin1ToUnicode(jchar* unicode, const char* latin1, jint length);
+
+/* alloccache.c */
+#define ALLOC_CACHE_GRANULE_BYTES (2 * sizeof(void*)) // Must match GRANULE_BYTES in the GC
+#define ALLOC_CACHE_MAX_SIZE 128 // Objects larger than this are never allocated from the cache
+#define ALLOC_CACHE_SIZE_CLASSES (ALLOC_CACHE_MAX_SIZE / ALLOC_CACHE_GRANULE_BYTES)
+
+typedef struct AllocCache {
+    jint extraBytes;
+    void** top[ALLOC_CACHE_SIZE_CLASSES];  // Top of the stack of free chunks for each size class
+    void** base[ALLOC_CACHE_SIZE_CLASSES]; // Bottom of the stack of free chunks for each size class
+    void* slots[0];
+} AllocCache;
+
+extern AllocCache* gcNewAllocCache(void);
+extern void gcFreeAllocCache(AllocCache* cache);
+extern void** gcRefillAllocCache(AllocCache* cache, jint index);
+
+/*
+ * Allocates a cleared chunk of GC memory for an instance of clazz from
+ * the specified thread local cache. The first word of the returned memory
+ * is set to clazz. Returns NULL if the size is too big for the cache or
+ * if the cache couldn't be refilled. The caller must fall back to
+ * GC_gcj_malloc() in that case.
+ */
+static inline void* gcAllocateObjectFromCache(AllocCache* cache, size_t size, Class* clazz) {
+    size_t index = (size + cache->extraBytes - 1) / ALLOC_CACHE_GRANULE_BYTES;
+    if (index >= ALLOC_CACHE_SIZE_CLASSES) {
+        return NULL;
+    }
+    void** top = cache->top[index];
+    if (top == cache->base[index]) {
+        top = gcRefillAllocCache(cache, index);
+        if (!top) {
+            return NULL;
+        }
+    }
+    void* m = *--top;
+    *top = NULL;
+    cache->top[index] = top;
+    *((Class**) m) = clazz;
+    return m;
+}
+
 /* unwind.c */
 typedef struct Frame {
     struct Frame* prev;
@@ -67,9 +130,18 @@ extern CallStack* captureCallStackFromFrame(Env* env, Frame* fp);
 
 /* signal.c */
 extern void dumpThreadStackTrace(Env* env, RvmThread* thread, CallStack* callStack);
+extern jboolean signalBiasRevocation(Env* env, RvmThread* thread);
+extern jboolean waitBiasRevocation(jint timeoutMillis);
+extern void ackBiasRevocation(void);
+
+/* monitor.c */
+extern void revokeRequestedBias(RvmThread* self);
+extern void deflateMonitors(void);
 
 /* class.c */
 extern uint32_t nextClassId();
+extern uint32_t interfaceTableSize(uint32_t interfaceCount);
+extern void initInterfaceTable(TypeInfo* typeInfo);
 extern ProxyMethod* addProxyMethod(Env* env, Class* clazz, Method* proxiedMethod, jint access, void* impl);
 
 /* call0-<os>-<arch>.s and proxy0-<os>-<arch>.s */
@@ -610,5 +682,29 @@ static inline void proxy0ReturnDouble(CallInfo* ci, jdouble d) {
 #error Unsupported arch
 #endif
 
+/* callplan.c */
+typedef struct CallPlan {
+    // Argument counts to pass to CALL0_ALLOCATE_CALL_INFO(). ptrArgsCount
+    // includes the Env* and the receiver of instance methods.
+    jint ptrArgsCount;
+    jint intArgsCount;
+    jint longArgsCount;
+    jint floatArgsCount;
+    jint doubleArgsCount;
+    // The invoker stub emitted by the compiler for the shape of the method
+    // or NULL if there is none. See rvmCallMethodUsingInvoker().
+    void* invoker;
+    jint paramsCount;
+    // The first character of the return type ('[' is stored as 'L').
+    char returnType;
+    // The first character of the type of each parameter ('[' is stored as
+    // 'L') followed by a NUL.
+    char types[0];
+} CallPlan;
+
+extern CallPlan* getCallPlan(Env* env, Method* method);
+extern void addCallPlanArgs(CallInfo* callInfo, CallPlan* plan, jvalue* args);
+extern void addCallPlanArgsV(CallInfo* callInfo, CallPlan* plan, va_list args);
+
 #endif
 
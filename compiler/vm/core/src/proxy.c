@@ -14,38 +14,89 @@
  * limitations under the License.
  */
 #include <robovm.h>
+#include <string.h>
 #include <unwind.h>
 #include "private.h"
-#include "uthash.h"
 #include "utlist.h"
 
 #define ALLOC_PROXY_FRAMES_SIZE 2
+#define INITIAL_LOOKUPS_SIZE 16
 
-// GC descriptor specifying which words in a LookupEntry that should be scanned 
-// for heap pointers. The hh.hashv value in particular must not be scanned since
-// it often can be mistaken for a pointer. We only need to scan the hh.next 
-// field. The key always refers to the ProxyMethod's name and desc and the 
-// ProxyMethod is referenced by a Class which is a static GC root. 
-#define LOOKUP_ENTRY_GC_BITMAP (MAKE_GC_BITMAP(offsetof(LookupEntry, hh.next)))
-
-static uint32_t lookupEntryGCKind;
-
+/*
+ * The lookup functions emitted by the compiler store the name and desc of 
+ * the called method in env->reserved0/1 before jumping to _proxy0. Those 
+ * are the same string constants as the name and desc of the proxied Method 
+ * so the lookups table is keyed on the pointers rather than the strings. 
+ * It's an open addressing table which is filled in when the proxy class 
+ * is created and never changed after that.
+ */
 typedef struct {
     const char* name;
     const char* desc;
-} LookupKey;
-
-typedef struct {
-    LookupKey key;
     ProxyMethod* method;
-    UT_hash_handle hh;
 } LookupEntry;
 
 typedef struct {
-    LookupEntry* lookupsHash;
+    LookupEntry* lookups;
+    jint lookupsMask;
+    jint lookupsCount;
     ProxyHandler handler;
 } ProxyClassData;
 
+static inline jint lookupIndex(const char* name, const char* desc, jint mask) {
+    uintptr_t h = ((uintptr_t) name ^ ((uintptr_t) desc << 7)) * (uintptr_t) 0x9e3779b97f4a7c15ULL;
+    return (jint) (h >> (sizeof(uintptr_t) * 8 - 24)) & mask;
+}
+
+static ProxyMethod* findLookup(ProxyClassData* data, const char* name, const char* desc) {
+    if (!data->lookups) {
+        return NULL;
+    }
+    jint i = lookupIndex(name, desc, data->lookupsMask);
+    while (data->lookups[i].name) {
+        if (data->lookups[i].name == name && data->lookups[i].desc == desc) {
+            return data->lookups[i].method;
+        }
+        i = (i + 1) & data->lookupsMask;
+    }
+    return NULL;
+}
+
+static void putLookup(LookupEntry* lookups, jint mask, const char* name, const char* desc, ProxyMethod* method) {
+    jint i = lookupIndex(name, desc, mask);
+    while (lookups[i].name && (lookups[i].name != name || lookups[i].desc != desc)) {
+        i = (i + 1) & mask;
+    }
+    lookups[i].name = name;
+    lookups[i].desc = desc;
+    lookups[i].method = method;
+}
+
+static jboolean addLookup(Env* env, ProxyClassData* data, const char* name, const char* desc, ProxyMethod* method) {
+    if ((data->lookupsCount + 1) * 4 > (data->lookupsMask + 1) * 3) {
+        // Keep the load factor below 3/4
+        jint size = data->lookups ? (data->lookupsMask + 1) << 1 : INITIAL_LOOKUPS_SIZE;
+        LookupEntry* lookups = rvmAllocateMemoryAtomicUncollectable(env, sizeof(LookupEntry) * size);
+        if (!lookups) return FALSE;
+        if (data->lookups) {
+            jint i;
+            for (i = 0; i <= data->lookupsMask; i++) {
+                if (data->lookups[i].name) {
+                    putLookup(lookups, size - 1, data->lookups[i].name, data->lookups[i].desc, data->lookups[i].method);
+                }
+            }
+            rvmFreeMemoryUncollectable(env, data->lookups);
+        }
+        data->lookups = lookups;
+        data->lookupsMask = size - 1;
+    }
+    if (!findLookup(data, name, desc)) {
+        data->lookupsCount++;
+    }
+    putLookup(data->lookups, data->lookupsMask, name, desc, method);
+    return TRUE;
+}
+
 static ProxyMethod* hasMethod(Env* env, Class* clazz, const char* name, const char* desc) {
     Method* method = clazz->_methods;
     char* paramsEnd = strchr(desc, ')');
@@ -155,13 +206,7 @@ static jboolean tryAddProxyMethod(Env* env, Class* proxyClass, Method* method, j
         }
     }
     // Record the lookup function in proxyClassData
-    LookupEntry* entry = allocateMemoryOfKind(env, sizeof(LookupEntry), lookupEntryGCKind);
-    if (!entry) return FALSE;
-    entry->key.name = method->name;
-    entry->key.desc = method->desc;
-    entry->method = proxyMethod;
-    HASH_ADD(hh, proxyClassData->lookupsHash, key, sizeof(LookupKey), entry);
-    return TRUE;
+    return addLookup(env, proxyClassData, method->name, method->desc, proxyMethod);
 }
 
 static jboolean addProxyMethods(Env* env, Class* proxyClass, Class* clazz, ProxyClassData* proxyClassData) {
@@ -221,7 +266,6 @@ static jboolean implementAbstractInterfaceMethods(Env* env, Class* proxyClass, I
 }
 
 jboolean rvmInitProxy(Env* env) {
-    lookupEntryGCKind = gcNewDirectBitmapKind(LOOKUP_ENTRY_GC_BITMAP);
     return TRUE;
 }
 
@@ -233,11 +277,11 @@ static TypeInfo* createTypeInfo(Env* env, Class* superclass, jint interfacesCoun
         ifTypesCount += interfaces[i]->typeInfo->interfaceCount;
     }
 
-    TypeInfo* typeInfo = rvmAllocateMemoryAtomic(env, sizeof(TypeInfo) + sizeof(uint32_t) * (classTypesCount + ifTypesCount));
+    TypeInfo* typeInfo = rvmAllocateMemoryAtomic(env, sizeof(TypeInfo)
+            + sizeof(uint32_t) * (classTypesCount + ifTypesCount + interfaceTableSize(ifTypesCount)));
     if (!typeInfo) return NULL;
     uint32_t classId = nextClassId();
     typeInfo->id = classId;
-    typeInfo->cache = 0xffffffff;
     typeInfo->offset = sizeof(TypeInfo) + sizeof(uint32_t) * (classTypesCount - 1);
     typeInfo->classCount = classTypesCount;
     typeInfo->interfaceCount = ifTypesCount;
@@ -255,6 +299,7 @@ static TypeInfo* createTypeInfo(Env* env, Class* superclass, jint interfacesCoun
         memcpy(types, ifTypeInfo->types, sizeof(uint32_t) * ifTypeInfo->interfaceCount);
         types += ifTypeInfo->interfaceCount;
     }
+    initInterfaceTable(typeInfo);
 
     return typeInfo;
 }
@@ -340,7 +385,9 @@ static ITables* createITables(Env* env, Class* superclass, jint interfacesCount,
             initITableArray(env, interfaces[i], &index, itables->table);
             if (rvmExceptionOccurred(env)) return NULL;
         }
-        itables->cache = itables->table[0];
+        for (i = 0; i < ITABLES_CACHE_SIZE; i++) {
+            itables->cache[i] = itables->table[0];
+        }
     }
 
     return itables;
@@ -385,7 +432,7 @@ Class* rvmProxyCreateProxyClass(Env* env, Class* superclass, Object* classLoader
         c = c->superclass;
     }
 
-    if (!rvmRegisterClass(env, proxyClass)) goto error;
+    if (!rvmRegisterClass(env, proxyClass, NULL, NULL)) goto error;
 
     rvmReleaseClassLock(env);
     return proxyClass;
@@ -400,58 +447,53 @@ void _rvmProxyHandler(CallInfo* callInfo) {
     Class* proxyClass = receiver->clazz;
     ProxyClassData* proxyClassData = (ProxyClassData*) proxyClass->data;
 
-    LookupKey key;
-    memset(&key, 0, sizeof(LookupKey));
-    key.name = (char*) env->reserved0;
-    key.desc = (char*) env->reserved1;
-    LookupEntry* entry;
-    HASH_FIND(hh, proxyClassData->lookupsHash, &key, sizeof(LookupKey), entry);
-    if (!entry) {
+    ProxyMethod* method = findLookup(proxyClassData, (const char*) env->reserved0, (const char*) env->reserved1);
+    if (!method) {
         rvmThrowNoSuchMethodError(env, "Failed to determine which method was called on proxy class");
         goto error;
     }
 
-    ProxyMethod* method = entry->method;
+    // The CallPlan is built the first time the method is called and tells us
+    // how to unpack the arguments without parsing the descriptor again.
+    CallPlan* plan = getCallPlan(env, (Method*) method);
+    if (!plan) goto error;
 
     rvmPushGatewayFrameProxy(env, method);
 
-    jint argsCount = rvmGetParameterCount((Method*) method);
     jvalue *jvalueArgs = NULL;
-    if (argsCount > 0) {
-        jvalueArgs = (jvalue*) alloca(sizeof(jvalue) * argsCount);
-
-        const char* desc = method->method.desc;
-        const char* c;
-        jint i = 0;
-        while ((c = rvmGetNextParameterType(&desc))) {
-            switch (c[0]) {
+    if (plan->paramsCount > 0) {
+        jvalueArgs = (jvalue*) alloca(sizeof(jvalue) * plan->paramsCount);
+
+        const char* types = plan->types;
+        jint i;
+        for (i = 0; types[i]; i++) {
+            switch (types[i]) {
             case 'B':
-                jvalueArgs[i++].b = (jbyte) proxy0NextInt(callInfo);
+                jvalueArgs[i].b = (jbyte) proxy0NextInt(callInfo);
                 break;
             case 'Z':
-                jvalueArgs[i++].z = (jboolean) proxy0NextInt(callInfo);
+                jvalueArgs[i].z = (jboolean) proxy0NextInt(callInfo);
                 break;
             case 'S':
-                jvalueArgs[i++].s = (jshort) proxy0NextInt(callInfo);
+                jvalueArgs[i].s = (jshort) proxy0NextInt(callInfo);
                 break;
             case 'C':
-                jvalueArgs[i++].c = (jchar) proxy0NextInt(callInfo);
+                jvalueArgs[i].c = (jchar) proxy0NextInt(callInfo);
                 break;
             case 'I':
-                jvalueArgs[i++].i = proxy0NextInt(callInfo);
+                jvalueArgs[i].i = proxy0NextInt(callInfo);
                 break;
             case 'J':
-                jvalueArgs[i++].j = proxy0NextLong(callInfo);
+                jvalueArgs[i].j = proxy0NextLong(callInfo);
                 break;
             case 'F':
-                jvalueArgs[i++].f = proxy0NextFloat(callInfo);
+                jvalueArgs[i].f = proxy0NextFloat(callInfo);
                 break;
             case 'D':
-                jvalueArgs[i++].d = proxy0NextDouble(callInfo);
+                jvalueArgs[i].d = proxy0NextDouble(callInfo);
                 break;
-            case '[':
             case 'L':
-                jvalueArgs[i++].l = (jobject) proxy0NextPtr(callInfo);
+                jvalueArgs[i].l = (jobject) proxy0NextPtr(callInfo);
                 break;
             }
         }
@@ -465,7 +507,7 @@ void _rvmProxyHandler(CallInfo* callInfo) {
     if (rvmExceptionCheck(env)) goto error;
 
     proxy0ReturnInt(callInfo, 0);
-    switch (rvmGetReturnType(method->method.desc)[0]) {
+    switch (plan->returnType) {
     case 'B':
         proxy0ReturnInt(callInfo, (jint) returnValue.b);
         break;
@@ -490,7 +532,6 @@ void _rvmProxyHandler(CallInfo* callInfo) {
     case 'D':
         proxy0ReturnDouble(callInfo, returnValue.d);
         break;
-    case '[':
     case 'L':
         proxy0ReturnPtr(callInfo, returnValue.l);
         break;
@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Reference tables and JNI global references.
+ *
+ * A RefTable is an open addressing hash table keyed by Object pointer with
+ * a reference count per entry. JNI handles are plain Object pointers so the
+ * table cannot hand out slot indexes. Hashing the pointer gives constant
+ * time adds and removes regardless of the order in which references are
+ * deleted. Entries are removed using backward shift deletion so the table
+ * never fills up with tombstones.
+ *
+ * The table holding the global references is guarded by globalRefsLock.
+ * To keep the lock out of the common NewGlobalRef()/DeleteGlobalRef() pair
+ * each thread also has a small GlobalRefCache of global references it has
+ * added recently. Only the owning thread fills slots in its cache. Any
+ * thread may empty a slot using a CAS when deleting a reference. When the
+ * cache is full the owner moves the oldest entry to the global table while
+ * holding globalRefsLock. A delete which misses both the thread's own cache
+ * and the global table searches the caches of all other threads while
+ * holding globalRefsLock which means a reference is always found in exactly
+ * one place.
+ *
+ * Tables and caches are allocated uncollectably and are scanned by the GC
+ * so the objects they reference are kept alive.
+ */
+#include <robovm.h>
+#include <string.h>
+#include "private.h"
+#include "utlist.h"
+
+#define GLOBAL_REFS_INITIAL_SIZE 2048
+#define MIN_REF_TABLE_SIZE 16
+
+struct GlobalRefCache {
+    GlobalRefCache* prev;
+    GlobalRefCache* next;
+    jint evictIndex; // The slot to move to the global table next time the cache is full
+    Object* refs[GLOBAL_REF_CACHE_SIZE];
+};
+
+static RefTable globalRefs = {0};
+static RvmMutex globalRefsLock;
+// All GlobalRefCaches of attached threads. Guarded by globalRefsLock.
+static GlobalRefCache* globalRefCaches = NULL;
+
+static inline jint hashRef(Object* object, jint size) {
+    uintptr_t h = ((uintptr_t) object >> 3) * 2654435761u;
+    return (jint) (h ^ (h >> 16)) & (size - 1);
+}
+
+static RefTableEntry* findRef(RefTable* refTable, Object* object) {
+    jint mask = refTable->size - 1;
+    for (jint i = hashRef(object, refTable->size);; i = (i + 1) & mask) {
+        RefTableEntry* entry = &refTable->entries[i];
+        if (entry->object == object || !entry->object) {
+            return entry;
+        }
+    }
+}
+
+static jboolean resizeRefTable(Env* env, RefTable* refTable, jint newSize) {
+    RefTableEntry* newEntries = rvmAllocateMemoryUncollectable(env, newSize * sizeof(RefTableEntry));
+    if (!newEntries) {
+        return FALSE;
+    }
+    RefTableEntry* oldEntries = refTable->entries;
+    jint oldSize = refTable->size;
+    refTable->entries = newEntries;
+    refTable->size = newSize;
+    for (jint i = 0; i < oldSize; i++) {
+        if (oldEntries[i].object) {
+            *findRef(refTable, oldEntries[i].object) = oldEntries[i];
+        }
+    }
+    rvmFreeMemoryUncollectable(env, oldEntries);
+    return TRUE;
+}
+
+jboolean rvmInitRefTable(Env* env, RefTable* refTable, jint size) {
+    jint actualSize = MIN_REF_TABLE_SIZE;
+    while (actualSize < size) {
+        actualSize <<= 1;
+    }
+    refTable->entries = rvmAllocateMemoryUncollectable(env, actualSize * sizeof(RefTableEntry));
+    if (!refTable->entries) {
+        return FALSE;
+    }
+    refTable->size = actualSize;
+    refTable->count = 0;
+    return TRUE;
+}
+
+jboolean rvmAddRef(Env* env, RefTable* refTable, Object* object) {
+    RefTableEntry* entry = findRef(refTable, object);
+    if (entry->object) {
+        entry->count++;
+        return TRUE;
+    }
+    // Keep the load factor below 3/4
+    if ((refTable->count + 1) * 4 > refTable->size * 3) {
+        if (!resizeRefTable(env, refTable, refTable->size << 1)) {
+            return FALSE;
+        }
+        entry = findRef(refTable, object);
+    }
+    entry->object = object;
+    entry->count = 1;
+    refTable->count++;
+    return TRUE;
+}
+
+jboolean rvmRemoveRef(Env* env, RefTable* refTable, Object* object) {
+    if (!refTable->entries) {
+        return FALSE;
+    }
+    RefTableEntry* entry = findRef(refTable, object);
+    if (!entry->object) {
+        return FALSE;
+    }
+    if (--entry->count > 0) {
+        return TRUE;
+    }
+    refTable->count--;
+
+    // Move back any following entries in the same probe sequence which
+    // would no longer be found once this entry is empty.
+    jint mask = refTable->size - 1;
+    jint i = (jint) (entry - refTable->entries);
+    jint j = i;
+    while (TRUE) {
+        refTable->entries[i].object = NULL;
+        refTable->entries[i].count = 0;
+        while (TRUE) {
+            j = (j + 1) & mask;
+            Object* o = refTable->entries[j].object;
+            if (!o) {
+                return TRUE;
+            }
+            jint k = hashRef(o, refTable->size);
+            // Leave the entry where it is if its home slot k is cyclically
+            // in (i, j].
+            if (i <= j ? (i < k && k <= j) : (i < k || k <= j)) {
+                continue;
+            }
+            refTable->entries[i] = refTable->entries[j];
+            i = j;
+            break;
+        }
+    }
+}
+
+jboolean initGlobalRefs(void) {
+    return rvmInitMutex(&globalRefsLock) == 0;
+}
+
+static jboolean addGlobalRefLocked(Env* env, Object* object) {
+    if (!globalRefs.entries) {
+        if (!rvmInitRefTable(env, &globalRefs, GLOBAL_REFS_INITIAL_SIZE)) {
+            return FALSE;
+        }
+    }
+    return rvmAddRef(env, &globalRefs, object);
+}
+
+static GlobalRefCache* getGlobalRefCache(Env* env, RvmThread* thread) {
+    GlobalRefCache* cache = thread->globalRefCache;
+    if (!cache) {
+        cache = rvmAllocateMemoryUncollectable(env, sizeof(GlobalRefCache));
+        if (!cache) {
+            // The cache is optional
+            rvmExceptionClear(env);
+            return NULL;
+        }
+        rvmLockMutex(&globalRefsLock);
+        DL_APPEND(globalRefCaches, cache);
+        rvmUnlockMutex(&globalRefsLock);
+        thread->globalRefCache = cache;
+    }
+    return cache;
+}
+
+jboolean rvmAddGlobalRef(Env* env, Object* object) {
+    if (!object) {
+        return TRUE;
+    }
+    GlobalRefCache* cache = env->currentThread ? getGlobalRefCache(env, env->currentThread) : NULL;
+    if (cache) {
+        for (jint i = 0; i < GLOBAL_REF_CACHE_SIZE; i++) {
+            // Only this thread fills slots so an empty slot stays empty
+            // until we store to it.
+            if (!cache->refs[i]) {
+                rvmAtomicStorePtr((void**) &cache->refs[i], object);
+                return TRUE;
+            }
+        }
+    }
+
+    rvmLockMutex(&globalRefsLock);
+    jboolean result;
+    if (cache) {
+        // Move the oldest cached reference to the global table to make
+        // room. Other threads only look for it in other threads' caches
+        // while holding globalRefsLock so it's never missing in both places.
+        jint i = cache->evictIndex;
+        Object* evicted = rvmAtomicStorePtr((void**) &cache->refs[i], object);
+        cache->evictIndex = (i + 1) & (GLOBAL_REF_CACHE_SIZE - 1);
+        result = !evicted || addGlobalRefLocked(env, evicted);
+        if (!result) {
+            // Put the evicted reference back and fail the new one
+            rvmAtomicStorePtr((void**) &cache->refs[i], evicted);
+        }
+    } else {
+        result = addGlobalRefLocked(env, object);
+    }
+    rvmUnlockMutex(&globalRefsLock);
+    return result;
+}
+
+static jboolean removeFromGlobalRefCache(GlobalRefCache* cache, Object* object) {
+    for (jint i = 0; i < GLOBAL_REF_CACHE_SIZE; i++) {
+        if (cache->refs[i] == object && rvmAtomicCompareAndSwapPtr((void**) &cache->refs[i], object, NULL)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+jboolean rvmRemoveGlobalRef(Env* env, Object* object) {
+    if (!object) {
+        return TRUE;
+    }
+    GlobalRefCache* own = env->currentThread ? env->currentThread->globalRefCache : NULL;
+    if (own && removeFromGlobalRefCache(own, object)) {
+        return TRUE;
+    }
+
+    rvmLockMutex(&globalRefsLock);
+    jboolean result = rvmRemoveRef(env, &globalRefs, object);
+    if (!result) {
+        GlobalRefCache* cache;
+        DL_FOREACH(globalRefCaches, cache) {
+            if (cache != own && removeFromGlobalRefCache(cache, object)) {
+                result = TRUE;
+                break;
+            }
+        }
+    }
+    rvmUnlockMutex(&globalRefsLock);
+    return result;
+}
+
+void freeGlobalRefCache(Env* env, RvmThread* thread) {
+    GlobalRefCache* cache = thread->globalRefCache;
+    if (!cache) {
+        return;
+    }
+    rvmLockMutex(&globalRefsLock);
+    for (jint i = 0; i < GLOBAL_REF_CACHE_SIZE; i++) {
+        Object* object = rvmAtomicStorePtr((void**) &cache->refs[i], NULL);
+        if (object && !addGlobalRefLocked(env, object)) {
+            // Nowhere else to keep the reference. Leave the cache behind
+            // and keep it on the list.
+            rvmAtomicStorePtr((void**) &cache->refs[i], object);
+            rvmExceptionClear(env);
+            thread->globalRefCache = NULL;
+            rvmUnlockMutex(&globalRefsLock);
+            return;
+        }
+    }
+    DL_DELETE(globalRefCaches, cache);
+    thread->globalRefCache = NULL;
+    rvmUnlockMutex(&globalRefsLock);
+    rvmFreeMemoryUncollectable(env, cache);
+}
@@ -24,16 +24,35 @@
 #   include <semaphore.h>
 #endif
 #include <errno.h>
+#include <sys/time.h>
 #include "private.h"
 
 #if defined(DARWIN)
-// Darwin doesn't implement sem_init(). Use Mach semaphores instead.
+// Darwin doesn't implement sem_init(). Use Mach semaphores instead. Errors
+// are reported like the POSIX functions do.
 typedef semaphore_t sem_t;
+static inline int semResult(kern_return_t kr) {
+    if (kr == KERN_SUCCESS) {
+        return 0;
+    }
+    errno = kr == KERN_ABORTED ? EINTR : kr == KERN_OPERATION_TIMED_OUT ? ETIMEDOUT : EINVAL;
+    return -1;
+}
 static inline int sem_init(sem_t* sem, int pshared, unsigned int value) {
     return semaphore_create(mach_task_self(), sem, SYNC_POLICY_FIFO, value);
 }
 static inline int sem_wait(sem_t* sem) {
-    return semaphore_wait(*sem);
+    return semResult(semaphore_wait(*sem));
+}
+static inline int sem_timedwait(sem_t* sem, const struct timespec* abstime) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    jlong nanos = (abstime->tv_sec - now.tv_sec) * 1000000000LL + abstime->tv_nsec - now.tv_usec * 1000LL;
+    if (nanos < 0) {
+        nanos = 0;
+    }
+    mach_timespec_t timeout = {(unsigned int) (nanos / 1000000000LL), (clock_res_t) (nanos % 1000000000LL)};
+    return semResult(semaphore_timedwait(*sem, timeout));
 }
 static inline int sem_post(sem_t* sem) {
     return semaphore_signal(*sem);
@@ -50,6 +69,22 @@ static inline int sem_post(sem_t* sem) {
 #define BLOCKED_THREAD_SIGNAL (SIGRTMIN + 2)
 #endif
 
+// The signal used to make a thread revoke the bias of a lock biased
+// towards it (see revokeBias() in monitor.c). Only installed when biased
+// locking has been enabled. On Linux the GC uses SIGPWR and SIGXCPU to
+// stop threads so a real-time signal is used. Darwin has no real-time
+// signals and SIGUSR1 and SIGUSR2 are taken above. SIGXCPU is used there
+// since the GC uses Mach thread suspension. It collides with the SIGXCPU
+// the kernel sends when a process exceeds its RLIMIT_CPU soft limit. With
+// biased locking enabled that signal is ignored by the handler (there is
+// no revocation request) instead of terminating the process, and an
+// app's own SIGXCPU handler is replaced.
+#if defined(__APPLE__)
+#define BIAS_REVOCATION_SIGNAL SIGXCPU
+#else
+#define BIAS_REVOCATION_SIGNAL (SIGRTMIN + 3)
+#endif
+
 typedef struct {
     struct sigaction blockedThreadSignal;
 } SavedSignals;
@@ -70,14 +105,25 @@ static Method* throwableInitMethod = NULL;
 static CallStack* dumpThreadStackTraceCallStack = NULL;
 #ifndef __SWITCH__
 static sem_t dumpThreadStackTraceCallSemaphore;
+static sem_t biasRevocationSemaphore;
 #if defined(DARWIN)
 static struct sigaction sigbusFallback;
 #endif
 static struct sigaction sigsegvFallback;
+// The SIGSEGV/SIGBUS handlers installed by the GC in incremental mode. The GC
+// write protects heap pages to find out which pages are dirtied between
+// collections. Faults on such pages must be forwarded to the GC.
+#if defined(DARWIN)
+static struct sigaction gcSigbusHandler;
+#endif
+static struct sigaction gcSigsegvHandler;
+static jboolean forwardGCFaults = FALSE;
 
 static void signalHandler_npe_so_nochaining(int signum, siginfo_t* info, void* context);
 static void signalHandler_npe_so_chaining(int signum, siginfo_t* info, void* context);
 static void signalHandler_dump_thread(int signum, siginfo_t* info, void* context);
+static void signalHandler_revoke_bias(int signum, siginfo_t* info, void* context);
+static void saveGCFaultHandlers(void);
 #endif
 static jboolean installNoChainingSignals(Env* env);
 
@@ -96,12 +142,24 @@ jboolean rvmInitSignals(Env* env) {
     if (sem_init(&dumpThreadStackTraceCallSemaphore, 0, 0) != 0) {
         return FALSE;
     }
+    if (sem_init(&biasRevocationSemaphore, 0, 0) != 0) {
+        return FALSE;
+    }
+#endif
+#ifndef __SWITCH__
+    if (rvmIsIncrementalGC(env)) {
+        saveGCFaultHandlers();
+    }
 #endif
     if (!installNoChainingSignals(env)) {
         return FALSE;
     }
 #if defined(DARWIN)
-    registerDarwinExceptionHandler();
+    if (!rvmIsIncrementalGC(env)) {
+        // The GC uses its own Mach exception port in incremental mode to
+        // track dirty pages. Replacing it would break the write barrier.
+        registerDarwinExceptionHandler();
+    }
 #endif
     return TRUE;
 }
@@ -115,6 +173,14 @@ static struct sigaction create_sigaction(void (*f)(int, siginfo_t*, void*)) {
     return sa;
 }
 
+static void saveGCFaultHandlers(void) {
+#if defined(DARWIN)
+    sigaction(SIGBUS, NULL, &gcSigbusHandler);
+#endif
+    sigaction(SIGSEGV, NULL, &gcSigsegvHandler);
+    forwardGCFaults = TRUE;
+}
+
 static int installSignalHandlerIfNeeded(int signum, struct sigaction sa, struct sigaction* savedsa) {
     struct sigaction oldsa;
 
@@ -150,6 +216,12 @@ static jboolean installChainingSignals(Env* env) {
         rvmThrowInternalErrorErrno(env, errno);
         return FALSE;
     }
+
+    if (env->vm->options->enableBiasedLocking
+            && installSignalHandlerIfNeeded(BIAS_REVOCATION_SIGNAL, create_sigaction(&signalHandler_revoke_bias), NULL) != 0) {
+        rvmThrowInternalErrorErrno(env, errno);
+        return FALSE;
+    }
 #endif
 
     return TRUE;
@@ -162,6 +234,12 @@ static jboolean reinstallSavedSignals(Env* env, SavedSignals* savedSignals) {
         return FALSE;
     }
 
+    if (env->vm->options->enableBiasedLocking
+            && installSignalHandlerIfNeeded(BIAS_REVOCATION_SIGNAL, create_sigaction(&signalHandler_revoke_bias), NULL) != 0) {
+        rvmThrowInternalErrorErrno(env, errno);
+        return FALSE;
+    }
+
     if (installSignalHandlerIfNeeded(BLOCKED_THREAD_SIGNAL, savedSignals->blockedThreadSignal, NULL) != 0) {
         rvmThrowInternalErrorErrno(env, errno);
         return FALSE;
@@ -190,6 +268,12 @@ static jboolean installNoChainingSignals(Env* env) {
         rvmThrowInternalErrorErrno(env, errno);
         return FALSE;
     }
+
+    if (env->vm->options->enableBiasedLocking
+            && installSignalHandlerIfNeeded(BIAS_REVOCATION_SIGNAL, create_sigaction(&signalHandler_revoke_bias), NULL) != 0) {
+        rvmThrowInternalErrorErrno(env, errno);
+        return FALSE;
+    }
 #endif
 
     return TRUE;
@@ -260,11 +344,60 @@ void dumpThreadStackTrace(Env* env, RvmThread* thread, CallStack* callStack) {
         return;
     }
 
-    while (sem_wait(&dumpThreadStackTraceCallSemaphore) == EINTR) {
+    // sem_wait() isn't restarted after a signal handler has run. The GC's
+    // stop-the-world signal may interrupt us here.
+    while (sem_wait(&dumpThreadStackTraceCallSemaphore) == -1 && errno == EINTR) {
     }
 #endif
 }
 
+jboolean signalBiasRevocation(Env* env, RvmThread* thread) {
+    // NOTE: The caller must hold the thread list lock. It serializes calls
+    // to this function and keeps the thread from exiting.
+#ifndef __SWITCH__
+    if (pthread_kill(thread->pThread, BIAS_REVOCATION_SIGNAL) != 0) {
+        // The thread is probably not alive
+        return FALSE;
+    }
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+jboolean waitBiasRevocation(jint timeoutMillis) {
+#ifndef __SWITCH__
+    if (timeoutMillis < 0) {
+        while (sem_wait(&biasRevocationSemaphore) == -1 && errno == EINTR) {
+        }
+        return TRUE;
+    }
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    struct timespec deadline;
+    deadline.tv_sec = now.tv_sec + timeoutMillis / 1000;
+    deadline.tv_nsec = now.tv_usec * 1000L + (timeoutMillis % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    while (sem_timedwait(&biasRevocationSemaphore, &deadline) == -1) {
+        if (errno != EINTR) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+void ackBiasRevocation(void) {
+#ifndef __SWITCH__
+    sem_post(&biasRevocationSemaphore);
+#endif
+}
+
 #ifndef __SWITCH__
 static inline void* getFramePointer(ucontext_t* context) {
 #if defined(DARWIN)
@@ -314,6 +447,28 @@ static inline void* getPC(ucontext_t* context) {
 #endif
 }
 
+// Forwards faults on GC heap pages to the GC's handler. Returns TRUE if the
+// fault was forwarded.
+static jboolean forwardGCFault(int signum, siginfo_t* info, void* context) {
+    if (!forwardGCFaults || !gcIsHeapPointer(info->si_addr)) {
+        return FALSE;
+    }
+    struct sigaction* sa = &gcSigsegvHandler;
+#if defined(DARWIN)
+    if (signum == SIGBUS) {
+        sa = &gcSigbusHandler;
+    }
+#endif
+    if (sa->sa_flags & SA_SIGINFO) {
+        sa->sa_sigaction(signum, info, context);
+    } else if (sa->sa_handler != SIG_DFL && sa->sa_handler != SIG_IGN) {
+        sa->sa_handler(signum);
+    } else {
+        return FALSE;
+    }
+    return TRUE;
+}
+
 static void signalHandler_npe_so(int signum, siginfo_t* info, void* context) {
     // SIGSEGV/SIGBUS are synchronous signals so we shouldn't have to worry about only calling
     // async-signal-safe functions here.
@@ -360,6 +515,9 @@ static void signalHandler_npe_so(int signum, siginfo_t* info, void* context) {
 // Signal handler used by default. Does not chain to the previously installed handler. Just delegates to SIG_DFL
 // in case a SIGSEGV/SIGBUS is cused by something other than an NPE or SOE.
 static void signalHandler_npe_so_nochaining(int signum, siginfo_t* info, void* context) {
+    if (forwardGCFault(signum, info, context)) {
+        return;
+    }
     signalHandler_npe_so(signum, info, context);
     // If we come this far it means that the cause of the signal wasn't an NPE or SOE but something
     // fatal happened in native code. Delegate to the default handler.
@@ -369,6 +527,9 @@ static void signalHandler_npe_so_nochaining(int signum, siginfo_t* info, void* c
 
 // Signal handler which chains to the previous handler in case a SIGSEGV/SIGBUS is cused by something other than an NPE or SOE.
 static void signalHandler_npe_so_chaining(int signum, siginfo_t* info, void* context) {
+    if (forwardGCFault(signum, info, context)) {
+        return;
+    }
     signalHandler_npe_so(signum, info, context);
     // If we come this far it means that the cause of the signal wasn't an NPE or SOE but something
     // fatal happened in native code. Chained to the previous handler.
@@ -409,4 +570,11 @@ static void signalHandler_dump_thread(int signum, siginfo_t* info, void* context
     }
     sem_post(&dumpThreadStackTraceCallSemaphore);
 }
+
+static void signalHandler_revoke_bias(int signum, siginfo_t* info, void* context) {
+    Env* env = rvmGetEnv();
+    if (env && env->currentThread) {
+        revokeRequestedBias(env->currentThread);
+    }
+}
 #endif
\ No newline at end of file
@@ -17,200 +17,235 @@
 #include <string.h>
 #include <stddef.h>
 #include "private.h"
-#include "uthash.h"
 
 #define LOG_TAG "core.string"
 
-static uint32_t cacheEntryGCKind;
 static const jchar EMPTY_JCHARS = 0;
 
-// TODO: Restrict the number of bytes stored in the cache instead of the number of String objects.
-#define MAX_CACHE_SIZE 10000
-
-// GC descriptor specifying which words in a CacheEntry that should be scanned 
-// for heap pointers. The hh.hashv value in particular must not be scanned since
-// it often can be mistaken for a pointer.
-#define CACHE_ENTRY_GC_BITMAP (MAKE_GC_BITMAP(offsetof(CacheEntry, key)) \
-                              |MAKE_GC_BITMAP(offsetof(CacheEntry, string)) \
-                              |MAKE_GC_BITMAP(offsetof(CacheEntry, hh.next)))
-
-typedef struct CacheEntry {
-    const char* key; // The string in modified UTF-8
-    Object* string;  // The java.lang.String object.
-    UT_hash_handle hh;
-} CacheEntry;
-static CacheEntry* internedStrings = NULL;
-static RvmMutex internedStringsLock;
-
-static inline void obtainInternedStringsLock() {
-    rvmLockMutex(&internedStringsLock);
-}
+// The interned strings table is split into stripes with their own locks.
+// The top bits of the hash of a string select the stripe. Must be a power of 2.
+#define INTERNED_STRINGS_STRIPE_BITS 6
+#define INTERNED_STRINGS_STRIPES (1 << INTERNED_STRINGS_STRIPE_BITS)
+// Number of buckets in a stripe when the first string is added to it. Must
+// be a power of 2.
+#define INTERNED_STRINGS_MIN_BUCKETS 64
 
-static inline void releaseInternedStringsLock() {
-    rvmUnlockMutex(&internedStringsLock);
+/*
+ * An entry in the interned strings table. Entries are allocated in memory
+ * which isn't scanned by the GC so the string is only weakly referenced.
+ * string is registered as a disappearing link which the GC clears when the
+ * string is collected. Cleared entries are removed when they are found
+ * while searching the table or when a stripe grows.
+ */
+typedef struct InternedString {
+    struct InternedString* next;
+    Object* string;
+    uint32_t hash; // The hash of the chars of the string. See hashChars().
+} InternedString;
+
+typedef struct InternedStringsStripe {
+    RvmMutex lock;
+    InternedString** buckets;
+    uint32_t bucketCount;
+    uint32_t count; // Including cleared entries
+} InternedStringsStripe;
+
+static InternedStringsStripe internedStrings[INTERNED_STRINGS_STRIPES];
+
+static inline uint32_t fmix32(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
 }
 
-/**
- * Finds an interned string in the interned strings key. If found the string
- * will be "touched", i.e. marked as most recently used. The internedStringsLock
- * MUST be held when calling this function.
+/*
+ * Decodes the next char of a modified UTF-8 string. Never reads past the
+ * terminating null byte, even if the last sequence is truncated.
  */
-static Object* findInternedString(Env* env, const char* s) {
-    CacheEntry* cacheEntry;
-    HASH_FIND_STR(internedStrings, s, cacheEntry);
-    if (cacheEntry) {
-        // Touch the string
-        HASH_DELETE(hh, internedStrings, cacheEntry);
-        HASH_ADD_KEYPTR(hh, internedStrings, cacheEntry->key, strlen(cacheEntry->key), cacheEntry);
-        return cacheEntry->string;
+static inline jchar nextUtf8Char(const unsigned char** utf8) {
+    const unsigned char* s = *utf8;
+    jchar ch = *s++;
+    if ((ch & 0x80) && s[0]) {
+        if ((ch & 0x20) && s[1]) {
+            ch = (jchar) (((0x0f & ch) << 12) + ((0x3f & s[0]) << 6) + (0x3f & s[1]));
+            s += 2;
+        } else {
+            ch = (jchar) (((0x1f & ch) << 6) + (0x3f & s[0]));
+            s += 1;
+        }
     }
-    return NULL;
+    *utf8 = s;
+    return ch;
 }
 
-/**
- * Adds a string to the cache of interned string. The string must not already be
- * interned.  The internedStringsLock MUST be held when calling this function.
+static uint32_t hashChars(const jchar* chars, jint length) {
+    uint32_t h = 0;
+    for (jint i = 0; i < length; i++) {
+        h = h * 31 + chars[i];
+    }
+    return fmix32(h);
+}
+
+/*
+ * Returns the same hash as hashChars() would for the first length UTF-16
+ * chars of the specified modified UTF-8 string.
  */
-static jboolean addInternedString(Env* env, const char* s,  Object* string) {
-    CacheEntry* cacheEntry = allocateMemoryOfKind(env, sizeof(CacheEntry), cacheEntryGCKind);
-    if (!cacheEntry) {
-        return FALSE;
+static uint32_t hashUtf8(const char* s, jint length) {
+    const unsigned char* utf8 = (const unsigned char*) s;
+    uint32_t h = 0;
+    for (jint i = 0; i < length && *utf8; i++) {
+        h = h * 31 + nextUtf8Char(&utf8);
     }
+    return fmix32(h);
+}
 
-    cacheEntry->key = s;
-    cacheEntry->string = string;
-    HASH_ADD_KEYPTR(hh, internedStrings, cacheEntry->key, strlen(cacheEntry->key), cacheEntry);
-
-    // prune the cache to MAX_CACHE_SIZE
-    if (HASH_COUNT(internedStrings) >= MAX_CACHE_SIZE) {
-        CacheEntry* tmpEntry;
-        HASH_ITER(hh, internedStrings, cacheEntry, tmpEntry) {
-            // prune the first entry (loop is based on insertion order so this deletes the oldest item)
-            HASH_DELETE(hh, internedStrings, cacheEntry);
-            break;
+static jboolean equalsChars(Env* env, Object* string, const void* key, jint length) {
+    return rvmRTGetStringLength(env, string) == length
+        && !memcmp(rvmRTGetStringChars(env, string), key, sizeof(jchar) * length);
+}
+
+static jboolean equalsUtf8(Env* env, Object* string, const void* key, jint length) {
+    if (rvmRTGetStringLength(env, string) != length) {
+        return FALSE;
+    }
+    const jchar* chars = rvmRTGetStringChars(env, string);
+    const unsigned char* utf8 = (const unsigned char*) key;
+    for (jint i = 0; i < length; i++) {
+        if (!*utf8 || chars[i] != nextUtf8Char(&utf8)) {
+            return FALSE;
         }
     }
-
     return TRUE;
 }
 
-// TODO: Return the same instance for strings of length == 0?
+static inline InternedStringsStripe* getInternedStringsStripe(uint32_t hash) {
+    return &internedStrings[hash >> (32 - INTERNED_STRINGS_STRIPE_BITS)];
+}
 
-/* 
- * Determines the number of Java chars needed to store the 
- * specified modified UTF-8 string.
- * Copied from Harmony (vm_strings.cpp).
- */
-static jint getUnicodeLengthOfUtf8(const char* utf8) {
-    jint len = 0;
-    unsigned char ch;
-    unsigned char ch2;
-    unsigned char ch3;
-    while ((ch = *utf8++)) {
-        len++;
-        if (ch & 0x80) { // 2 or 3 byte encoding
-            if (! (ch & 0x40))
-                return -1;
-            ch2 = *utf8++;
-            if (ch & 0x20) { // 3 byte encoding
-                ch3 = *utf8++;
-                if ((ch  & 0xf0) != 0xe0  ||  // check first byte high bits
-                    (ch2 & 0xc0) != 0x80  ||  // check second byte high bits
-                    (ch3 & 0xc0) != 0x80)     // check third byte high bits
-                    return -1;
-            } else {    // 2 byte encoding
-                if ((ch2 & 0xc0) != 0x80)     // check second byte high bits
-                    return -1;
-            }
-        } 
-    }
-    return len;
+static void removeInternedString(Env* env, InternedStringsStripe* stripe, InternedString** link) {
+    InternedString* entry = *link;
+    *link = entry->next;
+    stripe->count--;
+    rvmUnregisterDisappearingLink(env, (void**) &entry->string);
+    rvmFreeMemoryUncollectable(env, entry);
 }
 
-static jint getUtf8LengthOfUnicode(const jchar* unicode, jint unicodeLength) {
-    jint length = 0;
-    jint i;
-    for (i = 0; i < unicodeLength; i++) {
-        jchar ch = unicode[i];
-        if (ch == 0) {
-            length += 2;
-        } else if (ch < 0x80) {
-            length += 1;
-        } else if (ch < 0x800) {
-            length += 2;
+/**
+ * Finds the interned string with the specified hash which equals the
+ * specified key. Removes entries of collected strings with the same hash
+ * in the searched bucket. The stripe's lock MUST be held when calling this
+ * function.
+ */
+static Object* findInternedString(Env* env, InternedStringsStripe* stripe, uint32_t hash, const void* key, jint length,
+        jboolean (*equals)(Env*, Object*, const void*, jint)) {
+
+    if (!stripe->buckets) {
+        return NULL;
+    }
+    InternedString** link = &stripe->buckets[hash & (stripe->bucketCount - 1)];
+    while (*link) {
+        InternedString* entry = *link;
+        if (entry->hash != hash) {
+            link = &entry->next;
+            continue;
+        }
+        Object* string = rvmReadDisappearingLink(env, (void**) &entry->string);
+        if (!string) {
+            removeInternedString(env, stripe, link);
+        } else if (equals(env, string, key, length)) {
+            return string;
         } else {
-            length += 3;
+            link = &entry->next;
         }
     }
-    return length;
+    return NULL;
 }
 
-/* 
- * Converts a null terminated string of modified UTF-8 
- * characters into a string of UTF-16 Java chars.
- * Copied from Harmony (vm_strings.cpp).
+/**
+ * Removes the entries of all collected strings in the stripe and doubles
+ * the number of buckets if the stripe is still too full. The stripe's lock
+ * MUST be held when calling this function.
  */
-static void utf8ToUnicode(jchar* unicode, const char* utf8String) {
-    const unsigned char* utf8 = (const unsigned char*) utf8String;
-    jchar ch;
-    while ((ch = (jchar) *utf8++)) {
-        if (ch & 0x80) {
-//            assert(ch & 0x40);
-            if (ch & 0x20) {
-                jchar x = ch;
-                jchar y = (jchar) *utf8++;
-                jchar z = (jchar) *utf8++;
-                *unicode++ = (jchar) (((0x0f & x) << 12) + ((0x3f & y) << 6) + ((0x3f & z)));
+static jboolean growInternedStrings(Env* env, InternedStringsStripe* stripe) {
+    uint32_t bucketCount = stripe->bucketCount;
+    for (uint32_t i = 0; i < bucketCount; i++) {
+        InternedString** link = &stripe->buckets[i];
+        while (*link) {
+            if (!rvmReadDisappearingLink(env, (void**) &(*link)->string)) {
+                removeInternedString(env, stripe, link);
             } else {
-                jchar x = ch;
-                jchar y = (jchar) *utf8++;
-                *unicode++ = (jchar) (((0x1f & x) << 6) + (0x3f & y));
+                link = &(*link)->next;
             }
-        } else {
-            *unicode++ = ch;
         }
     }
+    if (stripe->count < bucketCount) {
+        return TRUE;
+    }
+
+    uint32_t newBucketCount = bucketCount ? bucketCount << 1 : INTERNED_STRINGS_MIN_BUCKETS;
+    InternedString** newBuckets = rvmAllocateMemoryAtomicUncollectable(env, sizeof(InternedString*) * newBucketCount);
+    if (!newBuckets) {
+        return FALSE;
+    }
+    memset(newBuckets, 0, sizeof(InternedString*) * newBucketCount);
+    for (uint32_t i = 0; i < bucketCount; i++) {
+        InternedString* entry = stripe->buckets[i];
+        while (entry) {
+            InternedString* next = entry->next;
+            InternedString** bucket = &newBuckets[entry->hash & (newBucketCount - 1)];
+            entry->next = *bucket;
+            *bucket = entry;
+            entry = next;
+        }
+    }
+    if (stripe->buckets) {
+        rvmFreeMemoryUncollectable(env, stripe->buckets);
+    }
+    stripe->buckets = newBuckets;
+    stripe->bucketCount = newBucketCount;
+    return TRUE;
 }
 
-static void unicodeToUtf8(char* utf8String, const jchar* unicode, jint unicodeLength) {
-    char *s = utf8String;
-    jint i;
-    for (i = 0; i < unicodeLength; i++) {
-        jint ch = unicode[i];
-        if (ch == 0) {
-            *s++ = (char)0xc0;
-            *s++ = (char)0x80;
-        } else if (ch < 0x80) {
-            *s++ = (char)ch;
-        } else if(ch < 0x800) {
-            unsigned b5_0 = ch & 0x3f;
-            unsigned b10_6 = (ch >> 6) & 0x1f;
-            *s++ = (char)(0xc0 | b10_6);
-            *s++ = (char)(0x80 | b5_0);
-        } else {
-            unsigned b5_0 = ch & 0x3f;
-            unsigned b11_6 = (ch >> 6) & 0x3f;
-            unsigned b15_12 = (ch >> 12) & 0xf;
-            *s++ = (char)(0xe0 | b15_12);
-            *s++ = (char)(0x80 | b11_6);
-            *s++ = (char)(0x80 | b5_0);
+/**
+ * Adds a string to the interned strings table. The string must not already
+ * be interned. The stripe's lock MUST be held when calling this function.
+ */
+static jboolean addInternedString(Env* env, InternedStringsStripe* stripe, uint32_t hash, Object* string) {
+    if (stripe->count >= stripe->bucketCount * 2) {
+        if (!growInternedStrings(env, stripe)) {
+            return FALSE;
         }
     }
-    *s = 0;
+
+    InternedString* entry = rvmAllocateMemoryAtomicUncollectable(env, sizeof(InternedString));
+    if (!entry) {
+        return FALSE;
+    }
+    entry->hash = hash;
+    entry->string = string;
+    rvmRegisterDisappearingLink(env, (void**) &entry->string, string);
+    InternedString** bucket = &stripe->buckets[hash & (stripe->bucketCount - 1)];
+    entry->next = *bucket;
+    *bucket = entry;
+    stripe->count++;
+    return TRUE;
 }
 
+// TODO: Return the same instance for strings of length == 0?
+
 static inline Object* newString(Env* env, CharArray* value, jint offset, jint length) {
     return rvmRTNewString(env, value, offset, length);
 }
 
 jboolean rvmInitStrings(Env* env) {
-    if (rvmInitMutex(&internedStringsLock) != 0) {
-        return FALSE;
+    for (jint i = 0; i < INTERNED_STRINGS_STRIPES; i++) {
+        if (rvmInitMutex(&internedStrings[i].lock) != 0) {
+            return FALSE;
+        }
     }
-
-    gcAddRoot(&internedStrings);
-    cacheEntryGCKind = gcNewDirectBitmapKind(CACHE_ENTRY_GC_BITMAP);
-
     return TRUE;
 }
 
@@ -224,10 +259,7 @@ Object* rvmNewStringAscii(Env* env, const char* s, jint length) {
     length = (length == -1) ? strlen(s) : length;
     CharArray* value = rvmNewCharArray(env, length);
     if (!value) return NULL;
-    jint i;
-    for (i = 0; i < length; i++) {
-        value->values[i] = (jchar) (s[i] & 0xff);
-    }
+    latin1ToUnicode(value->values, s, length);
     return newString(env, value, 0, length);
 }
 
@@ -254,23 +286,28 @@ Object* rvmNewInternedStringUTF(Env* env, const char* s, jint length) {
     if (length == 0) s = "";
     if (!s) return NULL;
 
-    obtainInternedStringsLock();
+    length = (length == -1) ? getUnicodeLengthOfUtf8(s) : length;
+    if (length < 0) {
+        // Malformed. Fails the same way as rvmNewStringUTF().
+        return rvmNewStringUTF(env, s, length);
+    }
+    uint32_t hash = hashUtf8(s, length);
+    InternedStringsStripe* stripe = getInternedStringsStripe(hash);
+    rvmLockMutex(&stripe->lock);
 
-    // Check the cache first.
-    Object* string = findInternedString(env, s);
+    Object* string = findInternedString(env, stripe, hash, s, length, equalsUtf8);
     if (!string) {
-        length = (length == -1) ? getUnicodeLengthOfUtf8(s) : length;
         CharArray* value = rvmNewCharArray(env, length);
         if (value) {
             utf8ToUnicode(value->values, s);
             Object* str = newString(env, value, 0, length);
-            if (str && addInternedString(env, s, str)) {
+            if (str && addInternedString(env, stripe, hash, str)) {
                 string = str;
             }
         }
     }
 
-    releaseInternedStringsLock();
+    rvmUnlockMutex(&stripe->lock);
 
     return string;
 }
@@ -278,22 +315,20 @@ Object* rvmNewInternedStringUTF(Env* env, const char* s, jint length) {
 Object* rvmInternString(Env* env, Object* str) {
     if (!str) return NULL;
 
-    obtainInternedStringsLock();
-
-    Object* string = NULL;
+    const jchar* chars = rvmGetStringChars(env, str);
+    jint length = rvmGetStringLength(env, str);
+    uint32_t hash = hashChars(chars, length);
+    InternedStringsStripe* stripe = getInternedStringsStripe(hash);
+    rvmLockMutex(&stripe->lock);
 
-    char* s = rvmGetStringUTFChars(env, str);
-    if (s) {
-        // Check the cache first.
-        string = findInternedString(env, s);
-        if (!string) {
-            if (addInternedString(env, s, str)) {
-                string = str;
-            }
+    Object* string = findInternedString(env, stripe, hash, chars, length, equalsChars);
+    if (!string) {
+        if (addInternedString(env, stripe, hash, str)) {
+            string = str;
         }
     }
 
-    releaseInternedStringsLock();
+    rvmUnlockMutex(&stripe->lock);
 
     return string;
 }
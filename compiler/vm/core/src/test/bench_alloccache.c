@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares the number of small object allocations per second using
+ * GC_gcj_malloc() directly (the path used before alloccache.c) with
+ * allocations from a thread local AllocCache.
+ *
+ * Usage: bench_alloccache [iterations]
+ */
+#include <robovm.h>
+#include <string.h>
+#include <time.h>
+#include <gc/gc_gcj.h>
+#include "../private.h"
+
+#define DEFAULT_ITERATIONS 20000000
+
+static Class benchClass;
+
+// Keeps the last allocated objects reachable to get some GC work going.
+static Object* volatile sink[64];
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void* allocateDirect(AllocCache* cache, size_t size) {
+    return GC_gcj_malloc(size, &benchClass);
+}
+
+static void* allocateCached(AllocCache* cache, size_t size) {
+    void* m = gcAllocateObjectFromCache(cache, size, &benchClass);
+    if (!m) {
+        m = GC_gcj_malloc(size, &benchClass);
+    }
+    return m;
+}
+
+static void run(const char* name, void* (*allocate)(AllocCache*, size_t), AllocCache* cache, size_t size, long iterations) {
+    GC_gcollect();
+    double start = now();
+    for (long i = 0; i < iterations; i++) {
+        Object* o = allocate(cache, size);
+        if (!o) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        sink[i & 63] = o;
+    }
+    double elapsed = now() - start;
+    printf("%-8s %4zu bytes: %12.0f allocations/s (%ld GCs)\n", name, size, iterations / elapsed, (long) GC_get_gc_no());
+}
+
+int main(int argc, char* argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : DEFAULT_ITERATIONS;
+
+    GC_INIT();
+    GC_init_gcj_malloc(GC_GCJ_RESERVED_MARK_PROC_INDEX, NULL);
+    memset(&benchClass, 0, sizeof(Class));
+    benchClass.gcDescriptor = (void*) GC_DS_LENGTH; // Nothing to scan
+
+    AllocCache* cache = gcNewAllocCache();
+    if (!cache) {
+        fprintf(stderr, "Failed to allocate AllocCache\n");
+        return 1;
+    }
+
+    size_t sizes[] = {sizeof(Object), 24, 32, 48, 64, 96, ALLOC_CACHE_MAX_SIZE - 1};
+    for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        run("direct", allocateDirect, cache, sizes[i], iterations);
+        run("cached", allocateCached, cache, sizes[i], iterations);
+    }
+
+    gcFreeAllocCache(cache);
+    return 0;
+}
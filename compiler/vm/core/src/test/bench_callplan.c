@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares calling methods with 0, 4 and 12 arguments through _call0()
+ * using cached CallPlans with the way the arguments were marshalled before
+ * callplan.c (the descriptor was parsed twice per call and the V variants
+ * copied the va_list into a heap allocated jvalue array). malloc() stands
+ * in for the GC allocation done by the old V variants. Also measures calls
+ * through invoker stubs like the ones the compiler emits for each call
+ * shape.
+ *
+ * Usage: bench_callplan [calls]
+ */
+#include <robovm.h>
+#include <string.h>
+#include <time.h>
+#include "../private.h"
+
+#define DEFAULT_CALLS 10000000
+
+// callplan.c only needs these from the rest of the VM.
+void* rvmAllocateMemoryAtomicUncollectable(Env* env, size_t size) {
+    return calloc(1, size);
+}
+void rvmFreeMemoryUncollectable(Env* env, void* m) {
+    free(m);
+}
+const char* rvmGetNextParameterType(const char** desc) {
+    const char* s = *desc;
+    (*desc)++;
+    switch (s[0]) {
+    case 'B':
+    case 'Z':
+    case 'S':
+    case 'C':
+    case 'I':
+    case 'J':
+    case 'F':
+    case 'D':
+        return s;
+    case '[':
+        rvmGetNextParameterType(desc);
+        return s;
+    case 'L':
+        while (**desc != ';') (*desc)++;
+        (*desc)++;
+        return s;
+    case '(':
+        return rvmGetNextParameterType(desc);
+    }
+    return 0;
+}
+const char* rvmGetReturnType(const char* desc) {
+    while (*desc != ')') desc++;
+    desc++;
+    return desc;
+}
+jint rvmGetParameterCount(Method* method) {
+    const char* desc = method->desc;
+    jint count = 0;
+    while (rvmGetNextParameterType(&desc)) {
+        count++;
+    }
+    return count;
+}
+
+// The argument marshalling used by method.c before CallPlans.
+typedef struct {
+    jint ptrArgsCount, intArgsCount, longArgsCount, floatArgsCount, doubleArgsCount;
+} ArgsCount;
+
+static void countArgs(Env* env, Method* method, ArgsCount* argsCount) {
+    memset(argsCount, 0, sizeof(ArgsCount));
+    argsCount->ptrArgsCount = 1;
+    if (!(method->access & ACC_STATIC)) {
+        argsCount->ptrArgsCount++;
+    }
+    const char* desc = method->desc;
+    const char* c;
+    while ((c = rvmGetNextParameterType(&desc))) {
+        switch (c[0]) {
+        case 'Z': case 'B': case 'S': case 'C': case 'I':
+            argsCount->intArgsCount++;
+            break;
+        case 'J':
+            argsCount->longArgsCount++;
+            break;
+        case 'F':
+            argsCount->floatArgsCount++;
+            break;
+        case 'D':
+            argsCount->doubleArgsCount++;
+            break;
+        case 'L': case '[':
+            argsCount->ptrArgsCount++;
+            break;
+        }
+    }
+}
+
+static void setArgs(Env* env, Object* obj, Method* method, CallInfo* callInfo, jvalue* args) {
+    call0AddPtr(callInfo, env);
+    if (!(method->access & ACC_STATIC)) {
+        call0AddPtr(callInfo, obj);
+    }
+    const char* desc = method->desc;
+    const char* c;
+    jint i = 0;
+    while ((c = rvmGetNextParameterType(&desc))) {
+        switch (c[0]) {
+        case 'Z': call0AddInt(callInfo, (jint) args[i++].z); break;
+        case 'B': call0AddInt(callInfo, (jint) args[i++].b); break;
+        case 'S': call0AddInt(callInfo, (jint) args[i++].s); break;
+        case 'C': call0AddInt(callInfo, (jint) args[i++].c); break;
+        case 'I': call0AddInt(callInfo, args[i++].i); break;
+        case 'J': call0AddLong(callInfo, args[i++].j); break;
+        case 'F': call0AddFloat(callInfo, args[i++].f); break;
+        case 'D': call0AddDouble(callInfo, args[i++].d); break;
+        case 'L': case '[': call0AddPtr(callInfo, args[i++].l); break;
+        }
+    }
+}
+
+static jvalue* va_list2jargs(Env* env, Method* method, va_list args) {
+    jint argsCount = rvmGetParameterCount(method);
+    jvalue* jvalueArgs = (jvalue*) malloc(sizeof(jvalue) * (argsCount + 1));
+    const char* desc = method->desc;
+    const char* c;
+    jint i = 0;
+    while ((c = rvmGetNextParameterType(&desc))) {
+        switch (c[0]) {
+        case 'B': jvalueArgs[i++].b = (jbyte) va_arg(args, jint); break;
+        case 'Z': jvalueArgs[i++].z = (jboolean) va_arg(args, jint); break;
+        case 'S': jvalueArgs[i++].s = (jshort) va_arg(args, jint); break;
+        case 'C': jvalueArgs[i++].c = (jchar) va_arg(args, jint); break;
+        case 'I': jvalueArgs[i++].i = va_arg(args, jint); break;
+        case 'J': jvalueArgs[i++].j = va_arg(args, jlong); break;
+        case 'F': jvalueArgs[i++].f = (jfloat) va_arg(args, jdouble); break;
+        case 'D': jvalueArgs[i++].d = va_arg(args, jdouble); break;
+        case '[': case 'L': jvalueArgs[i++].l = va_arg(args, jobject); break;
+        }
+    }
+    return jvalueArgs;
+}
+
+static jint target0(Env* env, Object* this) {
+    return 1;
+}
+static jint target4(Env* env, Object* this, jint a, jlong b, Object* c, jdouble d) {
+    return a + (jint) b + (jint) d;
+}
+static jint target12(Env* env, Object* this, jint a, jlong b, Object* c, jdouble d,
+        jboolean e, jbyte f, jfloat g, Object* h, jchar i, jshort j, jlong k, jdouble l) {
+    return a + (jint) b + (jint) d + e + f + (jint) g + i + j + (jint) k + (jint) l;
+}
+
+static Method method0 = {.name = "m", .desc = "()I", .impl = target0};
+static Method method4 = {.name = "m", .desc = "(IJLjava/lang/Object;D)I", .impl = target4};
+static Method method12 = {.name = "m", .desc = "(IJLjava/lang/Object;DZBF[ICSJD)I", .impl = target12};
+
+// _call0 is declared returning void. Cast through void (*)(void) to call it
+// as the jint returning function it is here.
+static jint (*call0Int)(CallInfo*) = (jint (*)(CallInfo*)) (void (*)(void)) _call0;
+
+static jint callOld(Env* env, Object* obj, Method* method, jvalue* args) {
+    ArgsCount argsCount;
+    countArgs(env, method, &argsCount);
+    CallInfo* callInfo = CALL0_ALLOCATE_CALL_INFO(env, method->impl, argsCount.ptrArgsCount, argsCount.intArgsCount, argsCount.longArgsCount, argsCount.floatArgsCount, argsCount.doubleArgsCount);
+    setArgs(env, obj, method, callInfo, args);
+    return call0Int(callInfo);
+}
+
+static jint callOldV(Env* env, Object* obj, Method* method, va_list args) {
+    jvalue* jargs = va_list2jargs(env, method, args);
+    jint result = callOld(env, obj, method, jargs);
+    free(jargs);
+    return result;
+}
+
+static jint callOldVarargs(Env* env, Object* obj, Method* method, ...) {
+    va_list args;
+    va_start(args, method);
+    jint result = callOldV(env, obj, method, args);
+    va_end(args);
+    return result;
+}
+
+#define CALL_NEW(_env, _obj, _method, _addArgs, _args) ({ \
+    CallPlan* _plan = getCallPlan(_env, _method); \
+    CallInfo* _callInfo = CALL0_ALLOCATE_CALL_INFO(_env, _method->impl, _plan->ptrArgsCount, _plan->intArgsCount, _plan->longArgsCount, _plan->floatArgsCount, _plan->doubleArgsCount); \
+    call0AddPtr(_callInfo, _env); \
+    call0AddPtr(_callInfo, _obj); \
+    _addArgs(_callInfo, _plan, _args); \
+    call0Int(_callInfo); \
+})
+
+static jint callNew(Env* env, Object* obj, Method* method, jvalue* args) {
+    return CALL_NEW(env, obj, method, addCallPlanArgs, args);
+}
+
+static jint callNewV(Env* env, Object* obj, Method* method, va_list args) {
+    return CALL_NEW(env, obj, method, addCallPlanArgsV, args);
+}
+
+static jint callNewVarargs(Env* env, Object* obj, Method* method, ...) {
+    va_list args;
+    va_start(args, method);
+    jint result = callNewV(env, obj, method, args);
+    va_end(args);
+    return result;
+}
+
+// What the compiler emits for the (L)I, (LIJLD)I and (LIJLDZBFLCSJD)I shapes.
+static void invoker0(Env* env, void* f, jvalue* args, jvalue* result) {
+    result->i = ((jint (*)(Env*, Object*)) f)(env, (Object*) args[0].l);
+}
+static void invoker4(Env* env, void* f, jvalue* args, jvalue* result) {
+    result->i = ((jint (*)(Env*, Object*, jint, jlong, Object*, jdouble)) f)(env, (Object*) args[0].l,
+            args[1].i, args[2].j, (Object*) args[3].l, args[4].d);
+}
+static void invoker12(Env* env, void* f, jvalue* args, jvalue* result) {
+    result->i = ((jint (*)(Env*, Object*, jint, jlong, Object*, jdouble, jboolean, jbyte, jfloat, Object*,
+            jchar, jshort, jlong, jdouble)) f)(env, (Object*) args[0].l,
+            args[1].i, args[2].j, (Object*) args[3].l, args[4].d, args[5].z, args[6].b, args[7].f,
+            (Object*) args[8].l, args[9].c, args[10].s, args[11].j, args[12].d);
+}
+static void* findInvoker(Env* env, const char* shape) {
+    if (!strcmp(shape, "(L)I")) return invoker0;
+    if (!strcmp(shape, "(LIJLD)I")) return invoker4;
+    if (!strcmp(shape, "(LIJLDZBFLCSJD)I")) return invoker12;
+    return NULL;
+}
+
+static jint callInvoker(Env* env, Method* method, jvalue* args) {
+    CallPlan* plan = getCallPlan(env, method);
+    jvalue result;
+    ((void (*)(Env*, void*, jvalue*, jvalue*)) plan->invoker)(env, method->impl, args, &result);
+    return result.i;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#define BENCH(_label, _calls, _expected, _call) { \
+    volatile jint _sum = 0; \
+    double _start = now(); \
+    for (long _i = 0; _i < _calls; _i++) { \
+        _sum += _call; \
+    } \
+    double _elapsed = now() - _start; \
+    if (_sum != (jint) (_calls * _expected)) { \
+        fprintf(stderr, "%s: wrong result\n", _label); \
+        exit(1); \
+    } \
+    printf("  %-10s %6.1f ns/call\n", _label, _elapsed * 1e9 / _calls); \
+}
+
+int main(int argc, char* argv[]) {
+    long calls = argc > 1 ? atol(argv[1]) : DEFAULT_CALLS;
+    Options options;
+    VM vm;
+    Env env;
+    Object obj;
+    memset(&options, 0, sizeof(options));
+    memset(&vm, 0, sizeof(vm));
+    memset(&env, 0, sizeof(env));
+    memset(&obj, 0, sizeof(obj));
+    options.findInvoker = findInvoker;
+    vm.options = &options;
+    env.vm = &vm;
+
+    jvalue args4[4] = {{.i = 1}, {.j = 2}, {.l = (jobject) &obj}, {.d = 3.0}};
+    jvalue args12[12] = {{.i = 1}, {.j = 2}, {.l = (jobject) &obj}, {.d = 3.0},
+            {.z = 1}, {.b = -1}, {.f = 2.0f}, {.l = (jobject) &obj}, {.c = 4}, {.s = -2}, {.j = 5}, {.d = 6.0}};
+    // Invoker stubs take the receiver followed by the arguments
+    jvalue invokerArgs0[1] = {{.l = (jobject) &obj}};
+    jvalue invokerArgs4[5] = {{.l = (jobject) &obj}};
+    memcpy(&invokerArgs4[1], args4, sizeof(args4));
+    jvalue invokerArgs12[13] = {{.l = (jobject) &obj}};
+    memcpy(&invokerArgs12[1], args12, sizeof(args12));
+
+    printf("0 args\n");
+    BENCH("old A", calls, 1, callOld(&env, &obj, &method0, NULL));
+    BENCH("new A", calls, 1, callNew(&env, &obj, &method0, NULL));
+    BENCH("old V", calls, 1, callOldVarargs(&env, &obj, &method0));
+    BENCH("new V", calls, 1, callNewVarargs(&env, &obj, &method0));
+    BENCH("invoker", calls, 1, callInvoker(&env, &method0, invokerArgs0));
+    printf("4 args\n");
+    BENCH("old A", calls, 6, callOld(&env, &obj, &method4, args4));
+    BENCH("new A", calls, 6, callNew(&env, &obj, &method4, args4));
+    BENCH("old V", calls, 6, callOldVarargs(&env, &obj, &method4, 1, (jlong) 2, &obj, 3.0));
+    BENCH("new V", calls, 6, callNewVarargs(&env, &obj, &method4, 1, (jlong) 2, &obj, 3.0));
+    BENCH("invoker", calls, 6, callInvoker(&env, &method4, invokerArgs4));
+    printf("12 args\n");
+    BENCH("old A", calls, 21, callOld(&env, &obj, &method12, args12));
+    BENCH("new A", calls, 21, callNew(&env, &obj, &method12, args12));
+    BENCH("old V", calls, 21, callOldVarargs(&env, &obj, &method12, 1, (jlong) 2, &obj, 3.0,
+            1, -1, 2.0, &obj, 4, -2, (jlong) 5, 6.0));
+    BENCH("new V", calls, 21, callNewVarargs(&env, &obj, &method12, 1, (jlong) 2, &obj, 3.0,
+            1, -1, 2.0, &obj, 4, -2, (jlong) 5, 6.0));
+    BENCH("invoker", calls, 21, callInvoker(&env, &method12, invokerArgs12));
+    return 0;
+}
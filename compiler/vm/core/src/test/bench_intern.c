@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares rvmInternString() and rvmNewInternedStringUTF() with the way
+ * strings were interned before the interned strings table was striped (a
+ * uthash table keyed by modified UTF-8 under a single lock) using an
+ * increasing number of threads. malloc() stands in for the GC allocations
+ * done by the old implementation.
+ *
+ * Usage: bench_intern [interns per thread] [max threads]
+ */
+#include <robovm.h>
+#include <string.h>
+#include <time.h>
+#include "../private.h"
+#include "../uthash.h"
+
+#define DEFAULT_INTERNS 2000000
+#define DEFAULT_MAX_THREADS 8
+#define DISTINCT_STRINGS 4096
+#define MAX_CACHE_SIZE 10000
+
+typedef struct {
+    Object object;
+    CharArray* value;
+    jint offset;
+    jint count;
+} String;
+
+// string.c only needs these from the rest of the VM.
+void* rvmAllocateMemoryAtomic(Env* env, size_t size) {
+    return malloc(size);
+}
+void* rvmAllocateMemoryAtomicUncollectable(Env* env, size_t size) {
+    return malloc(size);
+}
+void rvmFreeMemoryUncollectable(Env* env, void* m) {
+    free(m);
+}
+void rvmRegisterDisappearingLink(Env* env, void** address, Object* obj) {
+}
+void rvmUnregisterDisappearingLink(Env* env, void** address) {
+}
+Object* rvmReadDisappearingLink(Env* env, void** address) {
+    return *address;
+}
+CharArray* rvmNewCharArray(Env* env, jint length) {
+    CharArray* array = calloc(1, sizeof(CharArray) + sizeof(jchar) * length);
+    array->length = length;
+    return array;
+}
+Object* rvmRTNewString(Env* env, CharArray* value, jint offset, jint length) {
+    String* s = calloc(1, sizeof(String));
+    s->value = value;
+    s->offset = offset;
+    s->count = length;
+    return (Object*) s;
+}
+jint rvmRTGetStringLength(Env* env, Object* str) {
+    return ((String*) str)->count;
+}
+jchar* rvmRTGetStringChars(Env* env, Object* str) {
+    String* s = (String*) str;
+    return s->value->values + s->offset;
+}
+
+// The interned strings cache used before string.c used a striped table.
+typedef struct CacheEntry {
+    const char* key;
+    Object* string;
+    UT_hash_handle hh;
+} CacheEntry;
+static CacheEntry* oldInternedStrings = NULL;
+static pthread_mutex_t oldInternedStringsLock = PTHREAD_MUTEX_INITIALIZER;
+
+static Object* oldInternString(Env* env, Object* str) {
+    pthread_mutex_lock(&oldInternedStringsLock);
+    Object* string = NULL;
+    char* s = rvmGetStringUTFChars(env, str);
+    CacheEntry* cacheEntry;
+    HASH_FIND_STR(oldInternedStrings, s, cacheEntry);
+    if (cacheEntry) {
+        HASH_DELETE(hh, oldInternedStrings, cacheEntry);
+        HASH_ADD_KEYPTR(hh, oldInternedStrings, cacheEntry->key, strlen(cacheEntry->key), cacheEntry);
+        string = cacheEntry->string;
+        free(s);
+    } else {
+        cacheEntry = calloc(1, sizeof(CacheEntry));
+        cacheEntry->key = s;
+        cacheEntry->string = str;
+        HASH_ADD_KEYPTR(hh, oldInternedStrings, cacheEntry->key, strlen(cacheEntry->key), cacheEntry);
+        if (HASH_COUNT(oldInternedStrings) >= MAX_CACHE_SIZE) {
+            CacheEntry* tmpEntry;
+            HASH_ITER(hh, oldInternedStrings, cacheEntry, tmpEntry) {
+                HASH_DELETE(hh, oldInternedStrings, cacheEntry);
+                break;
+            }
+        }
+        string = str;
+    }
+    pthread_mutex_unlock(&oldInternedStringsLock);
+    return string;
+}
+
+static char* utf8Strings[DISTINCT_STRINGS];
+
+typedef struct {
+    long interns;
+    Object** strings; // A private copy of each of the distinct strings
+    Object** results;
+    jboolean old;
+    jboolean utf8;
+    pthread_t thread;
+} Work;
+
+static void* internThread(void* data) {
+    Work* work = (Work*) data;
+    Env env;
+    memset(&env, 0, sizeof(env));
+    for (long i = 0; i < work->interns; i++) {
+        jint j = (jint) ((i * 2654435761u) % DISTINCT_STRINGS);
+        Object* s;
+        if (work->utf8) {
+            s = rvmNewInternedStringUTF(&env, utf8Strings[j], -1);
+        } else if (work->old) {
+            s = oldInternString(&env, work->strings[j]);
+        } else {
+            s = rvmInternString(&env, work->strings[j]);
+        }
+        work->results[j] = s;
+    }
+    return NULL;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static Object* newString(const char* s) {
+    return rvmNewStringUTF(NULL, s, -1);
+}
+
+static void run(const char* label, jint threads, long interns, jboolean old, jboolean utf8) {
+    Work* works = calloc(threads, sizeof(Work));
+    for (jint t = 0; t < threads; t++) {
+        works[t].interns = interns;
+        works[t].old = old;
+        works[t].utf8 = utf8;
+        works[t].strings = calloc(DISTINCT_STRINGS, sizeof(Object*));
+        works[t].results = calloc(DISTINCT_STRINGS, sizeof(Object*));
+        for (jint j = 0; j < DISTINCT_STRINGS; j++) {
+            works[t].strings[j] = newString(utf8Strings[j]);
+        }
+    }
+    double start = now();
+    for (jint t = 0; t < threads; t++) {
+        pthread_create(&works[t].thread, NULL, internThread, &works[t]);
+    }
+    for (jint t = 0; t < threads; t++) {
+        pthread_join(works[t].thread, NULL);
+    }
+    double elapsed = now() - start;
+    for (jint t = 1; t < threads; t++) {
+        for (jint j = 0; j < DISTINCT_STRINGS; j++) {
+            if (works[t].results[j] != works[0].results[j]) {
+                fprintf(stderr, "%s: strings interned by different threads differ\n", label);
+                exit(1);
+            }
+        }
+    }
+    printf("  %-24s %2d threads: %6.1f ns/intern\n", label, threads, elapsed * 1e9 / (interns * threads));
+}
+
+int main(int argc, char* argv[]) {
+    long interns = argc > 1 ? atol(argv[1]) : DEFAULT_INTERNS;
+    jint maxThreads = argc > 2 ? atoi(argv[2]) : DEFAULT_MAX_THREADS;
+
+    rvmInitStrings(NULL);
+    for (jint j = 0; j < DISTINCT_STRINGS; j++) {
+        char buf[64];
+        // Mix ASCII identifiers with some non-ASCII strings
+        if (j % 8 == 0) {
+            snprintf(buf, sizeof(buf), "\xc3\xa5\xc3\xa4\xc3\xb6-%d", j);
+        } else {
+            snprintf(buf, sizeof(buf), "org.example.json.field%d", j);
+        }
+        utf8Strings[j] = strdup(buf);
+    }
+
+    for (jint threads = 1; threads <= maxThreads; threads <<= 1) {
+        run("old rvmInternString", threads, interns, TRUE, FALSE);
+        run("rvmInternString", threads, interns, FALSE, FALSE);
+        run("rvmNewInternedStringUTF", threads, interns, FALSE, TRUE);
+    }
+    return 0;
+}
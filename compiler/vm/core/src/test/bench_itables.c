@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares the ITable lookup done by invokeinterface
+ * (_bcLookupInterfaceMethodImpl() in bc.c) using rvmFindITable() with the
+ * way it was done before ITables had several cache slots (a single cache
+ * entry shared by all call sites which was overwritten on every miss).
+ * Each iteration looks up 2 or, like InterfaceDispatchTest, 6 interfaces
+ * implemented by two classes in turn. Threads share the classes' ITables
+ * just like call sites in different threads do.
+ *
+ * Usage: bench_itables [lookups per thread] [max threads]
+ */
+#include <robovm.h>
+#include <string.h>
+#include <time.h>
+#include "../private.h"
+
+#define DEFAULT_LOOKUPS 20000000
+#define DEFAULT_MAX_THREADS 8
+#define INTERFACES 6
+#define CLASSES 2
+
+// ITables before rvmFindITable().
+typedef struct {
+    uint16_t count;
+    ITable* cache;
+    ITable* table[INTERFACES];
+} OldITables;
+
+static ITable* oldFindITable(OldITables* itables, TypeInfo* typeInfo) {
+    ITable* itable = itables->cache;
+    if (itable->typeInfo == typeInfo) {
+        return itable;
+    }
+    for (uint32_t i = 0; i < itables->count; i++) {
+        itable = itables->table[i];
+        if (itable->typeInfo == typeInfo) {
+            itables->cache = itable;
+            return itable;
+        }
+    }
+    return NULL;
+}
+
+static TypeInfo* typeInfos[INTERFACES];
+static ITables* newITables[CLASSES];
+static OldITables* oldITables[CLASSES];
+
+static void initITables(void) {
+    // Interface ids are handed out in load order and are usually close
+    for (jint i = 0; i < INTERFACES; i++) {
+        typeInfos[i] = calloc(1, sizeof(TypeInfo));
+        typeInfos[i]->id = 0x10000100 + i;
+    }
+    for (jint c = 0; c < CLASSES; c++) {
+        newITables[c] = calloc(1, sizeof(ITables) + sizeof(ITable*) * INTERFACES);
+        oldITables[c] = calloc(1, sizeof(OldITables));
+        newITables[c]->count = INTERFACES;
+        oldITables[c]->count = INTERFACES;
+        for (jint i = 0; i < INTERFACES; i++) {
+            ITable* itable = calloc(1, sizeof(ITable) + sizeof(void*));
+            itable->typeInfo = typeInfos[i];
+            itable->table.size = 1;
+            itable->table.table[0] = (void*) (intptr_t) (c * INTERFACES + i + 1);
+            newITables[c]->table[i] = itable;
+            oldITables[c]->table[i] = itable;
+        }
+        for (jint i = 0; i < ITABLES_CACHE_SIZE; i++) {
+            newITables[c]->cache[i] = newITables[c]->table[0];
+        }
+        oldITables[c]->cache = oldITables[c]->table[0];
+    }
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    long lookups;
+    jint interfaces;
+    jboolean old;
+    intptr_t sum;
+    pthread_t thread;
+} Work;
+
+static void* lookupThread(void* data) {
+    Work* work = (Work*) data;
+    intptr_t sum = 0;
+    jint interfaces = work->interfaces;
+    for (long i = 0; i < work->lookups; i += interfaces) {
+        jint c = (i / interfaces) & (CLASSES - 1);
+        for (jint j = 0; j < interfaces; j++) {
+            ITable* itable = work->old
+                ? oldFindITable(oldITables[c], typeInfos[j])
+                : rvmFindITable(newITables[c], typeInfos[j]);
+            sum += (intptr_t) itable->table.table[0];
+        }
+    }
+    work->sum = sum;
+    return NULL;
+}
+
+static void run(const char* label, jint interfaces, jint threads, long lookups, jboolean old) {
+    Work* works = calloc(threads, sizeof(Work));
+    double start = now();
+    for (jint t = 0; t < threads; t++) {
+        works[t].lookups = lookups;
+        works[t].interfaces = interfaces;
+        works[t].old = old;
+        pthread_create(&works[t].thread, NULL, lookupThread, &works[t]);
+    }
+    for (jint t = 0; t < threads; t++) {
+        pthread_join(works[t].thread, NULL);
+    }
+    double elapsed = now() - start;
+    for (jint t = 1; t < threads; t++) {
+        if (works[t].sum != works[0].sum) {
+            fprintf(stderr, "%s: wrong ITable found\n", label);
+            exit(1);
+        }
+    }
+    printf("  %-16s %d interfaces %2d threads: %6.1f ns/lookup\n", label, interfaces, threads,
+        elapsed * 1e9 / (lookups * threads));
+    free(works);
+}
+
+int main(int argc, char* argv[]) {
+    long lookups = argc > 1 ? atol(argv[1]) : DEFAULT_LOOKUPS;
+    jint maxThreads = argc > 2 ? atoi(argv[2]) : DEFAULT_MAX_THREADS;
+
+    initITables();
+
+    for (jint interfaces = 2; interfaces <= INTERFACES; interfaces += INTERFACES - 2) {
+        for (jint threads = 1; threads <= maxThreads; threads <<= 1) {
+            run("single cache", interfaces, threads, lookups, TRUE);
+            run("rvmFindITable", interfaces, threads, lookups, FALSE);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares the time it takes to look up a Method by name and descriptor
+ * by walking the Class' method list (what findMethod() in method.c did
+ * before memberindex.c) with lookupMethod() for classes with an increasing
+ * number of methods. Then looks up methods in an increasing number of
+ * classes which makes the table of indexes grow.
+ *
+ * Usage: bench_memberindex [lookups]
+ */
+#include <robovm.h>
+#include <string.h>
+#include <time.h>
+#include "../private.h"
+
+#define DEFAULT_LOOKUPS 2000000
+#define MAX_METHODS 1024
+#define MAX_CLASSES 65536
+
+// memberindex.c only needs these from the rest of the VM.
+void* rvmAllocateMemoryAtomicUncollectable(Env* env, size_t size) {
+    return malloc(size);
+}
+void rvmFreeMemoryUncollectable(Env* env, void* m) {
+    free(m);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static Method* findMethodLinear(Env* env, Class* clazz, Method* methods, const char* name, const char* desc) {
+    for (Method* method = methods; method != NULL; method = method->next) {
+        if (!strcmp(method->name, name) && !strcmp(method->desc, desc)) {
+            return method;
+        }
+    }
+    return NULL;
+}
+
+static Class* newClass(char** names, jint count) {
+    Class* clazz = calloc(1, sizeof(Class));
+    clazz->flags = CLASS_STATE_INITIALIZED;
+    for (jint i = 0; i < count; i++) {
+        Method* m = calloc(1, sizeof(Method));
+        m->clazz = clazz;
+        m->name = names[i];
+        m->desc = "()V";
+        m->next = clazz->_methods;
+        clazz->_methods = m;
+    }
+    return clazz;
+}
+
+static void run(const char* name, Method* (*lookup)(Env*, Class*, Method*, const char*, const char*),
+        Env* env, Class* clazz, char** names, jint count, long lookups) {
+
+    // Warm up. Builds the index in the indexed case.
+    lookup(env, clazz, clazz->_methods, names[0], "()V");
+    double start = now();
+    for (long i = 0; i < lookups; i++) {
+        Method* m = lookup(env, clazz, clazz->_methods, names[i % count], "()V");
+        if (!m) {
+            fprintf(stderr, "Method %s not found\n", names[i % count]);
+            exit(1);
+        }
+    }
+    double elapsed = now() - start;
+    printf("%-8s %5d methods: %8.1f ns/lookup\n", name, count, elapsed * 1e9 / lookups);
+}
+
+int main(int argc, char* argv[]) {
+    long lookups = argc > 1 ? atol(argv[1]) : DEFAULT_LOOKUPS;
+    Env env;
+    memset(&env, 0, sizeof(Env));
+
+    // Names passed to the lookup functions are separate copies to avoid the
+    // pointer equality fast path. JNI callers pass their own strings.
+    char* names[MAX_METHODS];
+    char* lookupNames[MAX_METHODS];
+    for (jint i = 0; i < MAX_METHODS; i++) {
+        char s[32];
+        snprintf(s, sizeof(s), "method%d", i);
+        names[i] = strdup(s);
+        lookupNames[i] = strdup(s);
+    }
+
+    for (jint count = 1; count <= MAX_METHODS; count <<= 1) {
+        Class* clazz = newClass(names, count);
+        run("linear", findMethodLinear, &env, clazz, lookupNames, count, lookups);
+        run("indexed", lookupMethod, &env, clazz, lookupNames, count, lookups);
+    }
+
+    for (jint classCount = 16; classCount <= MAX_CLASSES; classCount <<= 2) {
+        Class** classes = calloc(classCount, sizeof(Class*));
+        for (jint c = 0; c < classCount; c++) {
+            classes[c] = newClass(names, 16);
+        }
+        double start = now();
+        for (long i = 0; i < lookups; i++) {
+            Class* clazz = classes[i % classCount];
+            Method* m = lookupMethod(&env, clazz, clazz->_methods, lookupNames[i & 15], "()V");
+            if (!m || m->clazz != clazz) {
+                fprintf(stderr, "Method %s not found\n", lookupNames[i & 15]);
+                exit(1);
+            }
+        }
+        double elapsed = now() - start;
+        printf("%-8s %5d classes: %8.1f ns/lookup\n", "indexed", classCount, elapsed * 1e9 / lookups);
+    }
+
+    return 0;
+}
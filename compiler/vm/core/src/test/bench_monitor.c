@@ -0,0 +1,513 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares rvmLockObject()/rvmUnlockObject() with and without biased
+ * locking for uncontended, recursive and contended locking. The
+ * uncontended and recursive cases are also run through a C copy of the
+ * inline monitorenter and monitorexit fast paths in header.ll which is
+ * what compiled synchronized blocks use. Also measures
+ * the cost of revoking a bias. The contended case is run with 2 to 64
+ * threads and reports the longest time any thread waited for the lock.
+ * Also measures how long threads waiting for a thin lock take to notice
+ * that it has been released. Finally measures inflating the locks of
+ * many short lived objects with deflateMonitors() run periodically like
+ * after a garbage collection.
+ *
+ * Usage: bench_monitor [iterations]
+ */
+#define _GNU_SOURCE
+#include <robovm.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <semaphore.h>
+#include <errno.h>
+#include "../private.h"
+
+#define DEFAULT_ITERATIONS 20000000
+#define REVOCATIONS 10000
+#define MAX_THREADS 64
+#define HANDOFF_ROUNDS 100
+#define INFLATIONS 200000
+#define DEFLATE_INTERVAL 1000
+#define BIAS_REVOCATION_SIGNAL (SIGRTMIN + 3)
+
+// monitor.c only needs these from the rest of the VM.
+static long monitorsAllocated = 0;
+void* rvmAllocateMemoryAtomicUncollectable(Env* env, size_t size) {
+    monitorsAllocated++;
+    return calloc(1, size);
+}
+void rvmFreeMemoryUncollectable(Env* env, void* m) {
+    free(m);
+}
+// Objects are made unreachable by pointing their clazz at deadClass.
+static Class deadClass;
+jboolean gcIsLive(void* ptr) {
+    return ((Object*) ptr)->clazz != &deadClass;
+}
+jint rvmChangeThreadStatus(Env* env, RvmThread* thread, jint newStatus) {
+    jint oldStatus = thread->status;
+    thread->status = newStatus;
+    return oldStatus;
+}
+void rvmAbort(char* format, ...) {
+    abort();
+}
+int rvmLog(int level, const char* tag, const char* text) {
+    return 0;
+}
+int rvmLogf(int level, const char* tag, const char* format, ...) {
+    return 0;
+}
+static jboolean fail(const char* message) {
+    fprintf(stderr, "%s\n", message);
+    exit(1);
+    return FALSE;
+}
+jboolean rvmThrowIllegalArgumentException(Env* env, const char* message) {
+    return fail(message);
+}
+jboolean rvmThrowIllegalMonitorStateException(Env* env, const char* message) {
+    return fail(message);
+}
+jboolean rvmThrowInterruptedException(Env* env) {
+    return fail("interrupted");
+}
+
+// A minimal version of the thread list and the revocation handshake in
+// signal.c.
+static pthread_mutex_t threadsLock = PTHREAD_MUTEX_INITIALIZER;
+static RvmThread* threads[MAX_THREADS + 2];
+static sem_t revocationSemaphore;
+static __thread Env* currentEnv;
+
+void rvmLockThreadsList() {
+    pthread_mutex_lock(&threadsLock);
+}
+void rvmUnlockThreadsList() {
+    pthread_mutex_unlock(&threadsLock);
+}
+RvmThread* rvmGetThreadByThreadId(Env* env, uint32_t threadId) {
+    return threadId < MAX_THREADS + 2 ? threads[threadId] : NULL;
+}
+jboolean signalBiasRevocation(Env* env, RvmThread* thread) {
+    return pthread_kill(thread->pThread, BIAS_REVOCATION_SIGNAL) == 0 ? TRUE : FALSE;
+}
+jboolean waitBiasRevocation(jint timeoutMillis) {
+    if (timeoutMillis < 0) {
+        while (sem_wait(&revocationSemaphore) == -1 && errno == EINTR) {
+        }
+        return TRUE;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += timeoutMillis * 1000000L;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+    while (sem_timedwait(&revocationSemaphore, &deadline) == -1) {
+        if (errno != EINTR) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+void ackBiasRevocation(void) {
+    sem_post(&revocationSemaphore);
+}
+static void revokeBiasHandler(int signum, siginfo_t* info, void* context) {
+    if (currentEnv) {
+        revokeRequestedBias(currentEnv->currentThread);
+    }
+}
+
+static Options options;
+static VM vm;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static Env* attach(jint threadId) {
+    Env* env = calloc(1, sizeof(Env));
+    RvmThread* thread = calloc(1, sizeof(RvmThread));
+    env->vm = &vm;
+    env->currentThread = thread;
+    thread->env = env;
+    thread->threadId = threadId;
+    thread->pThread = pthread_self();
+    thread->status = THREAD_RUNNING;
+    rvmLockThreadsList();
+    threads[threadId] = thread;
+    rvmUnlockThreadsList();
+    currentEnv = env;
+    return env;
+}
+
+static void detach(Env* env) {
+    rvmLockThreadsList();
+    threads[env->currentThread->threadId] = NULL;
+    rvmUnlockThreadsList();
+    currentEnv = NULL;
+}
+
+static Object* newObject(void) {
+    return calloc(1, sizeof(Object));
+}
+
+/*
+ * C versions of monitorenter and monitorexit in header.ll. Keep in sync.
+ * Calls to rvmLockObject() and rvmUnlockObject() stand in for the calls to
+ * _bcMonitorEnter() and _bcMonitorExit() which also push a GatewayFrame.
+ */
+extern uint32_t biasedLockBits;
+
+static inline void leaveBiasedLockOpInline(RvmThread* thread) {
+    thread->inBiasedLockOp = FALSE;
+    if (thread->biasRevocationRequest) {
+        revokeRequestedBias(thread);
+    }
+}
+
+static inline void monitorEnterInline(Env* env, Object* o) {
+    volatile uint32_t* lockPtr = (volatile uint32_t*) &o->lock;
+    uint32_t thin = *lockPtr;
+    if ((thin & 1) == 0) {
+        uint32_t owner = (thin >> 3) & 0xffff;
+        RvmThread* thread = env->currentThread;
+        uint32_t threadId = thread->threadId;
+        if (owner == 0) {
+            uint32_t newThin = thin | (threadId << 3) | ((thin & 4) ? 0 : biasedLockBits);
+            if (__sync_bool_compare_and_swap(lockPtr, thin, newThin)) {
+                return;
+            }
+        } else if (owner == (threadId | 0x8000)) {
+            jboolean locked = FALSE;
+            thread->inBiasedLockOp = TRUE;
+            uint32_t biased = *lockPtr;
+            if ((biased & 0x7fff9) == (owner << 3) && (biased >> 19) < 0x1fff) {
+                *lockPtr = biased + (1 << 19);
+                locked = TRUE;
+            }
+            leaveBiasedLockOpInline(thread);
+            if (locked) {
+                return;
+            }
+        }
+    }
+    rvmLockObject(env, o);
+}
+
+static inline void monitorExitInline(Env* env, Object* o) {
+    volatile uint32_t* lockPtr = (volatile uint32_t*) &o->lock;
+    uint32_t thin = *lockPtr;
+    if ((thin & 1) == 0) {
+        uint32_t owner = (thin >> 3) & 0xffff;
+        RvmThread* thread = env->currentThread;
+        uint32_t threadId = thread->threadId;
+        if (owner == threadId) {
+            if (((thin >> 19) & 0x1fff) == 0 && (thin & 2) == 0
+                    && __sync_bool_compare_and_swap(lockPtr, thin, thin & 4)) {
+                return;
+            }
+        } else if (owner == (threadId | 0x8000)) {
+            jboolean unlocked = FALSE;
+            thread->inBiasedLockOp = TRUE;
+            uint32_t biased = *lockPtr;
+            if ((biased & 0x7fff9) == (owner << 3) && (biased >> 19) != 0) {
+                *lockPtr = biased - (1 << 19);
+                unlocked = TRUE;
+            }
+            leaveBiasedLockOpInline(thread);
+            if (unlocked) {
+                return;
+            }
+        }
+    }
+    rvmUnlockObject(env, o);
+}
+
+static double uncontendedInline(Env* env, long iterations) {
+    Object* o = newObject();
+    double start = now();
+    for (long i = 0; i < iterations; i++) {
+        monitorEnterInline(env, o);
+        monitorExitInline(env, o);
+    }
+    return now() - start;
+}
+
+static double recursiveInline(Env* env, long iterations) {
+    Object* o = newObject();
+    monitorEnterInline(env, o);
+    double start = now();
+    for (long i = 0; i < iterations; i++) {
+        monitorEnterInline(env, o);
+        monitorExitInline(env, o);
+    }
+    double elapsed = now() - start;
+    monitorExitInline(env, o);
+    return elapsed;
+}
+
+static double uncontended(Env* env, long iterations) {
+    Object* o = newObject();
+    double start = now();
+    for (long i = 0; i < iterations; i++) {
+        rvmLockObject(env, o);
+        rvmUnlockObject(env, o);
+    }
+    return now() - start;
+}
+
+static double recursive(Env* env, long iterations) {
+    Object* o = newObject();
+    rvmLockObject(env, o);
+    double start = now();
+    for (long i = 0; i < iterations; i++) {
+        rvmLockObject(env, o);
+        rvmUnlockObject(env, o);
+    }
+    double elapsed = now() - start;
+    rvmUnlockObject(env, o);
+    return elapsed;
+}
+
+typedef struct {
+    Object* lock;
+    Object** objects;
+    long iterations;
+    volatile long* counter;
+    jint threadId;
+    double maxWait;
+    pthread_t thread;
+} Work;
+
+static void lockAndCount(Env* env, Work* work) {
+    for (long i = 0; i < work->iterations; i++) {
+        double start = now();
+        rvmLockObject(env, work->lock);
+        double wait = now() - start;
+        (*work->counter)++;
+        rvmUnlockObject(env, work->lock);
+        if (wait > work->maxWait) {
+            work->maxWait = wait;
+        }
+    }
+}
+
+static void* contendedThread(void* data) {
+    Work* work = (Work*) data;
+    Env* env = attach(work->threadId);
+    lockAndCount(env, work);
+    detach(env);
+    return NULL;
+}
+
+static double contended(Env* env, long iterations, jint threadCount, double* maxWait) {
+    volatile long counter = 0;
+    Object* lock = newObject();
+    Work* works = calloc(threadCount, sizeof(Work));
+    for (jint t = 0; t < threadCount; t++) {
+        works[t] = (Work) {lock, NULL, iterations / threadCount, &counter, t + 1, 0};
+    }
+    double start = now();
+    for (jint t = 1; t < threadCount; t++) {
+        pthread_create(&works[t].thread, NULL, contendedThread, &works[t]);
+    }
+    lockAndCount(env, &works[0]);
+    *maxWait = works[0].maxWait;
+    for (jint t = 1; t < threadCount; t++) {
+        pthread_join(works[t].thread, NULL);
+        if (works[t].maxWait > *maxWait) {
+            *maxWait = works[t].maxWait;
+        }
+    }
+    double elapsed = now() - start;
+    if (counter != works[0].iterations * threadCount) {
+        fail("lost update");
+    }
+    free(works);
+    return elapsed;
+}
+
+/*
+ * Measures how long it takes from the release of a thin lock held for a
+ * while until all the threads waiting for it have acquired it.
+ */
+typedef struct {
+    Object** objects;
+    volatile long* round;
+    volatile long* done;
+    volatile double* releaseTime;
+    double maxDelay;
+    jint threadId;
+    pthread_t thread;
+} Handoff;
+
+static void* handoffThread(void* data) {
+    Handoff* h = (Handoff*) data;
+    Env* env = attach(h->threadId);
+    for (long r = 1; r <= HANDOFF_ROUNDS; r++) {
+        while (*h->round < r) {
+            sched_yield();
+        }
+        rvmLockObject(env, h->objects[r - 1]);
+        double delay = now() - *h->releaseTime;
+        rvmUnlockObject(env, h->objects[r - 1]);
+        if (delay > h->maxDelay) {
+            h->maxDelay = delay;
+        }
+        __sync_fetch_and_add(h->done, 1);
+    }
+    detach(env);
+    return NULL;
+}
+
+static double handoff(Env* env, jint threadCount) {
+    Object** objects = calloc(HANDOFF_ROUNDS, sizeof(Object*));
+    volatile long round = 0;
+    volatile long done = 0;
+    volatile double releaseTime = 0;
+    Handoff* hs = calloc(threadCount, sizeof(Handoff));
+    for (long r = 0; r < HANDOFF_ROUNDS; r++) {
+        objects[r] = newObject();
+    }
+    for (jint t = 0; t < threadCount; t++) {
+        hs[t] = (Handoff) {objects, &round, &done, &releaseTime, 0, t + 2};
+        pthread_create(&hs[t].thread, NULL, handoffThread, &hs[t]);
+    }
+    struct timespec hold = {0, 200000};
+    for (long r = 1; r <= HANDOFF_ROUNDS; r++) {
+        rvmLockObject(env, objects[r - 1]);
+        round = r;
+        nanosleep(&hold, NULL);
+        releaseTime = now();
+        rvmUnlockObject(env, objects[r - 1]);
+        while (done < r * threadCount) {
+            sched_yield();
+        }
+    }
+    double maxDelay = 0;
+    for (jint t = 0; t < threadCount; t++) {
+        pthread_join(hs[t].thread, NULL);
+        if (hs[t].maxDelay > maxDelay) {
+            maxDelay = hs[t].maxDelay;
+        }
+    }
+    free(hs);
+    return maxDelay;
+}
+
+/*
+ * Inflates the locks of INFLATIONS objects by waiting on them. Every
+ * DEFLATE_INTERVAL objects half of the objects are made unreachable and
+ * the monitors are deflated.
+ */
+static double inflations(Env* env, long* allocated) {
+    Object* objects[DEFLATE_INTERVAL];
+    long before = monitorsAllocated;
+    double start = now();
+    for (long i = 0; i < INFLATIONS; i++) {
+        Object* o = objects[i % DEFLATE_INTERVAL] = newObject();
+        rvmLockObject(env, o);
+        rvmObjectWait(env, o, 0, 1, FALSE);
+        rvmUnlockObject(env, o);
+        if ((i + 1) % DEFLATE_INTERVAL == 0) {
+            for (long j = 0; j < DEFLATE_INTERVAL; j += 2) {
+                objects[j]->clazz = &deadClass;
+            }
+            deflateMonitors();
+        }
+    }
+    *allocated = monitorsAllocated - before;
+    return now() - start;
+}
+
+static void* revokingThread(void* data) {
+    Work* work = (Work*) data;
+    Env* env = attach(2);
+    for (long i = 0; i < work->iterations; i++) {
+        rvmLockObject(env, work->objects[i]);
+        rvmUnlockObject(env, work->objects[i]);
+    }
+    detach(env);
+    return NULL;
+}
+
+static double revocations(Env* env, long count) {
+    Object** objects = calloc(count, sizeof(Object*));
+    for (long i = 0; i < count; i++) {
+        objects[i] = newObject();
+        rvmLockObject(env, objects[i]);
+        rvmUnlockObject(env, objects[i]);
+    }
+    Work work = {NULL, objects, count, NULL};
+    pthread_t t;
+    double start = now();
+    pthread_create(&t, NULL, revokingThread, &work);
+    pthread_join(t, NULL);
+    return now() - start;
+}
+
+static void run(const char* name, Env* env, long iterations) {
+    printf("%s\n", name);
+    printf("  uncontended: %6.1f ns/lock\n", uncontended(env, iterations) * 1e9 / iterations);
+    printf("  recursive:   %6.1f ns/lock\n", recursive(env, iterations) * 1e9 / iterations);
+    printf("  uncontended (inline fast path): %6.1f ns/lock\n", uncontendedInline(env, iterations) * 1e9 / iterations);
+    printf("  recursive (inline fast path):   %6.1f ns/lock\n", recursiveInline(env, iterations) * 1e9 / iterations);
+    long n = iterations / 10;
+    for (jint threadCount = 2; threadCount <= MAX_THREADS; threadCount <<= 1) {
+        double maxWait;
+        double elapsed = contended(env, n, threadCount, &maxWait);
+        printf("  contended (%2d threads): %6.1f ns/lock, max wait %8.3f ms\n",
+                threadCount, elapsed * 1e9 / n, maxWait * 1e3);
+    }
+    for (jint threadCount = 1; threadCount < MAX_THREADS; threadCount <<= 1) {
+        printf("  thin lock released to %2d waiting threads: all acquired after %8.3f ms\n",
+                threadCount, handoff(env, threadCount) * 1e3);
+    }
+    printf("  first lock by another thread: %6.1f us/object\n", revocations(env, REVOCATIONS) * 1e6 / REVOCATIONS);
+    long allocated;
+    double elapsed = inflations(env, &allocated);
+    printf("  inflate and deflate: %6.1f us/object, %ld monitors allocated for %d inflations\n",
+            elapsed * 1e6 / INFLATIONS, allocated, INFLATIONS);
+}
+
+int main(int argc, char* argv[]) {
+    long iterations = argc > 1 ? atol(argv[1]) : DEFAULT_ITERATIONS;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_SIGINFO;
+    sa.sa_sigaction = revokeBiasHandler;
+    sigaction(BIAS_REVOCATION_SIGNAL, &sa, NULL);
+    sem_init(&revocationSemaphore, 0, 0);
+
+    vm.options = &options;
+    Env* env = attach(1);
+
+    rvmInitMonitors(env);
+    run("thin locks", env, iterations);
+    options.enableBiasedLocking = TRUE;
+    rvmInitMonitors(env);
+    run("biased locks", env, iterations);
+    return 0;
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares the way rvmRegisterReference() registers references in
+ * memory.c (sharded referents table, finalizer registered once per
+ * referent outside the shard lock) with the way it was done before (one
+ * referents table under a single lock, finalizer registered on every
+ * call with the lock held) using an increasing number of threads.
+ *
+ * memory.c can't be linked without the GC so both registration paths are
+ * copied here. A mutex stands in for the GC allocation lock taken by
+ * GC_REGISTER_FINALIZER_NO_ORDER() and by the allocations, which are done
+ * with malloc().
+ *
+ * Two workloads are measured:
+ *   WeakHashMap  every reference has a new referent, like the keys put
+ *                into a WeakHashMap.
+ *   shared       8 references per referent, like caches which hand out
+ *                several references to the same object.
+ *
+ * Usage: bench_referents [registrations per thread] [max threads]
+ */
+#include <robovm.h>
+#include <string.h>
+#include <time.h>
+#include "../private.h"
+#include "../uthash.h"
+#include "../utlist.h"
+
+#define DEFAULT_REGISTRATIONS 100000
+#define DEFAULT_MAX_THREADS 8
+#define REFERENTS_SHARDS_BITS 6
+#define REFERENTS_SHARDS (1 << REFERENTS_SHARDS_BITS)
+
+typedef struct ReferenceList {
+    struct ReferenceList* next;
+    Object* reference;
+} ReferenceList;
+typedef struct ReferentEntry {
+    void* key;
+    ReferenceList* references;
+    UT_hash_handle hh;
+} ReferentEntry;
+typedef struct {
+    pthread_mutex_t lock;
+    ReferentEntry* referents;
+} ReferentsShard;
+
+// Stands in for the GC's allocation lock and finalizer table.
+typedef struct Finalizable {
+    void* key;
+    UT_hash_handle hh;
+} Finalizable;
+static pthread_mutex_t gcLock = PTHREAD_MUTEX_INITIALIZER;
+static Finalizable* finalizables = NULL;
+
+static void* gcMalloc(size_t size) {
+    pthread_mutex_lock(&gcLock);
+    void* m = calloc(1, size);
+    pthread_mutex_unlock(&gcLock);
+    return m;
+}
+
+static void gcRegisterFinalizer(Object* o) {
+    pthread_mutex_lock(&gcLock);
+    Finalizable* f;
+    HASH_FIND_PTR(finalizables, &o, f);
+    if (!f) {
+        f = calloc(1, sizeof(Finalizable));
+        f->key = o;
+        HASH_ADD_PTR(finalizables, key, f);
+    }
+    pthread_mutex_unlock(&gcLock);
+}
+
+static ReferentsShard oldReferents = {PTHREAD_MUTEX_INITIALIZER, NULL};
+static ReferentsShard referentsShards[REFERENTS_SHARDS];
+
+static void oldRegisterReference(Object* reference, Object* referent) {
+    pthread_mutex_lock(&oldReferents.lock);
+    void* key = referent;
+    ReferentEntry* referentEntry;
+    HASH_FIND_PTR(oldReferents.referents, &key, referentEntry);
+    if (!referentEntry) {
+        referentEntry = gcMalloc(sizeof(ReferentEntry));
+        referentEntry->key = key;
+        HASH_ADD_PTR(oldReferents.referents, key, referentEntry);
+    }
+    ReferenceList* l = gcMalloc(sizeof(ReferenceList));
+    l->reference = reference;
+    LL_PREPEND(referentEntry->references, l);
+    gcRegisterFinalizer(referent);
+    pthread_mutex_unlock(&oldReferents.lock);
+}
+
+static inline ReferentsShard* getReferentsShard(Object* o) {
+    uint32_t h = (uint32_t) ((uintptr_t) o >> 3) * 2654435761u;
+    return &referentsShards[h >> (32 - REFERENTS_SHARDS_BITS)];
+}
+
+static void registerReference(Object* reference, Object* referent) {
+    ReferentsShard* shard = getReferentsShard(referent);
+    jboolean created = FALSE;
+    ReferenceList* l = gcMalloc(sizeof(ReferenceList));
+    l->reference = reference;
+    void* key = referent;
+    ReferentEntry* referentEntry;
+    pthread_mutex_lock(&shard->lock);
+    HASH_FIND_PTR(shard->referents, &key, referentEntry);
+    if (!referentEntry) {
+        pthread_mutex_unlock(&shard->lock);
+        ReferentEntry* newEntry = gcMalloc(sizeof(ReferentEntry));
+        newEntry->key = key;
+        pthread_mutex_lock(&shard->lock);
+        HASH_FIND_PTR(shard->referents, &key, referentEntry);
+        if (!referentEntry) {
+            referentEntry = newEntry;
+            HASH_ADD_PTR(shard->referents, key, referentEntry);
+            created = TRUE;
+        }
+    }
+    LL_PREPEND(referentEntry->references, l);
+    pthread_mutex_unlock(&shard->lock);
+    if (created) {
+        gcRegisterFinalizer(referent);
+    }
+}
+
+static void clearReferents(ReferentsShard* shard) {
+    ReferentEntry* referentEntry;
+    ReferentEntry* tmp;
+    HASH_ITER(hh, shard->referents, referentEntry, tmp) {
+        HASH_DEL(shard->referents, referentEntry);
+        ReferenceList* l;
+        ReferenceList* next;
+        LL_FOREACH_SAFE(referentEntry->references, l, next) {
+            free(l->reference);
+            free(l);
+        }
+        free(referentEntry->key);
+        free(referentEntry);
+    }
+}
+
+/*
+ * Empties all tables so that every run starts from scratch.
+ */
+static void clearTables(void) {
+    clearReferents(&oldReferents);
+    for (jint i = 0; i < REFERENTS_SHARDS; i++) {
+        clearReferents(&referentsShards[i]);
+    }
+    Finalizable* f;
+    Finalizable* tmp;
+    HASH_ITER(hh, finalizables, f, tmp) {
+        HASH_DEL(finalizables, f);
+        free(f);
+    }
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    long registrations;
+    jint referencesPerReferent;
+    jboolean old;
+    pthread_t thread;
+} Work;
+
+static void* registerThread(void* data) {
+    Work* work = (Work*) data;
+    Object* referent = NULL;
+    for (long i = 0; i < work->registrations; i++) {
+        if (i % work->referencesPerReferent == 0) {
+            referent = malloc(sizeof(Object));
+        }
+        Object* reference = malloc(sizeof(Object));
+        if (work->old) {
+            oldRegisterReference(reference, referent);
+        } else {
+            registerReference(reference, referent);
+        }
+    }
+    return NULL;
+}
+
+static void run(const char* label, const char* workload, jint threads, long registrations,
+        jint referencesPerReferent, jboolean old) {
+
+    Work* works = calloc(threads, sizeof(Work));
+    double start = now();
+    for (jint t = 0; t < threads; t++) {
+        works[t].registrations = registrations;
+        works[t].referencesPerReferent = referencesPerReferent;
+        works[t].old = old;
+        pthread_create(&works[t].thread, NULL, registerThread, &works[t]);
+    }
+    for (jint t = 0; t < threads; t++) {
+        pthread_join(works[t].thread, NULL);
+    }
+    double elapsed = now() - start;
+    printf("  %-12s %-22s %2d threads: %6.1f ns/registration\n", workload, label, threads,
+        elapsed * 1e9 / (registrations * threads));
+    free(works);
+    clearTables();
+}
+
+int main(int argc, char* argv[]) {
+    long registrations = argc > 1 ? atol(argv[1]) : DEFAULT_REGISTRATIONS;
+    jint maxThreads = argc > 2 ? atoi(argv[2]) : DEFAULT_MAX_THREADS;
+
+    for (jint i = 0; i < REFERENTS_SHARDS; i++) {
+        pthread_mutex_init(&referentsShards[i].lock, NULL);
+    }
+
+    for (jint threads = 1; threads <= maxThreads; threads <<= 1) {
+        run("old referents table", "WeakHashMap", threads, registrations, 1, TRUE);
+        run("sharded referents", "WeakHashMap", threads, registrations, 1, FALSE);
+        run("old referents table", "shared", threads, registrations, 8, TRUE);
+        run("sharded referents", "shared", threads, registrations, 8, FALSE);
+    }
+    return 0;
+}
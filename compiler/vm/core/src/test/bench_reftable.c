@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares rvmAddGlobalRef()/rvmRemoveGlobalRef() with the way global refs
+ * were kept before reftable.c (an array which was appended to and scanned
+ * backwards on delete under a single lock). Measures deleting a large
+ * number of live global refs in random order and add/delete pairs from an
+ * increasing number of threads.
+ *
+ * Usage: bench_reftable [live refs] [pairs per thread] [max threads]
+ */
+#include <robovm.h>
+#include <string.h>
+#include <time.h>
+#include "../private.h"
+
+#define DEFAULT_LIVE_REFS 50000
+#define DEFAULT_PAIRS 2000000
+#define DEFAULT_MAX_THREADS 8
+
+// reftable.c only needs these from the rest of the VM.
+void* rvmAllocateMemoryUncollectable(Env* env, size_t size) {
+    return calloc(1, size);
+}
+void rvmFreeMemoryUncollectable(Env* env, void* m) {
+    free(m);
+}
+
+// The global refs table used before reftable.c.
+typedef struct {
+    jint size;
+    jint count;
+    void** entries;
+} OldRefTable;
+static OldRefTable oldGlobalRefs = {0};
+static pthread_mutex_t oldGlobalRefsLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void oldAddGlobalRef(Object* object) {
+    pthread_mutex_lock(&oldGlobalRefsLock);
+    if (!oldGlobalRefs.entries) {
+        oldGlobalRefs.size = 2048;
+        oldGlobalRefs.entries = calloc(oldGlobalRefs.size, sizeof(void*));
+    }
+    if (oldGlobalRefs.count >= oldGlobalRefs.size) {
+        jint newSize = oldGlobalRefs.size << 1;
+        void** tmp = calloc(newSize, sizeof(void*));
+        memcpy(tmp, oldGlobalRefs.entries, oldGlobalRefs.size * sizeof(void*));
+        free(oldGlobalRefs.entries);
+        oldGlobalRefs.entries = tmp;
+        oldGlobalRefs.size = newSize;
+    }
+    oldGlobalRefs.entries[oldGlobalRefs.count++] = object;
+    pthread_mutex_unlock(&oldGlobalRefsLock);
+}
+
+static jboolean oldRemoveGlobalRef(Object* object) {
+    jboolean result = FALSE;
+    pthread_mutex_lock(&oldGlobalRefsLock);
+    for (jint i = oldGlobalRefs.count - 1; i >= 0; i--) {
+        if (oldGlobalRefs.entries[i] == object) {
+            jint toMove = oldGlobalRefs.count - 1 - i;
+            if (toMove > 0) {
+                memmove(&oldGlobalRefs.entries[i], &oldGlobalRefs.entries[i + 1], toMove * sizeof(void*));
+            }
+            oldGlobalRefs.entries[--oldGlobalRefs.count] = NULL;
+            result = TRUE;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&oldGlobalRefsLock);
+    return result;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void newEnv(Env* env, RvmThread* thread) {
+    memset(env, 0, sizeof(Env));
+    memset(thread, 0, sizeof(RvmThread));
+    env->currentThread = thread;
+}
+
+static void fail(const char* label) {
+    fprintf(stderr, "%s: global ref not found\n", label);
+    exit(1);
+}
+
+static void runRandomDeletes(const char* label, jint liveRefs, jboolean old) {
+    Env env;
+    RvmThread thread;
+    newEnv(&env, &thread);
+    Object** objects = calloc(liveRefs, sizeof(Object*));
+    for (jint i = 0; i < liveRefs; i++) {
+        objects[i] = malloc(sizeof(Object));
+    }
+    double start = now();
+    for (jint i = 0; i < liveRefs; i++) {
+        if (old) {
+            oldAddGlobalRef(objects[i]);
+        } else {
+            rvmAddGlobalRef(&env, objects[i]);
+        }
+    }
+    // Delete in a random (but reproducible) order
+    srand(1);
+    for (jint i = liveRefs - 1; i > 0; i--) {
+        jint j = rand() % (i + 1);
+        Object* tmp = objects[i];
+        objects[i] = objects[j];
+        objects[j] = tmp;
+    }
+    for (jint i = 0; i < liveRefs; i++) {
+        jboolean found = old ? oldRemoveGlobalRef(objects[i]) : rvmRemoveGlobalRef(&env, objects[i]);
+        if (!found) {
+            fail(label);
+        }
+    }
+    double elapsed = now() - start;
+    freeGlobalRefCache(&env, &thread);
+    printf("  %-24s %7d refs:     %8.1f ns/add+delete\n", label, liveRefs, elapsed * 1e9 / liveRefs);
+    for (jint i = 0; i < liveRefs; i++) {
+        free(objects[i]);
+    }
+    free(objects);
+}
+
+typedef struct {
+    long pairs;
+    jboolean old;
+    pthread_t thread;
+} Work;
+
+static void* pairsThread(void* data) {
+    Work* work = (Work*) data;
+    Env env;
+    RvmThread thread;
+    newEnv(&env, &thread);
+    Object* objects[4];
+    for (jint i = 0; i < 4; i++) {
+        objects[i] = malloc(sizeof(Object));
+    }
+    for (long i = 0; i < work->pairs; i++) {
+        Object* o = objects[i & 3];
+        if (work->old) {
+            oldAddGlobalRef(o);
+            if (!oldRemoveGlobalRef(o)) {
+                fail("old pairs");
+            }
+        } else {
+            rvmAddGlobalRef(&env, o);
+            if (!rvmRemoveGlobalRef(&env, o)) {
+                fail("pairs");
+            }
+        }
+    }
+    freeGlobalRefCache(&env, &thread);
+    return NULL;
+}
+
+static void runPairs(const char* label, jint threads, long pairs, jboolean old) {
+    Work* works = calloc(threads, sizeof(Work));
+    double start = now();
+    for (jint t = 0; t < threads; t++) {
+        works[t].pairs = pairs;
+        works[t].old = old;
+        pthread_create(&works[t].thread, NULL, pairsThread, &works[t]);
+    }
+    for (jint t = 0; t < threads; t++) {
+        pthread_join(works[t].thread, NULL);
+    }
+    double elapsed = now() - start;
+    printf("  %-24s %2d threads: %8.1f ns/add+delete\n", label, threads, elapsed * 1e9 / (pairs * threads));
+    free(works);
+}
+
+int main(int argc, char* argv[]) {
+    jint liveRefs = argc > 1 ? atoi(argv[1]) : DEFAULT_LIVE_REFS;
+    long pairs = argc > 2 ? atol(argv[2]) : DEFAULT_PAIRS;
+    jint maxThreads = argc > 3 ? atoi(argv[3]) : DEFAULT_MAX_THREADS;
+
+    initGlobalRefs();
+
+    printf("Random order deletes:\n");
+    runRandomDeletes("old global refs", liveRefs, TRUE);
+    runRandomDeletes("global refs", liveRefs, FALSE);
+
+    printf("Add/delete pairs:\n");
+    for (jint threads = 1; threads <= maxThreads; threads <<= 1) {
+        runPairs("old global refs", threads, pairs, TRUE);
+        runPairs("global refs", threads, pairs, FALSE);
+    }
+    return 0;
+}
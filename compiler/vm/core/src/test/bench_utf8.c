@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compares the throughput of the modified UTF-8 <-> UTF-16 conversions in
+ * utf8.c with the scalar versions string.c used before on ASCII, Latin-1
+ * and CJK heavy JSON-like text. Also checks that both produce the same
+ * results.
+ *
+ * Usage: bench_utf8 [chars] [iterations]
+ */
+#include <robovm.h>
+#include <string.h>
+#include <time.h>
+#include "../private.h"
+
+#define DEFAULT_CHARS 4096
+#define DEFAULT_ITERATIONS 20000
+
+// The scalar conversions used by string.c before utf8.c.
+static jint oldGetUnicodeLengthOfUtf8(const char* utf8) {
+    jint len = 0;
+    unsigned char ch;
+    unsigned char ch2;
+    unsigned char ch3;
+    while ((ch = *utf8++)) {
+        len++;
+        if (ch & 0x80) {
+            if (! (ch & 0x40))
+                return -1;
+            ch2 = *utf8++;
+            if (ch & 0x20) {
+                ch3 = *utf8++;
+                if ((ch  & 0xf0) != 0xe0  ||
+                    (ch2 & 0xc0) != 0x80  ||
+                    (ch3 & 0xc0) != 0x80)
+                    return -1;
+            } else {
+                if ((ch2 & 0xc0) != 0x80)
+                    return -1;
+            }
+        }
+    }
+    return len;
+}
+
+static jint oldGetUtf8LengthOfUnicode(const jchar* unicode, jint unicodeLength) {
+    jint length = 0;
+    jint i;
+    for (i = 0; i < unicodeLength; i++) {
+        jchar ch = unicode[i];
+        if (ch == 0) {
+            length += 2;
+        } else if (ch < 0x80) {
+            length += 1;
+        } else if (ch < 0x800) {
+            length += 2;
+        } else {
+            length += 3;
+        }
+    }
+    return length;
+}
+
+static void oldUtf8ToUnicode(jchar* unicode, const char* utf8String) {
+    const unsigned char* utf8 = (const unsigned char*) utf8String;
+    jchar ch;
+    while ((ch = (jchar) *utf8++)) {
+        if (ch & 0x80) {
+            if (ch & 0x20) {
+                jchar x = ch;
+                jchar y = (jchar) *utf8++;
+                jchar z = (jchar) *utf8++;
+                *unicode++ = (jchar) (((0x0f & x) << 12) + ((0x3f & y) << 6) + ((0x3f & z)));
+            } else {
+                jchar x = ch;
+                jchar y = (jchar) *utf8++;
+                *unicode++ = (jchar) (((0x1f & x) << 6) + (0x3f & y));
+            }
+        } else {
+            *unicode++ = ch;
+        }
+    }
+}
+
+static void oldUnicodeToUtf8(char* utf8String, const jchar* unicode, jint unicodeLength) {
+    char *s = utf8String;
+    jint i;
+    for (i = 0; i < unicodeLength; i++) {
+        jint ch = unicode[i];
+        if (ch == 0) {
+            *s++ = (char)0xc0;
+            *s++ = (char)0x80;
+        } else if (ch < 0x80) {
+            *s++ = (char)ch;
+        } else if(ch < 0x800) {
+            *s++ = (char)(0xc0 | ((ch >> 6) & 0x1f));
+            *s++ = (char)(0x80 | (ch & 0x3f));
+        } else {
+            *s++ = (char)(0xe0 | ((ch >> 12) & 0xf));
+            *s++ = (char)(0x80 | ((ch >> 6) & 0x3f));
+            *s++ = (char)(0x80 | (ch & 0x3f));
+        }
+    }
+    *s = 0;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Fills chars with JSON-like text where every 'every'th value is a string
+// of chars from [first, first + range).
+static void fill(jchar* chars, jint length, jint every, jchar first, jint range) {
+    static const char* key = "{\"id\":12345,\"name\":\"";
+    jint keyLength = (jint) strlen(key);
+    unsigned int seed = 1;
+    jint i = 0;
+    jint n = 0;
+    while (i < length) {
+        for (jint j = 0; j < keyLength && i < length; j++) {
+            chars[i++] = key[j];
+        }
+        for (jint j = 0; j < 24 && i < length; j++) {
+            seed = seed * 1103515245 + 12345;
+            if (every > 0 && n++ % every == 0) {
+                chars[i++] = (jchar) (first + (seed >> 16) % range);
+            } else {
+                chars[i++] = (jchar) ('a' + (seed >> 16) % 26);
+            }
+        }
+    }
+}
+
+static volatile jint sink;
+
+static void run(const char* label, jchar* chars, jint length, long iterations) {
+    jint utf8Length = oldGetUtf8LengthOfUnicode(chars, length);
+    if (getUtf8LengthOfUnicode(chars, length) != utf8Length) {
+        fprintf(stderr, "%s: getUtf8LengthOfUnicode() differs\n", label);
+        exit(1);
+    }
+    // Offset the buffers by 1 to exercise unaligned input
+    char* utf8Buffer = calloc(1, utf8Length + 2);
+    char* utf8 = utf8Buffer + 1;
+    char* oldUtf8 = calloc(1, utf8Length + 1);
+    jchar* unicode = calloc(length + 1, sizeof(jchar));
+    oldUnicodeToUtf8(oldUtf8, chars, length);
+    unicodeToUtf8(utf8, chars, length);
+    if (memcmp(utf8, oldUtf8, utf8Length + 1)) {
+        fprintf(stderr, "%s: unicodeToUtf8() differs\n", label);
+        exit(1);
+    }
+    if (getUnicodeLengthOfUtf8(utf8) != length || oldGetUnicodeLengthOfUtf8(utf8) != length) {
+        fprintf(stderr, "%s: getUnicodeLengthOfUtf8() differs\n", label);
+        exit(1);
+    }
+    utf8ToUnicode(unicode, utf8);
+    if (memcmp(unicode, chars, length * sizeof(jchar))) {
+        fprintf(stderr, "%s: utf8ToUnicode() differs\n", label);
+        exit(1);
+    }
+
+    for (jint old = 1; old >= 0; old--) {
+        double start = now();
+        for (long i = 0; i < iterations; i++) {
+            if (old) {
+                sink = oldGetUtf8LengthOfUnicode(chars, length);
+                oldUnicodeToUtf8(utf8, chars, length);
+            } else {
+                sink = getUtf8LengthOfUnicode(chars, length);
+                unicodeToUtf8(utf8, chars, length);
+            }
+        }
+        double encode = now() - start;
+        start = now();
+        for (long i = 0; i < iterations; i++) {
+            if (old) {
+                sink = oldGetUnicodeLengthOfUtf8(utf8);
+                oldUtf8ToUnicode(unicode, utf8);
+            } else {
+                sink = getUnicodeLengthOfUtf8(utf8);
+                utf8ToUnicode(unicode, utf8);
+            }
+        }
+        double decode = now() - start;
+        printf("  %-8s %-4s encode: %7.1f MB/s  decode: %7.1f MB/s\n", label, old ? "old" : "new",
+                length * 2.0 * iterations / encode / 1e6, length * 2.0 * iterations / decode / 1e6);
+    }
+    free(utf8Buffer);
+    free(oldUtf8);
+    free(unicode);
+}
+
+int main(int argc, char* argv[]) {
+    jint length = argc > 1 ? atoi(argv[1]) : DEFAULT_CHARS;
+    long iterations = argc > 2 ? atol(argv[2]) : DEFAULT_ITERATIONS;
+
+    jchar* chars = calloc(length, sizeof(jchar));
+    printf("Throughput in MB of UTF-16 per second:\n");
+    fill(chars, length, 0, 0, 1);
+    run("ASCII", chars, length, iterations);
+    fill(chars, length, 4, 0xc0, 0x40);
+    run("Latin-1", chars, length, iterations);
+    fill(chars, length, 1, 0x4e00, 0x5000);
+    run("CJK", chars, length, iterations);
+    return 0;
+}
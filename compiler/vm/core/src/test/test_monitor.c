@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Tests revoking the bias of locks biased towards a thread which is blocked
+ * in a system call or has the bias revocation signal blocked, like a thread
+ * running native code. monitor.c is linked on its own so the parts of the
+ * VM it calls are stubbed out below.
+ */
+#include <robovm.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include "../private.h"
+#include "CuTest.h"
+
+// Must match signal.c
+#if defined(__APPLE__)
+#define BIAS_REVOCATION_SIGNAL SIGXCPU
+#else
+#define BIAS_REVOCATION_SIGNAL (SIGRTMIN + 3)
+#endif
+
+#define MAX_THREADS 4
+#define LW_BIASED (0x8000 << 3) // Must match monitor.c
+
+int main(int argc, char* argv[]) __attribute__ ((weak));
+
+// monitor.c only needs these from the rest of the VM.
+void* rvmAllocateMemoryAtomicUncollectable(Env* env, size_t size) {
+    return calloc(1, size);
+}
+void rvmFreeMemoryUncollectable(Env* env, void* m) {
+    free(m);
+}
+jboolean gcIsLive(void* ptr) {
+    return TRUE;
+}
+jint rvmChangeThreadStatus(Env* env, RvmThread* thread, jint newStatus) {
+    jint oldStatus = thread->status;
+    thread->status = newStatus;
+    return oldStatus;
+}
+void rvmAbort(char* format, ...) {
+    abort();
+}
+int rvmLog(int level, const char* tag, const char* text) {
+    return 0;
+}
+int rvmLogf(int level, const char* tag, const char* format, ...) {
+    return 0;
+}
+jboolean rvmThrowIllegalArgumentException(Env* env, const char* message) {
+    abort();
+}
+jboolean rvmThrowIllegalMonitorStateException(Env* env, const char* message) {
+    abort();
+}
+jboolean rvmThrowInterruptedException(Env* env) {
+    abort();
+}
+
+// A minimal version of the thread list and the revocation handshake in
+// signal.c. Acknowledgements are counted instead of posted to a semaphore
+// since unnamed semaphores aren't available on Darwin.
+static pthread_mutex_t threadsLock = PTHREAD_MUTEX_INITIALIZER;
+static RvmThread* threads[MAX_THREADS];
+static jint revocationAcks = 0;
+static __thread Env* currentEnv;
+
+void rvmLockThreadsList() {
+    pthread_mutex_lock(&threadsLock);
+}
+void rvmUnlockThreadsList() {
+    pthread_mutex_unlock(&threadsLock);
+}
+RvmThread* rvmGetThreadByThreadId(Env* env, uint32_t threadId) {
+    return threadId < MAX_THREADS ? threads[threadId] : NULL;
+}
+jboolean signalBiasRevocation(Env* env, RvmThread* thread) {
+    return pthread_kill(thread->pThread, BIAS_REVOCATION_SIGNAL) == 0 ? TRUE : FALSE;
+}
+static void sleepMillis(jint millis) {
+    struct timespec ts = {millis / 1000, (millis % 1000) * 1000000L};
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+}
+jboolean waitBiasRevocation(jint timeoutMillis) {
+    for (jint waited = 0; timeoutMillis < 0 || waited <= timeoutMillis; waited++) {
+        jint acks = rvmAtomicLoadInt(&revocationAcks);
+        if (acks > 0 && rvmAtomicCompareAndSwapInt(&revocationAcks, acks, acks - 1)) {
+            return TRUE;
+        }
+        sleepMillis(1);
+    }
+    return FALSE;
+}
+void ackBiasRevocation(void) {
+    __sync_fetch_and_add(&revocationAcks, 1);
+}
+static void revokeBiasHandler(int signum, siginfo_t* info, void* context) {
+    if (currentEnv) {
+        revokeRequestedBias(currentEnv->currentThread);
+    }
+}
+
+static Options options;
+static VM vm;
+
+static Env* attach(jint threadId) {
+    Env* env = calloc(1, sizeof(Env));
+    RvmThread* thread = calloc(1, sizeof(RvmThread));
+    env->vm = &vm;
+    env->currentThread = thread;
+    thread->env = env;
+    thread->threadId = threadId;
+    thread->pThread = pthread_self();
+    thread->status = THREAD_RUNNING;
+    rvmLockThreadsList();
+    threads[threadId] = thread;
+    rvmUnlockThreadsList();
+    currentEnv = env;
+    return env;
+}
+
+static void detach(Env* env) {
+    rvmLockThreadsList();
+    threads[env->currentThread->threadId] = NULL;
+    rvmUnlockThreadsList();
+    currentEnv = NULL;
+}
+
+static void init(void) {
+    static jboolean initialized = FALSE;
+    if (!initialized) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_SIGINFO;
+        sa.sa_sigaction = revokeBiasHandler;
+        sigaction(BIAS_REVOCATION_SIGNAL, &sa, NULL);
+        vm.options = &options;
+        options.enableBiasedLocking = TRUE;
+        initialized = TRUE;
+    }
+}
+
+typedef struct {
+    Object* obj;
+    jint threadId;
+    jboolean maskSignal;     // Block BIAS_REVOCATION_SIGNAL while blocked
+    jint fds[2];             // The owner blocks in read() on fds[0]
+    volatile jint state;     // Owner: 1 when locked, 2 when released. Contender: 1 when locked.
+} Work;
+
+/*
+ * Locks the object, which biases it towards this thread, and then blocks
+ * in read() holding the lock until the test writes to the pipe.
+ */
+static void* ownerThread(void* data) {
+    Work* work = (Work*) data;
+    Env* env = attach(work->threadId);
+    rvmLockObject(env, work->obj);
+    sigset_t set, oldSet;
+    sigemptyset(&set);
+    sigaddset(&set, BIAS_REVOCATION_SIGNAL);
+    if (work->maskSignal) {
+        pthread_sigmask(SIG_BLOCK, &set, &oldSet);
+    }
+    work->state = 1;
+    char c;
+    while (read(work->fds[0], &c, 1) == -1 && errno == EINTR) {
+    }
+    work->state = 2;
+    rvmUnlockObject(env, work->obj);
+    if (work->maskSignal) {
+        // Lets the pending signal in.
+        pthread_sigmask(SIG_SETMASK, &oldSet, NULL);
+    }
+    detach(env);
+    return NULL;
+}
+
+static void* contenderThread(void* data) {
+    Work* work = (Work*) data;
+    Env* env = attach(work->threadId);
+    rvmLockObject(env, work->obj);
+    work->state = 1;
+    rvmUnlockObject(env, work->obj);
+    detach(env);
+    return NULL;
+}
+
+static void testRevocation(CuTest* tc, jboolean maskSignal) {
+    init();
+    Env* env = attach(1);
+    rvmInitMonitors(env);
+    Object* obj = calloc(1, sizeof(Object));
+
+    Work owner = {obj, 2, maskSignal};
+    CuAssertIntEquals(tc, 0, pipe(owner.fds));
+    pthread_t ownerT;
+    pthread_create(&ownerT, NULL, ownerThread, &owner);
+    while (owner.state != 1) {
+        sleepMillis(1);
+    }
+    CuAssertTrue(tc, (obj->lock & LW_BIASED) != 0);
+
+    Work contender = {obj, 3};
+    pthread_t contenderT;
+    pthread_create(&contenderT, NULL, contenderThread, &contender);
+    // Give the contender plenty of time to revoke the bias (or fail to) and
+    // to wrongly get hold of the lock.
+    sleepMillis(200);
+    CuAssertIntEquals(tc, 0, contender.state);
+
+    CuAssertIntEquals(tc, 1, write(owner.fds[1], "x", 1));
+    pthread_join(ownerT, NULL);
+    pthread_join(contenderT, NULL);
+    CuAssertIntEquals(tc, 2, owner.state);
+    CuAssertIntEquals(tc, 1, contender.state);
+    CuAssertTrue(tc, (obj->lock & LW_BIASED) == 0);
+    CuAssertIntEquals(tc, 0, rvmAtomicLoadInt(&revocationAcks));
+
+    // The lock must still work after the revocation.
+    rvmLockObject(env, obj);
+    rvmLockObject(env, obj);
+    rvmUnlockObject(env, obj);
+    rvmUnlockObject(env, obj);
+
+    close(owner.fds[0]);
+    close(owner.fds[1]);
+    detach(env);
+}
+
+void testBiasRevocationOwnerBlocked(CuTest* tc) {
+    testRevocation(tc, FALSE);
+}
+
+void testBiasRevocationOwnerSignalMasked(CuTest* tc) {
+    testRevocation(tc, TRUE);
+}
+
+/*
+ * The owner has released the lock but it stays biased towards it. Another
+ * thread must get the lock while the owner is still blocked.
+ */
+void testBiasRevocationOwnerBlockedNotHolding(CuTest* tc) {
+    init();
+    Env* env = attach(1);
+    rvmInitMonitors(env);
+    Object* obj = calloc(1, sizeof(Object));
+    rvmLockObject(env, obj);
+    rvmUnlockObject(env, obj);
+    CuAssertTrue(tc, (obj->lock & LW_BIASED) != 0);
+
+    // This thread is the owner. Block in the same way ownerThread() does
+    // while the contender locks the object.
+    jint fds[2];
+    CuAssertIntEquals(tc, 0, pipe(fds));
+    Work contender = {obj, 3};
+    pthread_t contenderT;
+    pthread_create(&contenderT, NULL, contenderThread, &contender);
+    struct timeval tv = {5, 0};
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(fds[0], &readable);
+    while (contender.state == 0 && (tv.tv_sec > 0 || tv.tv_usec > 0)) {
+        // Interrupted by the revocation signal.
+        select(fds[0] + 1, &readable, NULL, NULL, &tv);
+    }
+    pthread_join(contenderT, NULL);
+    CuAssertIntEquals(tc, 1, contender.state);
+    CuAssertTrue(tc, (obj->lock & LW_BIASED) == 0);
+
+    close(fds[0]);
+    close(fds[1]);
+    detach(env);
+}
+
+int runTests(int argc, char* argv[]) {
+    CuSuite* suite = CuSuiteNew();
+
+    if (argc < 2 || !strcmp(argv[1], "testBiasRevocationOwnerBlocked")) SUITE_ADD_TEST(suite, testBiasRevocationOwnerBlocked);
+    if (argc < 2 || !strcmp(argv[1], "testBiasRevocationOwnerSignalMasked")) SUITE_ADD_TEST(suite, testBiasRevocationOwnerSignalMasked);
+    if (argc < 2 || !strcmp(argv[1], "testBiasRevocationOwnerBlockedNotHolding")) SUITE_ADD_TEST(suite, testBiasRevocationOwnerBlockedNotHolding);
+
+    CuSuiteRun(suite);
+
+    if (argc < 2) {
+        CuString *output = CuStringNew();
+        CuSuiteSummary(suite, output);
+        CuSuiteDetails(suite, output);
+        printf("%s\n", output->buffer);
+    }
+
+    return suite->failCount;
+}
+
+int main(int argc, char* argv[]) {
+    return runTests(argc, argv);
+}
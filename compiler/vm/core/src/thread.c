@@ -241,6 +241,9 @@ static jboolean initThread(Env* env, RvmThread* thread, Object* threadObj) {
     }
     thread->threadId = getNextThreadId();
     thread->threadObj = threadObj;
+    // The allocation cache is optional. Objects will be allocated directly
+    // from the GC if this fails.
+    thread->allocCache = gcNewAllocCache();
     thread->env = env;
     env->currentThread = thread;
     env->attachCount = 1;
@@ -415,6 +418,9 @@ static jint detachThread(Env* env, jboolean ignoreAttachCount, jboolean unregist
 
     rvmRTResumeJoiningThreads(env, threadObj);
 
+    // Move any global refs cached by this thread to the global table
+    freeGlobalRefCache(env, thread);
+
     rvmLockThreadsList();
     thread->status = THREAD_ZOMBIE;
     DL_DELETE(threads, thread);
@@ -424,6 +430,10 @@ static jint detachThread(Env* env, jboolean ignoreAttachCount, jboolean unregist
     clearThreadTLS();
     freeThreadId(thread->threadId);
     cleanupThreadMutex(env, thread);
+    if (thread->allocCache) {
+        gcFreeAllocCache(thread->allocCache);
+        thread->allocCache = NULL;
+    }
     rvmUnlockThreadsList();
 
     if (unregisterGC) {
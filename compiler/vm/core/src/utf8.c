@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2012 RoboVM AB
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Conversions between modified UTF-8 and UTF-16 used by string.c.
+ *
+ * Most strings converted by the VM (class and member names, JNI strings,
+ * JSON keys) are mostly ASCII. Runs of ASCII are found and widened or
+ * narrowed 16 bytes at a time using SSE2 on x86 and NEON on ARM. Both are
+ * part of the base instruction set of every CPU we run on so there's no
+ * need for runtime feature detection. Other characters are converted one
+ * at a time. A scalar version of the ASCII loops is used if neither is
+ * available.
+ */
+#include <robovm.h>
+#include "private.h"
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+# define UTF8_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+# include <arm_neon.h>
+# define UTF8_NEON
+#endif
+
+#if defined(UTF8_SSE2) || defined(UTF8_NEON)
+// asciiPrefixLength() reads whole aligned 16 byte blocks and may read up to
+// 15 bytes before the start of the string and past its terminating null.
+// Those bytes are in the same pages as the string so the reads can't
+// fault, but AddressSanitizer would report them.
+# define NO_SANITIZE_ADDRESS __attribute__((no_sanitize_address))
+#else
+# define NO_SANITIZE_ADDRESS
+#endif
+
+#if defined(UTF8_SSE2)
+// One bit per byte in the masks returned by specialBytesMask()
+# define MASK_BITS_PER_BYTE 1
+typedef uint32_t ByteMask;
+
+NO_SANITIZE_ADDRESS static inline ByteMask specialBytesMask(const unsigned char* block) {
+    __m128i v = _mm_load_si128((const __m128i*) block);
+    __m128i zero = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+    return (ByteMask) (_mm_movemask_epi8(zero) | _mm_movemask_epi8(v));
+}
+#elif defined(UTF8_NEON)
+// NEON has no movemask. Narrowing shifts give 4 bits per byte instead.
+# define MASK_BITS_PER_BYTE 4
+typedef uint64_t ByteMask;
+
+NO_SANITIZE_ADDRESS static inline ByteMask specialBytesMask(const unsigned char* block) {
+    uint8x16_t v = vld1q_u8(block);
+    uint8x16_t special = vorrq_u8(vceqq_u8(v, vdupq_n_u8(0)), vcgeq_u8(v, vdupq_n_u8(0x80)));
+    uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(special), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+}
+#endif
+
+/*
+ * Returns the number of bytes in 0x01-0x7f at the start of the null
+ * terminated string s.
+ */
+NO_SANITIZE_ADDRESS static inline jint asciiPrefixLength(const unsigned char* s) {
+#if defined(UTF8_SSE2) || defined(UTF8_NEON)
+    // Aligned 16 byte loads never cross a page boundary so reading past
+    // the terminating null is safe.
+    uintptr_t misalign = (uintptr_t) s & 15;
+    const unsigned char* block = s - misalign;
+    ByteMask mask = specialBytesMask(block) >> (misalign * MASK_BITS_PER_BYTE);
+    if (mask) {
+        return (jint) (__builtin_ctzll(mask) / MASK_BITS_PER_BYTE);
+    }
+    while (TRUE) {
+        block += 16;
+        mask = specialBytesMask(block);
+        if (mask) {
+            return (jint) (block - s) + (jint) (__builtin_ctzll(mask) / MASK_BITS_PER_BYTE);
+        }
+    }
+#else
+    const unsigned char* p = s;
+    while ((unsigned char) (*p - 1) < 0x7f) {
+        p++;
+    }
+    return (jint) (p - s);
+#endif
+}
+
+/*
+ * Returns the number of chars in 0x0001-0x007f at the start of s.
+ */
+static inline jint asciiCharsPrefixLength(const jchar* s, jint length) {
+    jint i = 0;
+#if defined(UTF8_SSE2)
+    __m128i max = _mm_set1_epi16(0x7f);
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= length; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (s + i));
+        // v - 0x7f saturates to 0 for chars <= 0x7f
+        __m128i special = _mm_or_si128(_mm_cmpeq_epi16(v, zero),
+                _mm_xor_si128(_mm_cmpeq_epi16(_mm_subs_epu16(v, max), zero), _mm_set1_epi16(-1)));
+        uint32_t mask = (uint32_t) _mm_movemask_epi8(special);
+        if (mask) {
+            return i + (jint) (__builtin_ctz(mask) >> 1);
+        }
+    }
+#elif defined(UTF8_NEON)
+    for (; i + 8 <= length; i += 8) {
+        uint16x8_t v = vld1q_u16(s + i);
+        uint16x8_t special = vorrq_u16(vceqq_u16(v, vdupq_n_u16(0)), vcgtq_u16(v, vdupq_n_u16(0x7f)));
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(special)), 0);
+        if (mask) {
+            return i + (jint) (__builtin_ctzll(mask) >> 3);
+        }
+    }
+#endif
+    while (i < length && (jchar) (s[i] - 1) < 0x7f) {
+        i++;
+    }
+    return i;
+}
+
+/*
+ * Zero extends length bytes from src into dst.
+ */
+static inline void widenBytes(jchar* dst, const unsigned char* src, jint length) {
+    jint i = 0;
+#if defined(UTF8_SSE2)
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+        _mm_storeu_si128((__m128i*) (dst + i), _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128((__m128i*) (dst + i + 8), _mm_unpackhi_epi8(v, zero));
+    }
+#elif defined(UTF8_NEON)
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t v = vld1q_u8(src + i);
+        vst1q_u16(dst + i, vmovl_u8(vget_low_u8(v)));
+        vst1q_u16(dst + i + 8, vmovl_u8(vget_high_u8(v)));
+    }
+#endif
+    for (; i < length; i++) {
+        dst[i] = src[i];
+    }
+}
+
+/*
+ * Truncates length chars from src, which must all be <= 0xff, into dst.
+ */
+static inline void narrowChars(unsigned char* dst, const jchar* src, jint length) {
+    jint i = 0;
+#if defined(UTF8_SSE2)
+    for (; i + 16 <= length; i += 16) {
+        __m128i lo = _mm_loadu_si128((const __m128i*) (src + i));
+        __m128i hi = _mm_loadu_si128((const __m128i*) (src + i + 8));
+        _mm_storeu_si128((__m128i*) (dst + i), _mm_packus_epi16(lo, hi));
+    }
+#elif defined(UTF8_NEON)
+    for (; i + 16 <= length; i += 16) {
+        uint8x8_t lo = vmovn_u16(vld1q_u16(src + i));
+        uint8x8_t hi = vmovn_u16(vld1q_u16(src + i + 8));
+        vst1q_u8(dst + i, vcombine_u8(lo, hi));
+    }
+#endif
+    for (; i < length; i++) {
+        dst[i] = (unsigned char) src[i];
+    }
+}
+
+/*
+ * Returns the number of UTF-16 chars in the null terminated modified
+ * UTF-8 string or -1 if it's malformed. Based on Harmony (vm_strings.cpp).
+ */
+jint getUnicodeLengthOfUtf8(const char* utf8String) {
+    const unsigned char* utf8 = (const unsigned char*) utf8String;
+    jint len = 0;
+    while (TRUE) {
+        unsigned char ch = *utf8;
+        if (ch == 0) {
+            return len;
+        }
+        if (ch < 0x80) {
+            jint n = asciiPrefixLength(utf8);
+            len += n;
+            utf8 += n;
+            continue;
+        }
+        len++;
+        utf8++;
+        // 2 or 3 byte encoding
+        if (!(ch & 0x40)) {
+            return -1;
+        }
+        unsigned char ch2 = *utf8++;
+        if (ch & 0x20) { // 3 byte encoding
+            unsigned char ch3 = *utf8++;
+            if ((ch  & 0xf0) != 0xe0  ||  // check first byte high bits
+                (ch2 & 0xc0) != 0x80  ||  // check second byte high bits
+                (ch3 & 0xc0) != 0x80)     // check third byte high bits
+                return -1;
+        } else {    // 2 byte encoding
+            if ((ch2 & 0xc0) != 0x80)     // check second byte high bits
+                return -1;
+        }
+    }
+}
+
+/*
+ * Returns the number of bytes needed to encode the chars as modified
+ * UTF-8, not including a terminating null.
+ */
+jint getUtf8LengthOfUnicode(const jchar* unicode, jint unicodeLength) {
+    jint length = 0;
+    jint i = 0;
+    while (i < unicodeLength) {
+        jchar ch = unicode[i];
+        if (ch != 0 && ch < 0x80) {
+            jint n = asciiCharsPrefixLength(unicode + i, unicodeLength - i);
+            length += n;
+            i += n;
+            continue;
+        }
+        if (ch == 0 || ch < 0x800) {
+            length += 2;
+        } else {
+            length += 3;
+        }
+        i++;
+    }
+    return length;
+}
+
+/*
+ * Converts a null terminated string of modified UTF-8
+ * characters into a string of UTF-16 Java chars.
+ * Based on Harmony (vm_strings.cpp).
+ */
+void utf8ToUnicode(jchar* unicode, const char* utf8String) {
+    const unsigned char* utf8 = (const unsigned char*) utf8String;
+    while (TRUE) {
+        jchar ch = *utf8;
+        if (ch == 0) {
+            return;
+        }
+        if (ch < 0x80) {
+            jint n = asciiPrefixLength(utf8);
+            widenBytes(unicode, utf8, n);
+            unicode += n;
+            utf8 += n;
+            continue;
+        }
+        utf8++;
+        if (ch & 0x20) {
+            jchar x = ch;
+            jchar y = (jchar) *utf8++;
+            jchar z = (jchar) *utf8++;
+            *unicode++ = (jchar) (((0x0f & x) << 12) + ((0x3f & y) << 6) + ((0x3f & z)));
+        } else {
+            jchar x = ch;
+            jchar y = (jchar) *utf8++;
+            *unicode++ = (jchar) (((0x1f & x) << 6) + (0x3f & y));
+        }
+    }
+}
+
+/*
+ * Converts the chars to a null terminated modified UTF-8 string. The
+ * buffer must have room for getUtf8LengthOfUnicode() + 1 bytes.
+ */
+void unicodeToUtf8(char* utf8String, const jchar* unicode, jint unicodeLength) {
+    unsigned char* s = (unsigned char*) utf8String;
+    jint i = 0;
+    while (i < unicodeLength) {
+        jint ch = unicode[i];
+        if (ch != 0 && ch < 0x80) {
+            jint n = asciiCharsPrefixLength(unicode + i, unicodeLength - i);
+            narrowChars(s, unicode + i, n);
+            s += n;
+            i += n;
+            continue;
+        }
+        if (ch == 0) {
+            *s++ = 0xc0;
+            *s++ = 0x80;
+        } else if (ch < 0x800) {
+            unsigned b5_0 = ch & 0x3f;
+            unsigned b10_6 = (ch >> 6) & 0x1f;
+            *s++ = (unsigned char) (0xc0 | b10_6);
+            *s++ = (unsigned char) (0x80 | b5_0);
+        } else {
+            unsigned b5_0 = ch & 0x3f;
+            unsigned b11_6 = (ch >> 6) & 0x3f;
+            unsigned b15_12 = (ch >> 12) & 0xf;
+            *s++ = (unsigned char) (0xe0 | b15_12);
+            *s++ = (unsigned char) (0x80 | b11_6);
+            *s++ = (unsigned char) (0x80 | b5_0);
+        }
+        i++;
+    }
+    *s = 0;
+}
+
+/*
+ * Zero extends length Latin-1 bytes into chars.
+ */
+void latin1ToUnicode(jchar* unicode, const char* latin1, jint length) {
+    widenBytes(unicode, (const unsigned char*) latin1, length);
+}
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 
 #if HAVE_SQLITE2
 #include "sqlite.h"
@@ -106,6 +107,7 @@ typedef struct hvm {
     int tail_len;		/* only for SQLite3/prepare */
     handle *h;			/* SQLite database handle */
     handle hh;			/* fake SQLite database handle */
+    int batch_done;		/* SQLITE_DONE seen by Stmt.step_batch() */
 } hvm;
 #endif
 
@@ -151,6 +153,13 @@ static jfieldID F_SQLite_Stmt_error_code = 0;
 static jfieldID F_SQLite_Blob_handle = 0;
 static jfieldID F_SQLite_Blob_size = 0;
 static jfieldID F_SQLite_Backup_handle = 0;
+static jfieldID F_SQLite_StmtBatch_types = 0;
+static jfieldID F_SQLite_StmtBatch_longs = 0;
+static jfieldID F_SQLite_StmtBatch_doubles = 0;
+static jfieldID F_SQLite_StmtBatch_offsets = 0;
+static jfieldID F_SQLite_StmtBatch_lengths = 0;
+static jfieldID F_SQLite_StmtBatch_chars = 0;
+static jfieldID F_SQLite_StmtBatch_bytes = 0;
 
 static jmethodID M_java_lang_String_getBytes = 0;
 static jmethodID M_java_lang_String_getBytes2 = 0;
@@ -2999,6 +3008,7 @@ Java_SQLite_Vm_compile(JNIEnv *env, jobject obj)
 	v->vm = svm;
 	v->tail = (char *) tail;
 	v->hh.row1 = 1;
+	v->batch_done = 0;
 	return JNI_TRUE;
     }
     throwex(env, "vm already closed");
@@ -3141,6 +3151,7 @@ Java_SQLite_Database_vm_1compile(JNIEnv *env, jobject obj, jstring sql,
 	return;
     }
     v->next = h->vms;
+    v->batch_done = 0;
     h->vms = v;
     v->vm = svm;
     v->h = h;
@@ -3346,6 +3357,7 @@ Java_SQLite_Database_vm_1compile_1args(JNIEnv *env,
 		return;
 	    }
 	    v->next = h->vms;
+	    v->batch_done = 0;
 	    h->vms = v;
 	    v->vm = svm;
 	    v->h = h;
@@ -3522,6 +3534,7 @@ Java_SQLite_Stmt_prepare(JNIEnv *env, jobject obj)
 	v->vm = svm;
 	v->tail = (char *) tail;
 	v->hh.row1 = 1;
+	v->batch_done = 0;
 	return JNI_TRUE;
     }
     throwex(env, "stmt already closed");
@@ -3605,6 +3618,7 @@ Java_SQLite_Database_stmt_1prepare(JNIEnv *env, jobject obj, jstring sql,
 	return;
     }
     v->next = h->vms;
+    v->batch_done = 0;
     h->vms = v;
     v->vm = svm;
     v->h = h;
@@ -3642,6 +3656,7 @@ Java_SQLite_Stmt_step(JNIEnv *env, jobject obj)
     if (v && v->vm && v->h) {
 	int ret;
 
+	v->batch_done = 0;
 	ret = sqlite3_step((sqlite3_stmt *) v->vm);
 	if (ret == SQLITE_ROW) {
 	    return JNI_TRUE;
@@ -3661,6 +3676,222 @@ Java_SQLite_Stmt_step(JNIEnv *env, jobject obj)
     return JNI_FALSE;
 }
 
+#if HAVE_SQLITE3 && HAVE_SQLITE_COMPILE
+/* Growable buffer for text and blob data of a StmtBatch */
+
+typedef struct {
+    char *data;
+    int len;
+    int size;
+} batchbuf;
+
+static int
+batchbuf_append(batchbuf *b, const void *data, int n)
+{
+    if (b->len + n > b->size) {
+	int size = b->size ? b->size : 1024;
+	char *p;
+
+	while (size < b->len + n) {
+	    size *= 2;
+	}
+	p = realloc(b->data, size);
+	if (!p) {
+	    return 0;
+	}
+	b->data = p;
+	b->size = size;
+    }
+    memcpy(b->data + b->len, data, n);
+    b->len += n;
+    return 1;
+}
+
+/* Checks that a cell array of a StmtBatch holds at least ncells cells */
+
+static int
+batch_array_ok(JNIEnv *env, jarray a, int ncells)
+{
+    return a && (*env)->GetArrayLength(env, a) >= ncells;
+}
+#endif
+
+/*
+ * Steps up to maxrows rows and stores all their values in the
+ * arrays of the StmtBatch. Text and blobs are collected in
+ * native buffers and copied to the batch's char[] and byte[]
+ * at the end, which are replaced when too small.
+ */
+
+JNIEXPORT jint JNICALL
+Java_SQLite_Stmt_step_1batch0(JNIEnv *env, jobject obj, jobject batch,
+			       jint maxrows)
+{
+#if HAVE_SQLITE3 && HAVE_SQLITE_COMPILE
+    hvm *v = gethstmt(env, obj);
+
+    if (v && v->vm && v->h) {
+	sqlite3_stmt *stmt = (sqlite3_stmt *) v->vm;
+	int ncol = sqlite3_column_count(stmt);
+	jintArray typesa, offsetsa, lengthsa;
+	jlongArray longsa;
+	jdoubleArray doublesa;
+	jint *types, *offsets, *lengths;
+	jlong *longs;
+	jdouble *doubles;
+	batchbuf text = { 0, 0, 0 }, blob = { 0, 0, 0 };
+	int ret = SQLITE_DONE, nrows = 0, nomem = 0;
+
+	if (maxrows <= 0 || (ncol > 0 && maxrows > INT_MAX / ncol)) {
+	    throwex(env, "invalid batch size");
+	    return 0;
+	}
+	if (v->batch_done) {
+	    /*
+	     * The previous batch ended the result set. Stepping again
+	     * would make SQLite reset the statement and start over.
+	     */
+	    v->batch_done = 0;
+	    return 0;
+	}
+	typesa = (*env)->GetObjectField(env, batch, F_SQLite_StmtBatch_types);
+	longsa = (*env)->GetObjectField(env, batch, F_SQLite_StmtBatch_longs);
+	doublesa = (*env)->GetObjectField(env, batch,
+					  F_SQLite_StmtBatch_doubles);
+	offsetsa = (*env)->GetObjectField(env, batch,
+					  F_SQLite_StmtBatch_offsets);
+	lengthsa = (*env)->GetObjectField(env, batch,
+					  F_SQLite_StmtBatch_lengths);
+	if (!batch_array_ok(env, typesa, ncol * maxrows) ||
+	    !batch_array_ok(env, longsa, ncol * maxrows) ||
+	    !batch_array_ok(env, doublesa, ncol * maxrows) ||
+	    !batch_array_ok(env, offsetsa, ncol * maxrows) ||
+	    !batch_array_ok(env, lengthsa, ncol * maxrows)) {
+	    throwex(env, "batch too small");
+	    return 0;
+	}
+	types = (*env)->GetIntArrayElements(env, typesa, 0);
+	longs = (*env)->GetLongArrayElements(env, longsa, 0);
+	doubles = (*env)->GetDoubleArrayElements(env, doublesa, 0);
+	offsets = (*env)->GetIntArrayElements(env, offsetsa, 0);
+	lengths = (*env)->GetIntArrayElements(env, lengthsa, 0);
+	while (nrows < maxrows && !nomem) {
+	    int col;
+
+	    ret = sqlite3_step(stmt);
+	    if (ret != SQLITE_ROW) {
+		break;
+	    }
+	    for (col = 0; col < ncol; col++) {
+		int cell = nrows * ncol + col;
+		int type = sqlite3_column_type(stmt, col);
+		const void *data;
+		int n;
+
+		types[cell] = type;
+		switch (type) {
+		case SQLITE_INTEGER:
+		    longs[cell] = sqlite3_column_int64(stmt, col);
+		    break;
+		case SQLITE_FLOAT:
+		    doubles[cell] = sqlite3_column_double(stmt, col);
+		    break;
+		case SQLITE3_TEXT:
+		    data = sqlite3_column_text16(stmt, col);
+		    n = data ? sqlite3_column_bytes16(stmt, col) : 0;
+		    offsets[cell] = text.len / sizeof (jchar);
+		    lengths[cell] = n / sizeof (jchar);
+		    if (n && !batchbuf_append(&text, data, n)) {
+			nomem = 1;
+		    }
+		    break;
+		case SQLITE_BLOB:
+		    data = sqlite3_column_blob(stmt, col);
+		    n = data ? sqlite3_column_bytes(stmt, col) : 0;
+		    offsets[cell] = blob.len;
+		    lengths[cell] = n;
+		    if (n && !batchbuf_append(&blob, data, n)) {
+			nomem = 1;
+		    }
+		    break;
+		}
+	    }
+	    nrows++;
+	}
+	(*env)->ReleaseIntArrayElements(env, typesa, types, 0);
+	(*env)->ReleaseLongArrayElements(env, longsa, longs, 0);
+	(*env)->ReleaseDoubleArrayElements(env, doublesa, doubles, 0);
+	(*env)->ReleaseIntArrayElements(env, offsetsa, offsets, 0);
+	(*env)->ReleaseIntArrayElements(env, lengthsa, lengths, 0);
+	if (nomem) {
+	    free(text.data);
+	    free(blob.data);
+	    throwoom(env, "unable to get batch column data");
+	    return 0;
+	}
+	if (ret != SQLITE_ROW && ret != SQLITE_DONE) {
+	    const char *err = sqlite3_errmsg(v->h->sqlite);
+
+	    free(text.data);
+	    free(blob.data);
+	    setstmterr(env, obj, ret);
+	    throwex(env, err ? err : "error in step");
+	    return 0;
+	}
+	if (ret == SQLITE_DONE && nrows > 0) {
+	    v->batch_done = 1;
+	}
+	if (text.len) {
+	    jint nchars = text.len / sizeof (jchar);
+	    jcharArray chars = (*env)->GetObjectField(env, batch,
+						      F_SQLite_StmtBatch_chars);
+	    jint size = (*env)->GetArrayLength(env, chars);
+
+	    if (size < nchars) {
+		size = size * 2 > nchars ? size * 2 : nchars;
+		chars = (*env)->NewCharArray(env, size);
+		if (!chars) {
+		    free(text.data);
+		    free(blob.data);
+		    throwoom(env, "unable to get batch column data");
+		    return 0;
+		}
+		(*env)->SetObjectField(env, batch, F_SQLite_StmtBatch_chars,
+				       chars);
+	    }
+	    (*env)->SetCharArrayRegion(env, chars, 0, nchars,
+				       (const jchar *) text.data);
+	    free(text.data);
+	}
+	if (blob.len) {
+	    jbyteArray bytes = (*env)->GetObjectField(env, batch,
+						      F_SQLite_StmtBatch_bytes);
+	    jint size = (*env)->GetArrayLength(env, bytes);
+
+	    if (size < blob.len) {
+		size = size * 2 > blob.len ? size * 2 : blob.len;
+		bytes = (*env)->NewByteArray(env, size);
+		if (!bytes) {
+		    free(blob.data);
+		    throwoom(env, "unable to get batch column data");
+		    return 0;
+		}
+		(*env)->SetObjectField(env, batch, F_SQLite_StmtBatch_bytes,
+				       bytes);
+	    }
+	    (*env)->SetByteArrayRegion(env, bytes, 0, blob.len,
+				       (const jbyte *) blob.data);
+	    free(blob.data);
+	}
+	return nrows;
+    }
+    throwex(env, "stmt already closed");
+#else
+    throwex(env, "unsupported");
+#endif
+    return 0;
+}
+
 JNIEXPORT void JNICALL
 Java_SQLite_Stmt_close(JNIEnv *env, jobject obj)
 {
@@ -3695,6 +3926,7 @@ Java_SQLite_Stmt_reset(JNIEnv *env, jobject obj)
 
     if (v && v->vm && v->h) {
 	sqlite3_reset((sqlite3_stmt *) v->vm);
+	v->batch_done = 0;
     } else {
 	throwex(env, "stmt already closed");
     }
@@ -4945,6 +5177,25 @@ Java_SQLite_Stmt_internal_1init(JNIEnv *env, jclass cls)
 	(*env)->GetFieldID(env, cls, "error_code", "I");
 }
 
+JNIEXPORT void JNICALL
+Java_SQLite_StmtBatch_internal_1init(JNIEnv *env, jclass cls)
+{
+    F_SQLite_StmtBatch_types =
+	(*env)->GetFieldID(env, cls, "types", "[I");
+    F_SQLite_StmtBatch_longs =
+	(*env)->GetFieldID(env, cls, "longs", "[J");
+    F_SQLite_StmtBatch_doubles =
+	(*env)->GetFieldID(env, cls, "doubles", "[D");
+    F_SQLite_StmtBatch_offsets =
+	(*env)->GetFieldID(env, cls, "offsets", "[I");
+    F_SQLite_StmtBatch_lengths =
+	(*env)->GetFieldID(env, cls, "lengths", "[I");
+    F_SQLite_StmtBatch_chars =
+	(*env)->GetFieldID(env, cls, "chars", "[C");
+    F_SQLite_StmtBatch_bytes =
+	(*env)->GetFieldID(env, cls, "bytes", "[B");
+}
+
 JNIEXPORT void JNICALL
 Java_SQLite_Vm_internal_1init(JNIEnv *env, jclass cls)
 {
@@ -392,6 +392,14 @@ JNIEXPORT jboolean JNICALL Java_SQLite_Stmt_prepare
 JNIEXPORT jboolean JNICALL Java_SQLite_Stmt_step
   (JNIEnv *, jobject);
 
+/*
+ * Class:     SQLite_Stmt
+ * Method:    step_batch0
+ * Signature: (LSQLite/StmtBatch;I)I
+ */
+JNIEXPORT jint JNICALL Java_SQLite_Stmt_step_1batch0
+  (JNIEnv *, jobject, jobject, jint);
+
 /*
  * Class:     SQLite_Stmt
  * Method:    close
@@ -600,6 +608,25 @@ JNIEXPORT void JNICALL Java_SQLite_Stmt_finalize
 JNIEXPORT void JNICALL Java_SQLite_Stmt_internal_1init
   (JNIEnv *, jclass);
 
+#ifdef __cplusplus
+}
+#endif
+#endif
+/* Header for class SQLite_StmtBatch */
+
+#ifndef _Included_SQLite_StmtBatch
+#define _Included_SQLite_StmtBatch
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Class:     SQLite_StmtBatch
+ * Method:    internal_init
+ * Signature: ()V
+ */
+JNIEXPORT void JNICALL Java_SQLite_StmtBatch_internal_1init
+  (JNIEnv *, jclass);
+
 #ifdef __cplusplus
 }
 #endif
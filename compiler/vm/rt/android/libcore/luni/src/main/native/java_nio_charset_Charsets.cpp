@@ -24,6 +24,125 @@
 
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+// RoboVM note: The loops below handle 16 bytes or 8 chars at a time using SSE2 on x86 and NEON
+// on ARM. Both are available on every CPU RoboVM targets so they are selected at compile time.
+
+/**
+ * Returns the number of bytes in 0x00-0x7f at the start of bytes.
+ */
+static int asciiBytesPrefixLength(const jbyte* bytes, int length) {
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(bytes);
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= length; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t nonAscii = vcgeq_u8(vld1q_u8(src + i), vdupq_n_u8(0x80));
+        // 4 bits per byte
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(nonAscii), 4)), 0);
+        if (mask != 0) {
+            return i + (__builtin_ctzll(mask) >> 2);
+        }
+    }
+#endif
+    while (i < length && src[i] < 0x80) {
+        ++i;
+    }
+    return i;
+}
+
+/**
+ * Returns the number of chars <= maxChar at the start of chars.
+ */
+static int charsPrefixLength(const jchar* chars, int length, jchar maxChar) {
+    int i = 0;
+#if defined(__SSE2__)
+    __m128i max = _mm_set1_epi16(maxChar);
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= length; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(chars + i));
+        // v - maxChar saturates to 0 for chars <= maxChar
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_subs_epu16(v, max), zero));
+        if (mask != 0xffff) {
+            return i + (__builtin_ctz(~mask) >> 1);
+        }
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint16x8_t max = vdupq_n_u16(maxChar);
+    for (; i + 8 <= length; i += 8) {
+        uint16x8_t invalid = vcgtq_u16(vld1q_u16(chars + i), max);
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vmovn_u16(invalid)), 0);
+        if (mask != 0) {
+            return i + (__builtin_ctzll(mask) >> 3);
+        }
+    }
+#endif
+    while (i < length && chars[i] <= maxChar) {
+        ++i;
+    }
+    return i;
+}
+
+/**
+ * Zero extends length bytes to chars.
+ */
+static void widenBytes(jchar* dst, const jbyte* bytes, int length) {
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(bytes);
+    int i = 0;
+#if defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(v, zero));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t v = vld1q_u8(src + i);
+        vst1q_u16(dst + i, vmovl_u8(vget_low_u8(v)));
+        vst1q_u16(dst + i + 8, vmovl_u8(vget_high_u8(v)));
+    }
+#endif
+    for (; i < length; ++i) {
+        dst[i] = src[i];
+    }
+}
+
+/**
+ * Truncates length chars, which must all be <= 0xff, to bytes.
+ */
+static void narrowChars(jbyte* bytes, const jchar* src, int length) {
+    uint8_t* dst = reinterpret_cast<uint8_t*>(bytes);
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= length; i += 16) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for (; i + 16 <= length; i += 16) {
+        uint8x8_t lo = vmovn_u16(vld1q_u16(src + i));
+        uint8x8_t hi = vmovn_u16(vld1q_u16(src + i + 8));
+        vst1q_u8(dst + i, vcombine_u8(lo, hi));
+    }
+#endif
+    for (; i < length; ++i) {
+        dst[i] = static_cast<uint8_t>(src[i]);
+    }
+}
+
 /**
  * Approximates java.lang.UnsafeByteSequence so we don't have to pay the cost of calling back into
  * Java when converting a char[] to a UTF-8 byte[]. This lets us have UTF-8 conversions slightly
@@ -33,8 +152,8 @@
  * creating a byte[] on the Java heap when we know how big it needs to be, but one shouldn't lie
  * to the garbage collector (nor hide potentially large allocations from it).
  *
- * Because a call to append might require an allocation, it might fail. Callers should always
- * check the return value of append.
+ * Because a call to reserve might require an allocation, it might fail. Callers should always
+ * check the return value of reserve.
  */
 class NativeUnsafeByteSequence {
 public:
@@ -50,12 +169,25 @@ public:
         }
     }
 
-    bool append(jbyte b) {
-        if (mOffset == mSize && !resize(mSize * 2)) {
-            return false;
+    /**
+     * Makes room for at least n more bytes and returns where to write them, or NULL if the
+     * allocation failed. Callers must call advance() with the number of bytes actually written.
+     */
+    jbyte* reserve(int n) {
+        if (mOffset + n > mSize) {
+            int newSize = mSize * 2;
+            if (newSize < mOffset + n) {
+                newSize = mOffset + n;
+            }
+            if (!resize(newSize)) {
+                return NULL;
+            }
         }
-        mRawArray[mOffset++] = b;
-        return true;
+        return mRawArray + mOffset;
+    }
+
+    void advance(int n) {
+        mOffset += n;
     }
 
     bool resize(int newSize) {
@@ -119,9 +251,14 @@ extern "C" void Java_java_nio_charset_Charsets_asciiBytesToChars(JNIEnv* env, jc
     const jbyte* src = &bytes[offset];
     jchar* dst = &chars[0];
     static const jchar REPLACEMENT_CHAR = 0xfffd;
-    for (int i = length - 1; i >= 0; --i) {
-        jchar ch = static_cast<jchar>(*src++ & 0xff);
-        *dst++ = (ch <= 0x7f) ? ch : REPLACEMENT_CHAR;
+    int i = 0;
+    while (i < length) {
+        int n = asciiBytesPrefixLength(src + i, length - i);
+        widenBytes(dst + i, src + i, n);
+        i += n;
+        if (i < length) {
+            dst[i++] = REPLACEMENT_CHAR;
+        }
     }
 }
 
@@ -135,11 +272,7 @@ extern "C" void Java_java_nio_charset_Charsets_isoLatin1BytesToChars(JNIEnv* env
         return;
     }
 
-    const jbyte* src = &bytes[offset];
-    jchar* dst = &chars[0];
-    for (int i = length - 1; i >= 0; --i) {
-        *dst++ = static_cast<jchar>(*src++ & 0xff);
-    }
+    widenBytes(&chars[0], &bytes[offset], length);
 }
 
 /**
@@ -161,12 +294,14 @@ static jbyteArray charsToBytes(JNIEnv* env, jcharArray javaChars, jint offset, j
 
     const jchar* src = &chars[offset];
     jbyte* dst = &bytes[0];
-    for (int i = length - 1; i >= 0; --i) {
-        jchar ch = *src++;
-        if (ch > maxValidChar) {
-            ch = '?';
+    int i = 0;
+    while (i < length) {
+        int n = charsPrefixLength(src + i, length - i, maxValidChar);
+        narrowChars(dst + i, src + i, n);
+        i += n;
+        if (i < length) {
+            dst[i++] = '?';
         }
-        *dst++ = static_cast<jbyte>(ch);
     }
 
     return javaBytes;
@@ -191,48 +326,58 @@ extern "C" jbyteArray Java_java_nio_charset_Charsets_toUtf8Bytes(JNIEnv* env, jc
         return NULL;
     }
 
+    const jchar* src = chars.get();
     const int end = offset + length;
-    for (int i = offset; i < end; ++i) {
-        jint ch = chars[i];
+    int i = offset;
+    while (i < end) {
+        jint ch = src[i];
         if (ch < 0x80) {
-            // One byte.
-            if (!out.append(ch)) {
+            // A run of one byte characters.
+            int n = charsPrefixLength(src + i, end - i, 0x7f);
+            jbyte* dst = out.reserve(n);
+            if (dst == NULL) {
                 return NULL;
             }
-        } else if (ch < 0x800) {
+            narrowChars(dst, src + i, n);
+            out.advance(n);
+            i += n;
+            continue;
+        }
+        // At most four bytes.
+        jbyte* dst = out.reserve(4);
+        if (dst == NULL) {
+            return NULL;
+        }
+        ++i;
+        if (ch < 0x800) {
             // Two bytes.
-            if (!out.append((ch >> 6) | 0xc0) || !out.append((ch & 0x3f) | 0x80)) {
-                return NULL;
-            }
+            dst[0] = (ch >> 6) | 0xc0;
+            dst[1] = (ch & 0x3f) | 0x80;
+            out.advance(2);
         } else if (U16_IS_SURROGATE(ch)) {
             // A supplementary character.
             jchar high = (jchar) ch;
-            jchar low = (i + 1 != end) ? chars[i + 1] : 0;
+            jchar low = (i != end) ? src[i] : 0;
             if (!U16_IS_SURROGATE_LEAD(high) || !U16_IS_SURROGATE_TRAIL(low)) {
-                if (!out.append('?')) {
-                    return NULL;
-                }
+                dst[0] = '?';
+                out.advance(1);
                 continue;
             }
             // Now we know we have a *valid* surrogate pair, we can consume the low surrogate.
             ++i;
             ch = U16_GET_SUPPLEMENTARY(high, low);
             // Four bytes.
-            jbyte b1 = (ch >> 18) | 0xf0;
-            jbyte b2 = ((ch >> 12) & 0x3f) | 0x80;
-            jbyte b3 = ((ch >> 6) & 0x3f) | 0x80;
-            jbyte b4 = (ch & 0x3f) | 0x80;
-            if (!out.append(b1) || !out.append(b2) || !out.append(b3) || !out.append(b4)) {
-                return NULL;
-            }
+            dst[0] = (ch >> 18) | 0xf0;
+            dst[1] = ((ch >> 12) & 0x3f) | 0x80;
+            dst[2] = ((ch >> 6) & 0x3f) | 0x80;
+            dst[3] = (ch & 0x3f) | 0x80;
+            out.advance(4);
         } else {
             // Three bytes.
-            jbyte b1 = (ch >> 12) | 0xe0;
-            jbyte b2 = ((ch >> 6) & 0x3f) | 0x80;
-            jbyte b3 = (ch & 0x3f) | 0x80;
-            if (!out.append(b1) || !out.append(b2) || !out.append(b3)) {
-                return NULL;
-            }
+            dst[0] = (ch >> 12) | 0xe0;
+            dst[1] = ((ch >> 6) & 0x3f) | 0x80;
+            dst[2] = (ch & 0x3f) | 0x80;
+            out.advance(3);
         }
     }
     return out.toByteArray();
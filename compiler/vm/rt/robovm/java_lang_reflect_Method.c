@@ -27,12 +27,20 @@ Object* Java_java_lang_reflect_Method_internalInvoke(Env* env, Class* clazz, jlo
      * and that the number of arguments are correct. The args array is never null.
      */
 
-    jvalue* jvalueArgs = validateAndUnwrapArgs(env, parameterTypes, args);
-    if (!jvalueArgs) return NULL;
+    // The invoker stubs take the receiver of instance methods followed by
+    // the arguments.
+    jint first = METHOD_IS_STATIC(method) ? 0 : 1;
+    jvalue invokerArgs[args->length + 1];
+    invokerArgs[0].l = (jobject) receiver;
+    if (!validateAndUnwrapArgsInto(env, parameterTypes, args, &invokerArgs[first])) return NULL;
+    jvalue* jvalueArgs = &invokerArgs[first];
 
     const char* retDesc = rvmGetReturnType(method->desc);
 
     jvalue jvalueRet[1];
+    if (rvmCallMethodUsingInvoker(env, method, invokerArgs, jvalueRet)) {
+        goto done;
+    }
     if (METHOD_IS_STATIC(method)) {
         switch (retDesc[0]) {
         case 'V':
@@ -103,6 +111,7 @@ Object* Java_java_lang_reflect_Method_internalInvoke(Env* env, Class* clazz, jlo
         }
     }
 
+done:
     if (rvmExceptionCheck(env)) {
         throwInvocationTargetException(env, rvmExceptionOccurred(env));
         return NULL;
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 #include <robovm.h>
+#include <string.h>
 #include <gc.h>
 
 jboolean Java_org_robovm_rt_GC_getDontExpand(Env* env, Class* c) {
@@ -91,4 +92,57 @@ jlong Java_org_robovm_rt_GC_getTimeLimit(Env* env, Class* c) {
 
 void Java_org_robovm_rt_GC_setTimeLimit(Env* env, Class* c, jlong value) {
     GC_call_with_alloc_lock((void*)GC_set_time_limit, value);
-}
\ No newline at end of file
+}
+
+jboolean Java_org_robovm_rt_GC_isIncremental(Env* env, Class* c) {
+    return rvmIsIncrementalGC(env);
+}
+
+jint Java_org_robovm_rt_GC_getFullFrequency(Env* env, Class* c) {
+    return (jint)(intptr_t)GC_call_with_alloc_lock((void*)GC_get_full_freq, NULL);
+}
+
+void Java_org_robovm_rt_GC_setFullFrequency(Env* env, Class* c, jint value) {
+    GC_call_with_alloc_lock((void*)GC_set_full_freq, (void*)(intptr_t)value);
+}
+
+jlong Java_org_robovm_rt_GC_getPauseCount(Env* env, Class* c) {
+    GCPauseStats stats;
+    rvmGetGCPauseStats(env, &stats);
+    return stats.count;
+}
+
+jlong Java_org_robovm_rt_GC_getTotalPauseTime(Env* env, Class* c) {
+    GCPauseStats stats;
+    rvmGetGCPauseStats(env, &stats);
+    return stats.totalTime;
+}
+
+jlong Java_org_robovm_rt_GC_getMaxPauseTime(Env* env, Class* c) {
+    GCPauseStats stats;
+    rvmGetGCPauseStats(env, &stats);
+    return stats.maxTime;
+}
+
+LongArray* Java_org_robovm_rt_GC_getPauseTimeHistogram(Env* env, Class* c) {
+    GCPauseStats stats;
+    rvmGetGCPauseStats(env, &stats);
+    LongArray* histogram = rvmNewLongArray(env, GC_PAUSE_HISTOGRAM_BUCKETS);
+    if (!histogram) {
+        return NULL;
+    }
+    memcpy(histogram->values, stats.histogram, sizeof(stats.histogram));
+    return histogram;
+}
+
+void Java_org_robovm_rt_GC_resetPauseTimeStats(Env* env, Class* c) {
+    rvmResetGCPauseStats(env);
+}
+
+jint Java_org_robovm_rt_GC_drainEvents0(Env* env, Class* c, LongArray* buffer) {
+    return rvmDrainGCEvents(env, (GCEvent*) buffer->values, buffer->length / (sizeof(GCEvent) / sizeof(jlong)));
+}
+
+jlong Java_org_robovm_rt_GC_getDroppedEventCount(Env* env, Class* c) {
+    return rvmGetDroppedGCEventCount(env);
+}
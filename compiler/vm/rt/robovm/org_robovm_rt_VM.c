@@ -137,6 +137,10 @@ ObjectArray* Java_org_robovm_rt_VM_getStackClasses(Env* env, Class* c, jint skip
     return result;
 }
 
+ObjectArray* Java_org_robovm_rt_VM_getHotThrowSites(Env* env, Class* c) {
+    return rvmGetHotThrowSites(env);
+}
+
 jlong Java_org_robovm_rt_VM_allocateMemory(Env* env, Class* c, jint size) {
     return PTR_TO_LONG(rvmAllocateMemory(env, size));
 }
@@ -32,7 +32,12 @@ jvalue* validateAndUnwrapArgs(Env* env, ObjectArray* parameterTypes, ObjectArray
     jint length = args->length;
     jvalue* jvalueArgs = length > 0 ? (jvalue*) rvmAllocateMemory(env, sizeof(jvalue) * length) : emptyJValueArgs;
     if (!jvalueArgs) return NULL;
+    if (!validateAndUnwrapArgsInto(env, parameterTypes, args, jvalueArgs)) return NULL;
+    return jvalueArgs;
+}
 
+jboolean validateAndUnwrapArgsInto(Env* env, ObjectArray* parameterTypes, ObjectArray* args, jvalue* jvalueArgs) {
+    jint length = args->length;
     jint i;
     for (i = 0; i < length; i++) {
         Object* arg = args->values[i];
@@ -44,7 +49,7 @@ jvalue* validateAndUnwrapArgs(Env* env, ObjectArray* parameterTypes, ObjectArray
                     rvmThrowNewf(env, java_lang_IllegalArgumentException, 
                         "argument %d should have type %s, got null", i + 1, typeName);
                 }
-                return NULL;
+                return FALSE;
             }
             if (!rvmUnbox(env, arg, type, &jvalueArgs[i])) {
                 if (rvmExceptionOccurred(env)->clazz == java_lang_ClassCastException) {
@@ -56,7 +61,7 @@ jvalue* validateAndUnwrapArgs(Env* env, ObjectArray* parameterTypes, ObjectArray
                             "argument %d should have type %s, got %s", i + 1, typeName, argTypeName);
                     }
                 }
-                return NULL;
+                return FALSE;
             }
         } else {
             if (arg && !rvmIsInstanceOf(env, arg, type)) {
@@ -66,12 +71,12 @@ jvalue* validateAndUnwrapArgs(Env* env, ObjectArray* parameterTypes, ObjectArray
                     rvmThrowNewf(env, java_lang_IllegalArgumentException, 
                         "argument %d should have type %s, got %s", i + 1, typeName, argTypeName);
                 }
-                return NULL;
+                return FALSE;
             }
             jvalueArgs[i].l = (jobject) arg;
         }
     }
-    return jvalueArgs;
+    return TRUE;
 }
 
 Object* createMethodObject(Env* env, Method* method) {
@@ -22,3 +22,4 @@ Method* getMethodFromMethodObject(Env* env, Object* methodObject);
 Field* getFieldFromFieldObject(Env* env, Object* fieldObject);
 void throwInvocationTargetException(Env* env, Object* throwable);
 jvalue* validateAndUnwrapArgs(Env* env, ObjectArray* parameterTypes, ObjectArray* args);
+jboolean validateAndUnwrapArgsInto(Env* env, ObjectArray* parameterTypes, ObjectArray* args, jvalue* jvalueArgs);